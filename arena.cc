@@ -0,0 +1,222 @@
+/*-----------------------------------------------------------------------------
+ *	arena, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN				16
+#define ARENA_MINIMUM			(64 * 1024)
+
+#define ALIGN(n)				(((n) + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1))
+
+struct arena_block
+{
+	arena_block				*next;
+	size_t					size;
+	size_t					used;
+};
+
+static pthread_key_t		arena_key;
+static pthread_once_t		arena_once = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		arenaAlloc - Allocate Memory from an Arena
+ *
+ *	SYNOPSIS
+ *		void *
+ *		arenaAlloc(
+ *			arena			*a,					- Arena
+ *			size_t			size)				- Bytes Needed
+ *
+ *	RETURN VALUE
+ *		Memory aligned for any type, or NULL if memory is exhausted. It
+ *		remains valid until the arena is reset or released.
+ *
+ *	DESCRIPTION
+ *		Memory comes from the current block while it has room; otherwise a
+ *		new block at least twice the size of the arena is added, so that
+ *		the number of blocks stays small however much is allocated.
+ *-----------------------------------------------------------------------------
+ */
+
+void *arenaAlloc (arena *a, size_t size)
+{
+	arena_block					*block = a->blocks;
+	size_t						blockSize;
+	void						*p;
+
+	size = ALIGN (size);
+
+	if ((block == (arena_block *) NULL) || (block->size - block->used < size))
+	{
+		blockSize = (a->total * 2 < ARENA_MINIMUM) ? ARENA_MINIMUM : a->total * 2;
+		if (blockSize < size)
+			blockSize = size;
+
+		block = (arena_block *) malloc (ALIGN (sizeof (arena_block)) + blockSize);
+		if (block == (arena_block *) NULL)
+			return NULL;
+
+		block->next = a->blocks;
+		block->size = blockSize;
+		block->used = 0;
+		a->blocks = block;
+		a->total += blockSize;
+	}
+
+	p = (char *) block + ALIGN (sizeof (arena_block)) + block->used;
+	block->used += size;
+	return p;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		arenaString - Copy a String into an Arena
+ *
+ *	SYNOPSIS
+ *		char *
+ *		arenaString(
+ *			arena			*a,					- Arena
+ *			const char		*s)					- String to Copy
+ *
+ *	RETURN VALUE
+ *		Copy of the string, or NULL if memory is exhausted.
+ *-----------------------------------------------------------------------------
+ */
+
+char *arenaString (arena *a, const char *s)
+{
+	size_t						length = strlen (s) + 1;
+	char						*copy;
+
+	copy = (char *) arenaAlloc (a, length);
+	if (copy != (char *) NULL)
+		memcpy (copy, s, length);
+
+	return copy;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		arenaReset - Release Everything Allocated, but Keep the Memory
+ *
+ *	SYNOPSIS
+ *		void
+ *		arenaReset(
+ *			arena			*a)					- Arena
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		If the arena grew to more than one block, the blocks are replaced
+ *		by a single block of the same total size, so that the next use of
+ *		similar size needs no allocation at all.
+ *-----------------------------------------------------------------------------
+ */
+
+void arenaReset (arena *a)
+{
+	size_t						total = a->total;
+
+	if ((a->blocks != (arena_block *) NULL) && (a->blocks->next == (arena_block *) NULL))
+	{
+		a->blocks->used = 0;
+		return;
+	}
+
+	arenaRelease (a);
+	if (total > 0)
+	{
+		a->total = total / 2;
+		if (arenaAlloc (a, total) != NULL)
+			a->blocks->used = 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		arenaRelease - Free all Memory of an Arena
+ *-----------------------------------------------------------------------------
+ */
+
+void arenaRelease (arena *a)
+{
+	arena_block					*block;
+	arena_block					*next;
+
+	for (block = a->blocks; block != (arena_block *) NULL; block = next)
+	{
+		next = block->next;
+		free (block);
+	}
+
+	a->blocks = (arena_block *) NULL;
+	a->total = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		freeThreadArena - Free the Arena of a Thread that is Exiting
+ *-----------------------------------------------------------------------------
+ */
+
+static void freeThreadArena (void *value)
+{
+	arenaRelease ((arena *) value);
+	free (value);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		createArenaKey - Create the Key for Arenas of Threads
+ *-----------------------------------------------------------------------------
+ */
+
+static void createArenaKey (void)
+{
+	pthread_key_create (&arena_key, freeThreadArena);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		threadArena - Get the Arena of the Calling Thread
+ *
+ *	SYNOPSIS
+ *		arena *
+ *		threadArena(void)
+ *
+ *	RETURN VALUE
+ *		Arena belonging to the calling thread, or NULL if memory is
+ *		exhausted.
+ *
+ *	DESCRIPTION
+ *		The arena is created on first use and released when the thread
+ *		exits. It is never shared, so it needs no locking; whoever uses it
+ *		resets it when done with what was allocated.
+ *-----------------------------------------------------------------------------
+ */
+
+arena *threadArena (void)
+{
+	arena						*a;
+
+	pthread_once (&arena_once, createArenaKey);
+
+	a = (arena *) pthread_getspecific (arena_key);
+	if (a == (arena *) NULL)
+	{
+		a = (arena *) calloc (1, sizeof (arena));
+		if (a != (arena *) NULL)
+			pthread_setspecific (arena_key, a);
+	}
+
+	return a;
+}
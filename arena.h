@@ -0,0 +1,33 @@
+/*-----------------------------------------------------------------------------
+ *	arena, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*-----------------------------------------------------------------------------
+ *	Memory that is allocated piecemeal and released all at once. A zero
+ *	filled arena is empty and ready to use.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct arena_block arena_block;
+
+typedef struct
+{
+	arena_block				*blocks;			/* Most recent first */
+	size_t					total;				/* Size of all blocks */
+}
+arena;
+
+void *arenaAlloc (arena *a, size_t size);
+char *arenaString (arena *a, const char *s);
+void arenaReset (arena *a);
+void arenaRelease (arena *a);
+arena *threadArena (void);
+
+#endif
@@ -0,0 +1,419 @@
+/*-----------------------------------------------------------------------------
+ *	base64, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#define BASE64_X86				1
+#endif
+
+#include "base64.h"
+
+/*-----------------------------------------------------------------------------
+ *	Base64 Decoding Table: 0-63 = value, 64 = whitespace, 65 = pad, 255 = bad
+ *-----------------------------------------------------------------------------
+ */
+
+static const unsigned char	base64_table [256] =
+{
+	255, 255, 255, 255, 255, 255, 255, 255, 255,  64,  64,  64,  64,  64, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	 64, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+	 52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255,  65, 255, 255,
+	255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+	 15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+	255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+	 41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
+
+/*-----------------------------------------------------------------------------
+ *	A block decoder decodes width characters to (width * 3) / 4 bytes if all
+ *	of them are in the Base64 alphabet, and returns width. Otherwise, it
+ *	writes nothing and returns the number of leading alphabet characters.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef int (*block_decoder) (const char *in, unsigned char *out);
+
+static const char * const	method_names [] =
+{
+	"scalar", "sse4.1", "avx2"
+};
+
+#ifdef BASE64_X86
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeBlockSse41 - Decode 16 Base64 Characters with SSE4.1
+ *
+ *	SYNOPSIS
+ *		static int
+ *		decodeBlockSse41(
+ *			const char		*in,				- 16 Characters
+ *			unsigned char	*out)				- 12 Bytes
+ *
+ *	RETURN VALUE
+ *		16 if decoded, otherwise the number of leading alphabet characters.
+ *
+ *	DESCRIPTION
+ *		Characters are classified and translated with nibble lookups
+ *		(pshufb), then four sextets are packed into three bytes with
+ *		multiply-add and a final shuffle (W. Mula and D. Lemire, "Faster
+ *		Base64 Encoding and Decoding Using AVX2 Instructions", 2018).
+ *-----------------------------------------------------------------------------
+ */
+
+__attribute__ ((target ("sse4.1")))
+static int decodeBlockSse41 (const char *in, unsigned char *out)
+{
+	const __m128i				lut_lo = _mm_setr_epi8 (
+										0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+										0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m128i				lut_hi = _mm_setr_epi8 (
+										0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+										0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i				lut_roll = _mm_setr_epi8 (
+										0, 16, 19, 4, -65, -65, -71, -71,
+										0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i				mask_2f = _mm_set1_epi8 (0x2f);
+	__m128i						str;
+	__m128i						hi_nibbles;
+	__m128i						lo_nibbles;
+	__m128i						lo;
+	__m128i						hi;
+	__m128i						roll;
+	__m128i						merged;
+	unsigned int				invalid;
+	unsigned char				packed [16];
+
+	str = _mm_loadu_si128 ((const __m128i *) in);
+	hi_nibbles = _mm_and_si128 (_mm_srli_epi32 (str, 4), mask_2f);
+	lo_nibbles = _mm_and_si128 (str, mask_2f);
+	lo = _mm_shuffle_epi8 (lut_lo, lo_nibbles);
+	hi = _mm_shuffle_epi8 (lut_hi, hi_nibbles);
+
+	if (! _mm_testz_si128 (lo, hi))
+	{
+		invalid = (unsigned int) _mm_movemask_epi8 (_mm_cmpeq_epi8 (_mm_and_si128 (lo, hi), _mm_setzero_si128 ())) ^ 0xffff;
+		return __builtin_ctz (invalid);
+	}
+
+	roll = _mm_shuffle_epi8 (lut_roll, _mm_add_epi8 (_mm_cmpeq_epi8 (str, mask_2f), hi_nibbles));
+	str = _mm_add_epi8 (str, roll);
+
+	merged = _mm_maddubs_epi16 (str, _mm_set1_epi32 (0x01400140));
+	merged = _mm_madd_epi16 (merged, _mm_set1_epi32 (0x00011000));
+	merged = _mm_shuffle_epi8 (merged, _mm_setr_epi8 (2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+	_mm_storeu_si128 ((__m128i *) packed, merged);
+	memcpy (out, packed, 12);
+	return 16;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeBlockAvx2 - Decode 32 Base64 Characters with AVX2
+ *
+ *	SYNOPSIS
+ *		static int
+ *		decodeBlockAvx2(
+ *			const char		*in,				- 32 Characters
+ *			unsigned char	*out)				- 24 Bytes
+ *
+ *	RETURN VALUE
+ *		32 if decoded, otherwise the number of leading alphabet characters.
+ *
+ *	DESCRIPTION
+ *		The same algorithm as decodeBlockSse41, on 256 bit vectors.
+ *-----------------------------------------------------------------------------
+ */
+
+__attribute__ ((target ("avx2")))
+static int decodeBlockAvx2 (const char *in, unsigned char *out)
+{
+	const __m256i				lut_lo = _mm256_setr_epi8 (
+										0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+										0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+										0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+										0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	const __m256i				lut_hi = _mm256_setr_epi8 (
+										0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+										0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+										0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+										0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i				lut_roll = _mm256_setr_epi8 (
+										0, 16, 19, 4, -65, -65, -71, -71,
+										0, 0, 0, 0, 0, 0, 0, 0,
+										0, 16, 19, 4, -65, -65, -71, -71,
+										0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i				mask_2f = _mm256_set1_epi8 (0x2f);
+	__m256i						str;
+	__m256i						hi_nibbles;
+	__m256i						lo_nibbles;
+	__m256i						lo;
+	__m256i						hi;
+	__m256i						roll;
+	__m256i						merged;
+	unsigned int				invalid;
+
+	str = _mm256_loadu_si256 ((const __m256i *) in);
+	hi_nibbles = _mm256_and_si256 (_mm256_srli_epi32 (str, 4), mask_2f);
+	lo_nibbles = _mm256_and_si256 (str, mask_2f);
+	lo = _mm256_shuffle_epi8 (lut_lo, lo_nibbles);
+	hi = _mm256_shuffle_epi8 (lut_hi, hi_nibbles);
+
+	if (! _mm256_testz_si256 (lo, hi))
+	{
+		invalid = ~ (unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_and_si256 (lo, hi), _mm256_setzero_si256 ()));
+		return __builtin_ctz (invalid);
+	}
+
+	roll = _mm256_shuffle_epi8 (lut_roll, _mm256_add_epi8 (_mm256_cmpeq_epi8 (str, mask_2f), hi_nibbles));
+	str = _mm256_add_epi8 (str, roll);
+
+	merged = _mm256_maddubs_epi16 (str, _mm256_set1_epi32 (0x01400140));
+	merged = _mm256_madd_epi16 (merged, _mm256_set1_epi32 (0x00011000));
+	merged = _mm256_shuffle_epi8 (merged, _mm256_setr_epi8 (
+										2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+										2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+	merged = _mm256_permutevar8x32_epi32 (merged, _mm256_setr_epi32 (0, 1, 2, 4, 5, 6, 7, 7));
+
+	_mm_storeu_si128 ((__m128i *) out, _mm256_castsi256_si128 (merged));
+	_mm_storel_epi64 ((__m128i *) (out + 16), _mm256_extracti128_si256 (merged, 1));
+	return 32;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeBase64With - Decode Base64 Text with a Specific Method
+ *
+ *	SYNOPSIS
+ *		bool
+ *		decodeBase64With(
+ *			int				method,				- BASE64_SCALAR, ...
+ *			const char		*in,				- Base64 Text
+ *			size_t			inLength,			- Length of Base64 Text
+ *			unsigned char	*out,				- Decoded Output
+ *			size_t			*outLength)			- Length of Decoded Output
+ *
+ *	RETURN VALUE
+ *		true if the text was valid Base64, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function decodes the body of a PEM block. Whitespace (including
+ *		line breaks) is skipped. Decoding stops at the first pad, after
+ *		which only pads and whitespace may follow; there must be two pads
+ *		after two sextets of the last quantum, or one after three. The
+ *		output buffer must hold at least (inLength * 3) / 4 bytes. It may
+ *		also be the input itself (out == in), since nothing is written past
+ *		the characters already read.
+ *
+ *		Whenever a whole number of quanta has been decoded, the next block of
+ *		characters is offered to the vector decoder (if any). When a block
+ *		contains a line break (or pad, or invalid character), the characters
+ *		up to and including it (and then up to the end of the quantum) are
+ *		decoded one at a time, so each line break costs one rejected block.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decodeBase64With (int method, const char *in, size_t inLength, unsigned char *out, size_t *outLength)
+{
+	size_t						i = 0;
+	size_t						n = 0;
+	size_t						limit;
+	unsigned int				accumulator = 0;
+	int							sextets = 0;
+	int							pads;
+	int							width = 0;
+	int							valid;
+	unsigned char				value;
+	block_decoder				block = (block_decoder) NULL;
+
+#ifdef BASE64_X86
+	if (method == BASE64_AVX2)
+	{
+		block = decodeBlockAvx2;
+		width = 32;
+	}
+	else if (method == BASE64_SSE41)
+	{
+		block = decodeBlockSse41;
+		width = 16;
+	}
+#endif
+
+	while (i < inLength)
+	{
+		if ((width == 0) || (inLength - i < (size_t) width))
+			limit = inLength;
+		else if (sextets != 0)
+			limit = i;
+		else
+		{
+			valid = (*block) (in + i, out + n);
+			if (valid == width)
+			{
+				i += width;
+				n += (width / 4) * 3;
+				continue;
+			}
+
+			limit = i + valid + 1;
+		}
+
+		for (; i < inLength; i++)
+		{
+			if ((i >= limit) && (sextets == 0))
+				break;
+
+			value = base64_table [(unsigned char) in [i]];
+			if (value < 64)
+			{
+				accumulator = (accumulator << 6) | value;
+				if (++sextets == 4)
+				{
+					out [n++] = (unsigned char) (accumulator >> 16);
+					out [n++] = (unsigned char) (accumulator >> 8);
+					out [n++] = (unsigned char) accumulator;
+					accumulator = 0;
+					sextets = 0;
+				}
+			}
+			else if (value == 65)
+			{
+				/*-------------------------------------------------------------
+				 *	Only pads and whitespace may follow the first pad, and
+				 *	the pads must complete the last quantum: two after two
+				 *	sextets, one after three.
+				 *-------------------------------------------------------------
+				 */
+
+				pads = 0;
+				for (; i < inLength; i++)
+				{
+					value = base64_table [(unsigned char) in [i]];
+					if (value == 65)
+						pads++;
+					else if (value != 64)
+						return false;
+				}
+
+				if ((sextets < 2) || (pads != 4 - sextets))
+					return false;
+				break;
+			}
+			else if (value != 64)
+				return false;
+		}
+	}
+
+	if (sextets == 1)
+		return false;
+	else if (sextets == 2)
+		out [n++] = (unsigned char) (accumulator >> 4);
+	else if (sextets == 3)
+	{
+		out [n++] = (unsigned char) (accumulator >> 10);
+		out [n++] = (unsigned char) (accumulator >> 2);
+	}
+
+	*outLength = n;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		base64Method - Best Base64 Method for this Processor
+ *
+ *	SYNOPSIS
+ *		int
+ *		base64Method(void)
+ *
+ *	RETURN VALUE
+ *		BASE64_AVX2, BASE64_SSE41, or BASE64_SCALAR.
+ *
+ *	DESCRIPTION
+ *		The processor is examined once; the result is remembered.
+ *-----------------------------------------------------------------------------
+ */
+
+static int detectMethod (void)
+{
+#ifdef BASE64_X86
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2"))
+		return BASE64_AVX2;
+	if (__builtin_cpu_supports ("sse4.1"))
+		return BASE64_SSE41;
+#endif
+	return BASE64_SCALAR;
+}
+
+int base64Method (void)
+{
+	static const int			method = detectMethod ();
+
+	return method;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		base64MethodName - Name of a Base64 Method
+ *
+ *	SYNOPSIS
+ *		const char *
+ *		base64MethodName(
+ *			int				method)				- BASE64_SCALAR, ...
+ *
+ *	RETURN VALUE
+ *		Name of the method.
+ *-----------------------------------------------------------------------------
+ */
+
+const char *base64MethodName (int method)
+{
+	if ((method < 0) || (method >= (int) (sizeof (method_names) / sizeof (method_names [0]))))
+		return "unknown";
+
+	return method_names [method];
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeBase64 - Decode Base64 Text
+ *
+ *	SYNOPSIS
+ *		bool
+ *		decodeBase64(
+ *			const char		*in,				- Base64 Text
+ *			size_t			inLength,			- Length of Base64 Text
+ *			unsigned char	*out,				- Decoded Output
+ *			size_t			*outLength)			- Length of Decoded Output
+ *
+ *	RETURN VALUE
+ *		true if the text was valid Base64, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function decodes with the best method for this processor.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decodeBase64 (const char *in, size_t inLength, unsigned char *out, size_t *outLength)
+{
+	return decodeBase64With (base64Method (), in, inLength, out, outLength);
+}
@@ -0,0 +1,21 @@
+/*-----------------------------------------------------------------------------
+ *	base64, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+
+#define BASE64_SCALAR			0
+#define BASE64_SSE41			1
+#define BASE64_AVX2				2
+
+bool decodeBase64 (const char *in, size_t inLength, unsigned char *out, size_t *outLength);
+bool decodeBase64With (int method, const char *in, size_t inLength, unsigned char *out, size_t *outLength);
+int base64Method (void);
+const char *base64MethodName (int method);
+
+#endif
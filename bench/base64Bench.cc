@@ -0,0 +1,270 @@
+/*-----------------------------------------------------------------------------
+ *	base64Bench, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../base64.h"
+
+static const char			*my_name;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		encodePem - Encode Bytes as a PEM Body
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		encodePem(
+ *			const unsigned char	*in,			- Bytes to Encode
+ *			size_t				length,			- Number of Bytes
+ *			int					lineLength,		- Characters per Line
+ *			const char			*newline,		- Line Terminator
+ *			char				*out)			- Encoded Text
+ *
+ *	RETURN VALUE
+ *		Length of the encoded text.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t encodePem (const unsigned char *in, size_t length, int lineLength, const char *newline, char *out)
+{
+	static const char			alphabet [] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t						i;
+	size_t						n = 0;
+	unsigned long				v;
+	int							column = 0;
+	int							j;
+	char						quantum [4];
+
+	for (i = 0; i < length; i += 3)
+	{
+		v = (unsigned long) in [i] << 16;
+		if (i + 1 < length)
+			v |= (unsigned long) in [i + 1] << 8;
+		if (i + 2 < length)
+			v |= in [i + 2];
+
+		quantum [0] = alphabet [(v >> 18) & 0x3f];
+		quantum [1] = alphabet [(v >> 12) & 0x3f];
+		quantum [2] = (i + 1 < length) ? alphabet [(v >> 6) & 0x3f] : '=';
+		quantum [3] = (i + 2 < length) ? alphabet [v & 0x3f] : '=';
+
+		for (j = 0; j < 4; j++)
+		{
+			out [n++] = quantum [j];
+			if (++column == lineLength)
+			{
+				memcpy (out + n, newline, strlen (newline));
+				n += strlen (newline);
+				column = 0;
+			}
+		}
+	}
+
+	return n;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		elapsed - Seconds Between two Monotonic Times
+ *-----------------------------------------------------------------------------
+ */
+
+static double elapsed (const struct timespec *start, const struct timespec *stop)
+{
+	return (double) (stop->tv_sec - start->tv_sec) + (double) (stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		verify - Check that every Method Agrees with the Scalar Decoder
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		verify(
+ *			int				trials)				- Number of Random Inputs
+ *
+ *	RETURN VALUE
+ *		true if every method produced the same result.
+ *
+ *	DESCRIPTION
+ *		Random lengths, line lengths, and line terminators are used, and
+ *		some inputs have an invalid character inserted, so that the vector
+ *		paths are exercised at every alignment.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool verify (int trials)
+{
+	unsigned char				data [4096];
+	char						text [8192];
+	unsigned char				expected [8192];
+	unsigned char				actual [8192];
+	size_t						length;
+	size_t						textLength;
+	size_t						expectedLength;
+	size_t						actualLength;
+	bool						expectedOk;
+	bool						actualOk;
+	int							trial;
+	int							method;
+	size_t						i;
+
+	for (trial = 0; trial < trials; trial++)
+	{
+		length = (size_t) (rand () % (int) sizeof (data));
+		for (i = 0; i < length; i++)
+			data [i] = (unsigned char) rand ();
+
+		textLength = encodePem (data, length, 4 * (1 + rand () % 20), (rand () & 1) ? "\r\n" : "\n", text);
+		if ((textLength > 0) && ((rand () % 8) == 0))
+			text [rand () % textLength] = "!-.\x80"[rand () % 4];
+
+		expectedOk = decodeBase64With (BASE64_SCALAR, text, textLength, expected, &expectedLength);
+
+		for (method = BASE64_SSE41; method <= base64Method (); method++)
+		{
+			actualOk = decodeBase64With (method, text, textLength, actual, &actualLength);
+			if ((actualOk != expectedOk)
+			  || (expectedOk && ((actualLength != expectedLength) || (memcmp (actual, expected, actualLength) != 0))))
+			{
+				fprintf (stderr, "%s: %s disagrees with scalar (trial %d, length %lu)\n", my_name, base64MethodName (method), trial, (unsigned long) length);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		measure - Measure Throughput of one Method
+ *
+ *	SYNOPSIS
+ *		static double
+ *		measure(
+ *			int				method,				- BASE64_SCALAR, ...
+ *			const char		*text,				- PEM Bodies
+ *			size_t			chunk,				- Length of each Body
+ *			size_t			textLength,			- Total Length
+ *			unsigned char	*out,				- Decoded Output
+ *			int				iterations)			- Passes over the Text
+ *
+ *	RETURN VALUE
+ *		Throughput in MB (10^6 bytes) of Base64 text per second.
+ *-----------------------------------------------------------------------------
+ */
+
+static double measure (int method, const char *text, size_t chunk, size_t textLength, unsigned char *out, int iterations)
+{
+	struct timespec				start;
+	struct timespec				stop;
+	size_t						offset;
+	size_t						outLength;
+	int							i;
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++)
+	{
+		for (offset = 0; offset + chunk <= textLength; offset += chunk)
+			decodeBase64With (method, text + offset, chunk, out, &outLength);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+
+	return ((double) textLength * iterations) / elapsed (&start, &stop) / 1e6;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		main - base64Bench main function
+ *
+ *	DESCRIPTION
+ *		Compare the throughput of the scalar and vector Base64 decoders on
+ *		one large PEM body and on certificate sized (about 1.5 KB) bodies.
+ *-----------------------------------------------------------------------------
+ */
+
+int main (int argc, const char *argv[])
+{
+	const size_t				certSize = 1152;
+	size_t						size = 16 * 1000 * 1000;
+	size_t						certText;
+	size_t						textLength;
+	int							iterations = 10;
+	int							method;
+	unsigned char				*data;
+	unsigned char				*out;
+	char						*text;
+	double						scalar [2];
+	double						mbps [2];
+	size_t						i;
+
+	my_name = strrchr (argv[0], '/');
+	my_name = (my_name == (char *) NULL) ? argv[0] : my_name + 1;
+
+	if (argc > 1)
+		size = (size_t) strtol (argv [1], (char **) NULL, 10) * 1000 * 1000;
+	if (argc > 2)
+		iterations = (int) strtol (argv [2], (char **) NULL, 10);
+
+	srand (20211001);
+
+	if (! verify (20000))
+		exit (1);
+
+	size -= size % certSize;
+	if (size == 0)
+		size = certSize;
+	data = (unsigned char *) malloc (size);
+	out = (unsigned char *) malloc (size);
+	text = (char *) malloc (size * 2);
+	if ((data == (unsigned char *) NULL) || (out == (unsigned char *) NULL) || (text == (char *) NULL))
+	{
+		fprintf (stderr, "%s: malloc failed\n", my_name);
+		exit (1);
+	}
+
+	for (i = 0; i < size; i++)
+		data [i] = (unsigned char) rand ();
+
+	/*-------------------------------------------------------------------------
+	 *	Certificate sized bodies are encoded back to back, so that every
+	 *	chunk of certText characters is one complete body.
+	 *-------------------------------------------------------------------------
+	 */
+
+	certText = 0;
+	for (textLength = 0, i = 0; i < size; i += certSize)
+	{
+		textLength += encodePem (data + i, certSize, 64, "\n", text + textLength);
+		if (certText == 0)
+			certText = textLength;
+	}
+
+	fprintf (stdout, "%-8s %14s %14s\n", "method", "1 body MB/s", "1.5KB MB/s");
+	for (method = BASE64_SCALAR; method <= base64Method (); method++)
+	{
+		mbps [0] = measure (method, text, textLength, textLength, out, iterations);
+		mbps [1] = measure (method, text, certText, textLength, out, iterations);
+
+		if (method == BASE64_SCALAR)
+		{
+			scalar [0] = mbps [0];
+			scalar [1] = mbps [1];
+		}
+
+		fprintf (stdout, "%-8s %9.0f %4.1fx %9.0f %4.1fx\n", base64MethodName (method),
+					mbps [0], mbps [0] / scalar [0], mbps [1], mbps [1] / scalar [1]);
+	}
+
+	free (data);
+	free (out);
+	free (text);
+	return 0;
+}
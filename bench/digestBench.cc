@@ -0,0 +1,301 @@
+/*-----------------------------------------------------------------------------
+ *	digestBench, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../digest.h"
+
+typedef void (*digest_function) (int method, const void *data, size_t length, unsigned char *digest);
+
+typedef struct
+{
+	const char				*name;
+	digest_function			function;
+	size_t					length;
+}
+digest_hash;
+
+typedef struct
+{
+	const char				*message;			/* NULL for a million 'a' */
+	const char				*sha256;
+	const char				*sha1;
+}
+known_answer;
+
+static const digest_hash	hashes [] =
+{
+	{"SHA-256", sha256DigestWith, SHA256_LENGTH},
+	{"SHA-1", sha1DigestWith, SHA1_LENGTH}
+};
+
+/*-----------------------------------------------------------------------------
+ *	Known answers from FIPS 180-2 (Appendices A and B) and the NIST example
+ *	values.
+ *-----------------------------------------------------------------------------
+ */
+
+static const known_answer	answers [] =
+{
+	{
+		"abc",
+		"BA:78:16:BF:8F:01:CF:EA:41:41:40:DE:5D:AE:22:23:B0:03:61:A3:96:17:7A:9C:B4:10:FF:61:F2:00:15:AD",
+		"A9:99:3E:36:47:06:81:6A:BA:3E:25:71:78:50:C2:6C:9C:D0:D8:9D"
+	},
+	{
+		"",
+		"E3:B0:C4:42:98:FC:1C:14:9A:FB:F4:C8:99:6F:B9:24:27:AE:41:E4:64:9B:93:4C:A4:95:99:1B:78:52:B8:55",
+		"DA:39:A3:EE:5E:6B:4B:0D:32:55:BF:EF:95:60:18:90:AF:D8:07:09"
+	},
+	{
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+		"24:8D:6A:61:D2:06:38:B8:E5:C0:26:93:0C:3E:60:39:A3:3C:E4:59:64:FF:21:67:F6:EC:ED:D4:19:DB:06:C1",
+		"84:98:3E:44:1C:3B:D2:6E:BA:AE:4A:A1:F9:51:29:E5:E5:46:70:F1"
+	},
+	{
+		(const char *) NULL,
+		"CD:C7:6E:5C:99:14:FB:92:81:A1:C7:E2:84:D7:3E:67:F1:80:9A:48:A4:97:20:0E:04:6D:39:CC:C7:11:2C:D0",
+		"34:AA:97:3C:D4:C4:DA:A4:F6:1E:EB:2B:DB:AD:27:31:65:34:01:6F"
+	}
+};
+
+static const char			*my_name;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		elapsed - Seconds Between two Monotonic Times
+ *-----------------------------------------------------------------------------
+ */
+
+static double elapsed (const struct timespec *start, const struct timespec *stop)
+{
+	return (double) (stop->tv_sec - start->tv_sec) + (double) (stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		knownAnswers - Check a Method against the Known Answers
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		knownAnswers(
+ *			int				method)				- DIGEST_PORTABLE, ...
+ *
+ *	RETURN VALUE
+ *		true if every digest was as expected.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool knownAnswers (int method)
+{
+	static char					million [1000000];
+	unsigned char				digest [SHA256_LENGTH];
+	char						fingerprint [SHA256_LENGTH * 3];
+	const char					*message;
+	const char					*expected;
+	size_t						length;
+	size_t						i;
+	size_t						h;
+
+	memset (million, 'a', sizeof (million));
+
+	for (i = 0; i < sizeof (answers) / sizeof (answers [0]); i++)
+	{
+		message = (answers [i].message == (const char *) NULL) ? million : answers [i].message;
+		length = (answers [i].message == (const char *) NULL) ? sizeof (million) : strlen (message);
+
+		for (h = 0; h < sizeof (hashes) / sizeof (hashes [0]); h++)
+		{
+			expected = (h == 0) ? answers [i].sha256 : answers [i].sha1;
+			(*hashes [h].function) (method, message, length, digest);
+			formatDigest (digest, hashes [h].length, fingerprint, sizeof (fingerprint));
+			if (strcmp (fingerprint, expected) != 0)
+			{
+				fprintf (stderr, "%s: %s %s of %lu bytes is %s, expected %s\n", my_name, digestMethodName (method),
+							hashes [h].name, (unsigned long) length, fingerprint, expected);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		verify - Check that a Method Agrees with the Portable Hashes
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		verify(
+ *			int				method,				- DIGEST_SHA_NI, ...
+ *			int				trials)				- Number of Random Inputs
+ *
+ *	RETURN VALUE
+ *		true if every digest was the same.
+ *
+ *	DESCRIPTION
+ *		Random lengths (and offsets, so the input is unaligned) cover every
+ *		number of whole blocks and both padding cases.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool verify (int method, int trials)
+{
+	unsigned char				data [4096 + 16];
+	unsigned char				expected [SHA256_LENGTH];
+	unsigned char				actual [SHA256_LENGTH];
+	size_t						offset;
+	size_t						length;
+	size_t						h;
+	int							trial;
+	size_t						i;
+
+	for (trial = 0; trial < trials; trial++)
+	{
+		offset = (size_t) (rand () % 16);
+		length = (size_t) (rand () % 4096);
+		for (i = 0; i < length; i++)
+			data [offset + i] = (unsigned char) rand ();
+
+		for (h = 0; h < sizeof (hashes) / sizeof (hashes [0]); h++)
+		{
+			(*hashes [h].function) (DIGEST_PORTABLE, data + offset, length, expected);
+			(*hashes [h].function) (method, data + offset, length, actual);
+			if (memcmp (actual, expected, hashes [h].length) != 0)
+			{
+				fprintf (stderr, "%s: %s %s disagrees with portable (trial %d, length %lu)\n", my_name,
+							digestMethodName (method), hashes [h].name, trial, (unsigned long) length);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		measure - Measure Throughput of one Hash and Method
+ *
+ *	SYNOPSIS
+ *		static double
+ *		measure(
+ *			const digest_hash	*hash,			- SHA-256 or SHA-1
+ *			int				method,				- DIGEST_PORTABLE, ...
+ *			const unsigned char	*data,			- Messages
+ *			size_t			chunk,				- Length of each Message
+ *			size_t			size,				- Total Length
+ *			int				iterations)			- Passes over the Data
+ *
+ *	RETURN VALUE
+ *		Throughput in MB (10^6 bytes) per second.
+ *-----------------------------------------------------------------------------
+ */
+
+static double measure (const digest_hash *hash, int method, const unsigned char *data, size_t chunk, size_t size, int iterations)
+{
+	struct timespec				start;
+	struct timespec				stop;
+	unsigned char				digest [SHA256_LENGTH];
+	size_t						offset;
+	int							i;
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+	for (i = 0; i < iterations; i++)
+	{
+		for (offset = 0; offset + chunk <= size; offset += chunk)
+			(*hash->function) (method, data + offset, chunk, digest);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+
+	return ((double) size * iterations) / elapsed (&start, &stop) / 1e6;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		main - digestBench main function
+ *
+ *	DESCRIPTION
+ *		Check the portable hashes, and the accelerated ones (if this
+ *		processor has them), against the known answers and each other, then
+ *		compare their throughput on one large message and on certificate
+ *		sized (about 1.5 KB) messages.
+ *-----------------------------------------------------------------------------
+ */
+
+int main (int argc, const char *argv[])
+{
+	const size_t				certSize = 1500;
+	size_t						size = 16 * 1000 * 1000;
+	int							iterations = 10;
+	int							methods [2];
+	int							count = 1;
+	int							m;
+	unsigned char				*data;
+	double						portable [2];
+	double						mbps [2];
+	size_t						h;
+	size_t						i;
+
+	my_name = strrchr (argv[0], '/');
+	my_name = (my_name == (char *) NULL) ? argv[0] : my_name + 1;
+
+	if (argc > 1)
+		size = (size_t) strtol (argv [1], (char **) NULL, 10) * 1000 * 1000;
+	if (argc > 2)
+		iterations = (int) strtol (argv [2], (char **) NULL, 10);
+
+	srand (20211001);
+
+	methods [0] = DIGEST_PORTABLE;
+	if (digestMethod () != DIGEST_PORTABLE)
+		methods [count++] = digestMethod ();
+
+	for (m = 0; m < count; m++)
+	{
+		if ((! knownAnswers (methods [m])) || ((m > 0) && (! verify (methods [m], 20000))))
+			exit (1);
+	}
+
+	size -= size % certSize;
+	if (size == 0)
+		size = certSize;
+	data = (unsigned char *) malloc (size);
+	if (data == (unsigned char *) NULL)
+	{
+		fprintf (stderr, "%s: malloc failed\n", my_name);
+		exit (1);
+	}
+
+	for (i = 0; i < size; i++)
+		data [i] = (unsigned char) rand ();
+
+	fprintf (stdout, "%-8s %-9s %14s %14s\n", "hash", "method", "1 msg MB/s", "1.5KB MB/s");
+	for (h = 0; h < sizeof (hashes) / sizeof (hashes [0]); h++)
+	{
+		for (m = 0; m < count; m++)
+		{
+			mbps [0] = measure (&hashes [h], methods [m], data, size, size, iterations);
+			mbps [1] = measure (&hashes [h], methods [m], data, certSize, size, iterations);
+
+			if (m == 0)
+			{
+				portable [0] = mbps [0];
+				portable [1] = mbps [1];
+			}
+
+			fprintf (stdout, "%-8s %-9s %9.0f %4.1fx %9.0f %4.1fx\n", hashes [h].name, digestMethodName (methods [m]),
+						mbps [0], mbps [0] / portable [0], mbps [1], mbps [1] / portable [1]);
+		}
+	}
+
+	free (data);
+	return 0;
+}
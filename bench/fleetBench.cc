@@ -0,0 +1,418 @@
+/*-----------------------------------------------------------------------------
+ *	fleetBench, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sys/ptrace.h>
+#endif
+
+#ifndef __WALL
+#define __WALL					0
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	Each scenario is run over the whole fleet (decodeCert -r DIR ...), for
+ *	files/sec, certs/sec, peak RSS, and the number of processes the tool
+ *	spawned, and then once for each of a sample of files, for the latency
+ *	of one file as a hook or cron job sees it (including process start).
+ *
+ *	Processes spawned are counted by tracing fork and vfork (Linux only);
+ *	elsewhere, or where tracing is not permitted, they are shown as "-".
+ *-----------------------------------------------------------------------------
+ */
+
+#define DEFAULT_SAMPLES			100
+#define RUNS					3				/* Best of, for whole fleet */
+#define MAX_ARGS				16
+
+typedef struct
+{
+	const char				*tool;
+	const char				*args [MAX_ARGS];
+}
+bench_scenario;
+
+typedef struct
+{
+	double					seconds;
+	long					peakRss;			/* KB */
+	int						children;			/* -1 if not known */
+	int						status;
+}
+run_result;
+
+static const char			*my_name;
+static char					**fleet_files;
+static int					fleet_count;
+static int					fleet_size;
+static long					fleet_certs;
+
+static const bench_scenario	scenarios [] =
+{
+	{ "decodeCert",	{ (const char *) NULL } },
+	{ "decodeCert",	{ "-o", "json", (const char *) NULL } },
+	{ "decodeCert",	{ "--expires-within", "30", (const char *) NULL } },
+	{ "decodeCert",	{ "--check-chain", (const char *) NULL } },
+	{ "deleteCert",	{ "-t", "-e", (const char *) NULL } },
+	{ "deleteCert",	{ "-t", "-i", "Bench Cross Root", (const char *) NULL } },
+	{ "deleteCert",	{ "-t", "-o", "csv", "-e", (const char *) NULL } },
+};
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		elapsed - Seconds Between two Monotonic Times
+ *-----------------------------------------------------------------------------
+ */
+
+static double elapsed (const struct timespec *start, const struct timespec *stop)
+{
+	return (double) (stop->tv_sec - start->tv_sec) + (double) (stop->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		countFile - Count one File of the Fleet, and its Certificates
+ *-----------------------------------------------------------------------------
+ */
+
+static int countFile (const char *path, const struct stat *st, int type, struct FTW * /* ftw */)
+{
+	const char					*cp;
+	char						**files;
+	char						*data;
+	FILE						*in;
+
+	cp = strrchr (path, '.');
+	if ((type != FTW_F) || (cp == (const char *) NULL) || (strcmp (cp, ".pem") != 0))
+		return 0;
+
+	if (fleet_count == fleet_size)
+	{
+		fleet_size = (fleet_size == 0) ? 1024 : fleet_size * 2;
+		files = (char **) realloc (fleet_files, fleet_size * sizeof (char *));
+		if (files == (char **) NULL)
+			return -1;
+		fleet_files = files;
+	}
+	fleet_files [fleet_count++] = strdup (path);
+
+	in = fopen (path, "r");
+	data = (char *) malloc (st->st_size + 1);
+	if ((in != (FILE *) NULL) && (data != (char *) NULL))
+	{
+		data [fread (data, 1, st->st_size, in)] = '\0';
+		for (cp = data; (cp = strstr (cp, "-----BEGIN CERTIFICATE-----")) != (const char *) NULL; cp++)
+			fleet_certs++;
+	}
+
+	if (in != (FILE *) NULL)
+		fclose (in);
+	free (data);
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		compareFiles - Sort Filenames
+ *-----------------------------------------------------------------------------
+ */
+
+static int compareFiles (const void *a, const void *b)
+{
+	return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		compareTimes - Sort Latencies
+ *-----------------------------------------------------------------------------
+ */
+
+static int compareTimes (const void *a, const void *b)
+{
+	double						x = *(const double *) a;
+	double						y = *(const double *) b;
+
+	return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		runTool - Run one Command, Measuring it
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		runTool(
+ *			const char		*argv[],			- Command and Arguments
+ *			run_result		*result)			- Measurements
+ *
+ *	RETURN VALUE
+ *		true if the command ran (whatever its exit status).
+ *
+ *	DESCRIPTION
+ *		Output is discarded. On Linux, the command is traced so that each
+ *		fork or vfork (by it or its descendants) is counted; threads are
+ *		not. The trace stops only at those events, so it costs nothing
+ *		while the command is running.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool runTool (const char *argv[], run_result *result)
+{
+	struct timespec				start;
+	struct timespec				stop;
+	struct rusage				usage;
+	pid_t						pid;
+	pid_t						w;
+	int							status;
+	int							fd;
+	bool						traced = false;
+
+	result->peakRss = 0;
+	result->children = -1;
+	result->status = -1;
+
+	clock_gettime (CLOCK_MONOTONIC, &start);
+
+	pid = fork ();
+	if (pid == -1)
+	{
+		fprintf (stderr, "%s: fork failed <%s>\n", my_name, strerror (errno));
+		return false;
+	}
+
+	if (pid == 0)
+	{
+		fd = open ("/dev/null", O_WRONLY);
+		dup2 (fd, 1);
+		dup2 (fd, 2);
+#ifdef __linux__
+		if (ptrace (PTRACE_TRACEME, 0, (void *) NULL, (void *) NULL) == 0)
+			raise (SIGSTOP);
+#endif
+		execv (argv [0], (char * const *) argv);
+		_exit (127);
+	}
+
+	for (;;)
+	{
+		w = wait4 (-1, &status, __WALL, &usage);
+		if (w == -1)
+			break;
+
+		if (WIFEXITED (status) || WIFSIGNALED (status))
+		{
+			if (w == pid)
+			{
+				result->peakRss = usage.ru_maxrss;
+				result->status = status;
+			}
+			continue;
+		}
+
+#ifdef __linux__
+		if (WIFSTOPPED (status))
+		{
+			int					event = status >> 16;
+			int					signal = WSTOPSIG (status);
+
+			if ((w == pid) && ! traced)
+			{
+				ptrace (PTRACE_SETOPTIONS, pid, (void *) NULL,
+						(void *) (long) (PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEEXEC | PTRACE_O_EXITKILL));
+				traced = true;
+				result->children = 0;
+				signal = 0;
+			}
+			else if ((event == PTRACE_EVENT_FORK) || (event == PTRACE_EVENT_VFORK))
+			{
+				result->children++;
+				signal = 0;
+			}
+			else if ((event != 0) || (signal == SIGSTOP) || (signal == SIGTRAP))
+				signal = 0;
+
+			ptrace (PTRACE_CONT, w, (void *) NULL, (void *) (long) signal);
+		}
+#endif
+	}
+
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+	result->seconds = elapsed (&start, &stop);
+
+#ifdef __APPLE__
+	result->peakRss /= 1024;
+#endif
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		runScenario - Measure one Scenario and Report it
+ *
+ *	SYNOPSIS
+ *		static void
+ *		runScenario(
+ *			const bench_scenario *scenario,		- Tool and Options
+ *			const char		*toolDirectory,		- Where the Tools are
+ *			const char		*fleet,				- Fleet Directory
+ *			int				samples)			- Files Run Singly
+ *-----------------------------------------------------------------------------
+ */
+
+static void runScenario (const bench_scenario *scenario, const char *toolDirectory, const char *fleet, int samples)
+{
+	char						tool [4096];
+	char						label [256];
+	const char					*argv [MAX_ARGS + 4];
+	run_result					result;
+	run_result					best;
+	double						*times;
+	int							argc = 0;
+	int							options;
+	int							step;
+	int							count = 0;
+	int							i;
+
+	snprintf (tool, sizeof (tool), "%s/%s", toolDirectory, scenario->tool);
+	argv [argc++] = tool;
+
+	snprintf (label, sizeof (label), "%s", scenario->tool);
+	for (i = 0; scenario->args [i] != (const char *) NULL; i++)
+	{
+		argv [argc++] = scenario->args [i];
+		snprintf (label + strlen (label), sizeof (label) - strlen (label), (strchr (scenario->args [i], ' ') == (char *) NULL) ? " %s" : " \"%s\"", scenario->args [i]);
+	}
+	options = argc;
+
+	/*-------------------------------------------------------------------------
+	 *	Whole fleet, best of RUNS after one to warm up.
+	 *-------------------------------------------------------------------------
+	 */
+
+	argv [argc++] = "-r";
+	argv [argc++] = fleet;
+	argv [argc] = (const char *) NULL;
+
+	if ((! runTool (argv, &best)) || (! runTool (argv, &best)))
+		return;
+
+	for (i = 1; i < RUNS; i++)
+	{
+		if (runTool (argv, &result) && (result.seconds < best.seconds))
+			best = result;
+	}
+
+	if (! WIFEXITED (best.status) || ((WEXITSTATUS (best.status) != 0) && (WEXITSTATUS (best.status) != 1)))
+		fprintf (stderr, "%s: %s: exit status 0x%x\n", my_name, label, best.status);
+
+	/*-------------------------------------------------------------------------
+	 *	One file at a time, evenly spaced through the fleet.
+	 *-------------------------------------------------------------------------
+	 */
+
+	times = (double *) malloc (samples * sizeof (double));
+	step = (fleet_count > samples) ? fleet_count / samples : 1;
+	for (i = 0; (times != (double *) NULL) && (i < fleet_count) && (count < samples); i += step)
+	{
+		argv [options] = fleet_files [i];
+		argv [options + 1] = (const char *) NULL;
+		if (runTool (argv, &result))
+			times [count++] = result.seconds;
+	}
+
+	qsort (times, count, sizeof (double), compareTimes);
+
+	if (best.children == -1)
+		fprintf (stdout, "%-40s %9.0f %10.0f %8.2f %8.2f %9ld %8s\n", label,
+					fleet_count / best.seconds, fleet_certs / best.seconds,
+					(count == 0) ? 0.0 : times [(count - 1) / 2] * 1000.0,
+					(count == 0) ? 0.0 : times [(count - 1) * 99 / 100] * 1000.0,
+					best.peakRss, "-");
+	else
+		fprintf (stdout, "%-40s %9.0f %10.0f %8.2f %8.2f %9ld %8d\n", label,
+					fleet_count / best.seconds, fleet_certs / best.seconds,
+					(count == 0) ? 0.0 : times [(count - 1) / 2] * 1000.0,
+					(count == 0) ? 0.0 : times [(count - 1) * 99 / 100] * 1000.0,
+					best.peakRss, best.children);
+	fflush (stdout);
+
+	free (times);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		main - fleetBench main function
+ *
+ *	SYNOPSIS
+ *		fleetBench fleet [tool directory [samples]]
+ *
+ *	DESCRIPTION
+ *		Run every scenario against a fleet written by fleetGen. Only test
+ *		mode (-t) is used with deleteCert, so that the fleet is unchanged
+ *		and the results of one run can be compared with the next.
+ *-----------------------------------------------------------------------------
+ */
+
+int main (int argc, const char *argv[])
+{
+	const char					*fleet;
+	const char					*toolDirectory = ".";
+	int							samples = DEFAULT_SAMPLES;
+	size_t						i;
+
+	my_name = strrchr (argv[0], '/');
+	my_name = (my_name == (char *) NULL) ? argv[0] : my_name + 1;
+
+	if (argc < 2)
+	{
+		fprintf (stderr, "usage: %s fleet [tool directory [samples]]\n", my_name);
+		exit (1);
+	}
+
+	fleet = argv [1];
+	if (argc > 2)
+		toolDirectory = argv [2];
+	if (argc > 3)
+		samples = (int) strtol (argv [3], (char **) NULL, 10);
+	if (samples < 1)
+		samples = 1;
+
+	if (nftw (fleet, countFile, 64, FTW_PHYS) == -1)
+	{
+		fprintf (stderr, "%s: nftw (%s) failed <%s>\n", my_name, fleet, strerror (errno));
+		exit (1);
+	}
+
+	if (fleet_count == 0)
+	{
+		fprintf (stderr, "%s: no *.pem files in %s\n", my_name, fleet);
+		exit (1);
+	}
+
+	qsort (fleet_files, fleet_count, sizeof (char *), compareFiles);
+
+	fprintf (stdout, "%s: %d files, %ld certificates, %d samples per scenario\n", my_name, fleet_count, fleet_certs, samples);
+	fprintf (stdout, "%-40s %9s %10s %8s %8s %9s %8s\n", "scenario", "files/s", "certs/s", "p50 ms", "p99 ms", "peak KB", "children");
+
+	for (i = 0; i < sizeof (scenarios) / sizeof (bench_scenario); i++)
+		runScenario (&scenarios [i], toolDirectory, fleet, samples);
+
+	return 0;
+}
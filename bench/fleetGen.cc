@@ -0,0 +1,507 @@
+/*-----------------------------------------------------------------------------
+ *	fleetGen, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/*-----------------------------------------------------------------------------
+ *	A synthetic certificate fleet, laid out like /etc/letsencrypt/live:
+ *
+ *		live/hostN/cert.pem			Leaf
+ *		live/hostN/chain.pem		Intermediate, then cross signed root ...
+ *		live/hostN/fullchain.pem	Both
+ *		bundles/bundleN.pem			Large CA bundles
+ *
+ *	A few intermediates are shared by every host, some leaves have expired,
+ *	and the cross signed root has expired (as DST Root CA X3 did). The
+ *	certificates are well formed but not signed (the signatures are random
+ *	bytes), which is all the tools look at.
+ *
+ *	Everything, including the dates, comes from the seed, so that the same
+ *	arguments always produce the same bytes, on any system.
+ *-----------------------------------------------------------------------------
+ */
+
+#define DEFAULT_HOSTS			1000
+#define DEFAULT_CHAIN			3
+#define DEFAULT_SEED			20211001
+#define INTERMEDIATES			4
+#define BUNDLES					4
+#define BUNDLE_CERTS			500
+#define EXPIRED_PERCENT			10
+#define KEY_ID_LENGTH			20
+#define MAX_DER					2048
+
+typedef struct
+{
+	unsigned char			name [1024];		/* DER encoded Name */
+	size_t					nameLength;
+	unsigned char			keyId [KEY_ID_LENGTH];
+}
+bench_ca;
+
+static const char			*my_name;
+static uint64_t				random_state;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextRandom - Next Value of the Generator (xorshift64*)
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t nextRandom (void)
+{
+	random_state ^= random_state >> 12;
+	random_state ^= random_state << 25;
+	random_state ^= random_state >> 27;
+	return random_state * 0x2545f4914f6cdd1dULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		randomBytes - Fill a Buffer from the Generator
+ *-----------------------------------------------------------------------------
+ */
+
+static void randomBytes (unsigned char *p, size_t length)
+{
+	while (length-- > 0)
+		*p++ = (unsigned char) (nextRandom () >> 56);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		tlv - Encode one DER Element
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		tlv(
+ *			unsigned char		*out,			- Encoded Element
+ *			int					tag,			- Tag
+ *			const unsigned char	*content,		- Content (may be at out)
+ *			size_t				length)			- Length of Content
+ *
+ *	RETURN VALUE
+ *		Length of the encoded element.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t tlv (unsigned char *out, int tag, const unsigned char *content, size_t length)
+{
+	size_t						header;
+
+	header = (length < 0x80) ? 2 : (length < 0x100) ? 3 : 4;
+	memmove (out + header, content, length);
+
+	out [0] = (unsigned char) tag;
+	if (header == 2)
+		out [1] = (unsigned char) length;
+	else if (header == 3)
+	{
+		out [1] = 0x81;
+		out [2] = (unsigned char) length;
+	}
+	else
+	{
+		out [1] = 0x82;
+		out [2] = (unsigned char) (length >> 8);
+		out [3] = (unsigned char) length;
+	}
+
+	return header + length;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		encodeName - Encode a Name of Organization and Common Name
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t encodeName (const char *organization, const char *commonName, unsigned char *out)
+{
+	static const unsigned char	oidOrganization [] = { 0x55, 0x04, 0x0a };
+	static const unsigned char	oidCommonName [] = { 0x55, 0x04, 0x03 };
+	unsigned char				attribute [512];
+	unsigned char				rdns [1024];
+	size_t						length;
+	size_t						n = 0;
+
+	length = tlv (attribute, 0x06, oidOrganization, sizeof (oidOrganization));
+	length += tlv (attribute + length, 0x0c, (const unsigned char *) organization, strlen (organization));
+	length = tlv (attribute, 0x30, attribute, length);
+	n += tlv (rdns + n, 0x31, attribute, length);
+
+	length = tlv (attribute, 0x06, oidCommonName, sizeof (oidCommonName));
+	length += tlv (attribute + length, 0x0c, (const unsigned char *) commonName, strlen (commonName));
+	length = tlv (attribute, 0x30, attribute, length);
+	n += tlv (rdns + n, 0x31, attribute, length);
+
+	return tlv (out, 0x30, rdns, n);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		encodeTime - Encode a Time as UTCTime (1950-2049) or GeneralizedTime
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t encodeTime (const char *text, unsigned char *out)
+{
+	if ((strncmp (text, "1950", 4) >= 0) && (strncmp (text, "2050", 4) < 0))
+		return tlv (out, 0x17, (const unsigned char *) text + 2, strlen (text) - 2);
+
+	return tlv (out, 0x18, (const unsigned char *) text, strlen (text));
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		makeCert - Encode one Certificate
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		makeCert(
+ *			const bench_ca	*subject,			- Subject Name and Key
+ *			const bench_ca	*issuer,			- Issuer Name and Key
+ *			const char		*notBefore,			- YYYYMMDDHHMMSSZ
+ *			const char		*notAfter,			- YYYYMMDDHHMMSSZ
+ *			unsigned char	*der)				- Certificate (MAX_DER)
+ *
+ *	RETURN VALUE
+ *		Length of the certificate.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t makeCert (const bench_ca *subject, const bench_ca *issuer, const char *notBefore, const char *notAfter, unsigned char *der)
+{
+	static const unsigned char	version [] = { 0x02, 0x01, 0x02 };
+	static const unsigned char	sha256WithRSA [] = { 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b, 0x05, 0x00 };
+	static const unsigned char	rsaEncryption [] = { 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00 };
+	static const unsigned char	exponent [] = { 0x02, 0x03, 0x01, 0x00, 0x01 };
+	static const unsigned char	oidSubjectKeyId [] = { 0x06, 0x03, 0x55, 0x1d, 0x0e };
+	static const unsigned char	oidAuthorityKeyId [] = { 0x06, 0x03, 0x55, 0x1d, 0x23 };
+	unsigned char				tbs [MAX_DER];
+	unsigned char				part [MAX_DER];
+	unsigned char				inner [512];
+	unsigned char				extensions [256];
+	size_t						n = 0;
+	size_t						length;
+	size_t						e = 0;
+
+	n += tlv (tbs + n, 0xa0, version, sizeof (version));
+
+	randomBytes (inner, 16);
+	inner [0] = (inner [0] & 0x7f) | 0x01;
+	n += tlv (tbs + n, 0x02, inner, 16);
+
+	n += tlv (tbs + n, 0x30, sha256WithRSA, sizeof (sha256WithRSA));
+
+	memcpy (tbs + n, issuer->name, issuer->nameLength);
+	n += issuer->nameLength;
+
+	length = encodeTime (notBefore, part);
+	length += encodeTime (notAfter, part + length);
+	n += tlv (tbs + n, 0x30, part, length);
+
+	memcpy (tbs + n, subject->name, subject->nameLength);
+	n += subject->nameLength;
+
+	/*-------------------------------------------------------------------------
+	 *	RSA public key: a random 2048 bit modulus and exponent 65537.
+	 *-------------------------------------------------------------------------
+	 */
+
+	inner [0] = 0x00;
+	randomBytes (inner + 1, 256);
+	inner [1] |= 0x80;
+	length = tlv (part, 0x02, inner, 257);
+	memcpy (part + length, exponent, sizeof (exponent));
+	length = tlv (part, 0x30, part, length + sizeof (exponent));
+	memmove (part + 1, part, length);
+	part [0] = 0x00;
+	length = tlv (part, 0x03, part, length + 1);
+	memmove (part + sizeof (rsaEncryption) + 2, part, length);
+	tlv (part, 0x30, rsaEncryption, sizeof (rsaEncryption));
+	n += tlv (tbs + n, 0x30, part, sizeof (rsaEncryption) + 2 + length);
+
+	/*-------------------------------------------------------------------------
+	 *	Subject and authority key identifiers.
+	 *-------------------------------------------------------------------------
+	 */
+
+	length = tlv (inner, 0x04, subject->keyId, KEY_ID_LENGTH);
+	memcpy (part, oidSubjectKeyId, sizeof (oidSubjectKeyId));
+	length = sizeof (oidSubjectKeyId) + tlv (part + sizeof (oidSubjectKeyId), 0x04, inner, length);
+	e += tlv (extensions + e, 0x30, part, length);
+
+	length = tlv (inner, 0x80, issuer->keyId, KEY_ID_LENGTH);
+	length = tlv (inner, 0x30, inner, length);
+	memcpy (part, oidAuthorityKeyId, sizeof (oidAuthorityKeyId));
+	length = sizeof (oidAuthorityKeyId) + tlv (part + sizeof (oidAuthorityKeyId), 0x04, inner, length);
+	e += tlv (extensions + e, 0x30, part, length);
+
+	e = tlv (extensions, 0x30, extensions, e);
+	n += tlv (tbs + n, 0xa3, extensions, e);
+
+	/*-------------------------------------------------------------------------
+	 *	Certificate: TBS, algorithm, and a random "signature".
+	 *-------------------------------------------------------------------------
+	 */
+
+	n = tlv (der, 0x30, tbs, n);
+	n += tlv (der + n, 0x30, sha256WithRSA, sizeof (sha256WithRSA));
+	inner [0] = 0x00;
+	randomBytes (inner + 1, 256);
+	n += tlv (der + n, 0x03, inner, 257);
+
+	return tlv (der, 0x30, der, n);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		makeCa - Name and Key Identifier of a new Certificate Subject
+ *-----------------------------------------------------------------------------
+ */
+
+static void makeCa (const char *organization, const char *commonName, bench_ca *ca)
+{
+	ca->nameLength = encodeName (organization, commonName, ca->name);
+	randomBytes (ca->keyId, KEY_ID_LENGTH);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		writePem - Append one Certificate to a PEM File
+ *-----------------------------------------------------------------------------
+ */
+
+static void writePem (FILE *out, const unsigned char *der, size_t length)
+{
+	static const char			alphabet [] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	unsigned long				v;
+	size_t						i;
+	int							column = 0;
+
+	fprintf (out, "-----BEGIN CERTIFICATE-----\n");
+	for (i = 0; i < length; i += 3)
+	{
+		v = (unsigned long) der [i] << 16;
+		if (i + 1 < length)
+			v |= (unsigned long) der [i + 1] << 8;
+		if (i + 2 < length)
+			v |= der [i + 2];
+
+		putc (alphabet [(v >> 18) & 0x3f], out);
+		putc (alphabet [(v >> 12) & 0x3f], out);
+		putc ((i + 1 < length) ? alphabet [(v >> 6) & 0x3f] : '=', out);
+		putc ((i + 2 < length) ? alphabet [v & 0x3f] : '=', out);
+
+		column += 4;
+		if (column == 64)
+		{
+			putc ('\n', out);
+			column = 0;
+		}
+	}
+	if (column != 0)
+		putc ('\n', out);
+	fprintf (out, "-----END CERTIFICATE-----\n");
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		openOutput - Create a File (and its Directory) in the Fleet
+ *-----------------------------------------------------------------------------
+ */
+
+static FILE *openOutput (const char *directory, const char *name)
+{
+	char						filename [4096];
+	FILE						*out;
+
+	if ((mkdir (directory, 0755) == -1) && (errno != EEXIST))
+	{
+		fprintf (stderr, "%s: mkdir (%s) failed <%s>\n", my_name, directory, strerror (errno));
+		exit (1);
+	}
+
+	snprintf (filename, sizeof (filename), "%s/%s", directory, name);
+	out = fopen (filename, "w");
+	if (out == (FILE *) NULL)
+	{
+		fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, filename, strerror (errno));
+		exit (1);
+	}
+
+	return out;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		main - fleetGen main function
+ *
+ *	SYNOPSIS
+ *		fleetGen directory [hosts [certificates per chain [seed]]]
+ *
+ *	DESCRIPTION
+ *		Write a fleet of hosts (default 1000), each with a fullchain.pem
+ *		of the given length (default 3: leaf, intermediate, and expired
+ *		cross signed root), plus BUNDLES bundles of BUNDLE_CERTS each.
+ *-----------------------------------------------------------------------------
+ */
+
+int main (int argc, const char *argv[])
+{
+	const char					*directory;
+	int							hosts = DEFAULT_HOSTS;
+	int							chain = DEFAULT_CHAIN;
+	char						path [4096];
+	char						name [256];
+	bench_ca					root;
+	bench_ca					crossRoot;
+	bench_ca					intermediates [INTERMEDIATES];
+	bench_ca					leaf;
+	bench_ca					other;
+	unsigned char				cross [MAX_DER];
+	size_t						crossLength;
+	unsigned char				issued [INTERMEDIATES][MAX_DER];
+	size_t						issuedLength [INTERMEDIATES];
+	unsigned char				der [MAX_DER];
+	size_t						length;
+	FILE						*files [3];
+	long						certs = 0;
+	int							i;
+	int							j;
+	int							k;
+
+	my_name = strrchr (argv[0], '/');
+	my_name = (my_name == (char *) NULL) ? argv[0] : my_name + 1;
+
+	if (argc < 2)
+	{
+		fprintf (stderr, "usage: %s directory [hosts [certificates per chain [seed]]]\n", my_name);
+		exit (1);
+	}
+
+	directory = argv [1];
+	if (argc > 2)
+		hosts = (int) strtol (argv [2], (char **) NULL, 10);
+	if (argc > 3)
+		chain = (int) strtol (argv [3], (char **) NULL, 10);
+	random_state = (argc > 4) ? (uint64_t) strtoull (argv [4], (char **) NULL, 10) : DEFAULT_SEED;
+	random_state = (random_state == 0) ? 1 : random_state;
+
+	if (chain < 1)
+		chain = 1;
+
+	/*-------------------------------------------------------------------------
+	 *	The shared hierarchy: a root, its intermediates, and the root cross
+	 *	signed by an expired root.
+	 *-------------------------------------------------------------------------
+	 */
+
+	makeCa ("Bench Trust", "Bench Root X1", &root);
+	makeCa ("Bench Legacy Trust", "Bench Cross Root", &crossRoot);
+	crossLength = makeCert (&root, &crossRoot, "20210120191403Z", "20210930180000Z", cross);
+
+	for (i = 0; i < INTERMEDIATES; i++)
+	{
+		snprintf (name, sizeof (name), "Bench R%d", i + 3);
+		makeCa ("Bench Trust", name, &intermediates [i]);
+		issuedLength [i] = makeCert (&intermediates [i], &root, "20200904000000Z", "20450915160000Z", issued [i]);
+	}
+
+	if ((mkdir (directory, 0755) == -1) && (errno != EEXIST))
+	{
+		fprintf (stderr, "%s: mkdir (%s) failed <%s>\n", my_name, directory, strerror (errno));
+		exit (1);
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Hosts.
+	 *-------------------------------------------------------------------------
+	 */
+
+	snprintf (path, sizeof (path), "%s/live", directory);
+	if ((mkdir (path, 0755) == -1) && (errno != EEXIST))
+	{
+		fprintf (stderr, "%s: mkdir (%s) failed <%s>\n", my_name, path, strerror (errno));
+		exit (1);
+	}
+
+	for (i = 0; i < hosts; i++)
+	{
+		snprintf (path, sizeof (path), "%s/live/host%d", directory, i);
+		files [0] = openOutput (path, "cert.pem");
+		files [1] = openOutput (path, "chain.pem");
+		files [2] = openOutput (path, "fullchain.pem");
+
+		snprintf (name, sizeof (name), "host%d.bench.example", i);
+		makeCa ("Bench Hosting", name, &leaf);
+		k = (int) (nextRandom () % INTERMEDIATES);
+
+		if ((int) (nextRandom () % 100) < EXPIRED_PERCENT)
+			length = makeCert (&leaf, &intermediates [k], "20210601000000Z", "20210830000000Z", der);
+		else
+			length = makeCert (&leaf, &intermediates [k], "20210901000000Z", "20490101000000Z", der);
+
+		writePem (files [0], der, length);
+		writePem (files [2], der, length);
+		certs += 2;
+
+		for (j = 1; j < chain; j++)
+		{
+			if (j == 1)
+			{
+				writePem (files [1], issued [k], issuedLength [k]);
+				writePem (files [2], issued [k], issuedLength [k]);
+			}
+			else if (j == 2)
+			{
+				writePem (files [1], cross, crossLength);
+				writePem (files [2], cross, crossLength);
+			}
+			else
+			{
+				writePem (files [1], issued [(k + j) % INTERMEDIATES], issuedLength [(k + j) % INTERMEDIATES]);
+				writePem (files [2], issued [(k + j) % INTERMEDIATES], issuedLength [(k + j) % INTERMEDIATES]);
+			}
+			certs += 2;
+		}
+
+		for (j = 0; j < 3; j++)
+			fclose (files [j]);
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Bundles of unrelated certificates.
+	 *-------------------------------------------------------------------------
+	 */
+
+	snprintf (path, sizeof (path), "%s/bundles", directory);
+	for (i = 0; i < BUNDLES; i++)
+	{
+		snprintf (name, sizeof (name), "bundle%d.pem", i);
+		files [0] = openOutput (path, name);
+
+		for (j = 0; j < BUNDLE_CERTS; j++)
+		{
+			snprintf (name, sizeof (name), "Bench Bundle CA %d-%d", i, j);
+			makeCa ("Bench Bundles", name, &other);
+			length = makeCert (&other, &other, "20150101000000Z", ((j % 10) == 0) ? "20200101000000Z" : "20400101000000Z", der);
+			writePem (files [0], der, length);
+			certs++;
+		}
+
+		fclose (files [0]);
+	}
+
+	fprintf (stdout, "%s: %d hosts, %d bundles, %ld certificates in %s\n", my_name, hosts, BUNDLES, certs, directory);
+	return 0;
+}
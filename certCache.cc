@@ -0,0 +1,304 @@
+/*-----------------------------------------------------------------------------
+ *	certCache, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "certCache.h"
+
+/*-----------------------------------------------------------------------------
+ *	Decoded certificates, keyed by a hash of their DER encoding. In a fleet
+ *	of fullchain.pem files almost every file repeats the same intermediates,
+ *	so each distinct certificate is decoded only once per run.
+ *
+ *	The table is split into shards, each with its own lock, so that worker
+ *	threads rarely contend. Each shard is a chained hash table that doubles
+ *	when it becomes full. The DER itself is kept with each entry, so that a
+ *	hash collision can never return the wrong certificate. An entry holds
+ *	only the fields asked for so far; asking for more decodes it again.
+ *-----------------------------------------------------------------------------
+ */
+
+#define CACHE_SHARDS			16
+#define CACHE_INITIAL_BUCKETS	64
+
+typedef struct cache_entry
+{
+	struct cache_entry		*next;
+	uint64_t				hash;
+	size_t					length;
+	bool					valid;				/* decodeCertificate result */
+	int						fields;				/* Fields in info */
+	cert_info				info;
+	unsigned char			der [1];			/* length bytes */
+}
+cache_entry;
+
+typedef struct
+{
+	pthread_mutex_t			mutex;
+	cache_entry				**buckets;
+	size_t					bucketCount;
+	size_t					entryCount;
+	unsigned long			hits;
+	unsigned long			misses;
+}
+cache_shard;
+
+static cache_shard			shards [CACHE_SHARDS];
+static pthread_once_t		cache_once = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashDer - Hash a DER Encoded Certificate
+ *
+ *	SYNOPSIS
+ *		static uint64_t
+ *		hashDer(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
+ *
+ *	RETURN VALUE
+ *		64 bit hash.
+ *
+ *	DESCRIPTION
+ *		Eight bytes are mixed per step with a multiply and rotate, which is
+ *		several times faster than a byte at a time hash such as FNV-1a, and
+ *		is more than good enough to spread certificates over the table.
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t hashDer (const unsigned char *der, size_t length)
+{
+	const uint64_t				prime = 0x9e3779b97f4a7c15ULL;
+	uint64_t					h = length * prime;
+	uint64_t					word;
+	size_t						i;
+
+	for (i = 0; i + 8 <= length; i += 8)
+	{
+		memcpy (&word, der + i, 8);
+		h = (h ^ word) * prime;
+		h = (h << 29) | (h >> 35);
+	}
+
+	word = 0;
+	memcpy (&word, der + i, length - i);
+	h = (h ^ word) * prime;
+
+	return h ^ (h >> 32);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		initCache - Initialize the Shards
+ *-----------------------------------------------------------------------------
+ */
+
+static void initCache (void)
+{
+	int							i;
+
+	for (i = 0; i < CACHE_SHARDS; i++)
+	{
+		pthread_mutex_init (&shards [i].mutex, NULL);
+		shards [i].buckets = (cache_entry **) NULL;
+		shards [i].bucketCount = 0;
+		shards [i].entryCount = 0;
+		shards [i].hits = 0;
+		shards [i].misses = 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		growShard - Double the Number of Buckets in a Shard
+ *
+ *	SYNOPSIS
+ *		static void
+ *		growShard(
+ *			cache_shard		*shard)				- Shard to Grow (Locked)
+ *
+ *	RETURN VALUE
+ *		None. If memory is exhausted the shard keeps its current buckets,
+ *		which only makes the chains longer.
+ *-----------------------------------------------------------------------------
+ */
+
+static void growShard (cache_shard *shard)
+{
+	cache_entry					**buckets;
+	cache_entry					*entry;
+	cache_entry					*next;
+	size_t						bucketCount;
+	size_t						i;
+
+	bucketCount = (shard->bucketCount == 0) ? CACHE_INITIAL_BUCKETS : shard->bucketCount * 2;
+	buckets = (cache_entry **) calloc (bucketCount, sizeof (cache_entry *));
+	if (buckets == (cache_entry **) NULL)
+		return;
+
+	for (i = 0; i < shard->bucketCount; i++)
+	{
+		for (entry = shard->buckets [i]; entry != (cache_entry *) NULL; entry = next)
+		{
+			next = entry->next;
+			entry->next = buckets [(entry->hash / CACHE_SHARDS) % bucketCount];
+			buckets [(entry->hash / CACHE_SHARDS) % bucketCount] = entry;
+		}
+	}
+
+	free (shard->buckets);
+	shard->buckets = buckets;
+	shard->bucketCount = bucketCount;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeCached - Decode a Certificate, Using the Cache
+ *
+ *	SYNOPSIS
+ *		bool
+ *		decodeCached(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length,			- Length of Certificate
+ *			int					fields,			- CERT_FIELD_ISSUER | ...
+ *			cert_info			*info)			- Decoded Certificate
+ *
+ *	RETURN VALUE
+ *		Same as decodeCertificateFields.
+ *
+ *	DESCRIPTION
+ *		If an identical certificate has already been decoded with (at least)
+ *		these fields, its result is copied to info. Otherwise the certificate
+ *		is decoded, with these fields and those already cached, and the
+ *		result (including failure) is saved. Safe to call from any thread.
+ *
+ *		The lock is not held while decoding, so two threads may both decode
+ *		a new certificate; the second simply finds the first one's entry
+ *		and discards its own.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decodeCached (const unsigned char *der, size_t length, int fields, cert_info *info)
+{
+	uint64_t					hash = hashDer (der, length);
+	cache_shard					*shard;
+	cache_entry					*entry;
+	cache_entry					*newEntry;
+	cache_entry					**bucket;
+	bool						valid;
+
+	pthread_once (&cache_once, initCache);
+	shard = &shards [hash % CACHE_SHARDS];
+
+	pthread_mutex_lock (&shard->mutex);
+	if (shard->bucketCount > 0)
+	{
+		for (entry = shard->buckets [(hash / CACHE_SHARDS) % shard->bucketCount]; entry != (cache_entry *) NULL; entry = entry->next)
+		{
+			if ((entry->hash == hash) && (entry->length == length) && (memcmp (entry->der, der, length) == 0))
+			{
+				if ((entry->fields & fields) != fields)
+				{
+					fields |= entry->fields;
+					break;
+				}
+
+				shard->hits++;
+				*info = entry->info;
+				valid = entry->valid;
+				pthread_mutex_unlock (&shard->mutex);
+				return valid;
+			}
+		}
+	}
+	shard->misses++;
+	pthread_mutex_unlock (&shard->mutex);
+
+	valid = decodeCertificateFields (der, length, fields, info);
+
+	newEntry = (cache_entry *) malloc (sizeof (cache_entry) + length);
+	if (newEntry == (cache_entry *) NULL)
+		return valid;
+
+	newEntry->hash = hash;
+	newEntry->length = length;
+	newEntry->valid = valid;
+	newEntry->fields = fields;
+	newEntry->info = *info;
+	memcpy (newEntry->der, der, length);
+
+	pthread_mutex_lock (&shard->mutex);
+	if (shard->entryCount >= shard->bucketCount)
+		growShard (shard);
+
+	if (shard->bucketCount == 0)
+		free (newEntry);
+	else
+	{
+		bucket = &shard->buckets [(hash / CACHE_SHARDS) % shard->bucketCount];
+		for (entry = *bucket; entry != (cache_entry *) NULL; entry = entry->next)
+		{
+			if ((entry->hash == hash) && (entry->length == length) && (memcmp (entry->der, der, length) == 0))
+				break;
+		}
+
+		if (entry != (cache_entry *) NULL)
+		{
+			if ((entry->fields & fields) == entry->fields)
+			{
+				entry->fields = fields;
+				entry->info = newEntry->info;
+			}
+			free (newEntry);
+		}
+		else
+		{
+			newEntry->next = *bucket;
+			*bucket = newEntry;
+			shard->entryCount++;
+		}
+	}
+	pthread_mutex_unlock (&shard->mutex);
+
+	return valid;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		cacheStatistics - Report Cache Hits and Misses
+ *
+ *	SYNOPSIS
+ *		void
+ *		cacheStatistics(
+ *			unsigned long	*hits,				- Certificates Found in Cache
+ *			unsigned long	*misses)			- Certificates Decoded
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void cacheStatistics (unsigned long *hits, unsigned long *misses)
+{
+	int							i;
+
+	pthread_once (&cache_once, initCache);
+
+	*hits = 0;
+	*misses = 0;
+	for (i = 0; i < CACHE_SHARDS; i++)
+	{
+		pthread_mutex_lock (&shards [i].mutex);
+		*hits += shards [i].hits;
+		*misses += shards [i].misses;
+		pthread_mutex_unlock (&shards [i].mutex);
+	}
+}
@@ -0,0 +1,17 @@
+/*-----------------------------------------------------------------------------
+ *	certCache, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTCACHE_H
+#define CERTCACHE_H
+
+#include <stddef.h>
+
+#include "certDecode.h"
+
+bool decodeCached (const unsigned char *der, size_t length, int fields, cert_info *info);
+void cacheStatistics (unsigned long *hits, unsigned long *misses);
+
+#endif
@@ -0,0 +1,689 @@
+/*-----------------------------------------------------------------------------
+ *	certChain, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "certCache.h"
+#include "certChain.h"
+#include "dirWalk.h"
+#include "pemScan.h"
+
+/*-----------------------------------------------------------------------------
+ *	Certificates are found by subject key identifier, or (for those without
+ *	one, or when the authority key identifier does not find the issuer) by
+ *	subject name, in open addressing hash tables of pointers. Each lookup
+ *	is constant time, so a chain is built in time linear in its length.
+ *
+ *	The pool holds the intermediates from --pool DIR and those of the files
+ *	to be checked, all loaded before any file is checked, so that a chain
+ *	is completed the same way whatever the number of jobs. It keeps the
+ *	first certificate with any given key, so the pool directory takes
+ *	precedence.
+ *-----------------------------------------------------------------------------
+ */
+
+#define POOL_PATTERNS			"*.pem,*.crt,*.cer"
+
+typedef struct
+{
+	const char				*filename;
+	int						added;
+	bool					intermediates;		/* Skip the first (the leaf) */
+	chain_filter			keep;				/* NULL to keep all */
+}
+pool_context;
+
+typedef struct
+{
+	const chain_cert		**slots;
+	size_t					size;				/* Power of 2 */
+	size_t					count;
+	bool					byKeyId;			/* Otherwise by subject */
+}
+chain_table;
+
+static pthread_mutex_t		pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static arena				pool_arena;
+static chain_table			pool_by_key_id = { (const chain_cert **) NULL, 0, 0, true };
+static chain_table			pool_by_subject = { (const chain_cert **) NULL, 0, 0, false };
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashKey - FNV-1a Hash of a Key Identifier or Name
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t hashKey (const void *key, size_t length)
+{
+	const unsigned char			*p = (const unsigned char *) key;
+	uint64_t					h = 0xcbf29ce484222325ULL;
+
+	while (length-- > 0)
+	{
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		certKey - Get the Key a Certificate is Filed Under in a Table
+ *-----------------------------------------------------------------------------
+ */
+
+static const void *certKey (const chain_table *table, const chain_cert *cert, size_t *length)
+{
+	if (table->byKeyId)
+	{
+		*length = cert->keyIdLength;
+		return cert->keyId;
+	}
+
+	*length = strlen (cert->subject);
+	return cert->subject;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		tableFind - Find the First Certificate Filed Under a Key
+ *
+ *	SYNOPSIS
+ *		static const chain_cert *
+ *		tableFind(
+ *			const chain_table	*table,			- Table
+ *			const void			*key,			- Key Identifier or Name
+ *			size_t				length)			- Length of Key
+ *
+ *	RETURN VALUE
+ *		The certificate, or NULL if there is none.
+ *-----------------------------------------------------------------------------
+ */
+
+static const chain_cert *tableFind (const chain_table *table, const void *key, size_t length)
+{
+	const void					*other;
+	size_t						otherLength;
+	size_t						i;
+
+	if ((table->size == 0) || (length == 0))
+		return (const chain_cert *) NULL;
+
+	for (i = hashKey (key, length) & (table->size - 1); table->slots [i] != (const chain_cert *) NULL; i = (i + 1) & (table->size - 1))
+	{
+		other = certKey (table, table->slots [i], &otherLength);
+		if ((otherLength == length) && (memcmp (other, key, length) == 0))
+			return table->slots [i];
+	}
+
+	return (const chain_cert *) NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		tableAdd - File a Certificate Under its Key, Unless One Already Is
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		tableAdd(
+ *			chain_table			*table,			- Table (with room)
+ *			const chain_cert	*cert)			- Certificate
+ *
+ *	RETURN VALUE
+ *		true if added, false if the key was already present (or empty).
+ *-----------------------------------------------------------------------------
+ */
+
+static bool tableAdd (chain_table *table, const chain_cert *cert)
+{
+	const void					*key;
+	size_t						length;
+	size_t						i;
+
+	key = certKey (table, cert, &length);
+	if ((length == 0) || (tableFind (table, key, length) != (const chain_cert *) NULL))
+		return false;
+
+	for (i = hashKey (key, length) & (table->size - 1); table->slots [i] != (const chain_cert *) NULL; i = (i + 1) & (table->size - 1))
+		;
+
+	table->slots [i] = cert;
+	table->count++;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		tableGrow - Make Room in a Table for One More Certificate
+ *-----------------------------------------------------------------------------
+ */
+
+static bool tableGrow (chain_table *table)
+{
+	chain_table					grown;
+	size_t						i;
+
+	if ((table->count + 1) * 2 <= table->size)
+		return true;
+
+	grown = *table;
+	grown.size = (table->size == 0) ? 64 : table->size * 2;
+	grown.count = 0;
+	grown.slots = (const chain_cert **) calloc (grown.size, sizeof (const chain_cert *));
+	if (grown.slots == (const chain_cert **) NULL)
+		return false;
+
+	for (i = 0; i < table->size; i++)
+	{
+		if (table->slots [i] != (const chain_cert *) NULL)
+			tableAdd (&grown, table->slots [i]);
+	}
+
+	free (table->slots);
+	*table = grown;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		selfSigned - Is a Certificate its Own Issuer (a Root)?
+ *-----------------------------------------------------------------------------
+ */
+
+static bool selfSigned (const chain_cert *cert)
+{
+	if (strcmp (cert->subject, cert->issuer) != 0)
+		return false;
+
+	return (cert->authorityKeyIdLength == 0) || (cert->keyIdLength == 0)
+		|| ((cert->authorityKeyIdLength == cert->keyIdLength) && (memcmp (cert->authorityKeyId, cert->keyId, cert->keyIdLength) == 0));
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		findIssuer - Find the Issuer of a Certificate in a Pair of Tables
+ *
+ *	SYNOPSIS
+ *		static const chain_cert *
+ *		findIssuer(
+ *			const chain_cert	*cert,			- Certificate
+ *			const chain_table	*byKeyId,		- Certificates by Key Identifier
+ *			const chain_table	*bySubject)		- Certificates by Subject
+ *
+ *	RETURN VALUE
+ *		The issuer, or NULL if it is not in the tables (or cert is a root).
+ *
+ *	DESCRIPTION
+ *		The authority key identifier is tried first. A certificate found by
+ *		name alone is not accepted if both key identifiers are known and
+ *		differ, since that is a different key of the same authority.
+ *-----------------------------------------------------------------------------
+ */
+
+static const chain_cert *findIssuer (const chain_cert *cert, const chain_table *byKeyId, const chain_table *bySubject)
+{
+	const chain_cert			*issuer = (const chain_cert *) NULL;
+
+	if (selfSigned (cert))
+		return issuer;
+
+	if (cert->authorityKeyIdLength > 0)
+		issuer = tableFind (byKeyId, cert->authorityKeyId, cert->authorityKeyIdLength);
+
+	if (issuer == (const chain_cert *) NULL)
+	{
+		issuer = tableFind (bySubject, cert->issuer, strlen (cert->issuer));
+		if ((issuer != (const chain_cert *) NULL) && (cert->authorityKeyIdLength > 0) && (issuer->keyIdLength > 0)
+		  && ((issuer->keyIdLength != cert->authorityKeyIdLength) || (memcmp (issuer->keyId, cert->authorityKeyId, issuer->keyIdLength) != 0)))
+			issuer = (const chain_cert *) NULL;
+	}
+
+	return (issuer == cert) ? (const chain_cert *) NULL : issuer;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		inFile - Is a Certificate One of Those in a File (not the Pool)?
+ *-----------------------------------------------------------------------------
+ */
+
+static bool inFile (const chain_cert *cert, const chain_cert *certs, int count)
+{
+	return (cert >= certs) && (cert < certs + count);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		chainCert - Describe a Decoded Certificate for Chain Building
+ *
+ *	SYNOPSIS
+ *		void
+ *		chainCert(
+ *			const cert_info	*info,				- Decoded Certificate
+ *			int				index,				- Number in File
+ *			chain_cert		*cert)				- Certificate for Chain
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		cert refers to the strings of info, which must outlive it. pem and
+ *		source are left for the caller to set.
+ *-----------------------------------------------------------------------------
+ */
+
+void chainCert (const cert_info *info, int index, chain_cert *cert)
+{
+	cert->subject = info->subject;
+	cert->issuer = info->issuer;
+	cert->keyId = info->subjectKeyId;
+	cert->keyIdLength = info->subjectKeyIdLength;
+	cert->authorityKeyId = info->authorityKeyId;
+	cert->authorityKeyIdLength = info->authorityKeyIdLength;
+	cert->index = index;
+	cert->pem = (const char *) NULL;
+	cert->pemLength = 0;
+	cert->source = (const char *) NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addChainPool - Add a Certificate to the Pool of Intermediates
+ *
+ *	SYNOPSIS
+ *		void
+ *		addChainPool(
+ *			const chain_cert	*cert)			- Certificate, with pem
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Everything the certificate refers to is copied. A certificate whose
+ *		keys are already in the pool is ignored, as is a root (which belongs
+ *		in a trust store, not in a chain). May be called by several threads
+ *		at once.
+ *-----------------------------------------------------------------------------
+ */
+
+void addChainPool (const chain_cert *cert)
+{
+	chain_cert					*copy;
+	unsigned char				*keys;
+	char						*text;
+	size_t						subjectLength;
+	size_t						issuerLength;
+	size_t						sourceLength;
+
+	if (selfSigned (cert) || (cert->pem == (const char *) NULL))
+		return;
+
+	pthread_mutex_lock (&pool_mutex);
+
+	if (((cert->keyIdLength == 0) || (tableFind (&pool_by_key_id, cert->keyId, cert->keyIdLength) != (const chain_cert *) NULL))
+	  && (tableFind (&pool_by_subject, cert->subject, strlen (cert->subject)) != (const chain_cert *) NULL))
+	{
+		pthread_mutex_unlock (&pool_mutex);
+		return;
+	}
+
+	subjectLength = strlen (cert->subject) + 1;
+	issuerLength = strlen (cert->issuer) + 1;
+	sourceLength = (cert->source == (const char *) NULL) ? 0 : strlen (cert->source) + 1;
+
+	copy = (chain_cert *) arenaAlloc (&pool_arena, sizeof (chain_cert));
+	keys = (unsigned char *) arenaAlloc (&pool_arena, cert->keyIdLength + cert->authorityKeyIdLength + 1);
+	text = (char *) arenaAlloc (&pool_arena, subjectLength + issuerLength + sourceLength + cert->pemLength);
+
+	if ((copy == (chain_cert *) NULL) || (keys == (unsigned char *) NULL) || (text == (char *) NULL)
+	  || (! tableGrow (&pool_by_key_id)) || (! tableGrow (&pool_by_subject)))
+	{
+		pthread_mutex_unlock (&pool_mutex);
+		return;
+	}
+
+	*copy = *cert;
+	copy->index = -1;
+
+	memcpy (keys, cert->keyId, cert->keyIdLength);
+	memcpy (keys + cert->keyIdLength, cert->authorityKeyId, cert->authorityKeyIdLength);
+	copy->keyId = keys;
+	copy->authorityKeyId = keys + cert->keyIdLength;
+
+	copy->subject = (const char *) memcpy (text, cert->subject, subjectLength);
+	text += subjectLength;
+	copy->issuer = (const char *) memcpy (text, cert->issuer, issuerLength);
+	text += issuerLength;
+	if (sourceLength > 0)
+	{
+		copy->source = (const char *) memcpy (text, cert->source, sourceLength);
+		text += sourceLength;
+	}
+	copy->pem = (const char *) memcpy (text, cert->pem, cert->pemLength);
+
+	tableAdd (&pool_by_key_id, copy);
+	tableAdd (&pool_by_subject, copy);
+
+	pthread_mutex_unlock (&pool_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		poolCallback - Add one Certificate from a Pool File
+ *
+ *	SYNOPSIS
+ *		static void
+ *		poolCallback(
+ *			void				*context,		- pool_context
+ *			int					count,			- Certificate Number
+ *			const pem_block		*block,			- Location in File
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		In a file to be checked, the first certificate is taken to be the
+ *		leaf, and is not added, nor is any that the filter rejects.
+ *-----------------------------------------------------------------------------
+ */
+
+static void poolCallback (void *context, int count, const pem_block *block, const unsigned char *der, size_t length)
+{
+	pool_context				*pool = (pool_context *) context;
+	cert_info					info;
+	chain_cert					cert;
+
+	if (pool->intermediates && (count == 1))
+		return;
+
+	if ((pool->keep != (chain_filter) NULL) && ! (*pool->keep) (count, der, length))
+		return;
+
+	if ((der == (const unsigned char *) NULL) || (! decodeCached (der, length, CERT_FIELD_ISSUER | CERT_FIELD_SUBJECT | CERT_FIELD_KEY_IDS, &info)))
+		return;
+
+	chainCert (&info, -1, &cert);
+	cert.pem = block->begin;
+	cert.pemLength = block->end - block->begin;
+	cert.source = pool->filename;
+	addChainPool (&cert);
+	pool->added++;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadPoolFile - Add the Certificates in one File to the Pool
+ *-----------------------------------------------------------------------------
+ */
+
+static void loadPoolFile (const char *filename, pool_context *pool)
+{
+	pem_file					file;
+
+	if (! openPemFile (filename, &file))
+		return;
+
+	pool->filename = filename;
+	readPemFile (&file, poolCallback, pool);
+	closePemFile (&file);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadChainPool - Add the Certificates in a Directory to the Pool
+ *
+ *	SYNOPSIS
+ *		int
+ *		loadChainPool(
+ *			const char		*directory)			- Known Intermediates
+ *
+ *	RETURN VALUE
+ *		Number of certificates read, or -1 (with errno set) if the directory
+ *		could not be examined.
+ *
+ *	DESCRIPTION
+ *		Every *.pem, *.crt, and *.cer file in the directory tree is read.
+ *-----------------------------------------------------------------------------
+ */
+
+int loadChainPool (const char *directory)
+{
+	struct stat					st;
+	dir_walk					*walk;
+	char						*filename;
+	pool_context				pool;
+
+	if (stat (directory, &st) == -1)
+		return -1;
+
+	walk = startWalk (1, &directory, POOL_PATTERNS, 1);
+	if (walk == (dir_walk *) NULL)
+		return -1;
+
+	pool.added = 0;
+	pool.intermediates = false;
+	pool.keep = (chain_filter) NULL;
+	while ((filename = nextWalk (walk)) != (char *) NULL)
+	{
+		loadPoolFile (filename, &pool);
+		free (filename);
+	}
+
+	endWalk (walk);
+	return pool.added;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadChainFiles - Add the Intermediates of the Files to be Checked
+ *
+ *	SYNOPSIS
+ *		int
+ *		loadChainFiles(
+ *			int				count,				- Number of Names
+ *			const char		**names,			- Files (or Directories)
+ *			const char		*patterns,			- Comma Separated Patterns
+ *			bool			recursive,			- Walk Directories
+ *			chain_filter	keep)				- Certificates to Add, or NULL
+ *
+ *	RETURN VALUE
+ *		Number of certificates read.
+ *
+ *	DESCRIPTION
+ *		Called (after loadChainPool) before any of the files is checked.
+ *		The files are read in the order they will be processed, so which
+ *		certificate is kept for a key does not depend on timing. BACKUP
+ *		files (which hold what deleteCert replaced) are skipped, and keep
+ *		lets deleteCert skip the certificates it is deleting.
+ *-----------------------------------------------------------------------------
+ */
+
+int loadChainFiles (int count, const char **names, const char *patterns, bool recursive, chain_filter keep)
+{
+	dir_walk					*walk;
+	char						*filename;
+	pool_context				pool;
+	int							i;
+
+	pool.added = 0;
+	pool.intermediates = true;
+	pool.keep = keep;
+
+	if (! recursive)
+	{
+		for (i = 0; i < count; i++)
+		{
+			if (strstr (names [i], "-BACKUP.") == (const char *) NULL)
+				loadPoolFile (names [i], &pool);
+		}
+		return pool.added;
+	}
+
+	walk = startWalk (count, names, patterns, 1);
+	if (walk == (dir_walk *) NULL)
+		return pool.added;
+
+	while ((filename = nextWalk (walk)) != (char *) NULL)
+	{
+		if (strstr (filename, "-BACKUP.") == (const char *) NULL)
+			loadPoolFile (filename, &pool);
+		free (filename);
+	}
+
+	endWalk (walk);
+	return pool.added;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		checkChain - Put the Certificates of a File in Chain Order
+ *
+ *	SYNOPSIS
+ *		int
+ *		checkChain(
+ *			const chain_cert	*certs,			- Certificates in File
+ *			int					count,			- Number of Certificates
+ *			const chain_cert	**order,		- Chain (count + CHAIN_MAX_ADDED)
+ *			int					*status)		- CHAIN_MISORDERED, ...
+ *
+ *	RETURN VALUE
+ *		Length of the chain, or -1 if memory is exhausted.
+ *
+ *	DESCRIPTION
+ *		The leaf is the first certificate that issued none of the others
+ *		(and is not a root). From the leaf, each issuer is taken from the
+ *		file if it is there, or else from the pool (CHAIN_INCOMPLETE). The
+ *		chain ends at a root, or at an issuer found in neither; since roots
+ *		are not in the pool, a chain that omits its root (as fullchain.pem
+ *		does) is complete.
+ *
+ *		Certificates of the file not in the chain (stale cross signatures,
+ *		unrelated certificates) are CHAIN_EXTRA. If those that are in the
+ *		chain are not in chain order, the file is CHAIN_MISORDERED.
+ *-----------------------------------------------------------------------------
+ */
+
+int checkChain (const chain_cert *certs, int count, const chain_cert **order, int *status)
+{
+	chain_table					byKeyId;
+	chain_table					bySubject;
+	const chain_cert			*cert;
+	const chain_cert			*issuer;
+	const chain_cert			**slots;
+	bool						*used;
+	bool						*issued;
+	size_t						size;
+	int							length = 0;
+	int							added = 0;
+	int							last = -1;
+	int							i;
+
+	*status = 0;
+	if (count == 0)
+		return 0;
+
+	for (size = 4; size < (size_t) count * 2; size *= 2)
+		;
+
+	slots = (const chain_cert **) calloc (size * 2, sizeof (const chain_cert *));
+	used = (bool *) calloc (count * 2, sizeof (bool));
+	if ((slots == (const chain_cert **) NULL) || (used == (bool *) NULL))
+	{
+		free (slots);
+		free (used);
+		return -1;
+	}
+	issued = used + count;
+
+	byKeyId.slots = slots;
+	byKeyId.size = size;
+	byKeyId.count = 0;
+	byKeyId.byKeyId = true;
+
+	bySubject.slots = slots + size;
+	bySubject.size = size;
+	bySubject.count = 0;
+	bySubject.byKeyId = false;
+
+	for (i = 0; i < count; i++)
+	{
+		tableAdd (&byKeyId, &certs [i]);
+		tableAdd (&bySubject, &certs [i]);
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Find the leaf.
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (i = 0; i < count; i++)
+	{
+		issuer = findIssuer (&certs [i], &byKeyId, &bySubject);
+		if (issuer != (const chain_cert *) NULL)
+			issued [issuer - certs] = true;
+	}
+
+	for (i = 0; (i < count) && (issued [i] || selfSigned (&certs [i])); i++)
+		;
+	cert = &certs [(i < count) ? i : 0];
+
+	/*-------------------------------------------------------------------------
+	 *	Follow the issuers.
+	 *-------------------------------------------------------------------------
+	 */
+
+	while (cert != (const chain_cert *) NULL)
+	{
+		order [length++] = cert;
+
+		if (inFile (cert, certs, count))
+		{
+			used [cert - certs] = true;
+			if (cert - certs < last)
+				*status |= CHAIN_MISORDERED;
+			last = cert - certs;
+		}
+
+		issuer = findIssuer (cert, &byKeyId, &bySubject);
+		if ((issuer != (const chain_cert *) NULL) && used [issuer - certs])
+			break;
+
+		if ((issuer == (const chain_cert *) NULL) && (added < CHAIN_MAX_ADDED))
+		{
+			pthread_mutex_lock (&pool_mutex);
+			issuer = findIssuer (cert, &pool_by_key_id, &pool_by_subject);
+			pthread_mutex_unlock (&pool_mutex);
+
+			if (issuer != (const chain_cert *) NULL)
+			{
+				added++;
+				*status |= CHAIN_INCOMPLETE;
+			}
+		}
+
+		cert = issuer;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (! used [i])
+			*status |= CHAIN_EXTRA;
+	}
+
+	free (slots);
+	free (used);
+	return length;
+}
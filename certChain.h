@@ -0,0 +1,50 @@
+/*-----------------------------------------------------------------------------
+ *	certChain, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTCHAIN_H
+#define CERTCHAIN_H
+
+#include <stddef.h>
+
+#include "certDecode.h"
+
+#define CHAIN_MISORDERED		0x01				/* Not leaf first, then issuers */
+#define CHAIN_INCOMPLETE		0x02				/* Intermediates added from pool */
+#define CHAIN_EXTRA				0x04				/* Certificates not in the chain */
+
+#define CHAIN_MAX_ADDED			8					/* Most added to one chain */
+
+/*-----------------------------------------------------------------------------
+ *	What links one certificate to its issuer. Certificates in a file have
+ *	their number in index; certificates from the pool have index -1 and
+ *	their PEM text, so that they can be added to a file.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				*subject;
+	const char				*issuer;
+	const unsigned char		*keyId;				/* Subject key identifier */
+	int						keyIdLength;		/* 0 if none */
+	const unsigned char		*authorityKeyId;
+	int						authorityKeyIdLength;	/* 0 if none */
+	int						index;				/* Number in file, -1 in pool */
+	const char				*pem;				/* BEGIN through END line */
+	size_t					pemLength;
+	const char				*source;			/* File it came from */
+}
+chain_cert;
+
+typedef bool (*chain_filter) (int count, const unsigned char *der, size_t length);
+
+void chainCert (const cert_info *info, int index, chain_cert *cert);
+int loadChainPool (const char *directory);
+int loadChainFiles (int count, const char **names, const char *patterns, bool recursive, chain_filter keep);
+void addChainPool (const chain_cert *cert);
+int checkChain (const chain_cert *certs, int count, const chain_cert **order, int *status);
+
+#endif
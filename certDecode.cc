@@ -0,0 +1,1454 @@
+/*-----------------------------------------------------------------------------
+ *	certDecode, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "certDecode.h"
+#include "certView.h"
+
+/*-----------------------------------------------------------------------------
+ *	ASN.1 Universal Tags used in X.509 Certificates.
+ *-----------------------------------------------------------------------------
+ */
+
+#define TAG_BOOLEAN				0x01
+#define TAG_INTEGER				0x02
+#define TAG_BIT_STRING			0x03
+#define TAG_OCTET_STRING		0x04
+#define TAG_OID					0x06
+#define TAG_UTF8_STRING			0x0c
+#define TAG_NUMERIC_STRING		0x12
+#define TAG_PRINTABLE_STRING	0x13
+#define TAG_T61_STRING			0x14
+#define TAG_IA5_STRING			0x16
+#define TAG_UTC_TIME			0x17
+#define TAG_GENERALIZED_TIME	0x18
+#define TAG_VISIBLE_STRING		0x1a
+#define TAG_UNIVERSAL_STRING	0x1c
+#define TAG_BMP_STRING			0x1e
+#define TAG_SEQUENCE			0x30
+#define TAG_SET					0x31
+#define TAG_VERSION				0xa0
+#define TAG_EXTENSIONS			0xa3
+#define TAG_KEY_IDENTIFIER		0x80
+#define TAG_EC_PUBLIC_KEY		0xa1
+
+#define OID_SUBJECT_KEY_ID		"\x55\x1d\x0e"			/* 2.5.29.14 */
+#define OID_AUTHORITY_KEY_ID	"\x55\x1d\x23"			/* 2.5.29.35 */
+#define OID_RSA_ENCRYPTION		"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x01"	/* 1.2.840.113549.1.1.1 */
+
+/*-----------------------------------------------------------------------------
+ *	Object Identifier Names (as displayed by openssl).
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char * const	oid;
+	const char * const	name;
+}
+oid_name;
+
+static const oid_name		attribute_names [] =
+{
+	{ "2.5.4.3",						"CN"                      },
+	{ "2.5.4.4",						"SN"                      },
+	{ "2.5.4.5",						"serialNumber"            },
+	{ "2.5.4.6",						"C"                       },
+	{ "2.5.4.7",						"L"                       },
+	{ "2.5.4.8",						"ST"                      },
+	{ "2.5.4.9",						"street"                  },
+	{ "2.5.4.10",						"O"                       },
+	{ "2.5.4.11",						"OU"                      },
+	{ "2.5.4.12",						"title"                   },
+	{ "2.5.4.15",						"businessCategory"        },
+	{ "2.5.4.17",						"postalCode"              },
+	{ "2.5.4.41",						"name"                    },
+	{ "2.5.4.42",						"GN"                      },
+	{ "2.5.4.43",						"initials"                },
+	{ "2.5.4.44",						"generationQualifier"     },
+	{ "2.5.4.46",						"dnQualifier"             },
+	{ "2.5.4.65",						"pseudonym"               },
+	{ "2.5.4.97",						"organizationIdentifier"  },
+	{ "1.2.840.113549.1.9.1",			"emailAddress"            },
+	{ "0.9.2342.19200300.100.1.1",		"UID"                     },
+	{ "0.9.2342.19200300.100.1.25",		"DC"                      },
+	{ "1.3.6.1.4.1.311.60.2.1.1",		"jurisdictionL"           },
+	{ "1.3.6.1.4.1.311.60.2.1.2",		"jurisdictionST"          },
+	{ "1.3.6.1.4.1.311.60.2.1.3",		"jurisdictionC"           },
+};
+
+static const oid_name		algorithm_names [] =
+{
+	{ "1.2.840.113549.1.1.1",			"rsaEncryption"           },
+	{ "1.2.840.113549.1.1.4",			"md5WithRSAEncryption"    },
+	{ "1.2.840.113549.1.1.5",			"sha1WithRSAEncryption"   },
+	{ "1.2.840.113549.1.1.10",			"rsassaPss"               },
+	{ "1.2.840.113549.1.1.11",			"sha256WithRSAEncryption" },
+	{ "1.2.840.113549.1.1.12",			"sha384WithRSAEncryption" },
+	{ "1.2.840.113549.1.1.13",			"sha512WithRSAEncryption" },
+	{ "1.2.840.113549.1.1.14",			"sha224WithRSAEncryption" },
+	{ "1.2.840.10040.4.1",				"dsaEncryption"           },
+	{ "1.2.840.10040.4.3",				"dsaWithSHA1"             },
+	{ "1.2.840.10045.2.1",				"id-ecPublicKey"          },
+	{ "1.2.840.10045.4.1",				"ecdsa-with-SHA1"         },
+	{ "1.2.840.10045.4.3.2",			"ecdsa-with-SHA256"       },
+	{ "1.2.840.10045.4.3.3",			"ecdsa-with-SHA384"       },
+	{ "1.2.840.10045.4.3.4",			"ecdsa-with-SHA512"       },
+	{ "1.3.101.112",					"ED25519"                 },
+	{ "1.3.101.113",					"ED448"                   },
+};
+
+static const char * const	month_names [] =
+{
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		derNext - Read the Next DER Element
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		derNext(
+ *			const unsigned char	**pp,			- Current Position (updated)
+ *			const unsigned char	*end,			- End of Enclosing Element
+ *			int					*tag,			- Element Tag
+ *			const unsigned char	**content,		- Element Content
+ *			size_t				*length)		- Element Content Length
+ *
+ *	RETURN VALUE
+ *		true if a well formed element was found, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function reads one tag-length-value element and advances the
+ *		current position past it. Only the single byte tags and definite
+ *		lengths permitted by DER are accepted.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool derNext (const unsigned char **pp, const unsigned char *end, int *tag, const unsigned char **content, size_t *length)
+{
+	const unsigned char			*p = *pp;
+	size_t						n;
+	int							count;
+
+	if (end - p < 2)
+		return false;
+
+	*tag = *p++;
+	if ((*tag & 0x1f) == 0x1f)
+		return false;
+
+	n = *p++;
+	if (n & 0x80)
+	{
+		count = n & 0x7f;
+		if ((count == 0) || (count > (int) sizeof (size_t)) || (end - p < count))
+			return false;
+
+		for (n = 0; count > 0; count--)
+			n = (n << 8) | *p++;
+	}
+
+	if (n > (size_t) (end - p))
+		return false;
+
+	*content = p;
+	*length = n;
+	*pp = p + n;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		append - Append Text to a Bounded Buffer
+ *
+ *	SYNOPSIS
+ *		static void
+ *		append(
+ *			char			*buffer,			- Output Buffer
+ *			size_t			size,				- Size of Output Buffer
+ *			const char		*text,				- Text to Append
+ *			size_t			length)				- Length of Text
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		This function appends text to a null terminated string, truncating
+ *		rather than overflowing the buffer.
+ *-----------------------------------------------------------------------------
+ */
+
+static void append (char *buffer, size_t size, const char *text, size_t length)
+{
+	size_t						used = strlen (buffer);
+
+	if (used + length >= size)
+		length = size - used - 1;
+
+	memcpy (buffer + used, text, length);
+	buffer [used + length] = '\0';
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatOid - Format an Object Identifier
+ *
+ *	SYNOPSIS
+ *		static void
+ *		formatOid(
+ *			const unsigned char	*p,				- OID Content
+ *			size_t				length,			- OID Content Length
+ *			const oid_name		*names,			- Table of Known Names
+ *			int					count,			- Number of Known Names
+ *			char				*buffer,		- Output Buffer
+ *			size_t				size)			- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		This function converts an OID to dotted decimal notation, and then
+ *		replaces it with its name if the name is known.
+ *-----------------------------------------------------------------------------
+ */
+
+static void formatOid (const unsigned char *p, size_t length, const oid_name *names, int count, char *buffer, size_t size)
+{
+	char						dotted [256];
+	char						arc [32];
+	unsigned long				value = 0;
+	size_t						i;
+	int							j;
+	bool						first = true;
+
+	*dotted = '\0';
+	for (i = 0; i < length; i++)
+	{
+		value = (value << 7) | (p [i] & 0x7f);
+		if (p [i] & 0x80)
+			continue;
+
+		if (first)
+		{
+			if (value < 40)
+				sprintf (arc, "0.%lu", value);
+			else if (value < 80)
+				sprintf (arc, "1.%lu", value - 40);
+			else
+				sprintf (arc, "2.%lu", value - 80);
+			first = false;
+		}
+		else
+			sprintf (arc, ".%lu", value);
+
+		append (dotted, sizeof (dotted), arc, strlen (arc));
+		value = 0;
+	}
+
+	for (j = 0; j < count; j++)
+	{
+		if (strcmp (names [j].oid, dotted) == 0)
+		{
+			snprintf (buffer, size, "%s", names [j].name);
+			return;
+		}
+	}
+
+	snprintf (buffer, size, "%s", dotted);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		attributeName - Short Name of an Attribute Type
+ *
+ *	SYNOPSIS
+ *		static const char *
+ *		attributeName(
+ *			const unsigned char	*p,				- OID Content
+ *			size_t				length)			- OID Content Length
+ *
+ *	RETURN VALUE
+ *		The name displayed by openssl, or "" if the type is unknown.
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *attributeName (const unsigned char *p, size_t length)
+{
+	char						dotted [256];
+	int							i;
+
+	formatOid (p, length, (const oid_name *) NULL, 0, dotted, sizeof (dotted));
+
+	for (i = 0; i < (int) (sizeof (attribute_names) / sizeof (oid_name)); i++)
+	{
+		if (strcmp (attribute_names [i].oid, dotted) == 0)
+			return attribute_names [i].name;
+	}
+
+	return "";
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatValue - Format a Directory String Value
+ *
+ *	SYNOPSIS
+ *		static void
+ *		formatValue(
+ *			int					tag,			- Value Tag
+ *			const unsigned char	*element,		- Entire Value Element
+ *			const unsigned char	*p,				- Value Content
+ *			size_t				length,			- Value Content Length
+ *			char				*buffer,		- Output Buffer
+ *			size_t				size)			- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		This function formats an attribute value the way openssl does by
+ *		default: the value is converted to UTF-8, control characters and
+ *		bytes above 0x7f are escaped as \XX, and values containing RFC 2253
+ *		special characters are quoted. Values of unknown type are dumped as
+ *		# followed by the hex DER encoding.
+ *-----------------------------------------------------------------------------
+ */
+
+static void formatValue (int tag, const unsigned char *element, const unsigned char *p, size_t length, char *buffer, size_t size)
+{
+	char						value [CERT_MAX_NAME];
+	char						text [16];
+	unsigned char				utf8 [4];
+	unsigned long				c;
+	size_t						i;
+	size_t						width;
+	int							j;
+	int							n;
+	bool						quote = false;
+
+	*value = '\0';
+
+	switch (tag)
+	{
+		case TAG_UTF8_STRING:
+		case TAG_NUMERIC_STRING:
+		case TAG_PRINTABLE_STRING:
+		case TAG_T61_STRING:
+		case TAG_IA5_STRING:
+		case TAG_VISIBLE_STRING:
+			width = 1;
+			break;
+
+		case TAG_BMP_STRING:
+			width = 2;
+			break;
+
+		case TAG_UNIVERSAL_STRING:
+			width = 4;
+			break;
+
+		default:
+			append (buffer, size, "#", 1);
+			for (i = 0; i < (size_t) (p + length - element); i++)
+			{
+				sprintf (text, "%02X", element [i]);
+				append (buffer, size, text, 2);
+			}
+			return;
+	}
+
+	for (i = 0; i + width <= length; i += width)
+	{
+		/*---------------------------------------------------------------------
+		 *	Convert to UTF-8 (T61String is treated as Latin-1, as openssl does).
+		 *---------------------------------------------------------------------
+		 */
+
+		for (c = 0, j = 0; j < (int) width; j++)
+			c = (c << 8) | p [i + j];
+
+		if ((tag == TAG_UTF8_STRING) || (c < 0x80))
+		{
+			utf8 [0] = (unsigned char) c;
+			n = 1;
+		}
+		else if (c < 0x800)
+		{
+			utf8 [0] = (unsigned char) (0xc0 | (c >> 6));
+			utf8 [1] = (unsigned char) (0x80 | (c & 0x3f));
+			n = 2;
+		}
+		else if (c < 0x10000)
+		{
+			utf8 [0] = (unsigned char) (0xe0 | (c >> 12));
+			utf8 [1] = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+			utf8 [2] = (unsigned char) (0x80 | (c & 0x3f));
+			n = 3;
+		}
+		else
+		{
+			utf8 [0] = (unsigned char) (0xf0 | ((c >> 18) & 0x07));
+			utf8 [1] = (unsigned char) (0x80 | ((c >> 12) & 0x3f));
+			utf8 [2] = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+			utf8 [3] = (unsigned char) (0x80 | (c & 0x3f));
+			n = 4;
+		}
+
+		/*---------------------------------------------------------------------
+		 *	Escape each byte as required.
+		 *---------------------------------------------------------------------
+		 */
+
+		for (j = 0; j < n; j++)
+		{
+			if ((utf8 [j] > 0x7e) || (utf8 [j] < 0x20))
+			{
+				sprintf (text, "\\%02X", utf8 [j]);
+				append (value, sizeof (value), text, 3);
+			}
+			else if (utf8 [j] == '\\')
+				append (value, sizeof (value), "\\\\", 2);
+			else
+			{
+				if (strchr (",+\"<>;", utf8 [j]) != (const char *) NULL)
+					quote = true;
+				else if ((i == 0) && ((utf8 [j] == '#') || (utf8 [j] == ' ')))
+					quote = true;
+				else if ((i + width == length) && (utf8 [j] == ' '))
+					quote = true;
+
+				append (value, sizeof (value), (const char *) &utf8 [j], 1);
+			}
+		}
+	}
+
+	if (quote)
+		append (buffer, size, "\"", 1);
+	append (buffer, size, value, strlen (value));
+	if (quote)
+		append (buffer, size, "\"", 1);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatName - Format a Distinguished Name
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		formatName(
+ *			const unsigned char	*p,				- Name Content
+ *			size_t				length,			- Name Content Length
+ *			char				*buffer,		- Output Buffer
+ *			size_t				size)			- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		true if the name was well formed, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function formats a Name as "C = US, O = Org, CN = Name".
+ *		Attributes of a multi-valued RDN are separated by " + ". If buffer
+ *		is NULL, the structure of the name is only checked.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool formatName (const unsigned char *p, size_t length, char *buffer, size_t size)
+{
+	const unsigned char			*end = p + length;
+	const unsigned char			*rdn;
+	const unsigned char			*rdnEnd;
+	const unsigned char			*attribute;
+	const unsigned char			*attributeEnd;
+	const unsigned char			*content;
+	const unsigned char			*element;
+	size_t						contentLength;
+	char						attributeName [256];
+	int							tag;
+	bool						firstRdn = true;
+	bool						firstAttribute;
+
+	if (buffer != (char *) NULL)
+		*buffer = '\0';
+
+	while (p < end)
+	{
+		if ((! derNext (&p, end, &tag, &rdn, &contentLength)) || (tag != TAG_SET))
+			return false;
+
+		rdnEnd = rdn + contentLength;
+		firstAttribute = true;
+
+		while (rdn < rdnEnd)
+		{
+			if ((! derNext (&rdn, rdnEnd, &tag, &attribute, &contentLength)) || (tag != TAG_SEQUENCE))
+				return false;
+
+			attributeEnd = attribute + contentLength;
+
+			if ((! derNext (&attribute, attributeEnd, &tag, &content, &contentLength)) || (tag != TAG_OID))
+				return false;
+
+			if (buffer == (char *) NULL)
+			{
+				if (! derNext (&attribute, attributeEnd, &tag, &content, &contentLength))
+					return false;
+				continue;
+			}
+
+			formatOid (content, contentLength, attribute_names, sizeof (attribute_names) / sizeof (oid_name), attributeName, sizeof (attributeName));
+
+			element = attribute;
+			if (! derNext (&attribute, attributeEnd, &tag, &content, &contentLength))
+				return false;
+
+			if (! firstAttribute)
+				append (buffer, size, " + ", 3);
+			else if (! firstRdn)
+				append (buffer, size, ", ", 2);
+
+			append (buffer, size, attributeName, strlen (attributeName));
+			append (buffer, size, " = ", 3);
+			formatValue (tag, element, content, contentLength, buffer, size);
+
+			firstAttribute = false;
+		}
+
+		firstRdn = false;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		civilTime - Convert a GMT Date and Time to Seconds since the Epoch
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		civilTime(
+ *			int				year,				- Year
+ *			int				month,				- Month (1 - 12)
+ *			int				day,				- Day of Month (1 - 31)
+ *			int				hour,				- Hour (0 - 23)
+ *			int				minute,				- Minute (0 - 59)
+ *			int				second,				- Second (0 - 60)
+ *			time_t			*when)				- Seconds since the Epoch
+ *
+ *	RETURN VALUE
+ *		true if the date and time are valid, false otherwise.
+ *
+ *	DESCRIPTION
+ *		The days since 1970-01-01 are counted directly in the proleptic
+ *		Gregorian calendar (March-based years, so that the leap day is last),
+ *		without timegm or the time zone database.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool civilTime (int year, int month, int day, int hour, int minute, int second, time_t *when)
+{
+	static const int			month_days [] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	long						era;
+	long						yearOfEra;
+	long						dayOfYear;
+	long						dayOfEra;
+	long						days;
+
+	if ((month < 1) || (month > 12) || (day < 1) || (day > month_days [month - 1]) ||
+		(hour < 0) || (hour > 23) || (minute < 0) || (minute > 59) || (second < 0) || (second > 60))
+		return false;
+
+	if ((month == 2) && (day == 29) && (((year % 4) != 0) || (((year % 100) == 0) && ((year % 400) != 0))))
+		return false;
+
+	if (month <= 2)
+		year--;
+
+	era = ((year >= 0) ? year : year - 399) / 400;
+	yearOfEra = year - era * 400;
+	dayOfYear = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+	dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+	days = era * 146097 + dayOfEra - 719468;
+
+	*when = (time_t) days * 86400 + hour * 3600 + minute * 60 + second;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		parseTime - Parse a UTCTime or GeneralizedTime
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		parseTime(
+ *			int					tag,			- Time Tag
+ *			const unsigned char	*p,				- Time Content
+ *			size_t				length,			- Time Content Length
+ *			char				*buffer,		- Formatted Time
+ *			size_t				size,			- Size of Formatted Time
+ *			time_t				*when)			- Parsed Time
+ *
+ *	RETURN VALUE
+ *		true if the time was well formed, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function parses a certificate validity time, which is always
+ *		GMT, and formats it as "Mmm dd hh:mm:ss yyyy GMT" (unless buffer is
+ *		NULL).
+ *-----------------------------------------------------------------------------
+ */
+
+static bool parseTime (int tag, const unsigned char *p, size_t length, char *buffer, size_t size, time_t *when)
+{
+	int							digits [14];
+	int							count;
+	int							i;
+	int							year;
+	int							month;
+	int							day;
+	int							hour;
+	int							minute;
+	int							second;
+	size_t						fraction = 0;
+
+	count = (tag == TAG_UTC_TIME) ? 12 : 14;
+	if ((length < (size_t) count + 1) || (p [length - 1] != 'Z'))
+		return false;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((p [i] < '0') || (p [i] > '9'))
+			return false;
+		digits [i] = p [i] - '0';
+	}
+
+	if (tag == TAG_UTC_TIME)
+	{
+		year = (digits [0] * 10) + digits [1];
+		year += (year < 50) ? 2000 : 1900;
+		i = 2;
+	}
+	else
+	{
+		year = (digits [0] * 1000) + (digits [1] * 100) + (digits [2] * 10) + digits [3];
+		i = 4;
+		if ((length > (size_t) count + 1) && (p [count] == '.'))
+			fraction = length - count - 1;
+	}
+
+	month = (digits [i] * 10) + digits [i + 1];
+	day = (digits [i + 2] * 10) + digits [i + 3];
+	hour = (digits [i + 4] * 10) + digits [i + 5];
+	minute = (digits [i + 6] * 10) + digits [i + 7];
+	second = (digits [i + 8] * 10) + digits [i + 9];
+
+	if (! civilTime (year, month, day, hour, minute, second, when))
+		return false;
+
+	if (buffer != (char *) NULL)
+		snprintf (buffer, size, "%s %2d %02d:%02d:%02d%.*s %d GMT",
+				month_names [month - 1], day, hour, minute, second,
+				(int) fraction, (const char *) p + count, year);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		parseAlgorithm - Parse an AlgorithmIdentifier
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		parseAlgorithm(
+ *			const unsigned char	*p,				- AlgorithmIdentifier Content
+ *			size_t				length,			- Content Length
+ *			char				*buffer,		- Algorithm Name
+ *			size_t				size)			- Size of Algorithm Name
+ *
+ *	RETURN VALUE
+ *		true if the AlgorithmIdentifier was well formed, false otherwise.
+ *		If buffer is NULL, it is only checked.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool parseAlgorithm (const unsigned char *p, size_t length, char *buffer, size_t size)
+{
+	const unsigned char			*content;
+	size_t						contentLength;
+	int							tag;
+
+	if ((! derNext (&p, p + length, &tag, &content, &contentLength)) || (tag != TAG_OID))
+		return false;
+
+	if (buffer != (char *) NULL)
+		formatOid (content, contentLength, algorithm_names, sizeof (algorithm_names) / sizeof (oid_name), buffer, size);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		parseExtensions - Find the Key Identifiers among the Extensions
+ *
+ *	SYNOPSIS
+ *		static void
+ *		parseExtensions(
+ *			const unsigned char	*p,				- Extensions Content
+ *			size_t				length,			- Extensions Content Length
+ *			cert_info			*info)			- Decoded Certificate
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		Only the subject and authority key identifiers are extracted; they
+ *		link a certificate to its issuer. A malformed extension is ignored
+ *		rather than rejecting a certificate that displays correctly.
+ *-----------------------------------------------------------------------------
+ */
+
+static void parseExtensions (const unsigned char *p, size_t length, cert_info *info)
+{
+	const unsigned char			*end = p + length;
+	const unsigned char			*list;
+	const unsigned char			*sequence;
+	const unsigned char			*extension;
+	const unsigned char			*extensionEnd;
+	const unsigned char			*oid;
+	const unsigned char			*value;
+	const unsigned char			*inner;
+	size_t						listLength;
+	size_t						sequenceLength;
+	size_t						extensionLength;
+	size_t						oidLength;
+	size_t						valueLength;
+	size_t						innerLength;
+	int							tag;
+
+	/*-------------------------------------------------------------------------
+	 *	Extensions ::= SEQUENCE OF Extension
+	 *	Extension ::= SEQUENCE { extnID, critical BOOLEAN DEFAULT FALSE, extnValue OCTET STRING }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &list, &listLength)) || (tag != TAG_SEQUENCE))
+		return;
+	p = list;
+	end = list + listLength;
+
+	while (derNext (&p, end, &tag, &extension, &extensionLength))
+	{
+		if (tag != TAG_SEQUENCE)
+			continue;
+		extensionEnd = extension + extensionLength;
+
+		if ((! derNext (&extension, extensionEnd, &tag, &oid, &oidLength)) || (tag != TAG_OID) || (oidLength != 3))
+			continue;
+
+		if (! derNext (&extension, extensionEnd, &tag, &value, &valueLength))
+			continue;
+		if ((tag == TAG_BOOLEAN) && (! derNext (&extension, extensionEnd, &tag, &value, &valueLength)))
+			continue;
+		if (tag != TAG_OCTET_STRING)
+			continue;
+
+		if (memcmp (oid, OID_SUBJECT_KEY_ID, 3) == 0)
+		{
+			/*-----------------------------------------------------------------
+			 *	SubjectKeyIdentifier ::= OCTET STRING
+			 *-----------------------------------------------------------------
+			 */
+
+			if (derNext (&value, value + valueLength, &tag, &inner, &innerLength) && (tag == TAG_OCTET_STRING)
+			  && (innerLength <= CERT_MAX_KEY_ID))
+			{
+				memcpy (info->subjectKeyId, inner, innerLength);
+				info->subjectKeyIdLength = (int) innerLength;
+			}
+		}
+		else if (memcmp (oid, OID_AUTHORITY_KEY_ID, 3) == 0)
+		{
+			/*-----------------------------------------------------------------
+			 *	AuthorityKeyIdentifier ::= SEQUENCE { keyIdentifier [0] OPTIONAL, ... }
+			 *-----------------------------------------------------------------
+			 */
+
+			if ((! derNext (&value, value + valueLength, &tag, &sequence, &sequenceLength)) || (tag != TAG_SEQUENCE))
+				continue;
+
+			if (derNext (&sequence, sequence + sequenceLength, &tag, &inner, &innerLength) && (tag == TAG_KEY_IDENTIFIER)
+			  && (innerLength <= CERT_MAX_KEY_ID))
+			{
+				memcpy (info->authorityKeyId, inner, innerLength);
+				info->authorityKeyIdLength = (int) innerLength;
+			}
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeCertificateFields - Decode Selected Fields of a DER Certificate
+ *
+ *	SYNOPSIS
+ *		bool
+ *		decodeCertificateFields(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length,			- Length of Certificate
+ *			int					fields,			- CERT_FIELD_ISSUER | ...
+ *			cert_info			*info)			- Decoded Certificate
+ *
+ *	RETURN VALUE
+ *		true if the certificate was decoded, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function walks the TBSCertificate and extracts the version,
+ *		validity times, and whichever of the serial number, algorithms,
+ *		issuer, formatted validity, subject, and key identifiers are
+ *		selected; the others are left empty. Whatever the fields, the same
+ *		certificates are accepted: the names and algorithms not selected are
+ *		still checked, element by element, but nothing in them is formatted,
+ *		and extensions are examined only for the key identifiers.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decodeCertificateFields (const unsigned char *der, size_t length, int fields, cert_info *info)
+{
+	const unsigned char			*p = der;
+	const unsigned char			*end = der + length;
+	const unsigned char			*content;
+	const unsigned char			*inner;
+	size_t						contentLength;
+	size_t						innerLength;
+	size_t						i;
+	int							tag;
+	int							innerTag;
+
+	memset (info, 0, sizeof (*info));
+
+	/*-------------------------------------------------------------------------
+	 *	Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	p = content;
+	end = content + contentLength;
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	p = content;
+	end = content + contentLength;
+
+	/*-------------------------------------------------------------------------
+	 *	version [0] EXPLICIT Version DEFAULT v1
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (! derNext (&p, end, &tag, &content, &contentLength))
+		return false;
+
+	info->version = 1;
+	if (tag == TAG_VERSION)
+	{
+		if ((! derNext (&content, content + contentLength, &innerTag, &inner, &innerLength))
+		  || (innerTag != TAG_INTEGER) || (innerLength != 1))
+			return false;
+
+		info->version = *inner + 1;
+
+		if (! derNext (&p, end, &tag, &content, &contentLength))
+			return false;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	serialNumber CertificateSerialNumber
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((tag != TAG_INTEGER) || (contentLength == 0))
+		return false;
+
+	info->serialNegative = (*content & 0x80) != 0;
+	while ((contentLength > 1) && (*content == 0))
+	{
+		content++;
+		contentLength--;
+	}
+
+	if (! (fields & CERT_FIELD_SERIAL))
+		contentLength = 0;
+	else if (contentLength > CERT_MAX_SERIAL)
+		contentLength = CERT_MAX_SERIAL;
+
+	memcpy (info->serial, content, contentLength);
+	info->serialLength = (int) contentLength;
+
+	if (info->serialNegative)
+	{
+		/*---------------------------------------------------------------------
+		 *	Convert two's complement to magnitude.
+		 *---------------------------------------------------------------------
+		 */
+
+		for (i = 0; i < contentLength; i++)
+			info->serial [i] = ~info->serial [i];
+		for (i = contentLength; (i > 0) && (++info->serial [i - 1] == 0); i--)
+			;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	signature AlgorithmIdentifier
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE)
+	  || (! parseAlgorithm (content, contentLength, (fields & CERT_FIELD_ALGORITHMS) ? info->signatureAlgorithm : (char *) NULL, sizeof (info->signatureAlgorithm))))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	issuer Name
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE)
+	  || (! formatName (content, contentLength, (fields & CERT_FIELD_ISSUER) ? info->issuer : (char *) NULL, sizeof (info->issuer))))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	validity Validity ::= SEQUENCE { notBefore Time, notAfter Time }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	if ((! derNext (&content, p, &innerTag, &inner, &innerLength))
+	  || (! parseTime (innerTag, inner, innerLength, (fields & CERT_FIELD_VALIDITY) ? info->notBefore : (char *) NULL, sizeof (info->notBefore), &info->notBeforeTime)))
+		return false;
+
+	if ((! derNext (&content, p, &innerTag, &inner, &innerLength))
+	  || (! parseTime (innerTag, inner, innerLength, (fields & CERT_FIELD_VALIDITY) ? info->notAfter : (char *) NULL, sizeof (info->notAfter), &info->notAfterTime)))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	subject Name
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE)
+	  || (! formatName (content, contentLength, (fields & CERT_FIELD_SUBJECT) ? info->subject : (char *) NULL, sizeof (info->subject))))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	subjectPublicKeyInfo ::= SEQUENCE { algorithm, subjectPublicKey }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	if ((! derNext (&content, content + contentLength, &innerTag, &inner, &innerLength)) || (innerTag != TAG_SEQUENCE)
+	  || (! parseAlgorithm (inner, innerLength, (fields & CERT_FIELD_ALGORITHMS) ? info->publicKeyAlgorithm : (char *) NULL, sizeof (info->publicKeyAlgorithm))))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	issuerUniqueID [1], subjectUniqueID [2], extensions [3] (all optional)
+	 *-------------------------------------------------------------------------
+	 */
+
+	while ((fields & CERT_FIELD_KEY_IDS) && derNext (&p, end, &tag, &content, &contentLength))
+	{
+		if (tag == TAG_EXTENSIONS)
+			parseExtensions (content, contentLength, info);
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		decodeCertificate - Decode a DER Certificate
+ *
+ *	SYNOPSIS
+ *		bool
+ *		decodeCertificate(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length,			- Length of Certificate
+ *			cert_info			*info)			- Decoded Certificate
+ *
+ *	RETURN VALUE
+ *		true if the certificate was decoded, false otherwise.
+ *
+ *	DESCRIPTION
+ *		Same as decodeCertificateFields with CERT_FIELDS_ALL.
+ *-----------------------------------------------------------------------------
+ */
+
+bool decodeCertificate (const unsigned char *der, size_t length, cert_info *info)
+{
+	return decodeCertificateFields (der, length, CERT_FIELDS_ALL, info);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		publicKeyValue - Locate the Key in a SubjectPublicKeyInfo
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		publicKeyValue(
+ *			const unsigned char	*p,				- SubjectPublicKeyInfo Content
+ *			size_t				length,			- Length of Content
+ *			std::string_view	*key)			- Key Found
+ *
+ *	RETURN VALUE
+ *		true if the SubjectPublicKeyInfo was well formed, false otherwise.
+ *
+ *	DESCRIPTION
+ *		The key is located as viewPrivateKey locates it in a private key,
+ *		so that the two can be compared byte for byte: for RSA, the modulus
+ *		and public exponent INTEGERs; otherwise (EC), the BIT STRING content.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool publicKeyValue (const unsigned char *p, size_t length, std::string_view *key)
+{
+	const unsigned char			*end = p + length;
+	const unsigned char			*algorithm;
+	const unsigned char			*oid;
+	const unsigned char			*bits;
+	size_t						algorithmLength;
+	size_t						oidLength;
+	size_t						bitsLength;
+	int							tag;
+
+	if ((! derNext (&p, end, &tag, &algorithm, &algorithmLength)) || (tag != TAG_SEQUENCE)
+	  || (! derNext (&algorithm, algorithm + algorithmLength, &tag, &oid, &oidLength)) || (tag != TAG_OID)
+	  || (! derNext (&p, end, &tag, &bits, &bitsLength)) || (tag != TAG_BIT_STRING) || (bitsLength == 0))
+		return false;
+
+	if ((oidLength == sizeof (OID_RSA_ENCRYPTION) - 1) && (memcmp (oid, OID_RSA_ENCRYPTION, oidLength) == 0))
+	{
+		p = bits + 1;
+		if ((*bits != 0) || (! derNext (&p, bits + bitsLength, &tag, &bits, &bitsLength)) || (tag != TAG_SEQUENCE))
+			return false;
+	}
+
+	*key = std::string_view ((const char *) bits, bitsLength);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		viewCertificate - View a DER Certificate without Copying it
+ *
+ *	SYNOPSIS
+ *		bool
+ *		viewCertificate(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length,			- Length of Buffer
+ *			cert_view			*view)			- View of Certificate
+ *
+ *	RETURN VALUE
+ *		true if the certificate was well formed, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function walks the TBSCertificate as decodeCertificate does, but
+ *		only locates the serial number, names, and public key within der,
+ *		and converts the validity to seconds since the epoch; nothing is
+ *		formatted. The buffer may continue past the certificate;
+ *		view->derLength is the length of the certificate itself.
+ *-----------------------------------------------------------------------------
+ */
+
+bool viewCertificate (const unsigned char *der, size_t length, cert_view *view)
+{
+	const unsigned char			*p = der;
+	const unsigned char			*end = der + length;
+	const unsigned char			*content;
+	const unsigned char			*inner;
+	size_t						contentLength;
+	size_t						innerLength;
+	int							tag;
+	int							innerTag;
+
+	/*-------------------------------------------------------------------------
+	 *	Certificate ::= SEQUENCE { tbsCertificate, ... }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	view->der = der;
+	view->derLength = p - der;
+
+	p = content;
+	end = content + contentLength;
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	p = content;
+	end = content + contentLength;
+
+	if (! derNext (&p, end, &tag, &content, &contentLength))
+		return false;
+
+	view->version = 1;
+	if (tag == TAG_VERSION)
+	{
+		if ((! derNext (&content, content + contentLength, &innerTag, &inner, &innerLength))
+		  || (innerTag != TAG_INTEGER) || (innerLength != 1))
+			return false;
+
+		view->version = *inner + 1;
+
+		if (! derNext (&p, end, &tag, &content, &contentLength))
+			return false;
+	}
+
+	if ((tag != TAG_INTEGER) || (contentLength == 0))
+		return false;
+	view->serial = std::string_view ((const char *) content, contentLength);
+
+	/*-------------------------------------------------------------------------
+	 *	signature, issuer, validity, subject
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+	view->issuer = std::string_view ((const char *) content, contentLength);
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	if ((! derNext (&content, p, &innerTag, &inner, &innerLength))
+	  || (! parseTime (innerTag, inner, innerLength, (char *) NULL, 0, &view->notBefore)))
+		return false;
+
+	if ((! derNext (&content, p, &innerTag, &inner, &innerLength))
+	  || (! parseTime (innerTag, inner, innerLength, (char *) NULL, 0, &view->notAfter)))
+		return false;
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+	view->subject = std::string_view ((const char *) content, contentLength);
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE)
+	  || (! publicKeyValue (content, contentLength, &view->publicKey)))
+		return false;
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		viewPrivateKey - Locate the Public Key in a DER Private Key
+ *
+ *	SYNOPSIS
+ *		bool
+ *		viewPrivateKey(
+ *			const unsigned char	*der,			- DER Encoded Private Key
+ *			size_t				length,			- Length of Private Key
+ *			std::string_view	*publicKey)		- Public Key Found
+ *
+ *	RETURN VALUE
+ *		true if the public key was found, false otherwise.
+ *
+ *	DESCRIPTION
+ *		PKCS#8 (BEGIN PRIVATE KEY), PKCS#1 RSA (BEGIN RSA PRIVATE KEY), and
+ *		SEC 1 EC (BEGIN EC PRIVATE KEY) keys are recognized by their first
+ *		elements. The public key is located (not computed), so it is found
+ *		only for RSA keys, and EC keys that include it (as openssl and
+ *		certbot write them); it can be compared with cert_view.publicKey.
+ *-----------------------------------------------------------------------------
+ */
+
+bool viewPrivateKey (const unsigned char *der, size_t length, std::string_view *publicKey)
+{
+	const unsigned char			*p = der;
+	const unsigned char			*end = der + length;
+	const unsigned char			*start;
+	const unsigned char			*content;
+	const unsigned char			*inner;
+	size_t						contentLength;
+	size_t						innerLength;
+	int							tag;
+	int							innerTag;
+
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+
+	p = content;
+	end = content + contentLength;
+	if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_INTEGER))
+		return false;
+
+	start = p;
+	if (! derNext (&p, end, &tag, &content, &contentLength))
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	PrivateKeyInfo ::= SEQUENCE { version, AlgorithmIdentifier, OCTET STRING }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (tag == TAG_SEQUENCE)
+	{
+		if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_OCTET_STRING))
+			return false;
+
+		return viewPrivateKey (content, contentLength, publicKey);
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	RSAPrivateKey ::= SEQUENCE { version, modulus, publicExponent, ... }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (tag == TAG_INTEGER)
+	{
+		if ((! derNext (&p, end, &tag, &content, &contentLength)) || (tag != TAG_INTEGER))
+			return false;
+
+		*publicKey = std::string_view ((const char *) start, p - start);
+		return true;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	ECPrivateKey ::= SEQUENCE { version, privateKey, [0] parameters OPTIONAL,
+	 *		[1] publicKey OPTIONAL }
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (tag != TAG_OCTET_STRING)
+		return false;
+
+	while (derNext (&p, end, &tag, &content, &contentLength))
+	{
+		if (tag == TAG_EC_PUBLIC_KEY)
+		{
+			if ((! derNext (&content, content + contentLength, &innerTag, &inner, &innerLength)) || (innerTag != TAG_BIT_STRING))
+				return false;
+
+			*publicKey = std::string_view ((const char *) inner, innerLength);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextAttribute - Read the Next Attribute of a Distinguished Name
+ *
+ *	SYNOPSIS
+ *		bool
+ *		nextAttribute(
+ *			std::string_view	*name,			- Rest of Name (updated)
+ *			cert_attribute		*attribute)		- Attribute Found
+ *
+ *	RETURN VALUE
+ *		true if an attribute was found, false at the end of the name (or if
+ *		the rest of it is malformed).
+ *
+ *	DESCRIPTION
+ *		Attributes are found in the order they are encoded (and displayed
+ *		by openssl). Within a multi-valued RDN, each attribute after the
+ *		first is marked continued. A Name is a SEQUENCE of SETs of
+ *		attributes; the rest of the name may begin within a SET, so it is
+ *		read as one stream of SET headers and attributes.
+ *-----------------------------------------------------------------------------
+ */
+
+bool nextAttribute (std::string_view *name, cert_attribute *attribute)
+{
+	const unsigned char			*p = (const unsigned char *) name->data ();
+	const unsigned char			*end = p + name->size ();
+	const unsigned char			*element;
+	const unsigned char			*attributeEnd;
+	const unsigned char			*content;
+	size_t						contentLength;
+	int							tag;
+
+	if (p == end)
+		return false;
+
+	attribute->continued = true;
+	if (*p == TAG_SET)
+	{
+		if (! derNext (&p, end, &tag, &content, &contentLength))
+			return false;
+		p = content;
+		attribute->continued = false;
+	}
+
+	if ((! derNext (&p, end, &tag, &element, &contentLength)) || (tag != TAG_SEQUENCE))
+		return false;
+	attributeEnd = element + contentLength;
+
+	if ((! derNext (&element, attributeEnd, &tag, &content, &contentLength)) || (tag != TAG_OID))
+		return false;
+	attribute->oid = std::string_view ((const char *) content, contentLength);
+	attribute->name = attributeName (content, contentLength);
+
+	if (! derNext (&element, attributeEnd, &attribute->tag, &content, &contentLength))
+		return false;
+	attribute->value = std::string_view ((const char *) content, contentLength);
+
+	*name = std::string_view ((const char *) p, end - p);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatSerial - Format a Certificate Serial Number
+ *
+ *	SYNOPSIS
+ *		void
+ *		formatSerial(
+ *			const cert_info	*info,				- Decoded Certificate
+ *			const char		*indent,			- Indent for Long Serials
+ *			char			*buffer,			- Output Buffer
+ *			size_t			size)				- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		This function formats the serial number as openssl does. Serials
+ *		that fit in a long are shown as " decimal (0xhex)". Longer serials
+ *		are shown on the next line, after the indent, as colon separated hex.
+ *-----------------------------------------------------------------------------
+ */
+
+void formatSerial (const cert_info *info, const char *indent, char *buffer, size_t size)
+{
+	unsigned long				value = 0;
+	char						text [16];
+	const char					*sign = info->serialNegative ? "-" : "";
+	int							i;
+
+	*buffer = '\0';
+
+	if ((info->serialLength < (int) sizeof (long))
+	  || ((info->serialLength == (int) sizeof (long)) && (info->serial [0] < 0x80)))
+	{
+		for (i = 0; i < info->serialLength; i++)
+			value = (value << 8) | info->serial [i];
+
+		snprintf (buffer, size, " %s%lu (%s0x%lx)", sign, value, sign, value);
+		return;
+	}
+
+	append (buffer, size, "\n", 1);
+	append (buffer, size, indent, strlen (indent));
+	if (info->serialNegative)
+		append (buffer, size, " (Negative)", 11);
+
+	for (i = 0; i < info->serialLength; i++)
+	{
+		sprintf (text, (i == 0) ? "%02x" : ":%02x", info->serial [i]);
+		append (buffer, size, text, strlen (text));
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		validityMessage - Describe the Validity of a Certificate
+ *
+ *	SYNOPSIS
+ *		void
+ *		validityMessage(
+ *			time_t			notBefore,			- Start of Validity
+ *			time_t			notAfter,			- End of Validity
+ *			time_t			now,				- Current Time
+ *			char			*buffer,			- Validity Message
+ *			size_t			size)				- Size of Buffer
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		This function produces "*** NOT YET VALID ***" and/or "*** EXPIRED ***"
+ *		as appropriate, or an empty string if the certificate is valid now.
+ *-----------------------------------------------------------------------------
+ */
+
+void validityMessage (time_t notBefore, time_t notAfter, time_t now, char *buffer, size_t size)
+{
+	*buffer = '\0';
+
+	if (notBefore > now)
+		append (buffer, size, "*** NOT YET VALID ***", 21);
+
+	if (notAfter < now)
+	{
+		if (*buffer != '\0')
+			append (buffer, size, " ", 1);
+		append (buffer, size, "*** EXPIRED ***", 15);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		parseDate - Parse a Date (and Time) Given on the Command Line
+ *
+ *	SYNOPSIS
+ *		bool
+ *		parseDate(
+ *			const char		*text,				- YYYY-MM-DD[THH:MM[:SS]][Z]
+ *			time_t			*when)				- Seconds since the Epoch
+ *
+ *	RETURN VALUE
+ *		true if the date was well formed, false otherwise.
+ *
+ *	DESCRIPTION
+ *		The date is GMT, like the validity of a certificate. A space may be
+ *		used instead of the T.
+ *-----------------------------------------------------------------------------
+ */
+
+bool parseDate (const char *text, time_t *when)
+{
+	int							year;
+	int							month;
+	int							day;
+	int							hour = 0;
+	int							minute = 0;
+	int							second = 0;
+	int							used = 0;
+	int							timeUsed = 0;
+
+	if ((sscanf (text, "%4d-%2d-%2d%n", &year, &month, &day, &used) != 3) || (used != 10))
+		return false;
+
+	text += used;
+	if ((*text == 'T') || (*text == ' '))
+	{
+		if (sscanf (text + 1, "%2d:%2d%n:%2d%n", &hour, &minute, &timeUsed, &second, &timeUsed) < 2)
+			return false;
+		text += 1 + timeUsed;
+	}
+
+	if (*text == 'Z')
+		text++;
+
+	if (*text != '\0')
+		return false;
+
+	return civilTime (year, month, day, hour, minute, second, when);
+}
@@ -0,0 +1,69 @@
+/*-----------------------------------------------------------------------------
+ *	certDecode, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTDECODE_H
+#define CERTDECODE_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define CERT_MAX_NAME			1024
+#define CERT_MAX_SERIAL			64
+#define CERT_MAX_ALGORITHM		64
+#define CERT_MAX_TIME			64
+#define CERT_MAX_KEY_ID			64
+
+/*-----------------------------------------------------------------------------
+ *	Fields to decode (see decodeCertificateFields). The version and the
+ *	validity times are always decoded.
+ *-----------------------------------------------------------------------------
+ */
+
+#define CERT_FIELD_SERIAL		0x01
+#define CERT_FIELD_ALGORITHMS	0x02				/* Signature and Public Key */
+#define CERT_FIELD_ISSUER		0x04
+#define CERT_FIELD_VALIDITY		0x08				/* notBefore and notAfter */
+#define CERT_FIELD_SUBJECT		0x10
+#define CERT_FIELD_KEY_IDS		0x20
+#define CERT_FIELDS_ALL			0x3f
+
+/*-----------------------------------------------------------------------------
+ *	Decoded Certificate.
+ *
+ *	All names are formatted the way "openssl x509 -text" formats them, and
+ *	all times are formatted as "Mmm dd hh:mm:ss yyyy GMT", so that existing
+ *	output (and anything that parses it) is unchanged.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	int						version;
+	unsigned char			serial [CERT_MAX_SERIAL];
+	int						serialLength;
+	bool					serialNegative;
+	char					signatureAlgorithm [CERT_MAX_ALGORITHM];
+	char					issuer [CERT_MAX_NAME];
+	char					notBefore [CERT_MAX_TIME];
+	char					notAfter [CERT_MAX_TIME];
+	time_t					notBeforeTime;
+	time_t					notAfterTime;
+	char					subject [CERT_MAX_NAME];
+	char					publicKeyAlgorithm [CERT_MAX_ALGORITHM];
+	unsigned char			subjectKeyId [CERT_MAX_KEY_ID];
+	int						subjectKeyIdLength;		/* 0 if none */
+	unsigned char			authorityKeyId [CERT_MAX_KEY_ID];
+	int						authorityKeyIdLength;	/* 0 if none */
+}
+cert_info;
+
+bool decodeCertificate (const unsigned char *der, size_t length, cert_info *info);
+bool decodeCertificateFields (const unsigned char *der, size_t length, int fields, cert_info *info);
+void formatSerial (const cert_info *info, const char *indent, char *buffer, size_t size);
+void validityMessage (time_t notBefore, time_t notAfter, time_t now, char *buffer, size_t size);
+bool parseDate (const char *text, time_t *when);
+
+#endif
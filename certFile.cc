@@ -0,0 +1,220 @@
+/*-----------------------------------------------------------------------------
+ *	certFile, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/stat.h>
+
+#include "certFile.h"
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		fullPathname - Determine the Pathname to Display
+ *
+ *	SYNOPSIS
+ *		void
+ *		fullPathname(
+ *			const char		*filename,			- Filename as Specified
+ *			bool			fullPath,			- Prefix Working Directory
+ *			char			*buffer,			- Pathname to Display
+ *			size_t			size)				- Size of Buffer
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		If fullPath is set and filename is relative, the current working
+ *		directory is prefixed (dropping any leading "./"). Otherwise the
+ *		filename is used as specified.
+ *-----------------------------------------------------------------------------
+ */
+
+void fullPathname (const char *filename, bool fullPath, char *buffer, size_t size)
+{
+	char						wd [4096];
+
+	if (fullPath && (*filename != '/'))
+	{
+		getcwd (wd, sizeof (wd));
+		if (strncmp (filename, "./", 2) == 0)
+			snprintf (buffer, size, "%s/%s", wd, filename + 2);
+		else
+			snprintf (buffer, size, "%s/%s", wd, filename);
+	}
+	else
+		snprintf (buffer, size, "%s", filename);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		targetPathname - Determine the File to Edit
+ *
+ *	SYNOPSIS
+ *		bool
+ *		targetPathname(
+ *			const char		*filename,			- Filename as Specified
+ *			char			*buffer,			- Pathname to Edit
+ *			size_t			size)				- Size of Buffer
+ *
+ *	RETURN VALUE
+ *		true if the pathname was determined, false (with errno set)
+ *		otherwise.
+ *
+ *	DESCRIPTION
+ *		If filename is a symbolic link (as in certbot's live/ directory,
+ *		whose links refer to archive/), the file it finally refers to, so
+ *		that editing it leaves the link as it is. Otherwise the filename is
+ *		used as specified.
+ *-----------------------------------------------------------------------------
+ */
+
+bool targetPathname (const char *filename, char *buffer, size_t size)
+{
+	struct stat					st;
+	char						*target;
+	int							length;
+
+	if ((lstat (filename, &st) == -1) || ! S_ISLNK (st.st_mode))
+		target = (char *) NULL;
+	else if ((target = realpath (filename, (char *) NULL)) == (char *) NULL)
+		return false;
+
+	length = snprintf (buffer, size, "%s", (target == (char *) NULL) ? filename : target);
+	free (target);
+
+	if ((size_t) length >= size)
+	{
+		errno = ENAMETOOLONG;
+		return false;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatListing - Format a File the way "ls -l" does
+ *
+ *	SYNOPSIS
+ *		bool
+ *		formatListing(
+ *			const char		*filename,			- File to List
+ *			char			*buffer,			- Formatted Listing
+ *			size_t			size)				- Size of Buffer
+ *
+ *	RETURN VALUE
+ *		true if the file could be examined, false otherwise.
+ *
+ *	DESCRIPTION
+ *		This function produces the permissions, link count, owner, group,
+ *		size, modification time, and name of a file, as "ls -l" would, using
+ *		only lstat (and readlink for symbolic links).
+ *-----------------------------------------------------------------------------
+ */
+
+bool formatListing (const char *filename, char *buffer, size_t size)
+{
+	struct stat					st;
+	struct passwd				pw;
+	struct passwd				*pwp = (struct passwd *) NULL;
+	struct group				gr;
+	struct group				*grp = (struct group *) NULL;
+	struct tm					tm;
+	char						pwBuffer [1024];
+	char						grBuffer [4096];
+	char						owner [64];
+	char						group [64];
+	char						mode [11];
+	char						when [32];
+	char						target [4096];
+	const char					*arrow = "";
+	ssize_t						length;
+	time_t						now;
+
+	if (lstat (filename, &st) == -1)
+		return false;
+
+	/*-------------------------------------------------------------------------
+	 *	File Type and Permissions
+	 *-------------------------------------------------------------------------
+	 */
+
+	switch (st.st_mode & S_IFMT)
+	{
+		case S_IFDIR:	mode [0] = 'd';	break;
+		case S_IFLNK:	mode [0] = 'l';	break;
+		case S_IFCHR:	mode [0] = 'c';	break;
+		case S_IFBLK:	mode [0] = 'b';	break;
+		case S_IFIFO:	mode [0] = 'p';	break;
+		case S_IFSOCK:	mode [0] = 's';	break;
+		default:		mode [0] = '-';	break;
+	}
+
+	mode [1] = (st.st_mode & S_IRUSR) ? 'r' : '-';
+	mode [2] = (st.st_mode & S_IWUSR) ? 'w' : '-';
+	mode [3] = (st.st_mode & S_ISUID) ? ((st.st_mode & S_IXUSR) ? 's' : 'S') : ((st.st_mode & S_IXUSR) ? 'x' : '-');
+	mode [4] = (st.st_mode & S_IRGRP) ? 'r' : '-';
+	mode [5] = (st.st_mode & S_IWGRP) ? 'w' : '-';
+	mode [6] = (st.st_mode & S_ISGID) ? ((st.st_mode & S_IXGRP) ? 's' : 'S') : ((st.st_mode & S_IXGRP) ? 'x' : '-');
+	mode [7] = (st.st_mode & S_IROTH) ? 'r' : '-';
+	mode [8] = (st.st_mode & S_IWOTH) ? 'w' : '-';
+	mode [9] = (st.st_mode & S_ISVTX) ? ((st.st_mode & S_IXOTH) ? 't' : 'T') : ((st.st_mode & S_IXOTH) ? 'x' : '-');
+	mode [10] = '\0';
+
+	/*-------------------------------------------------------------------------
+	 *	Owner and Group
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((getpwuid_r (st.st_uid, &pw, pwBuffer, sizeof (pwBuffer), &pwp) == 0) && (pwp != (struct passwd *) NULL))
+		snprintf (owner, sizeof (owner), "%s", pwp->pw_name);
+	else
+		snprintf (owner, sizeof (owner), "%lu", (unsigned long) st.st_uid);
+
+	if ((getgrgid_r (st.st_gid, &gr, grBuffer, sizeof (grBuffer), &grp) == 0) && (grp != (struct group *) NULL))
+		snprintf (group, sizeof (group), "%s", grp->gr_name);
+	else
+		snprintf (group, sizeof (group), "%lu", (unsigned long) st.st_gid);
+
+	/*-------------------------------------------------------------------------
+	 *	Modification Time: show the year instead of the time if the file is
+	 *	more than six months old or in the future.
+	 *-------------------------------------------------------------------------
+	 */
+
+	time (&now);
+	localtime_r (&st.st_mtime, &tm);
+	if ((st.st_mtime > now) || (st.st_mtime < now - (365 * 24 * 60 * 60) / 2))
+		strftime (when, sizeof (when), "%b %e  %Y", &tm);
+	else
+		strftime (when, sizeof (when), "%b %e %H:%M", &tm);
+
+	/*-------------------------------------------------------------------------
+	 *	Symbolic Link Target
+	 *-------------------------------------------------------------------------
+	 */
+
+	*target = '\0';
+	if (S_ISLNK (st.st_mode))
+	{
+		length = readlink (filename, target, sizeof (target) - 1);
+		if (length >= 0)
+		{
+			target [length] = '\0';
+			arrow = " -> ";
+		}
+	}
+
+	snprintf (buffer, size, "%s %lu %s %s %lld %s %s%s%s",
+				mode, (unsigned long) st.st_nlink, owner, group, (long long) st.st_size, when, filename, arrow, target);
+	return true;
+}
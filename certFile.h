@@ -0,0 +1,16 @@
+/*-----------------------------------------------------------------------------
+ *	certFile, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTFILE_H
+#define CERTFILE_H
+
+#include <stddef.h>
+
+void fullPathname (const char *filename, bool fullPath, char *buffer, size_t size);
+bool targetPathname (const char *filename, char *buffer, size_t size);
+bool formatListing (const char *filename, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,278 @@
+/*-----------------------------------------------------------------------------
+ *	certFingerprint, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#include "certFingerprint.h"
+#include "digest.h"
+
+/*-----------------------------------------------------------------------------
+ *	Fingerprints (SHA-256 or SHA-1 digests of the DER encoding) are kept in
+ *	one open addressing hash table with linear probing, at most half full.
+ *	A digest is already uniformly distributed, so its first bytes are the
+ *	hash. The table is filled before any thread starts and only read
+ *	afterwards, so lookups need no lock.
+ *
+ *	A certificate is hashed only with the algorithms that occur in the
+ *	list, so a list of SHA-256 fingerprints costs one digest each.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	unsigned char			digest [SHA256_LENGTH];
+	unsigned char			length;				/* 0 if empty */
+}
+fingerprint_slot;
+
+static fingerprint_slot		*slots;
+static size_t				slot_count;			/* Power of 2 */
+static size_t				fingerprint_count;
+static bool					have_sha256 = false;
+static bool					have_sha1 = false;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		findSlot - Find a Fingerprint, or the Empty Slot for it
+ *-----------------------------------------------------------------------------
+ */
+
+static fingerprint_slot *findSlot (const unsigned char *digest, size_t length)
+{
+	uint64_t					h;
+	size_t						i;
+
+	memcpy (&h, digest, sizeof (h));
+	for (i = (size_t) (h ^ length) & (slot_count - 1); ; i = (i + 1) & (slot_count - 1))
+	{
+		if ((slots [i].length == 0) || ((slots [i].length == length) && (memcmp (slots [i].digest, digest, length) == 0)))
+			return &slots [i];
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addFingerprint - Add a Fingerprint to the Table (Once)
+ *
+ *	RETURN VALUE
+ *		true if added or already present, false if out of memory.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool addFingerprint (const unsigned char *digest, size_t length)
+{
+	fingerprint_slot			*old = slots;
+	fingerprint_slot			*slot;
+	size_t						oldCount = slot_count;
+	size_t						i;
+
+	if ((fingerprint_count + 1) * 2 > slot_count)
+	{
+		slot_count = (slot_count == 0) ? 1024 : slot_count * 2;
+		slots = (fingerprint_slot *) calloc (slot_count, sizeof (fingerprint_slot));
+		if (slots == (fingerprint_slot *) NULL)
+		{
+			slots = old;
+			slot_count = oldCount;
+			return false;
+		}
+
+		for (i = 0; i < oldCount; i++)
+		{
+			if (old [i].length != 0)
+				*findSlot (old [i].digest, old [i].length) = old [i];
+		}
+		free (old);
+	}
+
+	slot = findSlot (digest, length);
+	if (slot->length == 0)
+	{
+		memcpy (slot->digest, digest, length);
+		slot->length = (unsigned char) length;
+		fingerprint_count++;
+	}
+
+	if (length == SHA256_LENGTH)
+		have_sha256 = true;
+	else
+		have_sha1 = true;
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		parseFingerprint - Parse a Fingerprint from a Line
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		parseFingerprint(
+ *			const char		*text,				- Line
+ *			unsigned char	*digest)			- SHA256_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		Length of the digest (SHA256_LENGTH or SHA1_LENGTH), or 0 if the
+ *		line holds no fingerprint.
+ *
+ *	DESCRIPTION
+ *		The fingerprint is the first word (words are separated by spaces,
+ *		tabs, or "=") that is 64 or 40 hex digits, optionally separated by
+ *		colons, so lines of "openssl x509 -fingerprint" and of decodeCert
+ *		can be used as they are, and anything after the fingerprint (such
+ *		as the name of the certificate) is ignored.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t parseFingerprint (const char *text, unsigned char *digest)
+{
+	const char					*p = text;
+	const char					*q;
+	size_t						digits;
+	int							nibble;
+
+	while (*p != '\0')
+	{
+		while ((*p == ' ') || (*p == '\t') || (*p == '='))
+			p++;
+
+		digits = 0;
+		for (q = p; (*q != '\0') && (*q != ' ') && (*q != '\t') && (*q != '='); q++)
+		{
+			if (*q == ':')
+				continue;
+			if ((! isxdigit ((unsigned char) *q)) || (digits == SHA256_LENGTH * 2))
+				break;
+
+			nibble = isdigit ((unsigned char) *q) ? (*q - '0') : (tolower ((unsigned char) *q) - 'a' + 10);
+			if ((digits & 1) == 0)
+				digest [digits / 2] = (unsigned char) (nibble << 4);
+			else
+				digest [digits / 2] |= (unsigned char) nibble;
+			digits++;
+		}
+
+		if (((*q == '\0') || (*q == ' ') || (*q == '\t') || (*q == '=')) && ((digits == SHA256_LENGTH * 2) || (digits == SHA1_LENGTH * 2)))
+			return digits / 2;
+
+		while ((*q != '\0') && (*q != ' ') && (*q != '\t') && (*q != '='))
+			q++;
+		p = q;
+	}
+
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadFingerprints - Load a List of Fingerprints
+ *
+ *	SYNOPSIS
+ *		int
+ *		loadFingerprints(
+ *			const char		*filename,			- One Fingerprint per Line
+ *			int				*line)				- Line of Invalid Fingerprint
+ *
+ *	RETURN VALUE
+ *		Number of distinct fingerprints loaded, or -1 (with errno set) if
+ *		the file could not be read, or a line holds no fingerprint (errno
+ *		EINVAL, and *line is its line number). Blank lines, and lines that
+ *		begin with #, are ignored.
+ *-----------------------------------------------------------------------------
+ */
+
+int loadFingerprints (const char *filename, int *line)
+{
+	FILE						*in;
+	char						*text = (char *) NULL;
+	size_t						size = 0;
+	ssize_t						length;
+	unsigned char				digest [SHA256_LENGTH];
+	size_t						digestLength;
+	size_t						start;
+	int							error = 0;
+
+	*line = 0;
+
+	in = fopen (filename, "r");
+	if (in == (FILE *) NULL)
+		return -1;
+
+	while ((error == 0) && ((length = getline (&text, &size, in)) != -1))
+	{
+		(*line)++;
+
+		while ((length > 0) && isspace ((unsigned char) text [length - 1]))
+			text [--length] = '\0';
+		for (start = 0; isspace ((unsigned char) text [start]); start++)
+			;
+
+		if ((text [start] == '\0') || (text [start] == '#'))
+			continue;
+
+		digestLength = parseFingerprint (text + start, digest);
+		if (digestLength == 0)
+			error = EINVAL;
+		else if (! addFingerprint (digest, digestLength))
+			error = ENOMEM;
+	}
+
+	free (text);
+	fclose (in);
+
+	if (error != 0)
+	{
+		if (error == ENOMEM)
+			*line = 0;
+		errno = error;
+		return -1;
+	}
+
+	*line = 0;
+	return (int) fingerprint_count;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		knownFingerprint - Is a Certificate in the List?
+ *
+ *	SYNOPSIS
+ *		bool
+ *		knownFingerprint(
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
+ *
+ *	RETURN VALUE
+ *		true if the SHA-256 or SHA-1 fingerprint of the certificate was
+ *		loaded by loadFingerprints.
+ *-----------------------------------------------------------------------------
+ */
+
+bool knownFingerprint (const unsigned char *der, size_t length)
+{
+	unsigned char				digest [SHA256_LENGTH];
+
+	if (have_sha256)
+	{
+		sha256Digest (der, length, digest);
+		if (findSlot (digest, SHA256_LENGTH)->length != 0)
+			return true;
+	}
+
+	if (have_sha1)
+	{
+		sha1Digest (der, length, digest);
+		if (findSlot (digest, SHA1_LENGTH)->length != 0)
+			return true;
+	}
+
+	return false;
+}
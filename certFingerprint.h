@@ -0,0 +1,15 @@
+/*-----------------------------------------------------------------------------
+ *	certFingerprint, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTFINGERPRINT_H
+#define CERTFINGERPRINT_H
+
+#include <stddef.h>
+
+int loadFingerprints (const char *filename, int *line);
+bool knownFingerprint (const unsigned char *der, size_t length);
+
+#endif
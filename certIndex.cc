@@ -0,0 +1,963 @@
+/*-----------------------------------------------------------------------------
+ *	certIndex, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "certIndex.h"
+
+/*-----------------------------------------------------------------------------
+ *	Index File Format.
+ *
+ *	The index is written in native byte order and is used directly from an
+ *	mmap of the file, so loading it costs one validation pass. It consists
+ *	of a header followed by four arrays:
+ *
+ *	*	files, sorted by (dev, ino), each naming a range of refs
+ *	*	refs, one per certificate, each a summary number (or a status)
+ *	*	summaries, the decoded fields (and SHA-256 fingerprint) of each
+ *		distinct certificate
+ *	*	strings, every distinct string (and serial number) once
+ *
+ *	Shared intermediates appear once in summaries no matter how many files
+ *	contain them, and common issuer names appear once in strings.
+ *
+ *	An index is never modified in place. saveIndex writes a new file and
+ *	renames it over the old one, so readers see either the old or the new
+ *	index, never a partial one.
+ *-----------------------------------------------------------------------------
+ */
+
+#define INDEX_MAGIC				"CERTIDX\n"
+#define INDEX_VERSION			2
+#define INDEX_BYTE_ORDER		0x01020304
+
+#define INDEX_REF_INVALID_PEM	0xffffffff
+#define INDEX_REF_UNDECODABLE	0xfffffffe
+
+typedef struct
+{
+	char					magic [8];
+	uint32_t				version;
+	uint32_t				byteOrder;
+	uint32_t				fileCount;
+	uint32_t				summaryCount;
+	uint32_t				refCount;
+	uint32_t				stringBytes;
+}
+index_header;
+
+typedef struct
+{
+	uint64_t				dev;
+	uint64_t				ino;
+	uint64_t				size;
+	int64_t					mtime_ns;
+	uint32_t				firstRef;
+	uint32_t				refCount;
+}
+index_file;
+
+typedef struct
+{
+	int64_t					notBeforeTime;
+	int64_t					notAfterTime;
+	int32_t					version;
+	uint32_t				serial;				/* Offsets into strings */
+	uint16_t				serialLength;
+	uint8_t					serialNegative;
+	uint8_t					unused;
+	uint32_t				signatureAlgorithm;
+	uint32_t				issuer;
+	uint32_t				notBefore;
+	uint32_t				notAfter;
+	uint32_t				subject;
+	uint32_t				publicKeyAlgorithm;
+	uint8_t					fingerprint [SHA256_LENGTH];
+}
+index_summary;
+
+/*-----------------------------------------------------------------------------
+ *	Index loaded from disk (read only, shared by all threads).
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	void					*map;
+	size_t					length;
+	const index_header		*header;
+	const index_file		*files;
+	const index_summary		*summaries;
+	const uint32_t			*refs;
+	const char				*strings;
+}
+index_map;
+
+/*-----------------------------------------------------------------------------
+ *	Index being built during this run. Strings and summaries are interned
+ *	in open addressing hash tables whose slots hold (number + 1), with 0
+ *	marking an empty slot.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	char					*strings;
+	size_t					stringBytes;
+	size_t					stringSize;
+	uint32_t				*stringSlots;
+	size_t					stringSlotCount;
+	size_t					stringCount;
+
+	index_summary			*summaries;
+	size_t					summaryCount;
+	size_t					summarySize;
+	uint32_t				*summarySlots;
+	size_t					summarySlotCount;
+
+	uint32_t				*refs;
+	size_t					refCount;
+	size_t					refSize;
+
+	index_file				*files;
+	size_t					fileCount;
+	size_t					fileSize;
+
+	bool					failed;				/* Out of memory */
+	unsigned long			hits;
+	unsigned long			misses;
+}
+index_builder;
+
+static index_map			old_index;
+static index_builder		new_index;
+static pthread_mutex_t		index_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#if defined(__APPLE__)
+#define MTIME_NS(st)	((int64_t) (st)->st_mtimespec.tv_sec * 1000000000 + (st)->st_mtimespec.tv_nsec)
+#else
+#define MTIME_NS(st)	((int64_t) (st)->st_mtim.tv_sec * 1000000000 + (st)->st_mtim.tv_nsec)
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashBytes - FNV-1a Hash
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t hashBytes (const void *data, size_t length)
+{
+	const unsigned char			*p = (const unsigned char *) data;
+	uint64_t					h = 0xcbf29ce484222325ULL;
+	size_t						i;
+
+	for (i = 0; i < length; i++)
+		h = (h ^ p [i]) * 0x100000001b3ULL;
+
+	return h;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		growArray - Ensure Room in a Dynamic Array
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		growArray(
+ *			void			**array,			- Array to Grow
+ *			size_t			*size,				- Allocated Elements
+ *			size_t			needed,				- Required Elements
+ *			size_t			element)			- Size of one Element
+ *
+ *	RETURN VALUE
+ *		true if the array has room for needed elements.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool growArray (void **array, size_t *size, size_t needed, size_t element)
+{
+	size_t						newSize;
+	void						*newArray;
+
+	if (needed <= *size)
+		return true;
+
+	newSize = (*size == 0) ? 256 : *size;
+	while (newSize < needed)
+		newSize *= 2;
+
+	newArray = realloc (*array, newSize * element);
+	if (newArray == NULL)
+		return false;
+
+	*array = newArray;
+	*size = newSize;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashSummary - Hash a Summary and its Serial Number
+ *
+ *	SYNOPSIS
+ *		static uint64_t
+ *		hashSummary(
+ *			const index_summary	*summary,		- Summary to Hash
+ *			const unsigned char	*serial)		- Serial Number
+ *
+ *	RETURN VALUE
+ *		64 bit hash.
+ *
+ *	DESCRIPTION
+ *		The serial number is hashed by value rather than by its offset, so
+ *		that a summary hashes the same before and after it is stored.
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t hashSummary (const index_summary *summary, const unsigned char *serial)
+{
+	index_summary				key = *summary;
+
+	key.serial = 0;
+	return hashBytes (&key, sizeof (key)) ^ hashBytes (serial, summary->serialLength);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		rehash - Rebuild an Interning Table at Twice the Size
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		rehash(
+ *			uint32_t		**slots,			- Hash Table
+ *			size_t			*slotCount,			- Number of Slots
+ *			bool			strings)			- Table of Strings or Summaries
+ *
+ *	RETURN VALUE
+ *		true unless memory is exhausted.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool rehash (uint32_t **slots, size_t *slotCount, bool strings)
+{
+	size_t						newCount = (*slotCount == 0) ? 1024 : *slotCount * 2;
+	uint32_t					*newSlots;
+	const index_summary			*summary;
+	const char					*s;
+	uint64_t					h;
+	size_t						i;
+	size_t						j;
+
+	newSlots = (uint32_t *) calloc (newCount, sizeof (uint32_t));
+	if (newSlots == (uint32_t *) NULL)
+		return false;
+
+	for (i = 0; i < *slotCount; i++)
+	{
+		if ((*slots) [i] == 0)
+			continue;
+
+		if (strings)
+		{
+			s = new_index.strings + (*slots) [i] - 1;
+			h = hashBytes (s, strlen (s));
+		}
+		else
+		{
+			summary = &new_index.summaries [(*slots) [i] - 1];
+			h = hashSummary (summary, (const unsigned char *) new_index.strings + summary->serial);
+		}
+
+		for (j = h & (newCount - 1); newSlots [j] != 0; j = (j + 1) & (newCount - 1))
+			;
+		newSlots [j] = (*slots) [i];
+	}
+
+	free (*slots);
+	*slots = newSlots;
+	*slotCount = newCount;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addString - Add a String to the New Index
+ *
+ *	SYNOPSIS
+ *		static uint32_t
+ *		addString(
+ *			const char		*s,					- Bytes to Add
+ *			size_t			length,				- Number of Bytes
+ *			bool			intern)				- Reuse an Identical String
+ *
+ *	RETURN VALUE
+ *		Offset of the bytes in the string table. They are always followed
+ *		by a '\0', so strings may be used in place.
+ *
+ *	DESCRIPTION
+ *		Serial numbers (which may contain '\0') are also stored here; they
+ *		are not interned, since no two certificates share one.
+ *-----------------------------------------------------------------------------
+ */
+
+static uint32_t addString (const char *s, size_t length, bool intern)
+{
+	uint64_t					h = hashBytes (s, length);
+	uint32_t					offset;
+	size_t						j = 0;
+
+	if (intern)
+	{
+		if ((new_index.stringCount + 1) * 2 > new_index.stringSlotCount)
+		{
+			if (! rehash (&new_index.stringSlots, &new_index.stringSlotCount, true))
+			{
+				new_index.failed = true;
+				return 0;
+			}
+		}
+
+		for (j = h & (new_index.stringSlotCount - 1); new_index.stringSlots [j] != 0; j = (j + 1) & (new_index.stringSlotCount - 1))
+		{
+			offset = new_index.stringSlots [j] - 1;
+			if ((memcmp (new_index.strings + offset, s, length) == 0) && (new_index.strings [offset + length] == '\0'))
+				return offset;
+		}
+	}
+
+	if (! growArray ((void **) &new_index.strings, &new_index.stringSize, new_index.stringBytes + length + 1, 1))
+	{
+		new_index.failed = true;
+		return 0;
+	}
+
+	offset = (uint32_t) new_index.stringBytes;
+	memcpy (new_index.strings + offset, s, length);
+	new_index.strings [offset + length] = '\0';
+	new_index.stringBytes += length + 1;
+
+	if (intern)
+	{
+		new_index.stringSlots [j] = offset + 1;
+		new_index.stringCount++;
+	}
+
+	return offset;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addSummary - Add a Decoded Certificate to the New Index (Once)
+ *
+ *	SYNOPSIS
+ *		static uint32_t
+ *		addSummary(
+ *			const index_cert *cert)				- Decoded Certificate
+ *
+ *	RETURN VALUE
+ *		Number of the summary.
+ *-----------------------------------------------------------------------------
+ */
+
+static uint32_t addSummary (const index_cert *cert)
+{
+	const cert_info				*info = &cert->info;
+	index_summary				summary;
+	index_summary				other;
+	uint64_t					h;
+	size_t						j;
+
+	memset (&summary, 0, sizeof (summary));
+	summary.notBeforeTime = (int64_t) info->notBeforeTime;
+	summary.notAfterTime = (int64_t) info->notAfterTime;
+	summary.version = info->version;
+	summary.serialLength = (uint16_t) info->serialLength;
+	summary.serialNegative = info->serialNegative;
+	summary.signatureAlgorithm = addString (info->signatureAlgorithm, strlen (info->signatureAlgorithm), true);
+	summary.issuer = addString (info->issuer, strlen (info->issuer), true);
+	summary.notBefore = addString (info->notBefore, strlen (info->notBefore), true);
+	summary.notAfter = addString (info->notAfter, strlen (info->notAfter), true);
+	summary.subject = addString (info->subject, strlen (info->subject), true);
+	summary.publicKeyAlgorithm = addString (info->publicKeyAlgorithm, strlen (info->publicKeyAlgorithm), true);
+	memcpy (summary.fingerprint, cert->fingerprint, sizeof (summary.fingerprint));
+
+	if ((new_index.summaryCount + 1) * 2 > new_index.summarySlotCount)
+	{
+		if (! rehash (&new_index.summarySlots, &new_index.summarySlotCount, false))
+		{
+			new_index.failed = true;
+			return 0;
+		}
+	}
+
+	h = hashSummary (&summary, info->serial);
+	for (j = h & (new_index.summarySlotCount - 1); new_index.summarySlots [j] != 0; j = (j + 1) & (new_index.summarySlotCount - 1))
+	{
+		other = new_index.summaries [new_index.summarySlots [j] - 1];
+		if (memcmp (new_index.strings + other.serial, info->serial, info->serialLength) != 0)
+			continue;
+
+		other.serial = 0;
+		if (memcmp (&other, &summary, sizeof (summary)) == 0)
+			return new_index.summarySlots [j] - 1;
+	}
+
+	summary.serial = addString ((const char *) info->serial, info->serialLength, false);
+
+	if (! growArray ((void **) &new_index.summaries, &new_index.summarySize, new_index.summaryCount + 1, sizeof (index_summary)))
+	{
+		new_index.failed = true;
+		return 0;
+	}
+
+	new_index.summaries [new_index.summaryCount] = summary;
+	new_index.summarySlots [j] = (uint32_t) ++new_index.summaryCount;
+	return (uint32_t) (new_index.summaryCount - 1);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addFile - Add one File to the New Index (Locked)
+ *
+ *	SYNOPSIS
+ *		static void
+ *		addFile(
+ *			const index_file	*key,			- dev, ino, size, mtime_ns
+ *			int					count,			- Number of Certificates
+ *			const index_cert	*certs)			- Certificates in File
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+static void addFile (const index_file *key, int count, const index_cert *certs)
+{
+	index_file					*file;
+	int							i;
+
+	if (! growArray ((void **) &new_index.files, &new_index.fileSize, new_index.fileCount + 1, sizeof (index_file))
+	  || ! growArray ((void **) &new_index.refs, &new_index.refSize, new_index.refCount + count, sizeof (uint32_t)))
+	{
+		new_index.failed = true;
+		return;
+	}
+
+	file = &new_index.files [new_index.fileCount++];
+	*file = *key;
+	file->firstRef = (uint32_t) new_index.refCount;
+	file->refCount = (uint32_t) count;
+
+	for (i = 0; i < count; i++)
+	{
+		if (certs [i].status == INDEX_INVALID_PEM)
+			new_index.refs [new_index.refCount++] = INDEX_REF_INVALID_PEM;
+		else if (certs [i].status == INDEX_UNDECODABLE)
+			new_index.refs [new_index.refCount++] = INDEX_REF_UNDECODABLE;
+		else
+			new_index.refs [new_index.refCount++] = addSummary (&certs [i]);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		compareFiles - Order Files by dev and ino
+ *-----------------------------------------------------------------------------
+ */
+
+static int compareFiles (const void *a, const void *b)
+{
+	const index_file			*x = (const index_file *) a;
+	const index_file			*y = (const index_file *) b;
+
+	if (x->dev != y->dev)
+		return (x->dev < y->dev) ? -1 : 1;
+	if (x->ino != y->ino)
+		return (x->ino < y->ino) ? -1 : 1;
+	return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readOldFile - Expand one File of the Loaded Index
+ *
+ *	SYNOPSIS
+ *		static index_cert *
+ *		readOldFile(
+ *			const index_file	*file)			- File in Loaded Index
+ *
+ *	RETURN VALUE
+ *		Array of file->refCount certificates (to be freed by the caller),
+ *		or NULL if memory is exhausted.
+ *-----------------------------------------------------------------------------
+ */
+
+static index_cert *readOldFile (const index_file *file)
+{
+	const index_summary			*summary;
+	const char					*strings = old_index.strings;
+	index_cert					*certs;
+	uint32_t					ref;
+	uint32_t					i;
+
+	certs = (index_cert *) calloc ((file->refCount == 0) ? 1 : file->refCount, sizeof (index_cert));
+	if (certs == (index_cert *) NULL)
+		return (index_cert *) NULL;
+
+	for (i = 0; i < file->refCount; i++)
+	{
+		ref = old_index.refs [file->firstRef + i];
+		if (ref == INDEX_REF_INVALID_PEM)
+		{
+			certs [i].status = INDEX_INVALID_PEM;
+			continue;
+		}
+		if (ref == INDEX_REF_UNDECODABLE)
+		{
+			certs [i].status = INDEX_UNDECODABLE;
+			continue;
+		}
+
+		summary = &old_index.summaries [ref];
+		certs [i].status = INDEX_VALID;
+		certs [i].info.version = summary->version;
+		memcpy (certs [i].info.serial, strings + summary->serial, summary->serialLength);
+		certs [i].info.serialLength = summary->serialLength;
+		certs [i].info.serialNegative = (summary->serialNegative != 0);
+		snprintf (certs [i].info.signatureAlgorithm, sizeof (certs [i].info.signatureAlgorithm), "%s", strings + summary->signatureAlgorithm);
+		snprintf (certs [i].info.issuer, sizeof (certs [i].info.issuer), "%s", strings + summary->issuer);
+		snprintf (certs [i].info.notBefore, sizeof (certs [i].info.notBefore), "%s", strings + summary->notBefore);
+		snprintf (certs [i].info.notAfter, sizeof (certs [i].info.notAfter), "%s", strings + summary->notAfter);
+		certs [i].info.notBeforeTime = (time_t) summary->notBeforeTime;
+		certs [i].info.notAfterTime = (time_t) summary->notAfterTime;
+		snprintf (certs [i].info.subject, sizeof (certs [i].info.subject), "%s", strings + summary->subject);
+		snprintf (certs [i].info.publicKeyAlgorithm, sizeof (certs [i].info.publicKeyAlgorithm), "%s", strings + summary->publicKeyAlgorithm);
+		memcpy (certs [i].fingerprint, summary->fingerprint, sizeof (certs [i].fingerprint));
+	}
+
+	return certs;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		validIndex - Check that a Mapped Index is Consistent
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		validIndex(
+ *			const index_map	*index)				- Mapped Index
+ *
+ *	RETURN VALUE
+ *		true if every count, ref, and offset is within the file, so that
+ *		the index may be used without further checks.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool validIndex (index_map *index)
+{
+	const index_header			*header = (const index_header *) index->map;
+	const char					*base = (const char *) index->map;
+	const index_summary			*summary;
+	uint64_t					expected;
+	uint32_t					i;
+
+	if (index->length < sizeof (index_header))
+		return false;
+
+	if ((memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0)
+	  || (header->version != INDEX_VERSION) || (header->byteOrder != INDEX_BYTE_ORDER))
+		return false;
+
+	expected = sizeof (index_header)
+				+ (uint64_t) header->fileCount * sizeof (index_file)
+				+ (uint64_t) header->summaryCount * sizeof (index_summary)
+				+ (uint64_t) header->refCount * sizeof (uint32_t)
+				+ header->stringBytes;
+	if (expected != index->length)
+		return false;
+
+	index->header = header;
+	index->files = (const index_file *) (base + sizeof (index_header));
+	index->summaries = (const index_summary *) (index->files + header->fileCount);
+	index->refs = (const uint32_t *) (index->summaries + header->summaryCount);
+	index->strings = (const char *) (index->refs + header->refCount);
+
+	if ((header->stringBytes > 0) && (index->strings [header->stringBytes - 1] != '\0'))
+		return false;
+
+	for (i = 0; i < header->fileCount; i++)
+	{
+		if ((uint64_t) index->files [i].firstRef + index->files [i].refCount > header->refCount)
+			return false;
+	}
+
+	for (i = 0; i < header->refCount; i++)
+	{
+		if ((index->refs [i] >= header->summaryCount)
+		  && (index->refs [i] != INDEX_REF_INVALID_PEM) && (index->refs [i] != INDEX_REF_UNDECODABLE))
+			return false;
+	}
+
+	for (i = 0; i < header->summaryCount; i++)
+	{
+		summary = &index->summaries [i];
+		if ((summary->serialLength > CERT_MAX_SERIAL)
+		  || ((uint64_t) summary->serial + summary->serialLength > header->stringBytes)
+		  || (summary->signatureAlgorithm >= header->stringBytes)
+		  || (summary->issuer >= header->stringBytes)
+		  || (summary->notBefore >= header->stringBytes)
+		  || (summary->notAfter >= header->stringBytes)
+		  || (summary->subject >= header->stringBytes)
+		  || (summary->publicKeyAlgorithm >= header->stringBytes))
+			return false;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadIndex - Map an Existing Index
+ *
+ *	SYNOPSIS
+ *		bool
+ *		loadIndex(
+ *			const char		*filename)			- Index File
+ *
+ *	RETURN VALUE
+ *		true if the index was loaded or does not yet exist, false (with
+ *		errno set) otherwise. An index that cannot be used is ignored (and
+ *		replaced by saveIndex), and reported as EINVAL.
+ *-----------------------------------------------------------------------------
+ */
+
+bool loadIndex (const char *filename)
+{
+	struct stat					st;
+	void						*map;
+	int							fd;
+	int							saved;
+
+	memset (&old_index, 0, sizeof (old_index));
+
+	fd = open (filename, O_RDONLY);
+	if (fd == -1)
+		return (errno == ENOENT);
+
+	if (fstat (fd, &st) == -1)
+	{
+		saved = errno;
+		close (fd);
+		errno = saved;
+		return false;
+	}
+
+	if (st.st_size == 0)
+	{
+		close (fd);
+		errno = EINVAL;
+		return false;
+	}
+
+	map = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	saved = errno;
+	close (fd);
+	if (map == MAP_FAILED)
+	{
+		errno = saved;
+		return false;
+	}
+
+	old_index.map = map;
+	old_index.length = (size_t) st.st_size;
+	if (! validIndex (&old_index))
+	{
+		munmap (map, (size_t) st.st_size);
+		memset (&old_index, 0, sizeof (old_index));
+		errno = EINVAL;
+		return false;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		lookupIndex - Find an Unchanged File in the Loaded Index
+ *
+ *	SYNOPSIS
+ *		int
+ *		lookupIndex(
+ *			const struct stat	*st,			- Status of File
+ *			index_cert			**certs)		- Certificates in File
+ *
+ *	RETURN VALUE
+ *		Number of certificates in the file, or -1 if the file is not in the
+ *		index or has changed. When found, *certs is set to an array that the
+ *		caller must free.
+ *
+ *	DESCRIPTION
+ *		A file is unchanged if its device, inode, size, and modification
+ *		time (to the nanosecond) are all the same. Safe to call from any
+ *		thread.
+ *-----------------------------------------------------------------------------
+ */
+
+int lookupIndex (const struct stat *st, index_cert **certs)
+{
+	const index_file			*file = (const index_file *) NULL;
+	index_file					key;
+
+	if (old_index.header != (const index_header *) NULL)
+	{
+		key.dev = (uint64_t) st->st_dev;
+		key.ino = (uint64_t) st->st_ino;
+		file = (const index_file *) bsearch (&key, old_index.files, old_index.header->fileCount, sizeof (index_file), compareFiles);
+
+		if ((file != (const index_file *) NULL)
+		  && ((file->size != (uint64_t) st->st_size) || (file->mtime_ns != MTIME_NS (st))))
+			file = (const index_file *) NULL;
+	}
+
+	if (file != (const index_file *) NULL)
+		*certs = readOldFile (file);
+
+	pthread_mutex_lock (&index_mutex);
+	if ((file != (const index_file *) NULL) && (*certs != (index_cert *) NULL))
+		new_index.hits++;
+	else
+		new_index.misses++;
+	pthread_mutex_unlock (&index_mutex);
+
+	if ((file == (const index_file *) NULL) || (*certs == (index_cert *) NULL))
+		return -1;
+
+	return (int) file->refCount;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addIndex - Record a File in the New Index
+ *
+ *	SYNOPSIS
+ *		void
+ *		addIndex(
+ *			const struct stat	*st,			- Status of File
+ *			int					count,			- Number of Certificates
+ *			const index_cert	*certs)			- Certificates in File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Every file processed in this run (whether or not it came from the
+ *		loaded index) is recorded. Safe to call from any thread.
+ *-----------------------------------------------------------------------------
+ */
+
+void addIndex (const struct stat *st, int count, const index_cert *certs)
+{
+	index_file					key;
+
+	memset (&key, 0, sizeof (key));
+	key.dev = (uint64_t) st->st_dev;
+	key.ino = (uint64_t) st->st_ino;
+	key.size = (uint64_t) st->st_size;
+	key.mtime_ns = MTIME_NS (st);
+
+	pthread_mutex_lock (&index_mutex);
+	addFile (&key, count, certs);
+	pthread_mutex_unlock (&index_mutex);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		writeAll - Write a Buffer Completely
+ *-----------------------------------------------------------------------------
+ */
+
+static bool writeAll (int fd, const void *buffer, size_t length)
+{
+	const char					*p = (const char *) buffer;
+	ssize_t						n;
+
+	while (length > 0)
+	{
+		n = write (fd, p, length);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		length -= (size_t) n;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		saveIndex - Write the New Index
+ *
+ *	SYNOPSIS
+ *		bool
+ *		saveIndex(
+ *			const char		*filename)			- Index File
+ *
+ *	RETURN VALUE
+ *		true if the index was written, false (with errno set) otherwise.
+ *
+ *	DESCRIPTION
+ *		Files that were in the loaded index but were not processed in this
+ *		run are carried over unchanged, so that runs over different sets of
+ *		files share one index. The new index is written to a temporary file
+ *		in the same directory, synced, and renamed over the old index.
+ *-----------------------------------------------------------------------------
+ */
+
+bool saveIndex (const char *filename)
+{
+	index_header				header;
+	index_cert					*certs;
+	char						tempname [4096];
+	size_t						newCount;
+	size_t						i;
+	size_t						j;
+	int							fd;
+	int							saved;
+	bool						ok;
+
+	pthread_mutex_lock (&index_mutex);
+
+	/*-------------------------------------------------------------------------
+	 *	Sort the files from this run, dropping any named more than once.
+	 *-------------------------------------------------------------------------
+	 */
+
+	qsort (new_index.files, new_index.fileCount, sizeof (index_file), compareFiles);
+	for (i = 0, j = 0; i < new_index.fileCount; i++)
+	{
+		if ((j == 0) || (compareFiles (&new_index.files [j - 1], &new_index.files [i]) != 0))
+			new_index.files [j++] = new_index.files [i];
+	}
+	new_index.fileCount = j;
+	newCount = j;
+
+	/*-------------------------------------------------------------------------
+	 *	Carry over files not processed in this run.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (old_index.header != (const index_header *) NULL)
+	{
+		for (i = 0; i < old_index.header->fileCount; i++)
+		{
+			if (bsearch (&old_index.files [i], new_index.files, newCount, sizeof (index_file), compareFiles) != NULL)
+				continue;
+
+			certs = readOldFile (&old_index.files [i]);
+			if (certs == (index_cert *) NULL)
+			{
+				new_index.failed = true;
+				break;
+			}
+			addFile (&old_index.files [i], (int) old_index.files [i].refCount, certs);
+			free (certs);
+		}
+
+		qsort (new_index.files, new_index.fileCount, sizeof (index_file), compareFiles);
+	}
+
+	if (new_index.failed || (new_index.stringBytes > UINT32_MAX) || (new_index.refCount > UINT32_MAX))
+	{
+		pthread_mutex_unlock (&index_mutex);
+		errno = ENOMEM;
+		return false;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Write and Rename.
+	 *-------------------------------------------------------------------------
+	 */
+
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+	header.version = INDEX_VERSION;
+	header.byteOrder = INDEX_BYTE_ORDER;
+	header.fileCount = (uint32_t) new_index.fileCount;
+	header.summaryCount = (uint32_t) new_index.summaryCount;
+	header.refCount = (uint32_t) new_index.refCount;
+	header.stringBytes = (uint32_t) new_index.stringBytes;
+
+	snprintf (tempname, sizeof (tempname), "%s.XXXXXX", filename);
+	fd = mkstemp (tempname);
+	if (fd == -1)
+	{
+		pthread_mutex_unlock (&index_mutex);
+		return false;
+	}
+
+	ok = writeAll (fd, &header, sizeof (header))
+		&& writeAll (fd, new_index.files, new_index.fileCount * sizeof (index_file))
+		&& writeAll (fd, new_index.summaries, new_index.summaryCount * sizeof (index_summary))
+		&& writeAll (fd, new_index.refs, new_index.refCount * sizeof (uint32_t))
+		&& writeAll (fd, new_index.strings, new_index.stringBytes)
+		&& (fsync (fd) == 0);
+
+	saved = errno;
+	if ((close (fd) == -1) && ok)
+	{
+		saved = errno;
+		ok = false;
+	}
+
+	if (ok && (rename (tempname, filename) == -1))
+	{
+		saved = errno;
+		ok = false;
+	}
+
+	if (! ok)
+		unlink (tempname);
+
+	pthread_mutex_unlock (&index_mutex);
+	errno = saved;
+	return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		indexStatistics - Report Index Hits and Misses
+ *
+ *	SYNOPSIS
+ *		void
+ *		indexStatistics(
+ *			unsigned long	*hits,				- Files Reported from Index
+ *			unsigned long	*misses)			- Files Read
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void indexStatistics (unsigned long *hits, unsigned long *misses)
+{
+	pthread_mutex_lock (&index_mutex);
+	*hits = new_index.hits;
+	*misses = new_index.misses;
+	pthread_mutex_unlock (&index_mutex);
+}
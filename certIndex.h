@@ -0,0 +1,38 @@
+/*-----------------------------------------------------------------------------
+ *	certIndex, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTINDEX_H
+#define CERTINDEX_H
+
+#include <sys/stat.h>
+
+#include "certDecode.h"
+#include "digest.h"
+
+/*-----------------------------------------------------------------------------
+ *	Result of decoding one certificate in a file.
+ *-----------------------------------------------------------------------------
+ */
+
+#define INDEX_VALID				0
+#define INDEX_INVALID_PEM		1					/* Invalid Base64 or no END line */
+#define INDEX_UNDECODABLE		2					/* decodeCertificate failed */
+
+typedef struct
+{
+	int						status;
+	cert_info				info;
+	unsigned char			fingerprint [SHA256_LENGTH];	/* Zero if not decoded */
+}
+index_cert;
+
+bool loadIndex (const char *filename);
+int lookupIndex (const struct stat *st, index_cert **certs);
+void addIndex (const struct stat *st, int count, const index_cert *certs);
+bool saveIndex (const char *filename);
+void indexStatistics (unsigned long *hits, unsigned long *misses);
+
+#endif
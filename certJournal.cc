@@ -0,0 +1,503 @@
+/*-----------------------------------------------------------------------------
+ *	certJournal, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "certFile.h"
+#include "certJournal.h"
+
+/*-----------------------------------------------------------------------------
+ *	A journal is a text file:
+ *
+ *		certTools journal 1
+ *		edit<TAB>mode<TAB>original<TAB>backup
+ *		...
+ *		commit
+ *
+ *	mode is octal, and names are absolute, with backslash, tab, and newline
+ *	escaped as \\, \t, and \n. An edit line is written before the file is
+ *	replaced; commit is written once every edited file is durable.
+ *-----------------------------------------------------------------------------
+ */
+
+#define JOURNAL_HEADER			"certTools journal 1\n"
+#define JOURNAL_COMMIT			"commit\n"
+
+/*-----------------------------------------------------------------------------
+ *	A file system with files to be synced, and a descriptor to sync it by.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	dev_t					dev;
+	int						fd;
+}
+file_system;
+
+static pthread_mutex_t		journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int					journal_fd = -1;
+static file_system			*file_systems = (file_system *) NULL;
+static int					file_system_count = 0;
+static int					file_system_size = 0;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		writeAll - Write a Buffer Completely
+ *-----------------------------------------------------------------------------
+ */
+
+static bool writeAll (int fd, const void *buffer, size_t length)
+{
+	const char					*p = (const char *) buffer;
+	ssize_t						n;
+
+	while (length > 0)
+	{
+		n = write (fd, p, length);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		length -= (size_t) n;
+	}
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		escapeName - Append a Name to a Journal Line
+ *-----------------------------------------------------------------------------
+ */
+
+static void escapeName (const char *name, char *buffer, size_t size)
+{
+	size_t						length = strlen (buffer);
+
+	for (; (*name != '\0') && (length + 3 < size); name++)
+	{
+		if (*name == '\\')
+		{
+			buffer [length++] = '\\';
+			buffer [length++] = '\\';
+		}
+		else if (*name == '\t')
+		{
+			buffer [length++] = '\\';
+			buffer [length++] = 't';
+		}
+		else if (*name == '\n')
+		{
+			buffer [length++] = '\\';
+			buffer [length++] = 'n';
+		}
+		else
+			buffer [length++] = *name;
+	}
+
+	buffer [length] = '\0';
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		unescapeName - Copy a Name from a Journal Line
+ *-----------------------------------------------------------------------------
+ */
+
+static char *unescapeName (const char *field)
+{
+	char						*name;
+	char						*dp;
+
+	name = (char *) malloc (strlen (field) + 1);
+	if (name == (char *) NULL)
+		return name;
+
+	for (dp = name; *field != '\0'; field++)
+	{
+		if ((*field == '\\') && (field [1] != '\0'))
+		{
+			field++;
+			*dp++ = (*field == 't') ? '\t' : (*field == 'n') ? '\n' : *field;
+		}
+		else
+			*dp++ = *field;
+	}
+	*dp = '\0';
+
+	return name;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addFileSystem - Remember the File System of a File, to be Synced
+ *
+ *	SYNOPSIS
+ *		void
+ *		addFileSystem(
+ *			const char		*filename)			- Any File on the File System
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Each file system is remembered once, however many of its files are
+ *		added, so that syncFileSystems syncs each of them only once.
+ *-----------------------------------------------------------------------------
+ */
+
+void addFileSystem (const char *filename)
+{
+	struct stat					st;
+	file_system					*newList;
+	int							i;
+	int							fd;
+
+	fd = open (filename, O_RDONLY);
+	if (fd == -1)
+		return;
+
+	if (fstat (fd, &st) == -1)
+	{
+		close (fd);
+		return;
+	}
+
+	pthread_mutex_lock (&journal_mutex);
+
+	for (i = 0; i < file_system_count; i++)
+	{
+		if (file_systems [i].dev == st.st_dev)
+			break;
+	}
+
+	if (i == file_system_count)
+	{
+		if (file_system_count == file_system_size)
+		{
+			newList = (file_system *) realloc (file_systems, (file_system_size + 8) * sizeof (file_system));
+			if (newList != (file_system *) NULL)
+			{
+				file_systems = newList;
+				file_system_size += 8;
+			}
+		}
+
+		if (file_system_count < file_system_size)
+		{
+			file_systems [file_system_count].dev = st.st_dev;
+			file_systems [file_system_count].fd = fd;
+			file_system_count++;
+			fd = -1;
+		}
+	}
+
+	pthread_mutex_unlock (&journal_mutex);
+
+	if (fd != -1)
+		close (fd);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		syncFileSystems - Make all Files Written to Remembered File Systems
+ *		Durable
+ *
+ *	SYNOPSIS
+ *		bool
+ *		syncFileSystems(void)
+ *
+ *	RETURN VALUE
+ *		true if all were synced, false (with errno set) otherwise.
+ *
+ *	DESCRIPTION
+ *		One syncfs per file system takes the place of an fsync of every file
+ *		and directory written. Where syncfs is not available, everything is
+ *		synced once. The file systems are then forgotten.
+ *-----------------------------------------------------------------------------
+ */
+
+bool syncFileSystems (void)
+{
+	int							i;
+	int							saved = 0;
+	bool						ok = true;
+
+	pthread_mutex_lock (&journal_mutex);
+
+#ifdef __linux__
+	for (i = 0; i < file_system_count; i++)
+	{
+		if (syncfs (file_systems [i].fd) == -1)
+		{
+			saved = errno;
+			ok = false;
+		}
+	}
+#else
+	if (file_system_count > 0)
+		sync ();
+#endif
+
+	for (i = 0; i < file_system_count; i++)
+		close (file_systems [i].fd);
+	file_system_count = 0;
+
+	pthread_mutex_unlock (&journal_mutex);
+
+	errno = saved;
+	return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		openJournal - Start a Journal of the Files Edited in a Run
+ *
+ *	SYNOPSIS
+ *		bool
+ *		openJournal(
+ *			const char		*filename)			- Journal File
+ *
+ *	RETURN VALUE
+ *		true if the journal was created, false (with errno set) otherwise.
+ *
+ *	DESCRIPTION
+ *		Any existing journal of that name is replaced.
+ *-----------------------------------------------------------------------------
+ */
+
+bool openJournal (const char *filename)
+{
+	int							saved;
+
+	journal_fd = open (filename, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	if (journal_fd == -1)
+		return false;
+
+	if ((! writeAll (journal_fd, JOURNAL_HEADER, sizeof (JOURNAL_HEADER) - 1)) || (fsync (journal_fd) == -1))
+	{
+		saved = errno;
+		close (journal_fd);
+		journal_fd = -1;
+		errno = saved;
+		return false;
+	}
+
+	addFileSystem (filename);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		journalEdit - Record a File about to be Replaced
+ *
+ *	SYNOPSIS
+ *		bool
+ *		journalEdit(
+ *			const char		*original,			- File to be Replaced
+ *			const char		*backup,			- Backup of Original
+ *			mode_t			mode)				- Permissions of Original
+ *
+ *	RETURN VALUE
+ *		true if recorded (or there is no journal), false (with errno set)
+ *		otherwise.
+ *
+ *	DESCRIPTION
+ *		May be called by several threads at once. The file system of the
+ *		file is remembered, to be synced by closeJournal.
+ *-----------------------------------------------------------------------------
+ */
+
+bool journalEdit (const char *original, const char *backup, mode_t mode)
+{
+	char						path [4096];
+	char						line [3 * 8192 + 64];
+	bool						ok;
+
+	if (journal_fd == -1)
+		return true;
+
+	snprintf (line, sizeof (line), "edit\t%04o\t", (unsigned int) (mode & 07777));
+	fullPathname (original, true, path, sizeof (path));
+	escapeName (path, line, sizeof (line));
+	strcat (line, "\t");
+	fullPathname (backup, true, path, sizeof (path));
+	escapeName (path, line, sizeof (line));
+	strcat (line, "\n");
+
+	pthread_mutex_lock (&journal_mutex);
+	ok = writeAll (journal_fd, line, strlen (line));
+	pthread_mutex_unlock (&journal_mutex);
+
+	addFileSystem (original);
+	return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		closeJournal - Make the Run Durable and Mark it Complete
+ *
+ *	SYNOPSIS
+ *		bool
+ *		closeJournal(void)
+ *
+ *	RETURN VALUE
+ *		true if every edited file and the journal are durable, false (with
+ *		errno set) otherwise.
+ *-----------------------------------------------------------------------------
+ */
+
+bool closeJournal (void)
+{
+	bool						ok;
+	int							saved;
+
+	if (journal_fd == -1)
+		return true;
+
+	ok = syncFileSystems ()
+		&& writeAll (journal_fd, JOURNAL_COMMIT, sizeof (JOURNAL_COMMIT) - 1)
+		&& (fsync (journal_fd) == 0);
+
+	saved = errno;
+	if ((close (journal_fd) == -1) && ok)
+	{
+		saved = errno;
+		ok = false;
+	}
+	journal_fd = -1;
+
+	errno = saved;
+	return ok;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readJournal - Read the Files Edited in a Run
+ *
+ *	SYNOPSIS
+ *		int
+ *		readJournal(
+ *			const char		*filename,			- Journal File
+ *			journal_entry	**entries,			- Files Edited
+ *			bool			*committed)			- Run was Completed
+ *
+ *	RETURN VALUE
+ *		Number of entries, or -1 (with errno set) if the journal could not
+ *		be read. The entries are freed by freeJournal.
+ *-----------------------------------------------------------------------------
+ */
+
+int readJournal (const char *filename, journal_entry **entries, bool *committed)
+{
+	FILE						*in;
+	char						*line = (char *) NULL;
+	size_t						lineSize = 0;
+	ssize_t						length;
+	char						*fields [4];
+	char						*cp;
+	journal_entry				*list = (journal_entry *) NULL;
+	journal_entry				*newList;
+	int							count = 0;
+	int							size = 0;
+	int							i;
+
+	*entries = (journal_entry *) NULL;
+	*committed = false;
+
+	in = fopen (filename, "r");
+	if (in == (FILE *) NULL)
+		return -1;
+
+	length = getline (&line, &lineSize, in);
+	if ((length == -1) || (strcmp (line, JOURNAL_HEADER) != 0))
+	{
+		free (line);
+		fclose (in);
+		errno = EINVAL;
+		return -1;
+	}
+
+	while ((length = getline (&line, &lineSize, in)) != -1)
+	{
+		if (strcmp (line, JOURNAL_COMMIT) == 0)
+		{
+			*committed = true;
+			continue;
+		}
+
+		/*---------------------------------------------------------------------
+		 *	An incomplete last line (the run was interrupted) is ignored.
+		 *---------------------------------------------------------------------
+		 */
+
+		if (line [length - 1] != '\n')
+			break;
+		line [length - 1] = '\0';
+
+		for (i = 0, cp = line; i < 4; i++)
+		{
+			fields [i] = cp;
+			cp = strchr (cp, '\t');
+			if (cp == (char *) NULL)
+				break;
+			*cp++ = '\0';
+		}
+
+		if ((i != 3) || (strcmp (fields [0], "edit") != 0))
+			continue;
+
+		if (count == size)
+		{
+			newList = (journal_entry *) realloc (list, (size + 64) * sizeof (journal_entry));
+			if (newList == (journal_entry *) NULL)
+				break;
+			list = newList;
+			size += 64;
+		}
+
+		list [count].mode = (mode_t) strtol (fields [1], (char **) NULL, 8);
+		list [count].original = unescapeName (fields [2]);
+		list [count].backup = unescapeName (fields [3]);
+		count++;
+	}
+
+	free (line);
+	fclose (in);
+
+	*entries = list;
+	return count;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		freeJournal - Free the Entries Read by readJournal
+ *-----------------------------------------------------------------------------
+ */
+
+void freeJournal (journal_entry *entries, int count)
+{
+	int							i;
+
+	for (i = 0; i < count; i++)
+	{
+		free (entries [i].original);
+		free (entries [i].backup);
+	}
+
+	free (entries);
+}
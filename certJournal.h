@@ -0,0 +1,34 @@
+/*-----------------------------------------------------------------------------
+ *	certJournal, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTJOURNAL_H
+#define CERTJOURNAL_H
+
+#include <sys/types.h>
+
+/*-----------------------------------------------------------------------------
+ *	One file edited in a run: where it is, where its original was backed
+ *	up, and the permissions of the original.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	char					*original;
+	char					*backup;
+	mode_t					mode;
+}
+journal_entry;
+
+bool openJournal (const char *filename);
+bool journalEdit (const char *original, const char *backup, mode_t mode);
+bool closeJournal (void);
+int readJournal (const char *filename, journal_entry **entries, bool *committed);
+void freeJournal (journal_entry *entries, int count);
+void addFileSystem (const char *filename);
+bool syncFileSystems (void);
+
+#endif
@@ -0,0 +1,316 @@
+/*-----------------------------------------------------------------------------
+ *	certLineage, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "certLineage.h"
+#include "certView.h"
+#include "digest.h"
+#include "pemScan.h"
+
+/*-----------------------------------------------------------------------------
+ *	certbot keeps each lineage in live/<domain>/ as cert.pem (the leaf),
+ *	chain.pem (its intermediates), fullchain.pem (both, in that order), and
+ *	privkey.pem. A lineage is consistent if each certificate of fullchain.pem
+ *	has the same DER encoding as the corresponding one of cert.pem followed
+ *	by chain.pem, and the public key of privkey.pem is that of cert.pem.
+ *
+ *	Certificates are compared by the SHA-256 digests of their DER encodings,
+ *	as viewed by nextCertView, so that differences in line length or line
+ *	terminators do not matter.
+ *-----------------------------------------------------------------------------
+ */
+
+#define PEM_PRIVATE_KEY			"PRIVATE KEY-----"
+#define PEM_END					"-----END "
+
+typedef struct
+{
+	int						count;
+	unsigned char			digests [LINEAGE_MAX_CERTS][SHA256_LENGTH];
+	bool					valid [LINEAGE_MAX_CERTS];
+	bool					key;				/* Leaf key digest found */
+	unsigned char			keyDigest [SHA256_LENGTH];
+}
+lineage_file;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readLineageFile - Record the Digests of the Certificates in a File
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		readLineageFile(
+ *			const char		*directory,			- Lineage Directory
+ *			const char		*name,				- cert.pem, chain.pem, ...
+ *			lineage_file	*lineage)			- Digests Found
+ *
+ *	RETURN VALUE
+ *		true if the file was read, false (with errno set) otherwise.
+ *
+ *	DESCRIPTION
+ *		The public key of the first certificate (the leaf, in cert.pem) is
+ *		recorded too, for comparison with privkey.pem.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool readLineageFile (const char *directory, const char *name, lineage_file *lineage)
+{
+	char						filename [4096];
+	pem_file					file;
+	cert_iterator				iterator;
+	cert_view					view;
+	unsigned char				*scratch;
+
+	memset (lineage, 0, sizeof (lineage_file));
+
+	snprintf (filename, sizeof (filename), "%s/%s", directory, name);
+	if (! openPemFile (filename, &file))
+		return false;
+
+	scratch = (unsigned char *) malloc ((file.length * 3) / 4 + 1);
+	if (scratch == (unsigned char *) NULL)
+	{
+		closePemFile (&file);
+		errno = ENOMEM;
+		return false;
+	}
+
+	startCertViews (&iterator, file.data, file.length, scratch);
+	while (nextCertView (&iterator, &view))
+	{
+		lineage->count = view.index;
+		if ((view.index > LINEAGE_MAX_CERTS) || (view.der == (const unsigned char *) NULL))
+			continue;
+
+		lineage->valid [view.index - 1] = true;
+		sha256Digest (view.der, view.derLength, lineage->digests [view.index - 1]);
+
+		if (view.index == 1)
+		{
+			sha256Digest (view.publicKey.data (), view.publicKey.size (), lineage->keyDigest);
+			lineage->key = true;
+		}
+	}
+
+	free (scratch);
+	closePemFile (&file);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		wipeMemory - Clear Memory that Held a Private Key
+ *-----------------------------------------------------------------------------
+ */
+
+static void wipeMemory (const void *p, size_t length)
+{
+	volatile unsigned char		*wipe = (volatile unsigned char *) p;
+	size_t						i;
+
+	for (i = 0; i < length; i++)
+		wipe [i] = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readPrivateKey - Record the Digest of the Public Key of privkey.pem
+ *
+ *	SYNOPSIS
+ *		static int
+ *		readPrivateKey(
+ *			const char		*directory,			- Lineage Directory
+ *			unsigned char	*digest)			- SHA256_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		1 if the public key was found, 0 if not, or -1 (with errno set) if
+ *		the file could not be read.
+ *
+ *	DESCRIPTION
+ *		The first PEM block whose label ends in PRIVATE KEY is decoded. The
+ *		key (and the text of the file, unless it was mapped) is wiped from
+ *		memory as soon as its public key has been hashed.
+ *-----------------------------------------------------------------------------
+ */
+
+static int readPrivateKey (const char *directory, unsigned char *digest)
+{
+	char						filename [4096];
+	pem_file					file;
+	std::string_view			text;
+	std::string_view			publicKey;
+	size_t						begin;
+	size_t						label;
+	size_t						body;
+	size_t						bodyEnd;
+	size_t						length;
+	size_t						derSize;
+	unsigned char				*der;
+	int							found = 0;
+
+	snprintf (filename, sizeof (filename), "%s/privkey.pem", directory);
+	if (! openPemFile (filename, &file))
+		return -1;
+
+	text = std::string_view (file.data, file.length);
+	label = text.find (PEM_PRIVATE_KEY);
+	begin = text.rfind ("-----BEGIN ", label);
+	body = text.find ('\n', label);
+	bodyEnd = text.find (PEM_END, body);
+	if ((label == std::string_view::npos) || (begin == std::string_view::npos) || (text.find ('\n', begin) < label)
+	  || (body == std::string_view::npos) || (bodyEnd == std::string_view::npos))
+	{
+		closePemFile (&file);
+		return 0;
+	}
+
+	derSize = (bodyEnd - body) * 3 / 4 + 3;
+	der = (unsigned char *) malloc (derSize);
+	if (der == (unsigned char *) NULL)
+	{
+		closePemFile (&file);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	length = 0;
+	if (decodeBase64 (file.data + body, bodyEnd - body, der, &length) && viewPrivateKey (der, length, &publicKey))
+	{
+		sha256Digest (publicKey.data (), publicKey.size (), digest);
+		found = 1;
+	}
+
+	wipeMemory (der, derSize);
+	free (der);
+	if (! file.mapped)
+		wipeMemory (file.data, file.length);
+	closePemFile (&file);
+	return found;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		auditLineage - Check that the Files of a Lineage are Consistent
+ *
+ *	SYNOPSIS
+ *		void
+ *		auditLineage(
+ *			const char		*path,				- Lineage Directory, or its cert.pem
+ *			char			*directory,			- Lineage Directory (returned)
+ *			size_t			size,				- Size of directory
+ *			lineage_audit	*audit)				- Result
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		path may name the cert.pem of the lineage (as found by walking a
+ *		directory tree), rather than the directory itself. If cert.pem,
+ *		chain.pem, or fullchain.pem cannot be read, the lineage is
+ *		LINEAGE_UNREADABLE, and audit->file and audit->error say why; if
+ *		privkey.pem cannot be read (typically without root), or its public
+ *		key is not found, it is only LINEAGE_KEY_UNCHECKED.
+ *
+ *		audit->differs is the first certificate of fullchain.pem that is not
+ *		the corresponding one of cert.pem and chain.pem (or one more than
+ *		the shorter of the two, if that is where they differ).
+ *-----------------------------------------------------------------------------
+ */
+
+void auditLineage (const char *path, char *directory, size_t size, lineage_audit *audit)
+{
+	static const char * const	names [] = { "cert.pem", "chain.pem", "fullchain.pem" };
+	lineage_file				files [3];
+	unsigned char				keyDigest [SHA256_LENGTH];
+	const lineage_file			*expected;
+	size_t						length = strlen (path);
+	int							index;
+	int							expectedCount;
+	int							compared;
+	int							i;
+
+	while ((length > 1) && (path [length - 1] == '/'))
+		length--;
+	if ((length >= 8) && (strncmp (path + length - 8, "cert.pem", 8) == 0)
+	  && ((length == 8) || (path [length - 9] == '/')))
+		length = (length == 8) ? 0 : length - 9;
+	if (length == 0)
+		snprintf (directory, size, ".");
+	else
+		snprintf (directory, size, "%.*s", (int) length, path);
+
+	memset (audit, 0, sizeof (lineage_audit));
+	memset (files, 0, sizeof (files));
+
+	for (i = 0; i < 3; i++)
+	{
+		if (! readLineageFile (directory, names [i], &files [i]))
+		{
+			audit->status = LINEAGE_UNREADABLE;
+			audit->file = names [i];
+			audit->error = errno;
+			if (i == 0)
+				return;
+			break;
+		}
+	}
+
+	audit->certCount = files [0].count;
+	audit->chainCount = files [1].count;
+	audit->fullchainCount = files [2].count;
+
+	/*-------------------------------------------------------------------------
+	 *	fullchain.pem must be cert.pem followed by chain.pem.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (audit->status == 0)
+	{
+		expectedCount = files [0].count + files [1].count;
+		compared = (expectedCount < files [2].count) ? expectedCount : files [2].count;
+		for (i = 0; (i < compared) && (i < LINEAGE_MAX_CERTS) && (audit->differs == 0); i++)
+		{
+			expected = (i < files [0].count) ? &files [0] : &files [1];
+			index = (i < files [0].count) ? i : i - files [0].count;
+			if ((index >= LINEAGE_MAX_CERTS) || (! expected->valid [index]) || (! files [2].valid [i])
+			  || (memcmp (expected->digests [index], files [2].digests [i], SHA256_LENGTH) != 0))
+				audit->differs = i + 1;
+		}
+
+		if ((audit->differs == 0) && (expectedCount != files [2].count))
+			audit->differs = compared + 1;
+
+		if (audit->differs != 0)
+			audit->status |= LINEAGE_FULLCHAIN;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	privkey.pem must hold the key of the leaf.
+	 *-------------------------------------------------------------------------
+	 */
+
+	switch (files [0].key ? readPrivateKey (directory, keyDigest) : 0)
+	{
+	case 1:
+		if (memcmp (keyDigest, files [0].keyDigest, SHA256_LENGTH) != 0)
+			audit->status |= LINEAGE_KEY_MISMATCH;
+		break;
+
+	case 0:
+		audit->status |= LINEAGE_KEY_UNCHECKED;
+		break;
+
+	default:
+		audit->status |= LINEAGE_KEY_UNCHECKED;
+		audit->keyError = errno;
+		break;
+	}
+}
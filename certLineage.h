@@ -0,0 +1,39 @@
+/*-----------------------------------------------------------------------------
+ *	certLineage, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTLINEAGE_H
+#define CERTLINEAGE_H
+
+#include <stddef.h>
+
+#define LINEAGE_UNREADABLE		0x01				/* cert.pem, chain.pem, or fullchain.pem */
+#define LINEAGE_FULLCHAIN		0x02				/* fullchain.pem is not cert.pem, chain.pem */
+#define LINEAGE_KEY_MISMATCH	0x04				/* privkey.pem is not the key of cert.pem */
+#define LINEAGE_KEY_UNCHECKED	0x08				/* privkey.pem not read, or no public key */
+
+#define LINEAGE_MAX_CERTS		16					/* Compared in each file */
+
+/*-----------------------------------------------------------------------------
+ *	Result of auditing one certbot lineage (live/<domain>/) directory.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	int						status;				/* 0 if consistent */
+	const char				*file;				/* Not read, if unreadable */
+	int						error;				/* errno, if unreadable */
+	int						keyError;			/* errno, 0 if key not found */
+	int						certCount;			/* Certificates in cert.pem */
+	int						chainCount;			/* ... in chain.pem */
+	int						fullchainCount;		/* ... in fullchain.pem */
+	int						differs;			/* First that differs, 0 if none */
+}
+lineage_audit;
+
+void auditLineage (const char *path, char *directory, size_t size, lineage_audit *audit);
+
+#endif
@@ -0,0 +1,828 @@
+/*-----------------------------------------------------------------------------
+ *	certMatch, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <sys/types.h>
+
+#include "certDecode.h"
+#include "certMatch.h"
+
+/*-----------------------------------------------------------------------------
+ *	A name is matched by rewriting it as one string of its attributes, in
+ *	lower case and with escapes undone,
+ *
+ *		\001 attribute \003 value \002 \001 attribute \003 value \002 ...
+ *
+ *	and scanning that once with an Aho-Corasick automaton built from one
+ *	keyword per pattern. The automaton is a complete DFA over classes of
+ *	bytes (one class per byte that occurs in some keyword, and one for all
+ *	others), so each byte of a name costs one table lookup however many
+ *	patterns there are.
+ *
+ *	The keyword of a literal is the whole value between its markers (and
+ *	the attribute, if given), so finding it is a match. The keyword of a
+ *	glob or regex is its longest run of literal text, and finding it only
+ *	makes it a candidate, checked against the attribute it was found in.
+ *	A glob or regex with no literal text is checked against every
+ *	attribute.
+ *-----------------------------------------------------------------------------
+ */
+
+#define MARK_ATTRIBUTE			'\001'
+#define MARK_END				'\002'
+#define MARK_VALUE				'\003'
+
+#define MATCH_LITERAL			0
+#define MATCH_GLOB				1
+#define MATCH_REGEX				2
+
+typedef struct
+{
+	int						kind;				/* MATCH_LITERAL, ... */
+	char					*attribute;			/* Lower case, NULL for any */
+	char					*value;				/* Literal (lower case), glob, or regex */
+	regex_t					regex;
+	char					*keyword;			/* NULL if none */
+	size_t					keywordLength;
+}
+match_pattern;
+
+struct cert_matcher
+{
+	match_pattern			*patterns;
+	int						count;
+	int						size;
+	int						*always;			/* Patterns without keywords */
+	int						alwaysCount;
+	unsigned char			classes [256];		/* Byte to class */
+	int						classCount;
+	int						*delta;				/* [state * classCount + class] */
+	int						*first;				/* First pattern of state, -1 */
+	int						*next;				/* Next pattern of same state */
+	int						*output;			/* Nearest suffix state with patterns */
+	int						stateCount;
+};
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hexValue - Value of a Hexadecimal Digit, or -1
+ *-----------------------------------------------------------------------------
+ */
+
+static int hexValue (char c)
+{
+	if ((c >= '0') && (c <= '9'))
+		return c - '0';
+	if ((c >= 'a') && (c <= 'f'))
+		return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F'))
+		return c - 'A' + 10;
+	return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		unescapeValue - Copy a Value in Lower Case, Undoing Escapes
+ *
+ *	SYNOPSIS
+ *		static const char *
+ *		unescapeValue(
+ *			const char		*p,					- Value (after "NAME = ")
+ *			bool			inName,				- Ends at ", " or " + "
+ *			char			*buffer,			- Output Buffer
+ *			size_t			*length,			- Length Used (updated)
+ *			size_t			size)				- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		Just past the value.
+ *
+ *	DESCRIPTION
+ *		Undoes the quoting and escaping of formatValue, so that a value is
+ *		matched as the text it holds. Escaped control characters are left
+ *		escaped, so that a value never contains a marker. Within a name, a
+ *		value ends at the separator of the next attribute, which cannot
+ *		occur within an unquoted value (formatValue quotes any value
+ *		containing "," or "+").
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *unescapeValue (const char *p, bool inName, char *buffer, size_t *length, size_t size)
+{
+	bool						quoted = false;
+	int							high;
+	int							low;
+	int							c;
+
+	if (*p == '"')
+	{
+		quoted = true;
+		p++;
+	}
+
+	while (*p != '\0')
+	{
+		if (quoted && (*p == '"') && ((p [1] == '\0') || (strncmp (p + 1, ", ", 2) == 0) || (strncmp (p + 1, " + ", 3) == 0)))
+		{
+			p++;
+			break;
+		}
+
+		if (inName && (! quoted) && ((strncmp (p, ", ", 2) == 0) || (strncmp (p, " + ", 3) == 0)))
+			break;
+
+		if ((*p == '\\') && (p [1] == '\\'))
+		{
+			c = '\\';
+			p += 2;
+		}
+		else if ((*p == '\\') && ((high = hexValue (p [1])) >= 0) && ((low = hexValue (p [2])) >= 0) && (high * 16 + low >= 0x20))
+		{
+			c = high * 16 + low;
+			p += 3;
+		}
+		else
+			c = (unsigned char) *p++;
+
+		if (*length + 1 < size)
+			buffer [(*length)++] = (char) tolower (c);
+	}
+
+	buffer [*length] = '\0';
+	return p;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		normalizeName - Rewrite a Name as Marked Attributes
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		normalizeName(
+ *			const char		*name,				- "C = US, O = Org, CN = Name"
+ *			char			*buffer,			- Output Buffer
+ *			size_t			size)				- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		Length of the rewritten name.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t normalizeName (const char *name, char *buffer, size_t size)
+{
+	const char					*p = name;
+	const char					*equals;
+	size_t						length = 0;
+
+	while (*p != '\0')
+	{
+		equals = strstr (p, " = ");
+		if ((equals == (const char *) NULL) || (length + (equals - p) + 3 >= size))
+			break;
+
+		buffer [length++] = MARK_ATTRIBUTE;
+		while (p < equals)
+			buffer [length++] = (char) tolower ((unsigned char) *p++);
+		buffer [length++] = MARK_VALUE;
+
+		p = unescapeValue (equals + 3, true, buffer, &length, size - 1);
+		buffer [length++] = MARK_END;
+
+		if (strncmp (p, ", ", 2) == 0)
+			p += 2;
+		else if (strncmp (p, " + ", 3) == 0)
+			p += 3;
+	}
+
+	buffer [length] = '\0';
+	return length;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		literalRun - Find the Longest Run of Literal Text in a Glob or Regex
+ *
+ *	SYNOPSIS
+ *		static size_t
+ *		literalRun(
+ *			const char		*pattern,			- Glob or Regex
+ *			bool			regex,				- Pattern is a Regex
+ *			size_t			*start)				- Start of Run
+ *
+ *	RETURN VALUE
+ *		Length of the run, 0 if there is none that every match contains.
+ *
+ *	DESCRIPTION
+ *		A character followed by * ? or { in a regex is optional, and so is
+ *		not part of a run; a regex with alternatives or groups has no run.
+ *-----------------------------------------------------------------------------
+ */
+
+static size_t literalRun (const char *pattern, bool regex, size_t *start)
+{
+	const char					*metas = regex ? ".[]*+?{}^$\\" : "*?[\\";
+	size_t						bestStart = 0;
+	size_t						bestLength = 0;
+	size_t						runStart = 0;
+	size_t						i;
+
+	if (regex && (strpbrk (pattern, "|()") != (char *) NULL))
+		return 0;
+
+	for (i = 0; ; i++)
+	{
+		if ((pattern [i] != '\0') && (strchr (metas, pattern [i]) == (const char *) NULL))
+			continue;
+
+		/*---------------------------------------------------------------------
+		 *	End of a run.
+		 *---------------------------------------------------------------------
+		 */
+
+		if (regex && (i > runStart) && (pattern [i] != '\0') && (strchr ("*?{", pattern [i]) != (const char *) NULL))
+		{
+			if (i - 1 - runStart > bestLength)
+			{
+				bestStart = runStart;
+				bestLength = i - 1 - runStart;
+			}
+		}
+		else if (i - runStart > bestLength)
+		{
+			bestStart = runStart;
+			bestLength = i - runStart;
+		}
+
+		if (pattern [i] == '\0')
+			break;
+
+		if ((pattern [i] == '\\') && (pattern [i + 1] != '\0'))
+			i++;
+		else if (pattern [i] == '[')
+		{
+			/*-----------------------------------------------------------------
+			 *	Skip a bracket expression ("]" first is part of it).
+			 *-----------------------------------------------------------------
+			 */
+
+			if ((pattern [i + 1] == '!') || (pattern [i + 1] == '^'))
+				i++;
+			if (pattern [i + 1] == ']')
+				i++;
+			while ((pattern [i + 1] != '\0') && (pattern [i + 1] != ']'))
+				i++;
+			if (pattern [i + 1] == ']')
+				i++;
+		}
+
+		runStart = i + 1;
+	}
+
+	*start = bestStart;
+	return bestLength;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		createMatcher - Create an Empty Matcher
+ *
+ *	SYNOPSIS
+ *		cert_matcher *
+ *		createMatcher(void)
+ *
+ *	RETURN VALUE
+ *		Matcher, or NULL (with errno set) if out of memory.
+ *-----------------------------------------------------------------------------
+ */
+
+cert_matcher *createMatcher (void)
+{
+	return (cert_matcher *) calloc (1, sizeof (cert_matcher));
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addMatchPattern - Add a Pattern to a Matcher
+ *
+ *	SYNOPSIS
+ *		bool
+ *		addMatchPattern(
+ *			cert_matcher	*matcher,			- Matcher
+ *			const char		*pattern)			- [ATTRIBUTE=]VALUE
+ *
+ *	RETURN VALUE
+ *		true if the pattern was added, false (with errno set to EINVAL for
+ *		an invalid regex, ENOMEM if out of memory) otherwise.
+ *
+ *	DESCRIPTION
+ *		ATTRIBUTE is a name such as CN, O, OU, or emailAddress, or a dotted
+ *		OID, as displayed; spaces around "=" are ignored. Without it, the
+ *		pattern matches any attribute. A literal or glob must match the
+ *		whole value; a regex may match any part of it (use ^ and $ to
+ *		anchor it). A literal may be written as displayed, quoted and
+ *		escaped. The matcher must be compiled again after adding.
+ *-----------------------------------------------------------------------------
+ */
+
+bool addMatchPattern (cert_matcher *matcher, const char *pattern)
+{
+	match_pattern				*patterns;
+	match_pattern				*p;
+	const char					*value = pattern;
+	const char					*q;
+	size_t						length;
+	size_t						start;
+	size_t						i;
+
+	if (matcher->count == matcher->size)
+	{
+		matcher->size = (matcher->size == 0) ? 16 : matcher->size * 2;
+		patterns = (match_pattern *) realloc (matcher->patterns, matcher->size * sizeof (match_pattern));
+		if (patterns == (match_pattern *) NULL)
+			return false;
+		matcher->patterns = patterns;
+	}
+
+	p = &matcher->patterns [matcher->count];
+	memset (p, 0, sizeof (match_pattern));
+
+	/*-------------------------------------------------------------------------
+	 *	ATTRIBUTE=
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (q = pattern; isalnum ((unsigned char) *q) || (*q == '.'); q++)
+		;
+	length = q - pattern;
+	while (*q == ' ')
+		q++;
+
+	if ((length > 0) && (*q == '='))
+	{
+		p->attribute = strndup (pattern, length);
+		if (p->attribute == (char *) NULL)
+			return false;
+		for (i = 0; i < length; i++)
+			p->attribute [i] = (char) tolower ((unsigned char) p->attribute [i]);
+
+		for (value = q + 1; *value == ' '; value++)
+			;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	VALUE, and what the automaton will look for.
+	 *-------------------------------------------------------------------------
+	 */
+
+	length = strlen (value);
+	if ((length >= 2) && (value [0] == '/') && (value [length - 1] == '/'))
+	{
+		p->kind = MATCH_REGEX;
+		p->value = strndup (value + 1, length - 2);
+	}
+	else if (strpbrk (value, "*?[") != (char *) NULL)
+	{
+		p->kind = MATCH_GLOB;
+		p->value = strdup (value);
+	}
+	else
+	{
+		p->kind = MATCH_LITERAL;
+		p->value = (char *) malloc (length + 1);
+		if (p->value != (char *) NULL)
+		{
+			length = 0;
+			unescapeValue (value, false, p->value, &length, strlen (value) + 1);
+		}
+	}
+
+	if (p->value == (char *) NULL)
+	{
+		free (p->attribute);
+		return false;
+	}
+
+	if (p->kind == MATCH_REGEX)
+	{
+		if (regcomp (&p->regex, p->value, REG_EXTENDED | REG_ICASE | REG_NOSUB) != 0)
+		{
+			free (p->attribute);
+			free (p->value);
+			errno = EINVAL;
+			return false;
+		}
+	}
+
+	if (p->kind == MATCH_LITERAL)
+	{
+		start = 0;
+		length = strlen (p->value);
+	}
+	else
+		length = literalRun (p->value, p->kind == MATCH_REGEX, &start);
+
+	/*-------------------------------------------------------------------------
+	 *	A literal is looked for between its markers (so an empty literal
+	 *	matches an empty value), and a glob is anchored where it begins or
+	 *	ends with its run.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((length > 0) || (p->kind == MATCH_LITERAL))
+	{
+		p->keyword = (char *) malloc (length + strlen ((p->attribute != (char *) NULL) ? p->attribute : "") + 4);
+		if (p->keyword == (char *) NULL)
+		{
+			if (p->kind == MATCH_REGEX)
+				regfree (&p->regex);
+			free (p->attribute);
+			free (p->value);
+			return false;
+		}
+
+		i = 0;
+		if ((p->kind == MATCH_LITERAL) && (p->attribute != (char *) NULL))
+		{
+			p->keyword [i++] = MARK_ATTRIBUTE;
+			strcpy (p->keyword + i, p->attribute);
+			i += strlen (p->attribute);
+		}
+		if ((p->kind != MATCH_REGEX) && (start == 0))
+			p->keyword [i++] = MARK_VALUE;
+		for (q = p->value + start; q < p->value + start + length; q++)
+			p->keyword [i++] = (char) tolower ((unsigned char) *q);
+		if ((p->kind != MATCH_REGEX) && (p->value [start + length] == '\0'))
+			p->keyword [i++] = MARK_END;
+		p->keyword [i] = '\0';
+		p->keywordLength = i;
+	}
+
+	matcher->count++;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		loadMatchPatterns - Add the Patterns in a File to a Matcher
+ *
+ *	SYNOPSIS
+ *		int
+ *		loadMatchPatterns(
+ *			cert_matcher	*matcher,			- Matcher
+ *			const char		*filename,			- One Pattern per Line
+ *			int				*line)				- Line of Invalid Pattern
+ *
+ *	RETURN VALUE
+ *		Number of patterns added, or -1 (with errno set) if the file could
+ *		not be read or a pattern is invalid (errno EINVAL, and *line is its
+ *		line number).
+ *
+ *	DESCRIPTION
+ *		Blank lines, and lines that begin with #, are ignored.
+ *-----------------------------------------------------------------------------
+ */
+
+int loadMatchPatterns (cert_matcher *matcher, const char *filename, int *line)
+{
+	FILE						*in;
+	char						*text = (char *) NULL;
+	size_t						size = 0;
+	ssize_t						length;
+	int							count = 0;
+	int							error;
+
+	*line = 0;
+
+	in = fopen (filename, "r");
+	if (in == (FILE *) NULL)
+		return -1;
+
+	while ((length = getline (&text, &size, in)) != -1)
+	{
+		(*line)++;
+
+		while ((length > 0) && ((text [length - 1] == '\n') || (text [length - 1] == '\r')))
+			text [--length] = '\0';
+
+		if ((length == 0) || (*text == '#'))
+			continue;
+
+		if (! addMatchPattern (matcher, text))
+		{
+			error = errno;
+			free (text);
+			fclose (in);
+			errno = error;
+			return -1;
+		}
+		count++;
+	}
+
+	free (text);
+	fclose (in);
+	*line = 0;
+	return count;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		compileMatcher - Build the Automaton of a Matcher
+ *
+ *	SYNOPSIS
+ *		bool
+ *		compileMatcher(
+ *			cert_matcher	*matcher)			- Matcher
+ *
+ *	RETURN VALUE
+ *		true if compiled, false (with errno set) if out of memory.
+ *
+ *	DESCRIPTION
+ *		The keywords are entered in a trie, whose missing transitions are
+ *		then filled in breadth first from the failure links, giving a DFA.
+ *		Each state also links to the nearest state on its failure chain
+ *		that ends a keyword, so that every keyword ending at a byte is
+ *		found by following those links.
+ *-----------------------------------------------------------------------------
+ */
+
+bool compileMatcher (cert_matcher *matcher)
+{
+	match_pattern				*p;
+	const unsigned char			*q;
+	size_t						maxStates = 1;
+	int							*fail;
+	int							*queue;
+	int							head = 0;
+	int							tail = 0;
+	int							classCount;
+	int							state;
+	int							target;
+	int							f;
+	int							c;
+	int							i;
+
+	free (matcher->always);
+	free (matcher->delta);
+	free (matcher->first);
+	free (matcher->next);
+	free (matcher->output);
+
+	memset (matcher->classes, 0, sizeof (matcher->classes));
+	classCount = 1;
+	matcher->alwaysCount = 0;
+
+	for (i = 0; i < matcher->count; i++)
+	{
+		p = &matcher->patterns [i];
+		for (q = (const unsigned char *) p->keyword; (q != (const unsigned char *) NULL) && (*q != '\0'); q++)
+		{
+			if (matcher->classes [*q] == 0)
+				matcher->classes [*q] = (unsigned char) classCount++;
+		}
+		maxStates += p->keywordLength;
+	}
+	matcher->classCount = classCount;
+
+	matcher->always = (int *) malloc ((matcher->count + 1) * sizeof (int));
+	matcher->delta = (int *) malloc (maxStates * classCount * sizeof (int));
+	matcher->first = (int *) malloc (maxStates * sizeof (int));
+	matcher->next = (int *) malloc ((matcher->count + 1) * sizeof (int));
+	matcher->output = (int *) calloc (maxStates, sizeof (int));
+	fail = (int *) calloc (maxStates, sizeof (int));
+	queue = (int *) malloc (maxStates * sizeof (int));
+	if ((matcher->always == (int *) NULL) || (matcher->delta == (int *) NULL) || (matcher->first == (int *) NULL) ||
+		(matcher->next == (int *) NULL) || (matcher->output == (int *) NULL) || (fail == (int *) NULL) || (queue == (int *) NULL))
+	{
+		free (fail);
+		free (queue);
+		return false;
+	}
+
+	memset (matcher->delta, 0xff, maxStates * classCount * sizeof (int));
+	memset (matcher->first, 0xff, maxStates * sizeof (int));
+	matcher->stateCount = 1;
+
+	/*-------------------------------------------------------------------------
+	 *	Trie.
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (i = 0; i < matcher->count; i++)
+	{
+		p = &matcher->patterns [i];
+		if (p->keyword == (char *) NULL)
+		{
+			matcher->always [matcher->alwaysCount++] = i;
+			continue;
+		}
+
+		state = 0;
+		for (q = (const unsigned char *) p->keyword; *q != '\0'; q++)
+		{
+			c = matcher->classes [*q];
+			if (matcher->delta [state * classCount + c] == -1)
+				matcher->delta [state * classCount + c] = matcher->stateCount++;
+			state = matcher->delta [state * classCount + c];
+		}
+
+		matcher->next [i] = matcher->first [state];
+		matcher->first [state] = i;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Failure links, breadth first, so that the row of a failure state is
+	 *	complete before it is used.
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (c = 0; c < classCount; c++)
+	{
+		target = matcher->delta [c];
+		if (target == -1)
+			matcher->delta [c] = 0;
+		else
+			queue [tail++] = target;
+	}
+
+	while (head < tail)
+	{
+		state = queue [head++];
+		for (c = 0; c < classCount; c++)
+		{
+			target = matcher->delta [state * classCount + c];
+			f = matcher->delta [fail [state] * classCount + c];
+			if (target == -1)
+				matcher->delta [state * classCount + c] = f;
+			else
+			{
+				fail [target] = f;
+				matcher->output [target] = (matcher->first [f] != -1) ? f : matcher->output [f];
+				queue [tail++] = target;
+			}
+		}
+	}
+
+	free (fail);
+	free (queue);
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		matchPatterns - Number of Patterns in a Matcher
+ *-----------------------------------------------------------------------------
+ */
+
+int matchPatterns (const cert_matcher *matcher)
+{
+	return matcher->count;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		matchAttribute - Check a Pattern against One Attribute
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		matchAttribute(
+ *			const match_pattern	*p,				- Pattern
+ *			const char		*attribute)			- At MARK_ATTRIBUTE
+ *
+ *	RETURN VALUE
+ *		true if the pattern matches the attribute.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool matchAttribute (const match_pattern *p, const char *attribute)
+{
+	const char					*value;
+	const char					*end;
+	char						buffer [CERT_MAX_NAME];
+
+	value = strchr (attribute, MARK_VALUE);
+	end = strchr (attribute, MARK_END);
+	if ((value == (const char *) NULL) || (end == (const char *) NULL) || (end < value))
+		return false;
+
+	if ((p->attribute != (char *) NULL) &&
+		((strlen (p->attribute) != (size_t) (value - attribute - 1)) || (strncmp (p->attribute, attribute + 1, value - attribute - 1) != 0)))
+		return false;
+
+	value++;
+	snprintf (buffer, sizeof (buffer), "%.*s", (int) (end - value), value);
+
+	switch (p->kind)
+	{
+		case MATCH_LITERAL:
+			return strcmp (buffer, p->value) == 0;
+
+		case MATCH_GLOB:
+			return fnmatch (p->value, buffer, FNM_CASEFOLD) == 0;
+
+		default:
+			return regexec (&p->regex, buffer, 0, (regmatch_t *) NULL, 0) == 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		matchDN - Does any Pattern Match a Distinguished Name?
+ *
+ *	SYNOPSIS
+ *		bool
+ *		matchDN(
+ *			const cert_matcher	*matcher,		- Compiled Matcher
+ *			const char		*name)				- As Formatted by certDecode
+ *
+ *	RETURN VALUE
+ *		true if any pattern matches any attribute of the name. May be
+ *		called by several threads at once.
+ *-----------------------------------------------------------------------------
+ */
+
+bool matchDN (const cert_matcher *matcher, const char *name)
+{
+	const match_pattern			*p;
+	char						text [CERT_MAX_NAME * 2];
+	size_t						length;
+	size_t						i;
+	size_t						attribute;
+	int							state = 0;
+	int							s;
+	int							j;
+
+	if (matcher->count == 0)
+		return false;
+
+	length = normalizeName (name, text, sizeof (text));
+
+	for (i = 0; i < length; i++)
+	{
+		state = matcher->delta [state * matcher->classCount + matcher->classes [(unsigned char) text [i]]];
+
+		for (s = (matcher->first [state] != -1) ? state : matcher->output [state]; s != 0; s = matcher->output [s])
+		{
+			for (j = matcher->first [s]; j != -1; j = matcher->next [j])
+			{
+				p = &matcher->patterns [j];
+				if (p->kind == MATCH_LITERAL)
+					return true;
+
+				for (attribute = i + 1 - p->keywordLength; (attribute > 0) && (text [attribute] != MARK_ATTRIBUTE); attribute--)
+					;
+				if (matchAttribute (p, text + attribute))
+					return true;
+			}
+		}
+	}
+
+	for (j = 0; j < matcher->alwaysCount; j++)
+	{
+		p = &matcher->patterns [matcher->always [j]];
+		for (i = 0; i < length; i++)
+		{
+			if ((text [i] == MARK_ATTRIBUTE) && matchAttribute (p, text + i))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		freeMatcher - Free a Matcher
+ *-----------------------------------------------------------------------------
+ */
+
+void freeMatcher (cert_matcher *matcher)
+{
+	match_pattern				*p;
+	int							i;
+
+	for (i = 0; i < matcher->count; i++)
+	{
+		p = &matcher->patterns [i];
+		if (p->kind == MATCH_REGEX)
+			regfree (&p->regex);
+		free (p->attribute);
+		free (p->value);
+		free (p->keyword);
+	}
+
+	free (matcher->patterns);
+	free (matcher->always);
+	free (matcher->delta);
+	free (matcher->first);
+	free (matcher->next);
+	free (matcher->output);
+	free (matcher);
+}
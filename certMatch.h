@@ -0,0 +1,28 @@
+/*-----------------------------------------------------------------------------
+ *	certMatch, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTMATCH_H
+#define CERTMATCH_H
+
+/*-----------------------------------------------------------------------------
+ *	Patterns matched against the attributes of a distinguished name, as
+ *	formatted by decodeCertificate. Each pattern is [ATTRIBUTE=]VALUE, where
+ *	VALUE is /regex/, a glob (if it contains * ? or [), or a literal. All
+ *	matching ignores case.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct cert_matcher cert_matcher;
+
+cert_matcher *createMatcher (void);
+bool addMatchPattern (cert_matcher *matcher, const char *pattern);
+int loadMatchPatterns (cert_matcher *matcher, const char *filename, int *line);
+bool compileMatcher (cert_matcher *matcher);
+int matchPatterns (const cert_matcher *matcher);
+bool matchDN (const cert_matcher *matcher, const char *name);
+void freeMatcher (cert_matcher *matcher);
+
+#endif
@@ -0,0 +1,268 @@
+/*-----------------------------------------------------------------------------
+ *	certOutput, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "certOutput.h"
+#include "workPool.h"
+
+static const char * const	format_names [] = { "text", "json", "ndjson", "csv" };
+static const char			*fingerprint_name = "sha256";
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		outputFormat - Look up an Output Format by Name
+ *
+ *	SYNOPSIS
+ *		int
+ *		outputFormat(
+ *			const char		*name)				- text, json, ndjson, or csv
+ *
+ *	RETURN VALUE
+ *		OUTPUT_TEXT, ..., or -1 if the name is not recognized.
+ *-----------------------------------------------------------------------------
+ */
+
+int outputFormat (const char *name)
+{
+	int							i;
+
+	for (i = 0; i < (int) (sizeof (format_names) / sizeof (format_names [0])); i++)
+	{
+		if (strcasecmp (name, format_names [i]) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		outputBegin - Prepare stdout and Write any Header
+ *
+ *	SYNOPSIS
+ *		void
+ *		outputBegin(
+ *			int				format,				- OUTPUT_TEXT, ...
+ *			bool			deleteFields)		- Include delete and action
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		stdout is given a large buffer, so that it is written only when the
+ *		buffer is full (and at exit) rather than a line or a file at a time.
+ *		Must be called before anything is written to stdout.
+ *
+ *		Records of a JSON array are separated by commas, including records
+ *		of different files, which may have been formatted concurrently; the
+ *		work pool writes the separator between files as it emits them.
+ *-----------------------------------------------------------------------------
+ */
+
+void outputBegin (int format, bool deleteFields)
+{
+	setvbuf (stdout, (char *) NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+	if (format == OUTPUT_JSON)
+	{
+		fputs ("[\n", stdout);
+		setSeparator (",\n");
+	}
+	else if (format == OUTPUT_CSV)
+	{
+		fputs ("file,index,issuer,subject,not_before,not_after,status", stdout);
+		if (deleteFields)
+			fputs (",delete,action", stdout);
+		else
+			fprintf (stdout, ",%s", fingerprint_name);
+		fputs ("\n", stdout);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		setFingerprintName - Name the Fingerprint Field
+ *
+ *	SYNOPSIS
+ *		void
+ *		setFingerprintName(
+ *			const char		*name)				- "sha256" (default) or "sha1"
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		The name is the JSON key and CSV column of record->fingerprint, so
+ *		it must be set before outputBegin.
+ *-----------------------------------------------------------------------------
+ */
+
+void setFingerprintName (const char *name)
+{
+	fingerprint_name = name;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		outputEnd - Write any Trailer
+ *-----------------------------------------------------------------------------
+ */
+
+void outputEnd (int format)
+{
+	if (format == OUTPUT_JSON)
+		fputs ("\n]\n", stdout);
+
+	fflush (stdout);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		writeJson - Write a JSON String
+ *-----------------------------------------------------------------------------
+ */
+
+static void writeJson (FILE *out, const char *s)
+{
+	const unsigned char			*p;
+
+	putc ('"', out);
+	for (p = (const unsigned char *) s; *p != '\0'; p++)
+	{
+		if ((*p == '"') || (*p == '\\'))
+		{
+			putc ('\\', out);
+			putc (*p, out);
+		}
+		else if (*p < 0x20)
+			fprintf (out, "\\u%04x", *p);
+		else
+			putc (*p, out);
+	}
+	putc ('"', out);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		writeCsv - Write a CSV Field (RFC 4180)
+ *-----------------------------------------------------------------------------
+ */
+
+static void writeCsv (FILE *out, const char *s)
+{
+	const char					*p;
+
+	if (strpbrk (s, ",\"\r\n") == (const char *) NULL)
+	{
+		fputs (s, out);
+		return;
+	}
+
+	putc ('"', out);
+	for (p = s; *p != '\0'; p++)
+	{
+		if (*p == '"')
+			putc ('"', out);
+		putc (*p, out);
+	}
+	putc ('"', out);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		outputRecord - Write one Certificate
+ *
+ *	SYNOPSIS
+ *		void
+ *		outputRecord(
+ *			FILE				*out,			- Output File
+ *			int					format,			- OUTPUT_JSON, ...
+ *			const output_record	*record)		- Certificate to Write
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Times are written as seconds since the epoch. status is "valid",
+ *		"not_yet_valid", "expired", or (if the certificate could not be
+ *		decoded) "invalid", in which case the other certificate fields are
+ *		null (or empty in CSV). The fingerprint (empty if unknown) is
+ *		written only by decodeCert.
+ *-----------------------------------------------------------------------------
+ */
+
+void outputRecord (FILE *out, int format, const output_record *record)
+{
+	const char					*status;
+
+	if (record->issuer == (const char *) NULL)
+		status = "invalid";
+	else if (record->notBefore > record->now)
+		status = "not_yet_valid";
+	else if (record->notAfter < record->now)
+		status = "expired";
+	else
+		status = "valid";
+
+	if (format == OUTPUT_CSV)
+	{
+		writeCsv (out, record->file);
+		fprintf (out, ",%d,", record->index);
+		if (record->issuer != (const char *) NULL)
+		{
+			writeCsv (out, record->issuer);
+			putc (',', out);
+			writeCsv (out, record->subject);
+			fprintf (out, ",%lld,%lld", (long long) record->notBefore, (long long) record->notAfter);
+		}
+		else
+			fputs (",,,", out);
+		fprintf (out, ",%s", status);
+		if (record->remove >= 0)
+			fprintf (out, ",%s,%s", record->remove ? "true" : "false", record->action);
+		if (record->fingerprint != (const char *) NULL)
+			fprintf (out, ",%s", record->fingerprint);
+		putc ('\n', out);
+		return;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	JSON and NDJSON. Within a file, JSON records are separated here;
+	 *	between files, by the work pool.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((format == OUTPUT_JSON) && (! record->first))
+		fputs (",\n", out);
+
+	fputs ("{\"file\":", out);
+	writeJson (out, record->file);
+	fprintf (out, ",\"index\":%d", record->index);
+	if (record->issuer != (const char *) NULL)
+	{
+		fputs (",\"issuer\":", out);
+		writeJson (out, record->issuer);
+		fputs (",\"subject\":", out);
+		writeJson (out, record->subject);
+		fprintf (out, ",\"not_before\":%lld,\"not_after\":%lld", (long long) record->notBefore, (long long) record->notAfter);
+	}
+	else
+		fputs (",\"issuer\":null,\"subject\":null,\"not_before\":null,\"not_after\":null", out);
+	fprintf (out, ",\"status\":\"%s\"", status);
+	if (record->remove >= 0)
+		fprintf (out, ",\"delete\":%s,\"action\":\"%s\"", record->remove ? "true" : "false", record->action);
+	if ((record->fingerprint != (const char *) NULL) && (*record->fingerprint != '\0'))
+		fprintf (out, ",\"%s\":\"%s\"", fingerprint_name, record->fingerprint);
+	else if (record->fingerprint != (const char *) NULL)
+		fprintf (out, ",\"%s\":null", fingerprint_name);
+	putc ('}', out);
+
+	if (format == OUTPUT_NDJSON)
+		putc ('\n', out);
+}
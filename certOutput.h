@@ -0,0 +1,47 @@
+/*-----------------------------------------------------------------------------
+ *	certOutput, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTOUTPUT_H
+#define CERTOUTPUT_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define OUTPUT_TEXT				0
+#define OUTPUT_JSON				1
+#define OUTPUT_NDJSON			2
+#define OUTPUT_CSV				3
+
+#define OUTPUT_BUFFER_SIZE		(1024 * 1024)
+
+/*-----------------------------------------------------------------------------
+ *	One certificate, as reported in a structured format.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				*file;
+	int						index;				/* 1 for first in file */
+	bool					first;				/* First written for file */
+	const char				*issuer;			/* NULL if not decoded */
+	const char				*subject;
+	time_t					notBefore;
+	time_t					notAfter;
+	time_t					now;
+	int						remove;				/* -1 if not applicable */
+	const char				*action;			/* NULL if not applicable */
+	const char				*fingerprint;		/* NULL if not applicable */
+}
+output_record;
+
+int outputFormat (const char *name);
+void outputBegin (int format, bool deleteFields);
+void setFingerprintName (const char *name);
+void outputRecord (FILE *out, int format, const output_record *record);
+void outputEnd (int format);
+
+#endif
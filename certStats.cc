@@ -0,0 +1,137 @@
+/*-----------------------------------------------------------------------------
+ *	certStats, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "certCache.h"
+#include "certStats.h"
+
+/*-----------------------------------------------------------------------------
+ *	Counters and phase timers, kept for every run whether or not they are
+ *	printed. Each is updated with a relaxed atomic add, and each timer
+ *	reading is one monotonic clock call (a vDSO call, not a system call,
+ *	on Linux), so keeping them costs nothing measurable.
+ *
+ *	Timers add up the time spent in each phase by every thread, so with
+ *	several jobs they can exceed the elapsed time, and phases nest: the
+ *	time to open, decode, and rewrite is part of the time per file.
+ *-----------------------------------------------------------------------------
+ */
+
+static unsigned long		counters [STAT_COUNTERS];
+static unsigned long long	timers [STAT_TIMERS];		/* Nanoseconds */
+
+static const char * const	timer_names [STAT_TIMERS] =
+{
+	"processing files",
+	"opening and reading files",
+	"decoding certificates",
+	"rewriting files",
+};
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		countStat - Add to a Counter
+ *
+ *	SYNOPSIS
+ *		void
+ *		countStat(
+ *			int				counter,			- STAT_FILES, ...
+ *			unsigned long	amount)				- Amount to Add
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void countStat (int counter, unsigned long amount)
+{
+	__atomic_fetch_add (&counters [counter], amount, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		startTimer - Start Timing a Phase
+ *
+ *	SYNOPSIS
+ *		void
+ *		startTimer(
+ *			struct timespec	*start)				- Start Time
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void startTimer (struct timespec *start)
+{
+	clock_gettime (CLOCK_MONOTONIC, start);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		stopTimer - Add the Time Since startTimer to a Phase
+ *
+ *	SYNOPSIS
+ *		void
+ *		stopTimer(
+ *			int				timer,				- TIMER_FILE, ...
+ *			const struct timespec *start)		- From startTimer
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void stopTimer (int timer, const struct timespec *start)
+{
+	struct timespec				stop;
+	long long					nanoseconds;
+
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+	nanoseconds = (long long) (stop.tv_sec - start->tv_sec) * 1000000000LL + (stop.tv_nsec - start->tv_nsec);
+	__atomic_fetch_add (&timers [timer], (unsigned long long) nanoseconds, __ATOMIC_RELAXED);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		printStats - Print the Counters and Timers
+ *
+ *	SYNOPSIS
+ *		void
+ *		printStats(
+ *			FILE			*out,				- Output File (stderr)
+ *			const char		*name,				- Program Name
+ *			const struct timespec *start)		- Start of Run (startTimer)
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void printStats (FILE *out, const char *name, const struct timespec *start)
+{
+	struct timespec				stop;
+	unsigned long				hits;
+	unsigned long				misses;
+	int							i;
+
+	clock_gettime (CLOCK_MONOTONIC, &stop);
+	cacheStatistics (&hits, &misses);
+
+	fprintf (out, "%s: stats: %lu files, %lu certificates, %lu bytes read\n", name,
+				__atomic_load_n (&counters [STAT_FILES], __ATOMIC_RELAXED),
+				__atomic_load_n (&counters [STAT_CERTIFICATES], __ATOMIC_RELAXED),
+				__atomic_load_n (&counters [STAT_BYTES_READ], __ATOMIC_RELAXED));
+	fprintf (out, "%s: stats: %lu certificates decoded, %lu from cache\n", name, misses, hits);
+	fprintf (out, "%s: stats: %lu files rewritten\n", name, __atomic_load_n (&counters [STAT_FILES_REWRITTEN], __ATOMIC_RELAXED));
+	fprintf (out, "%s: stats: %10.6f s elapsed\n", name,
+				(double) (stop.tv_sec - start->tv_sec) + (double) (stop.tv_nsec - start->tv_nsec) / 1e9);
+
+	for (i = 0; i < STAT_TIMERS; i++)
+		fprintf (out, "%s: stats: %10.6f s %s (all threads)\n", name, (double) __atomic_load_n (&timers [i], __ATOMIC_RELAXED) / 1e9, timer_names [i]);
+}
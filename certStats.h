@@ -0,0 +1,30 @@
+/*-----------------------------------------------------------------------------
+ *	certStats, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTSTATS_H
+#define CERTSTATS_H
+
+#include <stdio.h>
+#include <time.h>
+
+#define STAT_FILES				0				/* Files processed */
+#define STAT_CERTIFICATES		1				/* Certificates found */
+#define STAT_BYTES_READ			2				/* Bytes of files read */
+#define STAT_FILES_REWRITTEN	3				/* Files replaced */
+#define STAT_COUNTERS			4
+
+#define TIMER_FILE				0				/* decodeOneCert, deleteOneCert */
+#define TIMER_OPEN				1				/* Opening and reading files */
+#define TIMER_DECODE			2				/* Decoding certificates */
+#define TIMER_EDIT				3				/* editCertFile */
+#define STAT_TIMERS				4
+
+void countStat (int counter, unsigned long amount);
+void startTimer (struct timespec *start);
+void stopTimer (int timer, const struct timespec *start);
+void printStats (FILE *out, const char *name, const struct timespec *start);
+
+#endif
@@ -0,0 +1,164 @@
+/*-----------------------------------------------------------------------------
+ *	certView, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base64.h"
+#include "certView.h"
+#include "pemScan.h"
+
+/*-----------------------------------------------------------------------------
+ *	Certificates are viewed where they are. Each PEM body is decoded to the
+ *	caller's scratch area, one after another, so nothing is allocated and
+ *	the views of a whole file of certificates remain valid together until
+ *	the buffer and scratch area are released. A buffer that begins with a
+ *	DER SEQUENCE is taken to be DER certificates, one after another, and
+ *	scratch is not used.
+ *-----------------------------------------------------------------------------
+ */
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		startCertViews - Start Iterating over the Certificates in a Buffer
+ *
+ *	SYNOPSIS
+ *		void
+ *		startCertViews(
+ *			cert_iterator	*iterator,			- Position in Buffer
+ *			const char		*buffer,			- PEM or DER Certificates
+ *			size_t			length,				- Length of Buffer
+ *			unsigned char	*scratch)			- (length * 3) / 4 Bytes
+ *
+ *	RETURN VALUE
+ *		None.
+ *
+ *	DESCRIPTION
+ *		scratch receives the DER of the PEM certificates, and must hold at
+ *		least (length * 3) / 4 bytes. It may be the buffer itself, which is
+ *		then overwritten as it is iterated (DER is always shorter than its
+ *		Base64, so nothing is written past the text already read).
+ *-----------------------------------------------------------------------------
+ */
+
+void startCertViews (cert_iterator *iterator, const char *buffer, size_t length, unsigned char *scratch)
+{
+	iterator->start = buffer;
+	iterator->next = buffer;
+	iterator->end = buffer + length;
+	iterator->scratch = scratch;
+	iterator->count = 0;
+	iterator->der = (length > 0) && ((unsigned char) *buffer == 0x30);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextCertView - View the Next Certificate in a Buffer
+ *
+ *	SYNOPSIS
+ *		bool
+ *		nextCertView(
+ *			cert_iterator	*iterator,			- Position in Buffer
+ *			cert_view		*view)				- Certificate Found
+ *
+ *	RETURN VALUE
+ *		true if another certificate was found, false at the end of the
+ *		buffer.
+ *
+ *	DESCRIPTION
+ *		Each certificate is counted as readPemFile counts them. If it could
+ *		not be decoded (invalid Base64, no END line, or malformed DER),
+ *		view->der is NULL and the other fields are unset.
+ *-----------------------------------------------------------------------------
+ */
+
+bool nextCertView (cert_iterator *iterator, cert_view *view)
+{
+	pem_file					file;
+	pem_block					block;
+	unsigned char				*der;
+	size_t						derLength;
+
+	if (iterator->next == (const char *) NULL)
+		return false;
+
+	if (iterator->der)
+	{
+		if (iterator->next >= iterator->end)
+			return false;
+
+		if (viewCertificate ((const unsigned char *) iterator->next, iterator->end - iterator->next, view))
+			iterator->next += view->derLength;
+		else
+		{
+			view->der = (const unsigned char *) NULL;
+			iterator->next = iterator->end;
+		}
+
+		view->index = ++iterator->count;
+		return true;
+	}
+
+	file.fd = -1;
+	file.data = iterator->start;
+	file.length = iterator->end - iterator->start;
+	file.mapped = false;
+
+	if (findPemBlock (&file, iterator->next, &block) == (const char *) NULL)
+	{
+		iterator->next = (const char *) NULL;
+		return false;
+	}
+
+	iterator->next = block.end;
+	der = iterator->scratch;
+
+	if ((block.end == block.bodyEnd) || (! decodeBase64 (block.body, block.bodyEnd - block.body, der, &derLength)))
+		view->der = (const unsigned char *) NULL;
+	else
+	{
+		iterator->scratch += derLength;
+		if (! viewCertificate (der, derLength, view))
+			view->der = (const unsigned char *) NULL;
+	}
+
+	view->index = ++iterator->count;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		findAttribute - Find an Attribute of a Distinguished Name
+ *
+ *	SYNOPSIS
+ *		bool
+ *		findAttribute(
+ *			std::string_view	name,			- DER Encoded Name
+ *			const char			*type,			- "CN", "O", ...
+ *			std::string_view	*value)			- Value Found
+ *
+ *	RETURN VALUE
+ *		true if the name has an attribute of the type, false otherwise. If
+ *		there are several (such as OU), the last (most specific) is found.
+ *-----------------------------------------------------------------------------
+ */
+
+bool findAttribute (std::string_view name, const char *type, std::string_view *value)
+{
+	cert_attribute				attribute;
+	bool						found = false;
+
+	while (nextAttribute (&name, &attribute))
+	{
+		if (attribute.name == type)
+		{
+			*value = attribute.value;
+			found = true;
+		}
+	}
+
+	return found;
+}
@@ -0,0 +1,86 @@
+/*-----------------------------------------------------------------------------
+ *	certView, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef CERTVIEW_H
+#define CERTVIEW_H
+
+#include <stddef.h>
+#include <time.h>
+#include <string_view>
+
+/*-----------------------------------------------------------------------------
+ *	View of one Certificate.
+ *
+ *	Every field points into the buffer being iterated, or for PEM into the
+ *	scratch area its bodies are decoded into (nothing is allocated), so a
+ *	view is valid only as long as both of those are. issuer
+ *	and subject are the DER encoded Names, to be walked with nextAttribute.
+ *	serial is the DER INTEGER content (big endian, two's complement).
+ *	publicKey is the modulus and exponent of an RSA key, or the BIT STRING
+ *	of any other key.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	int						index;				/* 1 for first in buffer */
+	const unsigned char		*der;				/* NULL if not decoded */
+	size_t					derLength;
+	int						version;
+	std::string_view		serial;
+	std::string_view		issuer;
+	std::string_view		subject;
+	time_t					notBefore;
+	time_t					notAfter;
+	std::string_view		publicKey;			/* See viewPrivateKey */
+}
+cert_view;
+
+/*-----------------------------------------------------------------------------
+ *	One attribute of a Distinguished Name. name is the short name displayed
+ *	by openssl ("CN", "O", ...), or empty if the attribute type is unknown;
+ *	oid is always the DER encoded attribute type. value is the string as
+ *	encoded, and tag its ASN.1 type (0x0c UTF8String, 0x13 PrintableString,
+ *	0x1e BMPString, ...).
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	std::string_view		name;
+	std::string_view		oid;
+	std::string_view		value;
+	int						tag;
+	bool					continued;			/* Same RDN as previous */
+}
+cert_attribute;
+
+/*-----------------------------------------------------------------------------
+ *	Position within a buffer of PEM (or DER) certificates. Each PEM body is
+ *	decoded to the next free part of scratch (see startCertViews); the
+ *	buffer itself is only read.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				*start;
+	const char				*next;
+	const char				*end;
+	unsigned char			*scratch;			/* Next DER decoded here */
+	int						count;
+	bool					der;				/* DER, not PEM */
+}
+cert_iterator;
+
+void startCertViews (cert_iterator *iterator, const char *buffer, size_t length, unsigned char *scratch);
+bool nextCertView (cert_iterator *iterator, cert_view *view);
+bool viewCertificate (const unsigned char *der, size_t length, cert_view *view);
+bool nextAttribute (std::string_view *name, cert_attribute *attribute);
+bool findAttribute (std::string_view name, const char *type, std::string_view *value);
+bool viewPrivateKey (const unsigned char *der, size_t length, std::string_view *publicKey);
+
+#endif
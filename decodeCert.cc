@@ -4,151 +4,375 @@
  *-----------------------------------------------------------------------------
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
-#include <xlocale.h>
-
-extern int					errno;
-extern const char * const	sys_errlist[];
+#include <sys/stat.h>
+
+#include "certCache.h"
+#include "certChain.h"
+#include "certDecode.h"
+#include "certFile.h"
+#include "certIndex.h"
+#include "certLineage.h"
+#include "certOutput.h"
+#include "certStats.h"
+#include "digest.h"
+#include "dirWalk.h"
+#include "dirWatch.h"
+#include "pemScan.h"
+#include "readAhead.h"
+#include "workPool.h"
 
 static const char			*my_name;
-static char					tempFile [1024];
 static int					opt_debug = 0;
 static int					opt_path = 0;
 static int					opt_verbose = 0;
+static const char			*opt_index = "";
+static int					output_format = OUTPUT_TEXT;
+static bool					expiry_filter = false;
+static time_t				expiry_limit = 0;
+static int					decode_fields = CERT_FIELD_ISSUER | CERT_FIELD_VALIDITY | CERT_FIELD_SUBJECT;
+static int					opt_check_chain = 0;
+static int					opt_watch = 0;
+static const char			*fingerprint_label = "SHA256";
+static size_t				fingerprint_length = SHA256_LENGTH;
+
+typedef struct
+{
+	const char				*certfile;
+	FILE					*out;
+	index_cert				*certs;				/* Recorded for the index */
+	int						certCount;
+	int						certSize;
+	int						listed;				/* Selected and displayed */
+}
+decode_context;
 
 /*-----------------------------------------------------------------------------
  *	NAME
- *		trim - Remove trailing blanks, tabs, and newlines
+ *		parse_certificate - Display one Certificate
  *
  *	SYNOPSIS
- *		static void
- *		trim(
- *			char			*buffer)			- Buffer to be trimmed
+ *		void
+ *		parse_certificate(
+ *			FILE				*out,			- Output File
+ *			const char			*certfile,		- Certificate File
+ *			int					count,			- Certificate Number
+ *			const index_cert	*cert,			- Decoded Certificate
+ *			int					*listed)		- Certificates Listed from File
  *
  *	RETURN VALUE
- *		None.
+ *		None
  *
  *	DESCRIPTION
- *		This function removes trailing whitespace from a null terminated
- *		string.
+ *		This function displays one decoded certificate in the same format
+ *		as "openssl x509 -text", or reports why it could not be decoded.
+ *		With -o, one record is written in the selected format instead.
+ *		The fingerprint (SHA-256, or SHA-1 with -F sha1) is shown as
+ *		"openssl x509 -fingerprint" shows it, so that deleteCert
+ *		--fingerprints can read the lines.
  *-----------------------------------------------------------------------------
  */
 
-static void trim (char *buffer)
+void parse_certificate (FILE *out, const char *certfile, int count, const index_cert *cert, int *listed)
 {
-	int					i = strlen (buffer) - 1;
+	const cert_info				*info = &cert->info;
+	char						validity_buffer [256];
+	char						serial_buffer [1024];
+	char						parsed_time_string [256];
+	char						fingerprint [SHA256_LENGTH * 3];
+	time_t						now;
+	struct tm					parsed_time_struct;
+	output_record				record;
+	bool						selected;
+
+	time (&now);
+
+	if (cert->status == INDEX_VALID)
+		formatDigest (cert->fingerprint, fingerprint_length, fingerprint, sizeof (fingerprint));
+	else
+		*fingerprint = '\0';
+
+	/*-------------------------------------------------------------------------
+	 *	With --expires-within or --expired-before, certificates that expire
+	 *	later (or could not be decoded) are not listed.
+	 *-------------------------------------------------------------------------
+	 */
+
+	selected = (! expiry_filter) || ((cert->status == INDEX_VALID) && (info->notAfterTime < expiry_limit));
+
+	if (selected)
+		(*listed)++;
+
+	if (selected && (output_format != OUTPUT_TEXT))
+	{
+		record.file = certfile;
+		record.index = count;
+		record.first = (*listed == 1);
+		if (cert->status == INDEX_VALID)
+		{
+			record.issuer = info->issuer;
+			record.subject = info->subject;
+		}
+		else
+		{
+			record.issuer = (const char *) NULL;
+			record.subject = (const char *) NULL;
+		}
+		record.notBefore = info->notBeforeTime;
+		record.notAfter = info->notAfterTime;
+		record.now = now;
+		record.remove = -1;
+		record.action = (const char *) NULL;
+		record.fingerprint = fingerprint;
+		outputRecord (out, output_format, &record);
+	}
+	else if (selected)
+		fprintf (out, "======== %s, Certificate %d\n", certfile, count);
+
+	if (cert->status == INDEX_INVALID_PEM)
+	{
+		fprintf (stderr, "%s: %s, Certificate %d: invalid PEM encoding\n", my_name, certfile, count);
+		return;
+	}
+
+	if (cert->status == INDEX_UNDECODABLE)
+	{
+		fprintf (stderr, "%s: %s, Certificate %d: unable to decode certificate\n", my_name, certfile, count);
+		return;
+	}
 
-	while ((i >= 0)
-	  && ((buffer[i] == ' ') || (buffer[i] == '\t') || (buffer[i] == '\n') || (buffer[i] == '\r') || (buffer[i] == '\f')))
-		buffer[i--] = '\0';
+	if ((! selected) || (output_format != OUTPUT_TEXT))
+		return;
+
+	if (opt_verbose)
+	{
+		/*---------------------------------------------------------------------
+		 *	Show all decoded fields.
+		 *---------------------------------------------------------------------
+		 */
+
+		formatSerial (info, "            ", serial_buffer, sizeof (serial_buffer));
+
+		fprintf (out, "Certificate:\n");
+		fprintf (out, "    Data:\n");
+		fprintf (out, "        Version: %d (0x%x)\n", info->version, info->version - 1);
+		fprintf (out, "        Serial Number:%s\n", serial_buffer);
+		fprintf (out, "        Signature Algorithm: %s\n", info->signatureAlgorithm);
+		fprintf (out, "        Issuer: %s\n", info->issuer);
+		fprintf (out, "        Validity\n");
+		fprintf (out, "            Not Before: %s\n", info->notBefore);
+		fprintf (out, "            Not After : %s\n", info->notAfter);
+		fprintf (out, "        Subject: %s\n", info->subject);
+		fprintf (out, "        Subject Public Key Info:\n");
+		fprintf (out, "            Public Key Algorithm: %s\n", info->publicKeyAlgorithm);
+		fprintf (out, "        %s Fingerprint=%s\n", fingerprint_label, fingerprint);
+		return;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Show only the most important fields.
+	 *-------------------------------------------------------------------------
+	 */
+
+	fprintf (out, "        Issuer: %s\n", info->issuer);
+
+	if (opt_debug)
+	{
+		gmtime_r (&info->notBeforeTime, &parsed_time_struct);
+		strftime (parsed_time_string, sizeof (parsed_time_string), "%Y-%m-%d-%a %T GMT", &parsed_time_struct);
+		fprintf (out, "*** PARSED NOT BEFORE (%s): %s\n", info->notBefore, parsed_time_string);
+
+		gmtime_r (&info->notAfterTime, &parsed_time_struct);
+		strftime (parsed_time_string, sizeof (parsed_time_string), "%Y-%m-%d-%a %T GMT", &parsed_time_struct);
+		fprintf (out, "*** PARSED NOT AFTER (%s): %s\n", info->notAfter, parsed_time_string);
+	}
+
+	validityMessage (info->notBeforeTime, info->notAfterTime, now, validity_buffer, sizeof (validity_buffer));
+	if (*validity_buffer == '\0')
+		fprintf (out, "        Validity\n");
+	else
+		fprintf (out, "        Validity %s\n", validity_buffer);
+	fprintf (out, "            Not Before: %s\n", info->notBefore);
+	fprintf (out, "            Not After : %s\n", info->notAfter);
+	fprintf (out, "        Subject: %s\n", info->subject);
+	fprintf (out, "        %s Fingerprint=%s\n", fingerprint_label, fingerprint);
 }
 
 /*-----------------------------------------------------------------------------
  *	NAME
- *		parse_openssl - Parse openssl output
+ *		decodeOneCertCallback - Display one Certificate from a File
  *
  *	SYNOPSIS
- *		void
- *		parse_openssl(
- *			FILE			*p)					- Input Pipe
+ *		static void
+ *		decodeOneCertCallback(
+ *			void				*context,		- Output File and Certificate File
+ *			int					count,			- Certificate Number
+ *			const pem_block		*block,			- Location in File
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
  *
  *	RETURN VALUE
  *		None
  *
  *	DESCRIPTION
- *		This function parses the output of openssl.
+ *		This function is called by readPemFile for each certificate.
+ *		Certificates that have already been decoded (typically shared
+ *		intermediates) are taken from the cache. When an index is in use,
+ *		each result is also saved for the index; with --check-chain, each
+ *		result is saved for checkFileChain.
  *-----------------------------------------------------------------------------
  */
 
-void parse_openssl (FILE *p)
+static void decodeOneCertCallback (void *context, int count, const pem_block * /* block */, const unsigned char *der, size_t length)
 {
-	char						buffer [4096];
-	char						validity_buffer [4096];
-	char						before_buffer [4096];
-	char						parsed_time_string [256];
-	const char					*cp;
-	char						*vp;
-	time_t						now;
-	time_t						parsed;
-	struct tm					parsed_time_struct;
+	decode_context				*decode = (decode_context *) context;
+	index_cert					cert;
+	index_cert					*certs;
+	struct timespec				start;
+	int							size;
+	bool						lazy;
 
-	time (&now);
+	/*-------------------------------------------------------------------------
+	 *	With an expiry filter (and nothing recorded), only the validity is
+	 *	decoded, and the rest (and the fingerprint) only if it is selected.
+	 *-------------------------------------------------------------------------
+	 */
 
-	while (fgets (buffer, sizeof (buffer), p) != NULL)
-	{
-		trim (buffer);
-		if (opt_verbose)
-		{
-			/*-----------------------------------------------------------------
-			 *	Show all output from openssl.
-			 *-----------------------------------------------------------------
-			 */
+	lazy = expiry_filter && (*opt_index == '\0') && ! opt_check_chain;
 
-			fprintf (stdout, "%s\n", buffer);
-			fflush (stdout);
-		}
+	startTimer (&start);
+	if (der == (const unsigned char *) NULL)
+		cert.status = INDEX_INVALID_PEM;
+	else if (! decodeCached (der, length, lazy ? 0 : decode_fields, &cert.info))
+		cert.status = INDEX_UNDECODABLE;
+	else if (lazy && (cert.info.notAfterTime < expiry_limit) && ! decodeCached (der, length, decode_fields, &cert.info))
+		cert.status = INDEX_UNDECODABLE;
+	else
+		cert.status = INDEX_VALID;
+
+	memset (cert.fingerprint, 0, sizeof (cert.fingerprint));
+	if ((der != (const unsigned char *) NULL) && ((! lazy) || ((cert.status == INDEX_VALID) && (cert.info.notAfterTime < expiry_limit))))
+	{
+		if (fingerprint_length == SHA1_LENGTH)
+			sha1Digest (der, length, cert.fingerprint);
 		else
-		{
-			/*-----------------------------------------------------------------
-			 *	Show only the most important output from openssl.
-			 *-----------------------------------------------------------------
-			 */
-
-			if ((strncmp (buffer, "========", 8) == 0)
-			  || (strstr (buffer, "Issuer:") != (const char *) NULL)
-			  || (strstr (buffer, "Subject:") != (const char *) NULL))
-			{
-				fprintf (stdout, "%s\n", buffer);
-				fflush (stdout);
-			}
-			else if ((cp = strstr (buffer, "Validity")) != (const char *) NULL)
-				strcpy (validity_buffer, buffer);
-			else if ((cp = strstr (buffer, "Not Before: ")) != (const char *) NULL)
-			{
-				strcpy (before_buffer, buffer);
-				strptime (cp + 12, "%b %e %T %Y %Z", &parsed_time_struct);
-				parsed = mktime (&parsed_time_struct);
+			sha256Digest (der, length, cert.fingerprint);
+	}
+	stopTimer (TIMER_DECODE, &start);
 
-				if (parsed > now)
-				{
-					vp = validity_buffer + strlen (validity_buffer);
-					strcpy (vp, " *** NOT YET VALID ***");
-				}
+	parse_certificate (decode->out, decode->certfile, count, &cert, &decode->listed);
 
-				if (opt_debug)
-				{
-					strftime (parsed_time_string, sizeof (parsed_time_string), "%Y-%m-%d-%a %T %Z", &parsed_time_struct);
-					fprintf (stdout, "*** PARSED NOT BEFORE (%s): %s\n", cp + 12, parsed_time_string);
-				}
-			}
-			else if ((cp = strstr (buffer, "Not After : ")) != (const char *) NULL)
-			{
-				strptime (cp + 12, "%b %e %T %Y %Z", &parsed_time_struct);
-				parsed = mktime (&parsed_time_struct);
+	if ((*opt_index == '\0') && ! opt_check_chain)
+		return;
 
-				if (parsed < now)
-				{
-					vp = validity_buffer + strlen (validity_buffer);
-					strcpy (vp, " *** EXPIRED ***");
-				}
+	if (decode->certCount == decode->certSize)
+	{
+		size = (decode->certSize == 0) ? 4 : decode->certSize * 2;
+		certs = (index_cert *) realloc (decode->certs, size * sizeof (index_cert));
+		if (certs == (index_cert *) NULL)
+			return;
+		decode->certs = certs;
+		decode->certSize = size;
+	}
+	decode->certs [decode->certCount++] = cert;
+}
 
-				if (opt_debug)
-				{
-					strftime (parsed_time_string, sizeof (parsed_time_string), "%Y-%m-%d-%a %T %Z", &parsed_time_struct);
-					fprintf (stdout, "*** PARSED NOT AFTER (%s): %s\n", cp + 12, parsed_time_string);
-				}
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		checkFileChain - Report the Chain of one Certificate File
+ *
+ *	SYNOPSIS
+ *		static void
+ *		checkFileChain(
+ *			FILE				*out,			- Output File
+ *			const decode_context *decode)		- Certificates in File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		With --check-chain, the summary line of each file says whether its
+ *		certificates form one chain in order (leaf first), and if not, the
+ *		correct order follows: the certificates of the file, those of the
+ *		pool that complete it, and those that are not part of it.
+ *-----------------------------------------------------------------------------
+ */
 
-				fprintf (stdout, "%s\n", validity_buffer);
-				fprintf (stdout, "%s\n", before_buffer);
-				fprintf (stdout, "%s\n", buffer);
-				fflush (stdout);
-			}
+static void checkFileChain (FILE *out, const decode_context *decode)
+{
+	chain_cert					*chain;
+	const chain_cert			**order;
+	bool						*used;
+	int							count = decode->certCount;
+	int							length;
+	int							status;
+	int							i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (decode->certs [i].status != INDEX_VALID)
+		{
+			fprintf (out, "######## %s, %d Certificates in File, Chain NOT Checked (Certificate %d not Decoded)\n", decode->certfile, count, i + 1);
+			return;
 		}
 	}
+
+	chain = (chain_cert *) malloc (count * sizeof (chain_cert));
+	order = (const chain_cert **) malloc ((count + CHAIN_MAX_ADDED) * sizeof (const chain_cert *));
+	used = (bool *) calloc (count, sizeof (bool));
+	length = -1;
+	if ((chain != (chain_cert *) NULL) && (order != (const chain_cert **) NULL) && (used != (bool *) NULL))
+	{
+		for (i = 0; i < count; i++)
+			chainCert (&decode->certs [i].info, i + 1, &chain [i]);
+		length = checkChain (chain, count, order, &status);
+	}
+
+	if (length == -1)
+	{
+		fprintf (stderr, "%s: %s: out of memory\n", my_name, decode->certfile);
+		free (chain);
+		free (order);
+		free (used);
+		return;
+	}
+
+	if (status == 0)
+		fprintf (out, "######## %s, %d Certificates in File, Chain OK\n", decode->certfile, count);
+	else
+		fprintf (out, "######## %s, %d Certificates in File, Chain%s%s%s\n", decode->certfile, count,
+					(status & CHAIN_MISORDERED) ? " Misordered" : "",
+					(status & CHAIN_INCOMPLETE) ? ((status & CHAIN_MISORDERED) ? ", Incomplete" : " Incomplete") : "",
+					(status & CHAIN_EXTRA) ? ((status & (CHAIN_MISORDERED | CHAIN_INCOMPLETE)) ? ", Has Extra Certificates" : " Has Extra Certificates") : "");
+
+	for (i = 0; (i < length) && (status != 0); i++)
+	{
+		if (order [i]->index == -1)
+			fprintf (out, "%3d. Add from %s; Subject <%s>\n", i + 1, order [i]->source, order [i]->subject);
+		else
+			fprintf (out, "%3d. Certificate %d; Subject <%s>\n", i + 1, order [i]->index, order [i]->subject);
+	}
+
+	for (i = 0; i < length; i++)
+	{
+		if (order [i]->index != -1)
+			used [order [i]->index - 1] = true;
+	}
+
+	for (i = 0; (i < count) && (status & CHAIN_EXTRA); i++)
+	{
+		if (! used [i])
+			fprintf (out, "  -. Certificate %d Not in Chain; Subject <%s>\n", i + 1, chain [i].subject);
+	}
+
+	free (chain);
+	free (order);
+	free (used);
 }
 
 /*-----------------------------------------------------------------------------
@@ -158,91 +382,164 @@ void parse_openssl (FILE *p)
  *	SYNOPSIS
  *		void
  *		decodeOneCert(
- *			const char		*filename)			- Filename to process
+ *			const char		*filename,			- Filename to process
+ *			FILE			*out)				- Output File
  *
  *	RETURN VALUE
  *		None
  *
  *	DESCRIPTION
  *		Process one Certificate File. This file may contain a certificate
- *		chain consisting of multiple individual certificates. Each certiicate
- *		must be individually decoded by openssl.
+ *		chain consisting of multiple individual certificates. Each certificate
+ *		is decoded in process.
+ *
+ *		When an index is in use, a file whose device, inode, size, and
+ *		modification time match the index is reported from the index
+ *		without being opened (except with --check-chain, since the index
+ *		does not keep what links certificates).
+ *
+ *		With --watch, a file whose contents are the same as when it was
+ *		last processed is skipped silently, and a file that has been
+ *		removed since it was last processed is reported as removed.
  *-----------------------------------------------------------------------------
  */
 
-void decodeOneCert (const char *filename)
+void decodeOneCert (const char *filename, FILE *out)
 {
-	char						command [4096];
-	char						buffer [4096];
-	char						wd [4096];
 	char						certfile [4096];
-	FILE						*inFile;
-	FILE						*outFile;
-	FILE						*p;
-	int							count = 0;
-	bool						inCert = false;
+	decode_context				decode;
+	pem_file					file;
+	index_cert					*certs;
+	struct stat					st;
+	struct timespec				start;
+	struct timespec				openStart;
+	int							count;
+	int							i;
+
+	startTimer (&start);
+	countStat (STAT_FILES, 1);
 
-	if (opt_path && (*filename != '/'))
+	fullPathname (filename, opt_path, certfile, sizeof (certfile));
+	decode.certfile = certfile;
+	decode.out = out;
+	decode.certs = (index_cert *) NULL;
+	decode.certCount = 0;
+	decode.certSize = 0;
+	decode.listed = 0;
+
+	if ((*opt_index != '\0') && (! opt_check_chain) && (! opt_watch) && (stat (filename, &st) == 0) && ((count = lookupIndex (&st, &certs)) >= 0))
 	{
-		getcwd (wd, sizeof (wd));
-		if (strncmp (filename, "./", 2) == 0)
-			sprintf (certfile, "%s/%s", wd, filename + 2);
-		else
-			sprintf (certfile, "%s/%s", wd, filename);
+		for (i = 0; i < count; i++)
+			parse_certificate (out, certfile, i + 1, &certs [i], &decode.listed);
+
+		if ((count > 1) && (decode.listed > 0) && (output_format == OUTPUT_TEXT))
+			fprintf (out, "######## %s, %d Certificates in File\n", certfile, count);
+
+		addIndex (&st, count, certs);
+		free (certs);
+		countStat (STAT_CERTIFICATES, count);
+		stopTimer (TIMER_FILE, &start);
+		return;
 	}
-	else
-		strcpy (certfile, filename);
 
-	inFile = fopen (filename, "r");
-	if (inFile == (FILE *) NULL)
+	startTimer (&openStart);
+	if (! openPemFile (filename, &file))
 	{
-		fprintf (stderr, "%s: fopen (%s) failed <%s>\n", my_name, filename, sys_errlist [errno]);
+		if (! opt_watch)
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, filename, strerror (errno));
+		else if (errno != ENOENT)
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, filename, strerror (errno));
+		else if (forgetSummary (filename))
+			fprintf (out, "######## %s: Removed\n", certfile);
+		stopTimer (TIMER_FILE, &start);
 		return;
 	}
+	stopTimer (TIMER_OPEN, &openStart);
+	countStat (STAT_BYTES_READ, file.length);
 
-	while (fgets (buffer, sizeof (buffer), inFile) != NULL)
+	if (opt_watch && ! changedSummary (filename, fileSummary (file.data, file.length)))
 	{
-		trim (buffer);
-		if (inCert)
-		{
-			fprintf (outFile, "%s\n", buffer);
-
-			if (strcmp (buffer, "-----END CERTIFICATE-----") == 0)
-			{
-				fclose (outFile);
-				inCert = false;
-
-				sprintf (command, "openssl x509 -in %s -text -noout", tempFile);
-				p = popen (command, "r");
-				parse_openssl (p);
-				pclose (p);
-				unlink (tempFile);
-			}
-		}
-		else
-		{
-			if (strcmp (buffer, "-----BEGIN CERTIFICATE-----") == 0)
-			{
-				count++;
-				fprintf (stdout, "======== %s, Certificate %d\n", certfile, count);
-				fflush (stdout);
-				outFile = fopen (tempFile, "w");
-				inCert = true;
-				fprintf (outFile, "%s\n", buffer);
-			}
-		}
+		closePemFile (&file);
+		stopTimer (TIMER_FILE, &start);
+		return;
 	}
 
-	if (inCert)
-		fclose (outFile);
+	count = readPemFile (&file, decodeOneCertCallback, &decode);
+	if (count > 0)
+		countStat (STAT_CERTIFICATES, count);
+	if (count == -1)
+		fprintf (stderr, "%s: %s: out of memory\n", my_name, certfile);
+	else if ((*opt_index != '\0') && (decode.certCount == count) && (fstat (file.fd, &st) == 0))
+		addIndex (&st, count, decode.certs);
 
-	if (count > 1)
+	if (opt_check_chain && (count > 0))
 	{
-		fprintf (stdout, "######## %s, %d Certificates in File\n", certfile, count);
-		fflush (stdout);
+		if (decode.certCount == count)
+			checkFileChain (out, &decode);
+		else
+			fprintf (stderr, "%s: %s: out of memory\n", my_name, certfile);
 	}
+	else if ((count > 1) && (decode.listed > 0) && (output_format == OUTPUT_TEXT))
+		fprintf (out, "######## %s, %d Certificates in File\n", certfile, count);
 
-	fclose (inFile);
+	closePemFile (&file);
+	free (decode.certs);
+	stopTimer (TIMER_FILE, &start);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		auditOneLineage - Report whether one certbot Lineage is Consistent
+ *
+ *	SYNOPSIS
+ *		void
+ *		auditOneLineage(
+ *			const char		*filename,			- Lineage Directory, or its cert.pem
+ *			FILE			*out)				- Output File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		With --audit-lineage, this function is called instead of
+ *		decodeOneCert, for each directory named (or each cert.pem found
+ *		with -r). See auditLineage.
+ *-----------------------------------------------------------------------------
+ */
+
+void auditOneLineage (const char *filename, FILE *out)
+{
+	char						path [4096];
+	char						directory [4096];
+	lineage_audit				audit;
+	struct timespec				start;
+
+	startTimer (&start);
+	countStat (STAT_FILES, 1);
+
+	fullPathname (filename, opt_path, path, sizeof (path));
+	auditLineage (path, directory, sizeof (directory), &audit);
+	countStat (STAT_CERTIFICATES, audit.fullchainCount);
+
+	if (audit.status & LINEAGE_UNREADABLE)
+		fprintf (out, "######## %s, Lineage NOT Checked (%s: %s)\n", directory, audit.file, strerror (audit.error));
+	else if (audit.status & (LINEAGE_FULLCHAIN | LINEAGE_KEY_MISMATCH))
+		fprintf (out, "######## %s, Lineage%s%s\n", directory,
+					(audit.status & LINEAGE_FULLCHAIN) ? " fullchain.pem Differs" : "",
+					(audit.status & LINEAGE_KEY_MISMATCH) ? ((audit.status & LINEAGE_FULLCHAIN) ? ", privkey.pem Does Not Match" : " privkey.pem Does Not Match") : "");
+	else
+		fprintf (out, "######## %s, Lineage OK\n", directory);
+
+	if (audit.status & LINEAGE_FULLCHAIN)
+		fprintf (out, "  -. fullchain.pem Certificate %d; fullchain.pem has %d, cert.pem %d, chain.pem %d Certificates\n",
+					audit.differs, audit.fullchainCount, audit.certCount, audit.chainCount);
+
+	if ((audit.status & LINEAGE_KEY_UNCHECKED) && (audit.keyError != 0))
+		fprintf (out, "  -. privkey.pem NOT Checked (%s)\n", strerror (audit.keyError));
+	else if (audit.status & LINEAGE_KEY_UNCHECKED)
+		fprintf (out, "  -. privkey.pem NOT Checked (No Public Key Found)\n");
+
+	stopTimer (TIMER_FILE, &start);
 }
 
 /*-----------------------------------------------------------------------------
@@ -267,7 +564,30 @@ int main (int argc, const char *argv[])
 {
 	int							i;
 	int							opt_help = 0;
-	char						buffer [4096];
+	int							jobs;
+	const char					*opt_jobs = "";
+	const char					*opt_output = "text";
+	const char					*opt_list = "";
+	const char					*opt_expires_within = "";
+	const char					*opt_expired_before = "";
+	const char					*opt_pool = "";
+	const char					*opt_read_ahead = "";
+	const char					*opt_fingerprint = "sha256";
+	char						*end;
+	long						days;
+	time_t						limit;
+	int							opt_null = 0;
+	int							opt_stats = 0;
+	name_list					names;
+	const char					*opt_patterns = WALK_DEFAULT_PATTERNS;
+	int							opt_recursive = 0;
+	int							opt_audit_lineage = 0;
+	work_function				function = decodeOneCert;
+	dir_watch					*watch;
+	dir_walk					*walk;
+	unsigned long				hits;
+	unsigned long				misses;
+	struct timespec				start;
 
 	typedef struct
 	{
@@ -281,9 +601,25 @@ int main (int argc, const char *argv[])
 	{
 		{ "-?",	&opt_help,				"Display these help messages"         },
 		{ "-h",	&opt_help,				"Display these help messages"         },
+		{ "-0",	&opt_null,				"Names Read by -@ are NUL Separated"  },
+		{ "=@",	&opt_list,				"Read Filenames from File (- = stdin)"},
 		{ "-d",	&opt_debug,				"Debug Output"                        },
+		{ "=F",	&opt_fingerprint,		"Fingerprint Digest (sha256 sha1)"    },
+		{ "=j",	&opt_jobs,				"Number of Parallel Jobs"             },
+		{ "=m",	&opt_patterns,			"Filename Patterns for -r"            },
+		{ "=o",	&opt_output,			"Output Format (text json ndjson csv)"},
 		{ "-p",	&opt_path,				"Display Full Pathname"               },
-		{ "-v",	&opt_verbose,			"Verbose (Full) Output from openssl"  },
+		{ "-r",	&opt_recursive,			"Recursively Search Directories"      },
+		{ "-v",	&opt_verbose,			"Verbose (Full) Output"               },
+		{ "=x",	&opt_index,				"Index File (Skip Unchanged Files)"   },
+		{ "=-expires-within",	&opt_expires_within,	"Only Certificates Expiring in DAYS"  },
+		{ "=-expired-before",	&opt_expired_before,	"Only Certificates Expiring by DATE"  },
+		{ "--stats",			&opt_stats,				"Print Counters and Timers to stderr" },
+		{ "--check-chain",		&opt_check_chain,		"Check Chain Order and Completeness"  },
+		{ "--audit-lineage",	&opt_audit_lineage,		"Audit certbot Lineage Directories"   },
+		{ "=-pool",				&opt_pool,				"Directory of Known Intermediates"    },
+		{ "--watch",			&opt_watch,				"Watch Directories, Report Changes"   },
+		{ "=-read-ahead",		&opt_read_ahead,		"Files Read Ahead at Once (0 = Off)"  },
 	};
 	int	number_of_options = sizeof (option_list) / sizeof (option_structure);
 
@@ -292,6 +628,8 @@ int main (int argc, const char *argv[])
 	 *-------------------------------------------------------------------------
 	 */
 
+	startTimer (&start);
+
 	my_name = strrchr (argv[0], '/');
 	if (my_name == (char *) NULL)
 		my_name = argv[0];
@@ -341,7 +679,100 @@ int main (int argc, const char *argv[])
 		}
 	}
 
-	if (opt_help || (argc == 0))
+	if (opt_null && (*opt_list == '\0'))
+		opt_list = "-";
+
+	if ((*opt_list != '\0') && ((argc > 0) || opt_recursive))
+	{
+		fprintf (stderr, "%s: -@ may not be combined with filenames or -r\n", my_name);
+		opt_help = 1;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	--expires-within and --expired-before both select certificates that
+	 *	expire before some time; given both, the later time is used.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (*opt_expires_within != '\0')
+	{
+		days = strtol (opt_expires_within, &end, 10);
+		if ((end == opt_expires_within) || (*end != '\0') || (days < 0))
+		{
+			fprintf (stderr, "Error: invalid number of days %s\n", opt_expires_within);
+			opt_help = 1;
+		}
+		else
+		{
+			expiry_limit = time ((time_t *) NULL) + (time_t) days * 86400;
+			expiry_filter = true;
+		}
+	}
+
+	if (*opt_expired_before != '\0')
+	{
+		if (! parseDate (opt_expired_before, &limit))
+		{
+			fprintf (stderr, "Error: invalid date %s (YYYY-MM-DD[THH:MM[:SS]], GMT)\n", opt_expired_before);
+			opt_help = 1;
+		}
+		else if ((! expiry_filter) || (limit > expiry_limit))
+		{
+			expiry_limit = limit;
+			expiry_filter = true;
+		}
+	}
+
+	output_format = outputFormat (opt_output);
+	if (output_format == -1)
+	{
+		fprintf (stderr, "Error: unrecognized output format %s\n", opt_output);
+		opt_help = 1;
+	}
+
+	if (strcasecmp (opt_fingerprint, "sha1") == 0)
+	{
+		fingerprint_label = "SHA1";
+		fingerprint_length = SHA1_LENGTH;
+		setFingerprintName ("sha1");
+	}
+	else if (strcasecmp (opt_fingerprint, "sha256") != 0)
+	{
+		fprintf (stderr, "Error: unrecognized fingerprint digest %s\n", opt_fingerprint);
+		opt_help = 1;
+	}
+
+	if ((fingerprint_length != SHA256_LENGTH) && (*opt_index != '\0'))
+	{
+		fprintf (stderr, "%s: -F sha1 may not be combined with -x (the index records SHA-256)\n", my_name);
+		opt_help = 1;
+	}
+
+	if (opt_check_chain && (output_format != OUTPUT_TEXT))
+	{
+		fprintf (stderr, "%s: --check-chain requires text output\n", my_name);
+		opt_help = 1;
+	}
+
+	if ((*opt_pool != '\0') && ! opt_check_chain)
+	{
+		fprintf (stderr, "%s: --pool requires --check-chain\n", my_name);
+		opt_help = 1;
+	}
+
+	if (opt_watch && ((*opt_list != '\0') || (output_format == OUTPUT_JSON)))
+	{
+		fprintf (stderr, "%s: --watch may not be combined with -@ or -o json\n", my_name);
+		opt_help = 1;
+	}
+
+	if (opt_audit_lineage && ((output_format != OUTPUT_TEXT) || opt_check_chain || opt_watch || (*opt_index != '\0') || expiry_filter))
+	{
+		fprintf (stderr, "%s: --audit-lineage requires text output, and may not be combined with -x, --check-chain, --watch, or an expiry filter\n", my_name);
+		opt_help = 1;
+	}
+
+	if (opt_help || ((argc == 0) && (*opt_list == '\0')))
 	{
 		fprintf (stderr, "usage: %s -options filename...\n", my_name);
 		fprintf (stderr, "options:\n");
@@ -359,13 +790,147 @@ int main (int argc, const char *argv[])
 		exit (1);
 	}
 
-	sprintf (tempFile, "/tmp/%s-%d.pem", my_name, getpid ());
+	if (*opt_jobs == '\0')
+		jobs = defaultThreads ();
+	else
+		jobs = (int) strtol (opt_jobs, (char **) NULL, 10);
+
+	/*-------------------------------------------------------------------------
+	 *	Files are read ahead of the workers, except with an index, since
+	 *	then unchanged files need not be opened at all.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (*opt_read_ahead != '\0')
+		setReadAhead ((int) strtol (opt_read_ahead, (char **) NULL, 10));
+	else if ((*opt_index == '\0') && ((! opt_audit_lineage) || opt_recursive))
+		setReadAhead (READ_AHEAD_DEFAULT);
+
+	/*-------------------------------------------------------------------------
+	 *	With --audit-lineage, each name is a lineage directory, except that
+	 *	-r finds them by their cert.pem files.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_audit_lineage)
+	{
+		function = auditOneLineage;
+		if (strcmp (opt_patterns, WALK_DEFAULT_PATTERNS) == 0)
+			opt_patterns = "cert.pem";
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Only what is displayed is decoded (all of it for -v or an index).
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_verbose || (*opt_index != '\0'))
+		decode_fields = CERT_FIELDS_ALL;
+	else if (opt_check_chain)
+		decode_fields |= CERT_FIELD_KEY_IDS;
+
+	if ((*opt_index != '\0') && ! loadIndex (opt_index))
+		fprintf (stderr, "%s: loadIndex (%s) failed <%s> (Index will be rebuilt)\n", my_name, opt_index, strerror (errno));
+
+	if ((*opt_pool != '\0') && (loadChainPool (opt_pool) == -1))
+	{
+		fprintf (stderr, "%s: loadChainPool (%s) failed <%s>\n", my_name, opt_pool, strerror (errno));
+		exit (1);
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	With --check-chain, the intermediates of every file are added to the
+	 *	pool before any file is checked, so that each chain is completed the
+	 *	same way whatever the number of jobs. The names read by -@ (and the
+	 *	files changed under --watch) are not known in advance, so those are
+	 *	completed from --pool alone.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_check_chain && (*opt_list == '\0') && ! opt_watch)
+		loadChainFiles (argc, argv, opt_patterns, opt_recursive, (chain_filter) NULL);
+
+	/*-------------------------------------------------------------------------
+	 *	With --watch, the directories are watched before they are scanned,
+	 *	so that no change made during the scan is missed. Then each file
+	 *	that is written or replaced is processed again, and reported only if
+	 *	its contents changed. Between changes, nextWatch waits in read.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_watch)
+	{
+		watch = startWatch (argc, argv, opt_patterns);
+		if (watch == (dir_watch *) NULL)
+		{
+			fprintf (stderr, "%s: startWatch failed <%s>\n", my_name, strerror (errno));
+			exit (1);
+		}
+
+		outputBegin (output_format, false);
+		setvbuf (stdout, (char *) NULL, _IOLBF, 0);
+
+		walk = startWalk (argc, argv, opt_patterns, jobs);
+		processSource (nextWalk, walk, jobs, decodeOneCert);
+		endWalk (walk);
+
+		processSource (nextWatch, watch, jobs, decodeOneCert);
+		endWatch (watch);
+		exit (1);
+	}
+
+	outputBegin (output_format, false);
 
 	/*-------------------------------------------------------------------------
-	 *	Process all arguments.
+	 *	Process all arguments. Files are processed in parallel, but the output
+	 *	of each file is emitted in argument order. With -r, directories are
+	 *	walked and each file is processed as soon as it is found; with -@,
+	 *	each file is processed as soon as its name is read.
 	 *-------------------------------------------------------------------------
 	 */
 
-	for (i = 0; i < argc; i++)
-		decodeOneCert (argv [i]);
+	if (*opt_list != '\0')
+	{
+		if (strcmp (opt_list, "-") == 0)
+			names.in = stdin;
+		else if ((names.in = fopen (opt_list, "r")) == (FILE *) NULL)
+		{
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, opt_list, strerror (errno));
+			exit (1);
+		}
+		names.delimiter = opt_null ? '\0' : '\n';
+
+		processSource (nextName, &names, jobs, function);
+
+		if (names.in != stdin)
+			fclose (names.in);
+	}
+	else if (opt_recursive)
+	{
+		walk = startWalk (argc, argv, opt_patterns, jobs);
+		processSource (nextWalk, walk, jobs, function);
+		endWalk (walk);
+	}
+	else
+		processFiles (argc, argv, jobs, function);
+
+	outputEnd (output_format);
+
+	if ((*opt_index != '\0') && ! saveIndex (opt_index))
+		fprintf (stderr, "%s: saveIndex (%s) failed <%s>\n", my_name, opt_index, strerror (errno));
+
+	if (opt_debug)
+	{
+		cacheStatistics (&hits, &misses);
+		fprintf (stderr, "*** CERTIFICATE CACHE: %lu hits, %lu misses\n", hits, misses);
+
+		if (*opt_index != '\0')
+		{
+			indexStatistics (&hits, &misses);
+			fprintf (stderr, "*** INDEX: %lu files unchanged, %lu files read\n", hits, misses);
+		}
+	}
+
+	if (opt_stats)
+		printStats (stderr, my_name, &start);
 }
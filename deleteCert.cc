@@ -4,94 +4,195 @@
  *-----------------------------------------------------------------------------
  */
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 
-extern int					errno;
-extern const char * const	sys_errlist[];
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#include "arena.h"
+#include "certCache.h"
+#include "certChain.h"
+#include "certDecode.h"
+#include "certFile.h"
+#include "certFingerprint.h"
+#include "certJournal.h"
+#include "certMatch.h"
+#include "certOutput.h"
+#include "certStats.h"
+#include "dirWalk.h"
+#include "dirWatch.h"
+#include "pemScan.h"
+#include "readAhead.h"
+#include "workPool.h"
 
 static const char			*my_name;
 static int					opt_path = 0;
 static int					opt_expired = 0;
 static int					opt_force = 0;
-static const char			*opt_issuer = "";
-static const char			*opt_subject = "";
+static cert_matcher			*issuer_matcher;
+static cert_matcher			*subject_matcher;
 static int					delete_number = -1;
 static int					opt_test = 0;
+static bool					ignore_backups = false;
+static int					output_format = OUTPUT_TEXT;
+static bool					expiry_filter = false;
+static time_t				expiry_limit = 0;
+static time_t				run_time;
+static int					decode_fields = CERT_FIELD_ISSUER | CERT_FIELD_VALIDITY | CERT_FIELD_SUBJECT;
+static bool					sync_each_file = true;
+static int					opt_check_chain = 0;
+static int					opt_watch = 0;
 
 /*-----------------------------------------------------------------------------
- *	NAME
- *		trim - Remove trailing blanks, tabs, and newlines
- *
- *	SYNOPSIS
- *		static void
- *		trim(
- *			char			*buffer)			- Buffer to be trimmed
- *
- *	RETURN VALUE
- *		None.
- *
- *	DESCRIPTION
- *		This function removes trailing whitespace from a null terminated
- *		string.
+ *	One certificate found in a file, and whether it is to be deleted. The
+ *	strings are NULL if the certificate could not be decoded; the key
+ *	identifiers are kept only for --check-chain.
  *-----------------------------------------------------------------------------
  */
 
-static void trim (char *buffer)
+typedef struct
 {
-	int							i = strlen (buffer) - 1;
+	pem_block				block;
+	bool					remove;
+	const char				*issuer;
+	const char				*subject;
+	const char				*notBefore;
+	const char				*notAfter;
+	time_t					notBeforeTime;
+	time_t					notAfterTime;
+	const unsigned char		*keyId;
+	int						keyIdLength;
+	const unsigned char		*authorityKeyId;
+	int						authorityKeyIdLength;
+}
+cert_record;
 
-	while ((i >= 0)
-	  && ((buffer[i] == ' ') || (buffer[i] == '\t') || (buffer[i] == '\n') || (buffer[i] == '\r') || (buffer[i] == '\f')))
-		buffer[i--] = '\0';
+/*-----------------------------------------------------------------------------
+ *	Certificates found in one file. The records, and the strings they point
+ *	to, are allocated from the arena of the thread, which is reset for each
+ *	file, so that once a thread has seen its largest file, nothing more is
+ *	allocated however many files or certificates there are.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				*certfile;
+	time_t					now;
+	arena					*storage;
+	cert_record				*certs;
+	int						capacity;
+	int						totalCount;
+	int						deleteCount;
+	bool					exhausted;
 }
+cert_list;
 
 /*-----------------------------------------------------------------------------
  *	NAME
- *		parseNames - Parse Organization and Common Names
+ *		copyBackup - Copy a Certificate File that cannot be Linked
  *
  *	SYNOPSIS
- *		static void
- *		parseNames(
- *			const char		*buffer,			- Names to be Parsed
- *			char			*organizationName,	- Organization Name
- *			char			*commonName)		- Common Name
+ *		static int
+ *		copyBackup(
+ *			const char		*name,				- Backup Certificate File
+ *			const pem_file	*file,				- Contents of Existing File
+ *			mode_t			mode)				- Permissions of New File
  *
  *	RETURN VALUE
- *		None.
+ *		Open descriptor of the backup, or -1 if it could not be written.
  *
  *	DESCRIPTION
- *		This function parses the Organization Name and the Common Name
+ *		Where the file system supports it, the backup shares the blocks of
+ *		the original (FICLONE), or is copied within the kernel; otherwise
+ *		the contents already loaded are written.
  *-----------------------------------------------------------------------------
  */
 
-static void parseNames (const char *buffer, char *organizationName, char *commonName)
+static int copyBackup (const char *name, const pem_file *file, mode_t mode)
 {
-	int							i = strlen (buffer) - 1;
-	const char					*cp;
-	char						*dp;
+	int							fd;
+	size_t						done = 0;
+	ssize_t						length;
 
-	cp = strstr (buffer, "O = ");
-	if (cp == (const char *) NULL)
-		*organizationName = '\0';
-	else
+	fd = open (name, O_WRONLY | O_CREAT | O_TRUNC, mode);
+	if (fd == -1)
 	{
-		strcpy (organizationName, cp + 4);
+		fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, name, strerror (errno));
+		return -1;
+	}
+
+#ifdef FICLONE
+	if (ioctl (fd, FICLONE, file->fd) == 0)
+		done = file->length;
+#endif
 
-		dp = strstr (organizationName, ", CN =");
-		if (dp != (const char *) NULL)
-			*dp = '\0';
+#ifdef __linux__
+	while (done < file->length)
+	{
+		loff_t					offset = done;
+
+		length = copy_file_range (file->fd, &offset, fd, (loff_t *) NULL, file->length - done, 0);
+		if (length <= 0)
+			break;
+		done += length;
+	}
+#endif
+
+	while (done < file->length)
+	{
+		length = pwrite (fd, file->data + done, file->length - done, done);
+		if (length == -1)
+		{
+			fprintf (stderr, "%s: write (%s) failed <%s>\n", my_name, name, strerror (errno));
+			close (fd);
+			unlink (name);
+			return -1;
+		}
+		done += length;
 	}
 
-	cp = strstr (buffer, "CN = ");
+	if (sync_each_file && (fsync (fd) == -1))
+		fprintf (stderr, "%s: fsync (%s) failed <%s>\n", my_name, name, strerror (errno));
+
+	return fd;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		syncDirectory - Make the Entries of a File's Directory Durable
+ *-----------------------------------------------------------------------------
+ */
+
+static void syncDirectory (const char *name)
+{
+	char						directory [4096];
+	const char					*cp;
+	int							fd;
+
+	cp = strrchr (name, '/');
 	if (cp == (const char *) NULL)
-		*commonName = '\0';
+		strcpy (directory, ".");
 	else
-		strcpy (commonName, cp + 5);
+		snprintf (directory, sizeof (directory), "%.*s", (int) ((cp == name) ? 1 : cp - name), name);
+
+	fd = open (directory, O_RDONLY);
+	if (fd == -1)
+		return;
+
+	if (fsync (fd) == -1)
+		fprintf (stderr, "%s: fsync (%s) failed <%s>\n", my_name, directory, strerror (errno));
+
+	close (fd);
 }
 
 /*-----------------------------------------------------------------------------
@@ -103,132 +204,499 @@ static void parseNames (const char *buffer, char *organizationName, char *common
  *		editCertFile(
  *			const char		*oldName			- Existing Certificate File
  *			const char		*newName			- Backup Certificate File
- *			const bool		*removeFlags)		- Array of Flags
+ *			const pem_file	*file,				- Contents of Existing File
+ *			const pem_block	*blocks,			- Certificates to Write
+ *			int				count)				- Number of Certificates
  *
  *	RETURN VALUE
  *		None
  *
  *	DESCRIPTION
  *		Edit one Certificate File.
+ *		*	Write New File to a Temporary File in the Same Directory
+ *		*	Change Ownership and Permissions, and fsync
  *		*	Backup Original File
- *		*	Write New File
- *		*	Change Ownership and Permissions
+ *		*	Rename New File over Original File
+ *
+ *		The original name always refers to either the complete original or
+ *		the complete new file, even if the system crashes, and anything that
+ *		has it open (a web server being reloaded) keeps reading the original.
+ *
+ *		The backup is a hard link to the original, so nothing is copied; if
+ *		linking is not possible, it is cloned or copied (see copyBackup).
+ *		Either way, the backup is then made read only, as before.
+ *
+ *		With --journal, the edit is recorded once the backup exists, and
+ *		nothing is synced here; closeJournal syncs each file system once.
+ *
+ *		The certificates that are kept are written, in the order given,
+ *		directly from the contents already loaded (or from the pool, for
+ *		those added by --check-chain), so the original is not read again.
  *-----------------------------------------------------------------------------
  */
 
-void editCertFile (const char *oldName, const char *newName, const bool *removeFlags)
+void editCertFile (const char *oldName, const char *newName, const pem_file *file, const pem_block *blocks, int count)
 {
-	int							count = 0;
+	int							i;
 	int							result;
-	char						buffer [4096];
-	bool						inCert = false;
+	int							fd;
+	int							backupFd;
+	size_t						length;
 	bool						blankLineNeeded = false;
-	FILE						*inFile;
+	bool						failed = false;
+	char						tempName [4096];
+	const char					*cp;
 	FILE						*outFile;
 	struct stat					in_stat;
 
-	result = rename (oldName, newName);
+	result = fstat (file->fd, &in_stat);
 	if (result == -1)
 	{
-		fprintf (stderr, "%s: rename (%s, %s) failed <%s>\n", my_name, oldName, newName, sys_errlist [errno]);
+		fprintf (stderr, "%s: fstat (%s) failed <%s>\n", my_name, oldName, strerror (errno));
 		return;
 	}
 
-	inFile = fopen (newName, "r");
-	if (inFile == (FILE *) NULL)
-	{
-		fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, newName, sys_errlist [errno]);
+	/*-------------------------------------------------------------------------
+	 *	Write New File to a Temporary File (.name.XXXXXX)
+	 *-------------------------------------------------------------------------
+	 */
 
-		result = rename (newName, oldName);
-		if (result == -1)
-			fprintf (stderr, "%s: rename (%s, %s) failed <%s>\n", my_name, newName, oldName, sys_errlist [errno]);
+	cp = strrchr (oldName, '/');
+	if (cp == (const char *) NULL)
+		snprintf (tempName, sizeof (tempName), ".%s.XXXXXX", oldName);
+	else
+		snprintf (tempName, sizeof (tempName), "%.*s/.%s.XXXXXX", (int) (cp - oldName), oldName, cp + 1);
 
+	fd = mkstemp (tempName);
+	if (fd == -1)
+	{
+		fprintf (stderr, "%s: mkstemp (%s) failed <%s>\n", my_name, tempName, strerror (errno));
 		return;
 	}
 
-	outFile = fopen (oldName, "w");
+	outFile = fdopen (fd, "w");
 	if (outFile == (FILE *) NULL)
 	{
-		fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, oldName, sys_errlist [errno]);
+		fprintf (stderr, "%s: fdopen (%s) failed <%s>\n", my_name, tempName, strerror (errno));
+		close (fd);
+		unlink (tempName);
+		return;
+	}
 
-		fclose (inFile);
+	for (i = 0; i < count; i++)
+	{
+		if (blankLineNeeded)
+			fprintf (outFile, "\n");
 
-		result = rename (newName, oldName);
-		if (result == -1)
-			fprintf (stderr, "%s: rename (%s, %s) failed <%s>\n", my_name, newName, oldName, sys_errlist [errno]);
+		length = blocks [i].end - blocks [i].begin;
+		fwrite (blocks [i].begin, 1, length, outFile);
+		if ((length == 0) || (blocks [i].begin [length - 1] != '\n'))
+			fprintf (outFile, "\n");
 
-		return;
+		blankLineNeeded = true;
 	}
 
-	while (fgets (buffer, sizeof (buffer), inFile) != NULL)
+	if (fflush (outFile) == EOF)
 	{
-		trim (buffer);
-		if (inCert)
-		{
-			if (! (removeFlags [count - 1]))
-				fprintf (outFile, "%s\n", buffer);
+		fprintf (stderr, "%s: write (%s) failed <%s>\n", my_name, tempName, strerror (errno));
+		failed = true;
+	}
 
-			if (strcmp (buffer, "-----END CERTIFICATE-----") == 0)
-			{
-				inCert = false;
+	/*-------------------------------------------------------------------------
+	 *	Change Ownership and Permissions of New File to those of Original
+	 *-------------------------------------------------------------------------
+	 */
 
-				if (! (removeFlags [count - 1]))
-					blankLineNeeded = true;
-			}
-		}
-		else
-		{
-			if (strcmp (buffer, "-----BEGIN CERTIFICATE-----") == 0)
-			{
-				count++;
-				inCert = true;
+	result = fchmod (fd, (in_stat.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)));
+	if (result == -1)
+		fprintf (stderr, "%s: fchmod (%s) failed <%s>\n", my_name, tempName, strerror (errno));
 
-				if (! (removeFlags [count - 1]))
-				{
-					if (blankLineNeeded)
-					{
-						fprintf (outFile, "\n");
-						blankLineNeeded = false;
-					}
-					fprintf (outFile, "%s\n", buffer);
-				}
-			}
-		}
+	result = fchown (fd, in_stat.st_uid, in_stat.st_gid);
+	if (result == -1)
+		fprintf (stderr, "%s: fchown (%s) failed <%s>\n", my_name, tempName, strerror (errno));
+
+	if ((! failed) && sync_each_file && (fsync (fd) == -1))
+	{
+		fprintf (stderr, "%s: fsync (%s) failed <%s>\n", my_name, tempName, strerror (errno));
+		failed = true;
+	}
+
+	if (fclose (outFile) == EOF)
+		failed = true;
+
+	if (failed)
+	{
+		unlink (tempName);
+		return;
 	}
 
 	/*-------------------------------------------------------------------------
-	 *	Get Ownership and Permissions of Original (Backup) File (newName)
+	 *	Backup Original File (newName), Replacing any Earlier Backup
 	 *-------------------------------------------------------------------------
 	 */
 
-	result = fstat (fileno (inFile), &in_stat);
+	backupFd = file->fd;
+
+	result = link (oldName, newName);
+	if ((result == -1) && (errno == EEXIST) && (unlink (newName) == 0))
+		result = link (oldName, newName);
+
 	if (result == -1)
-		fprintf (stderr, "%s: fstat (%s) failed <%s>\n", my_name, newName, sys_errlist [errno]);
+	{
+		(void) unlink (newName);
+		backupFd = copyBackup (newName, file, in_stat.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO));
+		if (backupFd == -1)
+		{
+			unlink (tempName);
+			return;
+		}
+
+		if (fchown (backupFd, in_stat.st_uid, in_stat.st_gid) == -1)
+			fprintf (stderr, "%s: fchown (%s) failed <%s>\n", my_name, newName, strerror (errno));
+	}
+
+	if (! journalEdit (oldName, newName, in_stat.st_mode))
+	{
+		fprintf (stderr, "%s: journal (%s) failed <%s>\n", my_name, oldName, strerror (errno));
+		unlink (tempName);
+		if (backupFd != file->fd)
+			close (backupFd);
+		return;
+	}
 
 	/*-------------------------------------------------------------------------
-	 *	Change Permissions of Original (Backup) File (newName) to Prevent Write
+	 *	Replace Original File (oldName) with New File
 	 *-------------------------------------------------------------------------
 	 */
 
-	result = fchmod (fileno (inFile), (in_stat.st_mode & (S_IRUSR | S_IXUSR | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)));
+	result = renameat (AT_FDCWD, tempName, AT_FDCWD, oldName);
 	if (result == -1)
-		fprintf (stderr, "%s: fchmod (%s) failed <%s>\n", my_name, newName, sys_errlist [errno]);
+	{
+		fprintf (stderr, "%s: rename (%s, %s) failed <%s>\n", my_name, tempName, oldName, strerror (errno));
+		unlink (tempName);
+	}
+	else
+	{
+		countStat (STAT_FILES_REWRITTEN, 1);
+		if (sync_each_file)
+			syncDirectory (oldName);
+	}
 
 	/*-------------------------------------------------------------------------
-	 *	Change Ownership and Permissions of New File (oldName)
+	 *	Change Permissions of Backup File (newName) to Prevent Write
 	 *-------------------------------------------------------------------------
 	 */
 
-	result = fchmod (fileno (outFile), (in_stat.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)));
+	result = fchmod (backupFd, (in_stat.st_mode & (S_IRUSR | S_IXUSR | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)));
 	if (result == -1)
-		fprintf (stderr, "%s: fchmod (%s) failed <%s>\n", my_name, oldName, sys_errlist [errno]);
+		fprintf (stderr, "%s: fchmod (%s) failed <%s>\n", my_name, newName, strerror (errno));
 
-	result = fchown (fileno (outFile), in_stat.st_uid, in_stat.st_gid);
-	if (result == -1)
-		fprintf (stderr, "%s: fchown (%s) failed <%s>\n", my_name, oldName, sys_errlist [errno]);
+	if (backupFd != file->fd)
+		close (backupFd);
+}
 
-	fclose (inFile);
-	fclose (outFile);
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		deleteMatch - Decide whether to Delete one Certificate
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		deleteMatch(
+ *			int					count,			- Certificate Number
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length,			- Length of Certificate
+ *			const cert_info		*cert,			- Decoded Certificate
+ *			bool				decoded,		- Whether cert was Decoded
+ *			time_t				now)			- Current Time
+ *
+ *	RETURN VALUE
+ *		true if the certificate matches the number, fingerprint, issuer,
+ *		subject, expiration, or expiry limit criteria.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool deleteMatch (int count, const unsigned char *der, size_t length, const cert_info *cert, bool decoded, time_t now)
+{
+	if (count == delete_number)
+		return true;
+
+	if ((der != (const unsigned char *) NULL) && knownFingerprint (der, length))
+		return true;
+
+	if (matchDN (issuer_matcher, cert->issuer))
+		return true;
+
+	/*-------------------------------------------------------------------------
+	 *	Only expired certificates, not those not yet valid.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_expired && decoded && (cert->notAfterTime < now))
+		return true;
+
+	if (expiry_filter && decoded && (cert->notAfterTime < expiry_limit))
+		return true;
+
+	return matchDN (subject_matcher, cert->subject);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		keptInPool - Whether a Certificate of a File may Complete other Chains
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		keptInPool(
+ *			int					count,			- Certificate Number
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
+ *
+ *	RETURN VALUE
+ *		false if the certificate is to be deleted, so that --check-chain
+ *		does not add it back to another file.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool keptInPool (int count, const unsigned char *der, size_t length)
+{
+	cert_info					cert;
+
+	if ((der == (const unsigned char *) NULL) || ! decodeCached (der, length, decode_fields, &cert))
+		return false;
+
+	return ! deleteMatch (count, der, length, &cert, true, run_time);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		deleteOneCertCallback - Decide whether to Delete one Certificate
+ *
+ *	SYNOPSIS
+ *		static void
+ *		deleteOneCertCallback(
+ *			void				*context,		- Certificate List
+ *			int					count,			- Certificate Number
+ *			const pem_block		*block,			- Location in File
+ *			const unsigned char	*der,			- DER Encoded Certificate
+ *			size_t				length)			- Length of Certificate
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		This function is called by readPemFile for each certificate. It
+ *		determines whether the certificate matches the number, fingerprint,
+ *		issuer, subject, expiration, or expiry limit criteria, and saves
+ *		what will be reported.
+ *-----------------------------------------------------------------------------
+ */
+
+static void deleteOneCertCallback (void *context, int count, const pem_block *block, const unsigned char *der, size_t length)
+{
+	cert_list					*list = (cert_list *) context;
+	cert_record					*record;
+	cert_info					cert;
+	unsigned char				*keys;
+	struct timespec				start;
+	bool						decoded = false;
+	bool						remove;
+
+	list->totalCount = count;
+	if (count > list->capacity)
+		return;
+
+	startTimer (&start);
+	if (der == (const unsigned char *) NULL)
+		fprintf (stderr, "%s: %s, Certificate %d: invalid PEM encoding\n", my_name, list->certfile, count);
+	else if (! decodeCached (der, length, decode_fields, &cert))
+		fprintf (stderr, "%s: %s, Certificate %d: unable to decode certificate\n", my_name, list->certfile, count);
+	else
+		decoded = true;
+	stopTimer (TIMER_DECODE, &start);
+
+	if (! decoded)
+		memset (&cert, 0, sizeof (cert));
+
+	remove = deleteMatch (count, der, length, &cert, decoded, list->now);
+	if (remove)
+		list->deleteCount++;
+
+	/*-------------------------------------------------------------------------
+	 *	Keep only what is reported, each string at its actual length.
+	 *-------------------------------------------------------------------------
+	 */
+
+	record = &list->certs [count - 1];
+	record->block = *block;
+	record->remove = remove;
+	record->issuer = (const char *) NULL;
+	record->subject = (const char *) NULL;
+	record->notBefore = (const char *) NULL;
+	record->notAfter = (const char *) NULL;
+	record->notBeforeTime = cert.notBeforeTime;
+	record->notAfterTime = cert.notAfterTime;
+	record->keyId = (const unsigned char *) NULL;
+	record->keyIdLength = 0;
+	record->authorityKeyId = (const unsigned char *) NULL;
+	record->authorityKeyIdLength = 0;
+
+	if (decoded && opt_check_chain)
+	{
+		keys = (unsigned char *) arenaAlloc (list->storage, cert.subjectKeyIdLength + cert.authorityKeyIdLength + 1);
+		if (keys == (unsigned char *) NULL)
+			list->exhausted = true;
+		else
+		{
+			memcpy (keys, cert.subjectKeyId, cert.subjectKeyIdLength);
+			memcpy (keys + cert.subjectKeyIdLength, cert.authorityKeyId, cert.authorityKeyIdLength);
+			record->keyId = keys;
+			record->keyIdLength = cert.subjectKeyIdLength;
+			record->authorityKeyId = keys + cert.subjectKeyIdLength;
+			record->authorityKeyIdLength = cert.authorityKeyIdLength;
+		}
+	}
+
+	if (decoded)
+	{
+		record->issuer = arenaString (list->storage, cert.issuer);
+		record->subject = arenaString (list->storage, cert.subject);
+		record->notBefore = arenaString (list->storage, cert.notBefore);
+		record->notAfter = arenaString (list->storage, cert.notAfter);
+
+		if ((record->issuer == (const char *) NULL) || (record->subject == (const char *) NULL) ||
+			(record->notBefore == (const char *) NULL) || (record->notAfter == (const char *) NULL))
+			list->exhausted = true;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		keptCertificates - List the Certificates to be Written, in Order
+ *
+ *	SYNOPSIS
+ *		static int
+ *		keptCertificates(
+ *			cert_list			*list,			- Certificates in File
+ *			pem_block			*blocks,		- Certificates to Write
+ *			int					*numbers,		- Their Numbers (0 if Added)
+ *			const chain_cert	**added,		- Added from Pool
+ *			int					*addedCount,	- Number Added
+ *			int					*status)		- CHAIN_MISORDERED, ...
+ *
+ *	RETURN VALUE
+ *		Number of certificates to write, or -1 if memory is exhausted.
+ *
+ *	DESCRIPTION
+ *		The certificates not being deleted are kept in the order of the
+ *		file. With --check-chain, they are put in chain order instead:
+ *		certificates that are not part of the chain are deleted as well,
+ *		and missing intermediates are added from the pool (so blocks has
+ *		room for CHAIN_MAX_ADDED more than the file). If any certificate
+ *		being kept could not be decoded, the chain is not checked.
+ *
+ *		The intermediates of the chain are then added to the pool, so that
+ *		they can complete the chains of later files.
+ *-----------------------------------------------------------------------------
+ */
+
+static int keptCertificates (cert_list *list, pem_block *blocks, int *numbers, const chain_cert **added, int *addedCount, int *status)
+{
+	chain_cert					*chain;
+	const chain_cert			**order;
+	bool						*unused;
+	int							count = 0;
+	int							length;
+	int							i;
+
+	*addedCount = 0;
+	*status = 0;
+
+	for (i = 0; i < list->totalCount; i++)
+	{
+		if (! list->certs [i].remove)
+		{
+			numbers [count] = i + 1;
+			blocks [count++] = list->certs [i].block;
+		}
+	}
+
+	if ((! opt_check_chain) || (count == 0))
+		return count;
+
+	for (i = 0; i < list->totalCount; i++)
+	{
+		if ((! list->certs [i].remove) && (list->certs [i].issuer == (const char *) NULL))
+		{
+			fprintf (stderr, "%s: %s, Certificate %d: not decoded, so chain NOT checked\n", my_name, list->certfile, i + 1);
+			return count;
+		}
+	}
+
+	chain = (chain_cert *) arenaAlloc (list->storage, count * sizeof (chain_cert));
+	order = (const chain_cert **) arenaAlloc (list->storage, (count + CHAIN_MAX_ADDED) * sizeof (const chain_cert *));
+	unused = (bool *) arenaAlloc (list->storage, count * sizeof (bool));
+	if ((chain == (chain_cert *) NULL) || (order == (const chain_cert **) NULL) || (unused == (bool *) NULL))
+		return -1;
+
+	count = 0;
+	for (i = 0; i < list->totalCount; i++)
+	{
+		if (list->certs [i].remove)
+			continue;
+
+		chain [count].subject = list->certs [i].subject;
+		chain [count].issuer = list->certs [i].issuer;
+		chain [count].keyId = list->certs [i].keyId;
+		chain [count].keyIdLength = list->certs [i].keyIdLength;
+		chain [count].authorityKeyId = list->certs [i].authorityKeyId;
+		chain [count].authorityKeyIdLength = list->certs [i].authorityKeyIdLength;
+		chain [count].index = i + 1;
+		chain [count].pem = list->certs [i].block.begin;
+		chain [count].pemLength = list->certs [i].block.end - list->certs [i].block.begin;
+		chain [count].source = list->certfile;
+		unused [count++] = true;
+	}
+
+	length = checkChain (chain, count, order, status);
+	if (length == -1)
+		return -1;
+
+	/*-------------------------------------------------------------------------
+	 *	Delete what is not in the chain, and write the chain.
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (i = 0; i < length; i++)
+	{
+		if (order [i]->index != -1)
+			unused [order [i] - chain] = false;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (unused [i])
+		{
+			list->certs [chain [i].index - 1].remove = true;
+			list->deleteCount++;
+		}
+	}
+
+	for (i = 0; i < length; i++)
+	{
+		numbers [i] = (order [i]->index == -1) ? 0 : order [i]->index;
+		if (order [i]->index == -1)
+		{
+			added [(*addedCount)++] = order [i];
+			blocks [i].begin = order [i]->pem;
+			blocks [i].end = order [i]->pem + order [i]->pemLength;
+			blocks [i].body = (const char *) NULL;
+			blocks [i].bodyEnd = (const char *) NULL;
+		}
+		else
+			blocks [i] = list->certs [order [i]->index - 1].block;
+	}
+
+	return length;
 }
 
 /*-----------------------------------------------------------------------------
@@ -238,7 +706,8 @@ void editCertFile (const char *oldName, const char *newName, const bool *removeF
  *	SYNOPSIS
  *		void
  *		deleteOneCert(
- *			const char		*filename)			- Filename to process
+ *			const char		*filename,			- Filename to process
+ *			FILE			*out)				- Output File
  *
  *	RETURN VALUE
  *		None
@@ -247,7 +716,8 @@ void editCertFile (const char *oldName, const char *newName, const bool *removeF
  *		Process one Certificate File.
  *		*	for each cert in file, parse and save info
  *		*	determine whether cert needs to be deleted
- *		*	If any cert need to be deleted, edit file
+ *		*	If any cert need to be deleted, edit file (the file a
+ *			symbolic link refers to, leaving the link)
  *		*	Produce output
  *
  *	NOTES
@@ -258,190 +728,222 @@ void editCertFile (const char *oldName, const char *newName, const bool *removeF
  *-----------------------------------------------------------------------------
  */
 
-void deleteOneCert (const char *filename)
+void deleteOneCert (const char *filename, FILE *out)
 {
 	int							i;
 	int							result;
-	const int					MAXIMUM_CERTIFICATES = 16;
-	const int					MAXIMUM_LENGTH = 1024;
-	char						command [4096];
-	char						buffer [4096];
-	char						wd [4096];
+	int							length;
+	char						buffer [8192];
+	char						header [20480];
 	char						certfile [4096];
+	char						editfile [4096];
 	char						backupFilename [4096];
-	char						issuer [MAXIMUM_CERTIFICATES] [MAXIMUM_LENGTH];
-	char						validity_message [MAXIMUM_CERTIFICATES] [MAXIMUM_LENGTH];
-	char						validity_range [MAXIMUM_CERTIFICATES] [MAXIMUM_LENGTH];
-	char						subject [MAXIMUM_CERTIFICATES] [MAXIMUM_LENGTH];
-	bool						remove [MAXIMUM_CERTIFICATES];
-	char						organizationName [1024];
-	char						commonName [1024];
+	char						validity_message [256];
+	char						validity_range [256];
 	const char					*reportFilename;
 	const char					*cp;
-	bool						editFile = false;
+	const char					*action;
 	bool						updateFile = false;
-	FILE						*inFile;
-	FILE						*outFile;
-	FILE						*p;
-	int							totalCount = 0;
-	int							deleteCount = 0;
+	bool						changed;
+	pem_file					file;
+	pem_block					*blocks;
+	int							*numbers;
+	const chain_cert			*added [CHAIN_MAX_ADDED];
+	int							addedCount;
+	int							keptCount = -1;
+	int							status;
+	char						chainNote [64];
+	int							totalCount;
+	int							deleteCount;
+	cert_list					list;
 	struct stat					in_stat;
 	struct stat					out_stat;
+	struct timespec				start;
+	output_record				record;
 
-	if (opt_path && (*filename != '/'))
+	fullPathname (filename, opt_path, certfile, sizeof (certfile));
+
+	startTimer (&start);
+	if (! openPemFile (filename, &file))
 	{
-		getcwd (wd, sizeof (wd));
-		if (strncmp (filename, "./", 2) == 0)
-			sprintf (certfile, "%s/%s", wd, filename + 2);
+		if (opt_watch && (errno == ENOENT))
+			forgetSummary (filename);
 		else
-			sprintf (certfile, "%s/%s", wd, filename);
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, filename, strerror (errno));
+		return;
 	}
-	else
-		strcpy (certfile, filename);
+	stopTimer (TIMER_OPEN, &start);
+	countStat (STAT_BYTES_READ, file.length);
 
-	result = stat (filename, &in_stat);
-	if (result == -1)
+	/*-------------------------------------------------------------------------
+	 *	With --watch, a file is reported only when it changed since it was
+	 *	last processed and something in it must be deleted, reordered, or
+	 *	added. The file this writes is processed again, and left alone.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_watch && ! changedSummary (filename, fileSummary (file.data, file.length)))
 	{
-		fprintf (stderr, "%s: stat (%s) failed <%s>\n", my_name, filename, sys_errlist [errno]);
+		closePemFile (&file);
 		return;
 	}
 
-	if (opt_path)
-		sprintf (command, "decodeCert -p %s", filename);
-	else
-		sprintf (command, "decodeCert %s", filename);
-
-	p = popen (command, "r");
-	if (p == (FILE *) NULL)
+	result = fstat (file.fd, &in_stat);
+	if (result == -1)
 	{
-		fprintf (stderr, "%s: popen (%s) failed <%s>\n", my_name, command, sys_errlist [errno]);
+		fprintf (stderr, "%s: fstat (%s) failed <%s>\n", my_name, filename, strerror (errno));
+		closePemFile (&file);
 		return;
 	}
 
-	while (fgets (buffer, sizeof (buffer), p) != NULL)
-	{
-		trim (buffer);
+	/*-------------------------------------------------------------------------
+	 *	One record per certificate, sized by counting them first.
+	 *-------------------------------------------------------------------------
+	 */
 
-		if (strncmp (buffer, "========", 8) == 0)
-		{
-			totalCount++;
+	list.certfile = certfile;
+	list.storage = threadArena ();
+	list.capacity = countPemBlocks (&file);
+	list.totalCount = 0;
+	list.deleteCount = 0;
+	list.exhausted = false;
 
-			issuer [totalCount - 1] [0] = '\0';
-			validity_message [totalCount - 1] [0] = '\0';
-			validity_range [totalCount - 1] [0] = '\0';
-			subject [totalCount - 1] [0] = '\0';
-			remove [totalCount - 1] = false;
+	/*-------------------------------------------------------------------------
+	 *	Expiry is judged as of the start of the run, as it is for the pool,
+	 *	except for files that change under --watch.
+	 *-------------------------------------------------------------------------
+	 */
 
-			if ((totalCount == delete_number) && (! (remove [totalCount - 1])))
-			{
-				remove [totalCount - 1] = true;
-				deleteCount++;
-			}
+	if (opt_watch)
+		time (&list.now);
+	else
+		list.now = run_time;
 
-			continue;
-		}
+	if (list.storage == (arena *) NULL)
+		list.certs = (cert_record *) NULL;
+	else
+	{
+		arenaReset (list.storage);
+		list.certs = (cert_record *) arenaAlloc (list.storage, list.capacity * sizeof (cert_record));
+	}
 
-		if ((cp = strstr (buffer, "Issuer: ")) != (const char *) NULL)
-		{
-			strcpy (issuer [totalCount - 1], cp + 8);
-			if (! (remove [totalCount - 1]))
-			{
-				parseNames (issuer [totalCount - 1], organizationName, commonName);
-				if ((*opt_issuer != '\0') && ((strcasecmp (organizationName, opt_issuer) == 0) || (strcasecmp (commonName, opt_issuer) == 0)))
-				{
-					remove [totalCount - 1] = true;
-					deleteCount++;
-				}
-			}
-			continue;
-		}
+	if (list.certs == (cert_record *) NULL)
+		list.exhausted = true;
+	else
+		result = readPemFile (&file, deleteOneCertCallback, &list);
 
-		if ((cp = strstr (buffer, "Validity")) != (const char *) NULL)
-		{
-			if (cp [8] != '\0')
-			{
-				strcpy (validity_message [totalCount - 1], cp + 9);
-				if ((opt_expired) && (! (remove [totalCount - 1])))
-				{
-					remove [totalCount - 1] = true;
-					deleteCount++;
-				}
-			}
-			continue;
-		}
+	countStat (STAT_CERTIFICATES, list.totalCount);
 
-		if ((cp = strstr (buffer, "Not Before: ")) != (const char *) NULL)
-		{
-			strcpy (validity_range [totalCount - 1], cp + 12);
-			continue;
-		}
+	if (list.exhausted || (result == -1))
+	{
+		fprintf (stderr, "%s: %s: out of memory\n", my_name, certfile);
+		closePemFile (&file);
+		return;
+	}
 
-		if ((cp = strstr (buffer, "Not After : ")) != (const char *) NULL)
-		{
-			strcat (validity_range [totalCount - 1], " - ");
-			strcat (validity_range [totalCount - 1], cp + 12);
-			continue;
-		}
+	if (list.totalCount != list.capacity)
+	{
+		fprintf (stderr, "%s: %s: %d Certificates Expected, %d Found (File NOT Modified)\n", my_name, certfile, list.capacity, list.totalCount);
+		closePemFile (&file);
+		return;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	What will be written, and in what order (see keptCertificates).
+	 *-------------------------------------------------------------------------
+	 */
 
-		if ((cp = strstr (buffer, "Subject: ")) != (const char *) NULL)
-		{
-			strcpy (subject [totalCount - 1], cp + 9);
-			if (! (remove [totalCount - 1]))
-			{
-				parseNames (subject [totalCount - 1], organizationName, commonName);
-				if ((*opt_subject != '\0') && ((strcasecmp (organizationName, opt_subject) == 0) || (strcasecmp (commonName, opt_subject) == 0)))
-				{
-					remove [totalCount - 1] = true;
-					deleteCount++;
-				}
-			}
-			continue;
-		}
+	blocks = (pem_block *) arenaAlloc (list.storage, (list.totalCount + CHAIN_MAX_ADDED) * sizeof (pem_block));
+	numbers = (int *) arenaAlloc (list.storage, (list.totalCount + CHAIN_MAX_ADDED) * sizeof (int));
+	if ((blocks != (pem_block *) NULL) && (numbers != (int *) NULL))
+		keptCount = keptCertificates (&list, blocks, numbers, added, &addedCount, &status);
+
+	if (keptCount == -1)
+	{
+		fprintf (stderr, "%s: %s: out of memory\n", my_name, certfile);
+		closePemFile (&file);
+		return;
 	}
 
-	pclose (p);
+	totalCount = list.totalCount;
+	deleteCount = list.deleteCount;
+	changed = (deleteCount > 0) || ((status & (CHAIN_MISORDERED | CHAIN_INCOMPLETE)) != 0);
 
-	*buffer = '\0';
-	sprintf (command, "ls -l %s", certfile);
-	p = popen (command, "r");
-	if (p != (FILE *) NULL)
+	if (opt_watch && ! changed)
 	{
-		fgets (buffer, sizeof (buffer), p);
-		trim (buffer);
-		pclose (p);
+		closePemFile (&file);
+		return;
 	}
 
+	*chainNote = '\0';
+	if (status & CHAIN_MISORDERED)
+		strcpy (chainNote, ", Chain Reordered");
+	if (addedCount > 0)
+		snprintf (chainNote + strlen (chainNote), sizeof (chainNote) - strlen (chainNote), ", Add %d from Pool", addedCount);
+
 	/*-------------------------------------------------------------------------
 	 *	Need to report Filename, permissions, owner, group, timestamp, size, [BACKUP TO ...]
 	 *-------------------------------------------------------------------------
 	 */
 
-	if (*buffer == '\0')
-		reportFilename = certfile;
-	else
+	if (formatListing (certfile, buffer, sizeof (buffer)))
 		reportFilename = buffer;
+	else
+		reportFilename = certfile;
 
-	if (deleteCount == 0)
-		fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (File NOT Modified)\n", reportFilename, totalCount, deleteCount);
+	if (! changed)
+	{
+		action = "not_modified";
+		snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (File NOT Modified)\n", reportFilename, totalCount, deleteCount, chainNote);
+	}
 	else if (deleteCount == totalCount)
-		fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (Entire file must be deleted)\n", reportFilename, totalCount, deleteCount);
+	{
+		action = "delete_entire_file";
+		snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (Entire file must be deleted)\n", reportFilename, totalCount, deleteCount, chainNote);
+	}
 	else if (opt_test)
-		fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (File not updated in Test Mode)\n", reportFilename, totalCount, deleteCount);
+	{
+		action = "test_mode";
+		snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (File not updated in Test Mode)\n", reportFilename, totalCount, deleteCount, chainNote);
+	}
 	else
 	{
+		/*---------------------------------------------------------------------
+		 *	A symbolic link is left as it is; the file it refers to is edited,
+		 *	and backed up beside it.
+		 *---------------------------------------------------------------------
+		 */
+
+		if (! targetPathname (certfile, editfile, sizeof (editfile)))
+		{
+			fprintf (stderr, "%s: realpath (%s) failed <%s> (File NOT Modified)\n", my_name, certfile, strerror (errno));
+			closePemFile (&file);
+			return;
+		}
+
 		updateFile = true;
-		cp = strrchr (certfile, '.');
+		cp = strrchr (editfile, '.');
+		if ((cp != (const char *) NULL) && (strchr (cp, '/') != (const char *) NULL))
+			cp = (const char *) NULL;
 		if (cp == (const char *) NULL)
-			sprintf (backupFilename, "%s-BACKUP", certfile);
+			length = snprintf (backupFilename, sizeof (backupFilename), "%s-BACKUP", editfile);
 		else
-			sprintf (backupFilename, "%.*s-BACKUP.%s", (int) (cp - certfile), certfile, cp + 1);
+			length = snprintf (backupFilename, sizeof (backupFilename), "%.*s-BACKUP.%s", (int) (cp - editfile), editfile, cp + 1);
+
+		if ((length < 0) || ((size_t) length >= sizeof (backupFilename)))
+		{
+			fprintf (stderr, "%s: %s: Backup Filename too long (File NOT Modified)\n", my_name, editfile);
+			closePemFile (&file);
+			return;
+		}
 
 		result = stat (backupFilename, &out_stat);
 		if (result == 0)
 		{
 			if (opt_force)
 			{
-				fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (Backup %s will be overwritten in Force Mode)\n", reportFilename, totalCount, deleteCount, backupFilename);
+				action = "updated";
+				snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (Backup %s will be overwritten in Force Mode)\n", reportFilename, totalCount, deleteCount, chainNote, backupFilename);
 
 				/*-------------------------------------------------------------
 				 *	Change permissions of backup file to allow overwrite.
@@ -450,23 +952,206 @@ void deleteOneCert (const char *filename)
 
 				result = chmod (backupFilename, (in_stat.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)));
 				if (result == -1)
-					fprintf (stderr, "%s: chmod (%s) failed <%s>\n", my_name, backupFilename, sys_errlist [errno]);
+					fprintf (stderr, "%s: chmod (%s) failed <%s>\n", my_name, backupFilename, strerror (errno));
 			}
 			else
 			{
-				fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (Backup %s already exists so %s will NOT be updated)\n", reportFilename, totalCount, deleteCount, backupFilename, certfile);
+				action = "backup_exists";
+				snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (Backup %s already exists so %s will NOT be updated)\n", reportFilename, totalCount, deleteCount, chainNote, backupFilename, editfile);
 				updateFile = false;
 			}
 		}
 		else
-			fprintf (stdout, "######## %s, %d Certificates in File, Delete %d (Backup to %s)\n", reportFilename, totalCount, deleteCount, backupFilename);
+		{
+			action = "updated";
+			snprintf (header, sizeof (header), "######## %s, %d Certificates in File, Delete %d%s (Backup to %s)\n", reportFilename, totalCount, deleteCount, chainNote, backupFilename);
+		}
 	}
 
-	for (i = 0; i < totalCount; i++)
-		fprintf (stdout, "%3d. %s %-21.21s %s; Issuer <%s>; Subject <%s>\n", i + 1, remove [i] ? "DELETE" : "      ", validity_message [i], validity_range [i], issuer[i], subject [i]);
+	/*-------------------------------------------------------------------------
+	 *	With -o, one record per certificate replaces the report.
+	 *-------------------------------------------------------------------------
+	 */
+
+	for (i = 0; (i < totalCount) && (output_format != OUTPUT_TEXT); i++)
+	{
+		record.file = certfile;
+		record.index = i + 1;
+		record.first = (i == 0);
+		record.issuer = list.certs [i].issuer;
+		record.subject = list.certs [i].subject;
+		record.notBefore = list.certs [i].notBeforeTime;
+		record.notAfter = list.certs [i].notAfterTime;
+		record.now = list.now;
+		record.remove = list.certs [i].remove;
+		record.action = action;
+		record.fingerprint = (const char *) NULL;
+		outputRecord (out, output_format, &record);
+	}
+
+	if (output_format == OUTPUT_TEXT)
+		fputs (header, out);
+
+	for (i = 0; (i < totalCount) && (output_format == OUTPUT_TEXT); i++)
+	{
+		*validity_message = '\0';
+		*validity_range = '\0';
+		if (list.certs [i].issuer != (const char *) NULL)
+		{
+			validityMessage (list.certs [i].notBeforeTime, list.certs [i].notAfterTime, list.now, validity_message, sizeof (validity_message));
+			snprintf (validity_range, sizeof (validity_range), "%s - %s", list.certs [i].notBefore, list.certs [i].notAfter);
+		}
+
+		fprintf (out, "%3d. %s %-21.21s %s; Issuer <%s>; Subject <%s>\n", i + 1, list.certs [i].remove ? "DELETE" : "      ", validity_message, validity_range,
+					(list.certs [i].issuer != (const char *) NULL) ? list.certs [i].issuer : "",
+					(list.certs [i].subject != (const char *) NULL) ? list.certs [i].subject : "");
+	}
+
+	for (i = 0; (i < addedCount) && (output_format == OUTPUT_TEXT); i++)
+		fprintf (out, "  +. ADD    From %s; Issuer <%s>; Subject <%s>\n", added [i]->source, added [i]->issuer, added [i]->subject);
+
+	if ((status & (CHAIN_MISORDERED | CHAIN_INCOMPLETE)) && (output_format == OUTPUT_TEXT))
+	{
+		fprintf (out, "     Chain Order:");
+		for (i = 0; i < keptCount; i++)
+		{
+			if (numbers [i] == 0)
+				fprintf (out, " +");
+			else
+				fprintf (out, " %d", numbers [i]);
+		}
+		fprintf (out, "\n");
+	}
 
 	if (updateFile)
-		editCertFile (certfile, backupFilename, remove);
+	{
+		startTimer (&start);
+		editCertFile (editfile, backupFilename, &file, blocks, keptCount);
+		stopTimer (TIMER_EDIT, &start);
+	}
+
+	closePemFile (&file);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		processOneFile - Process One File Unless it is a BACKUP File
+ *
+ *	SYNOPSIS
+ *		void
+ *		processOneFile(
+ *			const char		*filename,			- Filename to process
+ *			FILE			*out)				- Output File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		BACKUP files are reported and ignored when more than one file is
+ *		specified (so that "*.pem" does not pick up earlier backups), and
+ *		ignored silently with --watch (which sees each backup written).
+ *		All other files are passed to deleteOneCert.
+ *-----------------------------------------------------------------------------
+ */
+
+void processOneFile (const char *filename, FILE *out)
+{
+	char						certfile [4096];
+	char						buffer [8192];
+	const char					*reportFilename;
+	struct timespec				start;
+
+	if (ignore_backups && (strstr (filename, "-BACKUP.") != (const char *) NULL))
+	{
+		fullPathname (filename, opt_path, certfile, sizeof (certfile));
+
+		if (formatListing (certfile, buffer, sizeof (buffer)))
+			reportFilename = buffer;
+		else
+			reportFilename = certfile;
+
+		if ((output_format == OUTPUT_TEXT) && ! opt_watch)
+			fprintf (out, "######## %s: Ignoring BACKUP File\n", reportFilename);
+	}
+	else
+	{
+		startTimer (&start);
+		countStat (STAT_FILES, 1);
+		deleteOneCert (filename, out);
+		stopTimer (TIMER_FILE, &start);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		rollbackRun - Restore every File Edited in a Journaled Run
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		rollbackRun(
+ *			const char		*journal)			- Journal of the Run
+ *
+ *	RETURN VALUE
+ *		true if every file was restored, false otherwise.
+ *
+ *	DESCRIPTION
+ *		Each backup is renamed back over its original and given back the
+ *		permissions of the original. The journal of a run that did not
+ *		complete (see closeJournal) lists every file that might have been
+ *		replaced, so it can be rolled back too. All restored files are
+ *		made durable at the end, once per file system.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool rollbackRun (const char *journal)
+{
+	journal_entry				*entries;
+	bool						committed;
+	bool						ok = true;
+	int							count;
+	int							i;
+
+	count = readJournal (journal, &entries, &committed);
+	if (count == -1)
+	{
+		fprintf (stderr, "%s: read (%s) failed <%s>\n", my_name, journal, strerror (errno));
+		return false;
+	}
+
+	if (! committed)
+		fprintf (stderr, "%s: %s: run did not complete, restoring the files it recorded\n", my_name, journal);
+
+	for (i = count - 1; i >= 0; i--)
+	{
+		if ((entries [i].original == (char *) NULL) || (entries [i].backup == (char *) NULL))
+		{
+			fprintf (stderr, "%s: %s: out of memory\n", my_name, journal);
+			ok = false;
+			continue;
+		}
+
+		if (rename (entries [i].backup, entries [i].original) == -1)
+		{
+			fprintf (stderr, "%s: rename (%s, %s) failed <%s>\n", my_name, entries [i].backup, entries [i].original, strerror (errno));
+			ok = false;
+			continue;
+		}
+
+		if (chmod (entries [i].original, entries [i].mode) == -1)
+			fprintf (stderr, "%s: chmod (%s) failed <%s>\n", my_name, entries [i].original, strerror (errno));
+
+		addFileSystem (entries [i].original);
+		printf ("######## %s: Restored from %s\n", entries [i].original, entries [i].backup);
+	}
+
+	if (! syncFileSystems ())
+	{
+		fprintf (stderr, "%s: syncfs failed <%s>\n", my_name, strerror (errno));
+		ok = false;
+	}
+
+	freeJournal (entries, count);
+	return ok;
 }
 
 /*-----------------------------------------------------------------------------
@@ -493,13 +1178,34 @@ int main (int argc, const char *argv[])
 	int							opt_help = 0;
 	int							opt_debug = 0;
 	int							opt_verbose = 0;
+	int							jobs;
 	const char					*opt_number = "";
-	const char					*reportFilename;
-	char						wd [4096];
-	char						certfile [4096];
-	char						command [4096];
-	char						buffer [4096];
-	FILE						*p;
+	const char					*opt_jobs = "";
+	const char					*opt_output = "text";
+	const char					*opt_list = "";
+	const char					*opt_expires_within = "";
+	const char					*opt_expired_before = "";
+	char						*end;
+	long						days;
+	time_t						limit;
+	const char					*opt_journal = "";
+	const char					*opt_rollback = "";
+	const char					*opt_pool = "";
+	const char					*opt_read_ahead = "";
+	const char					*opt_fingerprints = "";
+	const char					*opt_issuer_file = "";
+	const char					*opt_subject_file = "";
+	int							line;
+	int							opt_null = 0;
+	int							opt_stats = 0;
+	name_list					names;
+	const char					*opt_patterns = WALK_DEFAULT_PATTERNS;
+	int							opt_recursive = 0;
+	dir_watch					*watch;
+	dir_walk					*walk;
+	unsigned long				hits;
+	unsigned long				misses;
+	struct timespec				start;
 
 	typedef struct
 	{
@@ -513,15 +1219,33 @@ int main (int argc, const char *argv[])
 	{
 		{ "-?",	&opt_help,				"Display these help messages"         },
 		{ "-h",	&opt_help,				"Display these help messages"         },
+		{ "-0",	&opt_null,				"Names Read by -@ are NUL Separated"  },
+		{ "=@",	&opt_list,				"Read Filenames from File (- = stdin)"},
 		{ "-d",	&opt_debug,				"Debug Output"                        },
 		{ "-e",	&opt_expired,			"Delete Expired Certificates"         },
 		{ "-f",	&opt_force,				"Overwrite Backup"                    },
-		{ "=i",	&opt_issuer,			"Delete by Matching Issuer"           },
+		{ "+i",	&issuer_matcher,		"Delete by Matching Issuer (Repeat)"  },
+		{ "=j",	&opt_jobs,				"Number of Parallel Jobs"             },
+		{ "=m",	&opt_patterns,			"Filename Patterns for -r"            },
 		{ "=n",	&opt_number,			"Delete by Matching Certificat Number"},
+		{ "=o",	&opt_output,			"Output Format (text json ndjson csv)"},
 		{ "-p",	&opt_path,				"Display Full Pathname"               },
-		{ "=s",	&opt_subject,			"Delete by Matching Subject"          },
+		{ "-r",	&opt_recursive,			"Recursively Search Directories"      },
+		{ "+s",	&subject_matcher,		"Delete by Matching Subject (Repeat)" },
 		{ "-t",	&opt_test,				"Test Mode - Do not delete"           },
 		{ "-v",	&opt_verbose,			"Verbose Output"                      },
+		{ "=-journal",	&opt_journal,	"Record Edited Files in Journal"      },
+		{ "=-expires-within",	&opt_expires_within,	"Delete if Expiring in DAYS"          },
+		{ "=-expired-before",	&opt_expired_before,	"Delete if Expiring by DATE"          },
+		{ "=-rollback",	&opt_rollback,	"Restore Files Edited in Journal"     },
+		{ "--stats",			&opt_stats,				"Print Counters and Timers to stderr" },
+		{ "--check-chain",		&opt_check_chain,		"Fix Chain Order, Delete Extras"      },
+		{ "=-pool",				&opt_pool,				"Directory of Known Intermediates"    },
+		{ "=-issuer-file",		&opt_issuer_file,		"Issuer Patterns, One per Line"       },
+		{ "=-subject-file",		&opt_subject_file,		"Subject Patterns, One per Line"      },
+		{ "=-fingerprints",		&opt_fingerprints,		"Delete by SHA-256/SHA-1 Fingerprint" },
+		{ "--watch",			&opt_watch,				"Watch Directories, Apply to Changes" },
+		{ "=-read-ahead",		&opt_read_ahead,		"Files Read Ahead at Once (0 = Off)"  },
 	};
 	int	number_of_options = sizeof (option_list) / sizeof (option_structure);
 
@@ -530,6 +1254,17 @@ int main (int argc, const char *argv[])
 	 *-------------------------------------------------------------------------
 	 */
 
+	startTimer (&start);
+	time (&run_time);
+
+	issuer_matcher = createMatcher ();
+	subject_matcher = createMatcher ();
+	if ((issuer_matcher == (cert_matcher *) NULL) || (subject_matcher == (cert_matcher *) NULL))
+	{
+		fprintf (stderr, "createMatcher failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
 	my_name = strrchr (argv[0], '/');
 	if (my_name == (char *) NULL)
 		my_name = argv[0];
@@ -570,6 +1305,27 @@ int main (int argc, const char *argv[])
 						fprintf (stderr, "Error: required value missing for %s\n", *argv);
 				}
 			}
+			if (option_list[i].name[0] == '+')
+			{
+				if (strcmp (option_list [i].name + 1, *argv + 1) == 0)
+				{
+					if (argc > 1)
+					{
+						argv++;
+						argc--;
+						if (! addMatchPattern (*((cert_matcher **) (option_list [i].value)), *argv))
+						{
+							fprintf (stderr, "Error: invalid pattern %s <%s>\n", *argv, strerror (errno));
+							opt_help = 1;
+						}
+						argv++;
+						argc--;
+						break;
+					}
+					else
+						fprintf (stderr, "Error: required value missing for %s\n", *argv);
+				}
+			}
 		}
 		if (i == number_of_options)
 		{
@@ -579,11 +1335,14 @@ int main (int argc, const char *argv[])
 		}
 	}
 
+	if (opt_null && (*opt_list == '\0'))
+		opt_list = "-";
+
 	if (*opt_number == '\0')
 		delete_number = -1;
 	else
 	{
-		if (argc > 1)
+		if ((argc > 1) || opt_recursive || opt_watch || (*opt_list != '\0'))
 		{
 			fprintf (stderr, "%s: -n may be specified only with a single file\n", my_name);
 			opt_help = 1;
@@ -592,6 +1351,111 @@ int main (int argc, const char *argv[])
 		delete_number = (int) strtol (opt_number, (char **) NULL, 10);
 	}
 
+	if ((*opt_list != '\0') && ((argc > 0) || opt_recursive))
+	{
+		fprintf (stderr, "%s: -@ may not be combined with filenames or -r\n", my_name);
+		opt_help = 1;
+	}
+
+	if ((*opt_rollback != '\0') && ((argc > 0) || opt_recursive || (*opt_list != '\0') || (*opt_journal != '\0')))
+	{
+		fprintf (stderr, "%s: --rollback may not be combined with filenames, -r, -@, or --journal\n", my_name);
+		opt_help = 1;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	--expires-within and --expired-before both select certificates that
+	 *	expire before some time; given both, the later time is used.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (*opt_expires_within != '\0')
+	{
+		days = strtol (opt_expires_within, &end, 10);
+		if ((end == opt_expires_within) || (*end != '\0') || (days < 0))
+		{
+			fprintf (stderr, "Error: invalid number of days %s\n", opt_expires_within);
+			opt_help = 1;
+		}
+		else
+		{
+			expiry_limit = run_time + (time_t) days * 86400;
+			expiry_filter = true;
+		}
+	}
+
+	if (*opt_expired_before != '\0')
+	{
+		if (! parseDate (opt_expired_before, &limit))
+		{
+			fprintf (stderr, "Error: invalid date %s (YYYY-MM-DD[THH:MM[:SS]], GMT)\n", opt_expired_before);
+			opt_help = 1;
+		}
+		else if ((! expiry_filter) || (limit > expiry_limit))
+		{
+			expiry_limit = limit;
+			expiry_filter = true;
+		}
+	}
+
+	output_format = outputFormat (opt_output);
+	if (output_format == -1)
+	{
+		fprintf (stderr, "Error: unrecognized output format %s\n", opt_output);
+		opt_help = 1;
+	}
+
+	if ((*opt_pool != '\0') && ! opt_check_chain)
+	{
+		fprintf (stderr, "%s: --pool requires --check-chain\n", my_name);
+		opt_help = 1;
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Only what is matched and reported is decoded (the names and the
+	 *	validity), and the key identifiers for --check-chain.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_check_chain)
+		decode_fields |= CERT_FIELD_KEY_IDS;
+
+	/*-------------------------------------------------------------------------
+	 *	Patterns from -i and -s, and from files, are compiled into one
+	 *	automaton for issuers and one for subjects.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if ((*opt_issuer_file != '\0') && (loadMatchPatterns (issuer_matcher, opt_issuer_file, &line) == -1))
+	{
+		if (line == 0)
+			fprintf (stderr, "Error: open (%s) failed <%s>\n", opt_issuer_file, strerror (errno));
+		else
+			fprintf (stderr, "Error: %s, line %d: invalid pattern\n", opt_issuer_file, line);
+		opt_help = 1;
+	}
+
+	if ((*opt_subject_file != '\0') && (loadMatchPatterns (subject_matcher, opt_subject_file, &line) == -1))
+	{
+		if (line == 0)
+			fprintf (stderr, "Error: open (%s) failed <%s>\n", opt_subject_file, strerror (errno));
+		else
+			fprintf (stderr, "Error: %s, line %d: invalid pattern\n", opt_subject_file, line);
+		opt_help = 1;
+	}
+
+	if ((! compileMatcher (issuer_matcher)) || (! compileMatcher (subject_matcher)))
+	{
+		fprintf (stderr, "%s: compileMatcher failed <%s>\n", my_name, strerror (errno));
+		exit (1);
+	}
+
+	if (opt_watch && ((argc == 0) || (*opt_list != '\0') || (*opt_journal != '\0') || (*opt_rollback != '\0') || (output_format == OUTPUT_JSON)))
+	{
+		fprintf (stderr, "%s: --watch requires directories, and may not be combined with -@, --journal, --rollback, or -o json\n", my_name);
+		opt_help = 1;
+	}
+
 	if (opt_help)
 	{
 		fprintf (stderr, "usage: %s -options filename...\n", my_name);
@@ -602,6 +1466,10 @@ int main (int argc, const char *argv[])
 				fprintf (stderr, "  %s: %s [%s]\n",
 							option_list [i].name, option_list [i].help,
 							*((int *) (option_list [i].value)) ? "enabled" : "disabled");
+			else if (option_list[i].name[0] == '+')
+				fprintf (stderr, "  -%s value: %s [%d patterns]\n",
+							option_list [i].name + 1, option_list [i].help,
+							matchPatterns (*((cert_matcher **) (option_list [i].value))));
 			else
 				fprintf (stderr, "  -%s value: %s [%s]\n",
 							option_list [i].name + 1, option_list [i].help,
@@ -610,44 +1478,139 @@ int main (int argc, const char *argv[])
 		exit (1);
 	}
 
+	if (*opt_rollback != '\0')
+		exit (rollbackRun (opt_rollback) ? 0 : 1);
+
+	if ((*opt_pool != '\0') && (loadChainPool (opt_pool) == -1))
+	{
+		fprintf (stderr, "%s: loadChainPool (%s) failed <%s>\n", my_name, opt_pool, strerror (errno));
+		exit (1);
+	}
+
+	if ((*opt_fingerprints != '\0') && (loadFingerprints (opt_fingerprints, &line) == -1))
+	{
+		if (line == 0)
+			fprintf (stderr, "%s: loadFingerprints (%s) failed <%s>\n", my_name, opt_fingerprints, strerror (errno));
+		else
+			fprintf (stderr, "%s: %s, line %d: no fingerprint\n", my_name, opt_fingerprints, line);
+		exit (1);
+	}
+
 	/*-------------------------------------------------------------------------
-	 *	Process all arguments EXCEPT BACKUP files
+	 *	With --check-chain, the intermediates of every file are added to the
+	 *	pool before any file is checked, so that each chain is completed the
+	 *	same way whatever the number of jobs. The names read by -@ (and the
+	 *	files changed under --watch) are not known in advance, so those are
+	 *	completed from --pool alone.
 	 *-------------------------------------------------------------------------
 	 */
 
-	for (i = 0; i < argc; i++)
+	if (opt_check_chain && (*opt_list == '\0') && ! opt_watch)
+		loadChainFiles (argc, argv, opt_patterns, opt_recursive, keptInPool);
+
+	/*-------------------------------------------------------------------------
+	 *	With --journal, each edited file is recorded, and instead of syncing
+	 *	each file as it is written, each file system is synced at the end.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (*opt_journal != '\0')
 	{
-		if ((strstr (argv [i], "-BACKUP.") != (const char *) NULL) && (argc > 1))
+		if (! openJournal (opt_journal))
 		{
-			if (opt_path && ((*(argv [i])) != '/'))
-			{
-				getcwd (wd, sizeof (wd));
-				if (strncmp (argv [i], "./", 2) == 0)
-					sprintf (certfile, "%s/%s", wd, argv [i] + 2);
-				else
-					sprintf (certfile, "%s/%s", wd, argv [i]);
-			}
-			else
-				strcpy (certfile, argv [i]);
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, opt_journal, strerror (errno));
+			exit (1);
+		}
+		sync_each_file = false;
+	}
 
-			*buffer = '\0';
-			sprintf (command, "ls -l %s", certfile);
-			p = popen (command, "r");
-			if (p != (FILE *) NULL)
-			{
-				fgets (buffer, sizeof (buffer), p);
-				trim (buffer);
-				pclose (p);
-			}
+	/*-------------------------------------------------------------------------
+	 *	Process all arguments EXCEPT BACKUP files. Files are processed in
+	 *	parallel, but the output of each file is emitted in argument order.
+	 *	With -r, directories are walked and each file is processed as soon
+	 *	as it is found; with -@, each file is processed as soon as its name
+	 *	is read.
+	 *-------------------------------------------------------------------------
+	 */
 
-			if (*buffer == '\0')
-				reportFilename = certfile;
-			else
-				reportFilename = buffer;
+	ignore_backups = (argc > 1) || opt_recursive || (*opt_list != '\0') || opt_watch;
 
-			fprintf (stdout, "######## %s: Ignoring BACKUP File\n", reportFilename);
+	if (*opt_jobs == '\0')
+		jobs = defaultThreads ();
+	else
+		jobs = (int) strtol (opt_jobs, (char **) NULL, 10);
+
+	if (*opt_read_ahead != '\0')
+		setReadAhead ((int) strtol (opt_read_ahead, (char **) NULL, 10));
+	else
+		setReadAhead (READ_AHEAD_DEFAULT);
+
+	/*-------------------------------------------------------------------------
+	 *	With --watch, the directories are watched before they are scanned,
+	 *	so that no change made during the scan is missed; then each file
+	 *	that is written or replaced is processed again.
+	 *-------------------------------------------------------------------------
+	 */
+
+	if (opt_watch)
+	{
+		watch = startWatch (argc, argv, opt_patterns);
+		if (watch == (dir_watch *) NULL)
+		{
+			fprintf (stderr, "%s: startWatch failed <%s>\n", my_name, strerror (errno));
+			exit (1);
 		}
-		else
-			deleteOneCert (argv [i]);
+
+		outputBegin (output_format, true);
+		setvbuf (stdout, (char *) NULL, _IOLBF, 0);
+
+		walk = startWalk (argc, argv, opt_patterns, jobs);
+		processSource (nextWalk, walk, jobs, processOneFile);
+		endWalk (walk);
+
+		processSource (nextWatch, watch, jobs, processOneFile);
+		endWatch (watch);
+		exit (1);
+	}
+
+	outputBegin (output_format, true);
+
+	if (*opt_list != '\0')
+	{
+		if (strcmp (opt_list, "-") == 0)
+			names.in = stdin;
+		else if ((names.in = fopen (opt_list, "r")) == (FILE *) NULL)
+		{
+			fprintf (stderr, "%s: open (%s) failed <%s>\n", my_name, opt_list, strerror (errno));
+			exit (1);
+		}
+		names.delimiter = opt_null ? '\0' : '\n';
+
+		processSource (nextName, &names, jobs, processOneFile);
+
+		if (names.in != stdin)
+			fclose (names.in);
+	}
+	else if (opt_recursive)
+	{
+		walk = startWalk (argc, argv, opt_patterns, jobs);
+		processSource (nextWalk, walk, jobs, processOneFile);
+		endWalk (walk);
+	}
+	else
+		processFiles (argc, argv, jobs, processOneFile);
+
+	outputEnd (output_format);
+
+	if (! closeJournal ())
+		fprintf (stderr, "%s: sync (%s) failed <%s>\n", my_name, opt_journal, strerror (errno));
+
+	if (opt_debug)
+	{
+		cacheStatistics (&hits, &misses);
+		fprintf (stderr, "*** CERTIFICATE CACHE: %lu hits, %lu misses\n", hits, misses);
 	}
+
+	if (opt_stats)
+		printStats (stderr, my_name, &start);
 }
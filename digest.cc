@@ -0,0 +1,734 @@
+/*-----------------------------------------------------------------------------
+ *	digest, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define DIGEST_X86				1
+#elif defined (__aarch64__)
+#include <arm_neon.h>
+#if defined (__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#define DIGEST_ARM				1
+#if defined (__clang__)
+#define ARMV8_CRYPTO			__attribute__ ((target ("crypto")))
+#else
+#define ARMV8_CRYPTO			__attribute__ ((target ("+crypto")))
+#endif
+#endif
+
+#include "digest.h"
+
+/*-----------------------------------------------------------------------------
+ *	SHA-256 and SHA-1 (FIPS 180-4), used for certificate fingerprints. A
+ *	certificate is hashed in one call, so there is no incremental interface:
+ *	whole blocks are compressed straight from the input, and only the final
+ *	one or two padded blocks are built in a buffer.
+ *
+ *	Each hash has a portable block function, and one for the SHA extensions
+ *	of x86 processors (SHA-NI) and of ARMv8 processors, chosen when the
+ *	processor is examined (as base64 chooses its decoder).
+ *-----------------------------------------------------------------------------
+ */
+
+#define ROTR(x, n)				(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTL(x, n)				(((x) << (n)) | ((x) >> (32 - (n))))
+
+typedef void (*block_function) (uint32_t *state, const unsigned char *blocks, size_t count);
+
+static const char * const	method_names [] =
+{
+	"portable", "sha-ni", "armv8"
+};
+
+static const uint32_t		sha1_k [4] =
+{
+	0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+};
+
+static const uint32_t		sha256_k [64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		load32 - Load a Big Endian 32 Bit Word
+ *-----------------------------------------------------------------------------
+ */
+
+static inline uint32_t load32 (const unsigned char *p)
+{
+	return ((uint32_t) p [0] << 24) | ((uint32_t) p [1] << 16) | ((uint32_t) p [2] << 8) | (uint32_t) p [3];
+}
+
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha256Blocks - Compress 64 Byte Blocks with SHA-256
+ *-----------------------------------------------------------------------------
+ */
+
+static void sha256Blocks (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	uint32_t					w [64];
+	uint32_t					a, b, c, d, e, f, g, h;
+	uint32_t					t1;
+	uint32_t					t2;
+	int							i;
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		for (i = 0; i < 16; i++)
+			w [i] = load32 (blocks + i * 4);
+
+		for (i = 16; i < 64; i++)
+			w [i] = (ROTR (w [i - 2], 17) ^ ROTR (w [i - 2], 19) ^ (w [i - 2] >> 10)) + w [i - 7]
+					+ (ROTR (w [i - 15], 7) ^ ROTR (w [i - 15], 18) ^ (w [i - 15] >> 3)) + w [i - 16];
+
+		a = state [0];
+		b = state [1];
+		c = state [2];
+		d = state [3];
+		e = state [4];
+		f = state [5];
+		g = state [6];
+		h = state [7];
+
+		for (i = 0; i < 64; i++)
+		{
+			t1 = h + (ROTR (e, 6) ^ ROTR (e, 11) ^ ROTR (e, 25)) + ((e & f) ^ (~e & g)) + sha256_k [i] + w [i];
+			t2 = (ROTR (a, 2) ^ ROTR (a, 13) ^ ROTR (a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		state [0] += a;
+		state [1] += b;
+		state [2] += c;
+		state [3] += d;
+		state [4] += e;
+		state [5] += f;
+		state [6] += g;
+		state [7] += h;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha1Blocks - Compress 64 Byte Blocks with SHA-1
+ *-----------------------------------------------------------------------------
+ */
+
+static void sha1Blocks (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	uint32_t					w [80];
+	uint32_t					a, b, c, d, e;
+	uint32_t					f;
+	uint32_t					t;
+	int							i;
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		for (i = 0; i < 16; i++)
+			w [i] = load32 (blocks + i * 4);
+
+		for (i = 16; i < 80; i++)
+			w [i] = ROTL (w [i - 3] ^ w [i - 8] ^ w [i - 14] ^ w [i - 16], 1);
+
+		a = state [0];
+		b = state [1];
+		c = state [2];
+		d = state [3];
+		e = state [4];
+
+		for (i = 0; i < 80; i++)
+		{
+			if (i < 20)
+				f = (b & c) | (~b & d);
+			else if ((i < 40) || (i >= 60))
+				f = b ^ c ^ d;
+			else
+				f = (b & c) | (b & d) | (c & d);
+
+			t = ROTL (a, 5) + f + e + sha1_k [i / 20] + w [i];
+			e = d;
+			d = c;
+			c = ROTL (b, 30);
+			b = a;
+			a = t;
+		}
+
+		state [0] += a;
+		state [1] += b;
+		state [2] += c;
+		state [3] += d;
+		state [4] += e;
+	}
+}
+
+#ifdef DIGEST_X86
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha256BlocksShaNi - Compress 64 Byte Blocks with the x86 SHA Extensions
+ *
+ *	DESCRIPTION
+ *		sha256rnds2 performs two rounds on the state held as ABEF and CDGH
+ *		(rather than ABCD and EFGH), so the state is shuffled into that form
+ *		once for all the blocks, and back at the end. The message schedule
+ *		is computed four words at a time with sha256msg1 and sha256msg2.
+ *-----------------------------------------------------------------------------
+ */
+
+__attribute__ ((target ("sha,sse4.1")))
+static void sha256BlocksShaNi (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	const __m128i				mask = _mm_set_epi64x (0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i						abef;
+	__m128i						cdgh;
+	__m128i						abefSave;
+	__m128i						cdghSave;
+	__m128i						x0, x1, x2, x3;
+	__m128i						next;
+	__m128i						message;
+	__m128i						t;
+	int							i;
+
+	t = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) state), 0xb1);
+	cdgh = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) (state + 4)), 0x1b);
+	abef = _mm_alignr_epi8 (t, cdgh, 8);
+	cdgh = _mm_blend_epi16 (cdgh, t, 0xf0);
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		abefSave = abef;
+		cdghSave = cdgh;
+
+		x0 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) blocks), mask);
+		x1 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 16)), mask);
+		x2 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 32)), mask);
+		x3 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 48)), mask);
+
+		for (i = 0; i < 16; i++)
+		{
+			message = _mm_add_epi32 (x0, _mm_loadu_si128 ((const __m128i *) (sha256_k + i * 4)));
+			cdgh = _mm_sha256rnds2_epu32 (cdgh, abef, message);
+			abef = _mm_sha256rnds2_epu32 (abef, cdgh, _mm_shuffle_epi32 (message, 0x0e));
+
+			next = _mm_add_epi32 (_mm_sha256msg1_epu32 (x0, x1), _mm_alignr_epi8 (x3, x2, 4));
+			next = _mm_sha256msg2_epu32 (next, x3);
+			x0 = x1;
+			x1 = x2;
+			x2 = x3;
+			x3 = next;
+		}
+
+		abef = _mm_add_epi32 (abef, abefSave);
+		cdgh = _mm_add_epi32 (cdgh, cdghSave);
+	}
+
+	t = _mm_shuffle_epi32 (abef, 0x1b);
+	cdgh = _mm_shuffle_epi32 (cdgh, 0xb1);
+	_mm_storeu_si128 ((__m128i *) state, _mm_blend_epi16 (t, cdgh, 0xf0));
+	_mm_storeu_si128 ((__m128i *) (state + 4), _mm_alignr_epi8 (cdgh, t, 8));
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha1BlocksShaNi - Compress 64 Byte Blocks with the x86 SHA Extensions
+ *
+ *	DESCRIPTION
+ *		sha1rnds4 performs four rounds, with the function and constant of
+ *		its immediate operand (one for each 20 rounds). sha1nexte derives E
+ *		for the next four rounds from A before them, and adds it to the
+ *		next four message words.
+ *-----------------------------------------------------------------------------
+ */
+
+__attribute__ ((target ("sha,sse4.1")))
+static void sha1BlocksShaNi (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	const __m128i				mask = _mm_set_epi64x (0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i						abcd;
+	__m128i						e;
+	__m128i						abcdSave;
+	__m128i						eSave;
+	__m128i						previous;
+	__m128i						x0, x1, x2, x3;
+	__m128i						next;
+	int							i;
+
+	abcd = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) state), 0x1b);
+	e = _mm_set_epi32 ((int) state [4], 0, 0, 0);
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		abcdSave = abcd;
+		eSave = e;
+
+		x0 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) blocks), mask);
+		x1 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 16)), mask);
+		x2 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 32)), mask);
+		x3 = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (blocks + 48)), mask);
+
+		e = _mm_add_epi32 (e, x0);
+		for (i = 0; i < 20; i++)
+		{
+			if (i > 0)
+				e = _mm_sha1nexte_epu32 (previous, x0);
+
+			previous = abcd;
+			if (i < 5)
+				abcd = _mm_sha1rnds4_epu32 (abcd, e, 0);
+			else if (i < 10)
+				abcd = _mm_sha1rnds4_epu32 (abcd, e, 1);
+			else if (i < 15)
+				abcd = _mm_sha1rnds4_epu32 (abcd, e, 2);
+			else
+				abcd = _mm_sha1rnds4_epu32 (abcd, e, 3);
+
+			next = _mm_sha1msg2_epu32 (_mm_xor_si128 (_mm_sha1msg1_epu32 (x0, x1), x2), x3);
+			x0 = x1;
+			x1 = x2;
+			x2 = x3;
+			x3 = next;
+		}
+
+		e = _mm_sha1nexte_epu32 (previous, eSave);
+		abcd = _mm_add_epi32 (abcd, abcdSave);
+	}
+
+	_mm_storeu_si128 ((__m128i *) state, _mm_shuffle_epi32 (abcd, 0x1b));
+	state [4] = (uint32_t) _mm_extract_epi32 (e, 3);
+}
+
+#endif
+
+#ifdef DIGEST_ARM
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha256BlocksArmv8 - Compress 64 Byte Blocks with the ARMv8 Crypto
+ *		Extensions
+ *
+ *	DESCRIPTION
+ *		sha256h and sha256h2 perform four rounds on ABCD and EFGH, and
+ *		sha256su0 and sha256su1 compute the next four message words.
+ *-----------------------------------------------------------------------------
+ */
+
+ARMV8_CRYPTO
+static void sha256BlocksArmv8 (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	uint32x4_t					abcd = vld1q_u32 (state);
+	uint32x4_t					efgh = vld1q_u32 (state + 4);
+	uint32x4_t					abcdSave;
+	uint32x4_t					efghSave;
+	uint32x4_t					x0, x1, x2, x3;
+	uint32x4_t					next;
+	uint32x4_t					message;
+	uint32x4_t					t;
+	int							i;
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		abcdSave = abcd;
+		efghSave = efgh;
+
+		x0 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks)));
+		x1 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 16)));
+		x2 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 32)));
+		x3 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 48)));
+
+		for (i = 0; i < 16; i++)
+		{
+			message = vaddq_u32 (x0, vld1q_u32 (sha256_k + i * 4));
+			t = abcd;
+			abcd = vsha256hq_u32 (abcd, efgh, message);
+			efgh = vsha256h2q_u32 (efgh, t, message);
+
+			next = vsha256su1q_u32 (vsha256su0q_u32 (x0, x1), x2, x3);
+			x0 = x1;
+			x1 = x2;
+			x2 = x3;
+			x3 = next;
+		}
+
+		abcd = vaddq_u32 (abcd, abcdSave);
+		efgh = vaddq_u32 (efgh, efghSave);
+	}
+
+	vst1q_u32 (state, abcd);
+	vst1q_u32 (state + 4, efgh);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha1BlocksArmv8 - Compress 64 Byte Blocks with the ARMv8 Crypto
+ *		Extensions
+ *
+ *	DESCRIPTION
+ *		sha1c, sha1p, and sha1m perform four rounds with each function, and
+ *		sha1h derives E for the next four rounds from A before them.
+ *-----------------------------------------------------------------------------
+ */
+
+ARMV8_CRYPTO
+static void sha1BlocksArmv8 (uint32_t *state, const unsigned char *blocks, size_t count)
+{
+	uint32x4_t					abcd = vld1q_u32 (state);
+	uint32_t					e = state [4];
+	uint32x4_t					abcdSave;
+	uint32_t					eSave;
+	uint32_t					nextE;
+	uint32x4_t					x0, x1, x2, x3;
+	uint32x4_t					next;
+	uint32x4_t					message;
+	int							i;
+
+	for (; count > 0; count--, blocks += 64)
+	{
+		abcdSave = abcd;
+		eSave = e;
+
+		x0 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks)));
+		x1 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 16)));
+		x2 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 32)));
+		x3 = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (blocks + 48)));
+
+		for (i = 0; i < 20; i++)
+		{
+			message = vaddq_u32 (x0, vdupq_n_u32 (sha1_k [i / 5]));
+			nextE = vsha1h_u32 (vgetq_lane_u32 (abcd, 0));
+			if (i < 5)
+				abcd = vsha1cq_u32 (abcd, e, message);
+			else if ((i < 10) || (i >= 15))
+				abcd = vsha1pq_u32 (abcd, e, message);
+			else
+				abcd = vsha1mq_u32 (abcd, e, message);
+			e = nextE;
+
+			next = vsha1su1q_u32 (vsha1su0q_u32 (x0, x1, x2), x3);
+			x0 = x1;
+			x1 = x2;
+			x2 = x3;
+			x3 = next;
+		}
+
+		abcd = vaddq_u32 (abcd, abcdSave);
+		e += eSave;
+	}
+
+	vst1q_u32 (state, abcd);
+	state [4] = e;
+}
+
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashBlocks - Hash a Message with a Block Function
+ *
+ *	SYNOPSIS
+ *		static void
+ *		hashBlocks(
+ *			block_function	blocks,				- sha256Blocks, sha1Blocks, ...
+ *			uint32_t		*state,				- Initial State (updated)
+ *			int				words,				- Words of State in Digest
+ *			const unsigned char	*data,			- Message
+ *			size_t			length,				- Length of Message
+ *			unsigned char	*digest)			- Digest (words * 4 bytes)
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Both hashes pad the same way: 0x80, zeros, and the length in bits
+ *		as a big endian 64 bit number, to a multiple of 64 bytes. The block
+ *		function is called once for the whole blocks of the message, and
+ *		once for the padded blocks, so the vector functions load and store
+ *		the state only twice per message.
+ *-----------------------------------------------------------------------------
+ */
+
+static void hashBlocks (block_function blocks, uint32_t *state, int words, const unsigned char *data, size_t length, unsigned char *digest)
+{
+	unsigned char				last [128];
+	uint64_t					bits = (uint64_t) length * 8;
+	size_t						full = length & ~(size_t) 63;
+	size_t						rest = length - full;
+	size_t						padded;
+	int							j;
+
+	if (full > 0)
+		(*blocks) (state, data, full / 64);
+
+	memset (last, 0, sizeof (last));
+	memcpy (last, data + full, rest);
+	last [rest] = 0x80;
+	padded = (rest < 56) ? 64 : 128;
+	for (j = 0; j < 8; j++)
+		last [padded - 1 - j] = (unsigned char) (bits >> (j * 8));
+
+	(*blocks) (state, last, padded / 64);
+
+	for (j = 0; j < words; j++)
+	{
+		digest [j * 4] = (unsigned char) (state [j] >> 24);
+		digest [j * 4 + 1] = (unsigned char) (state [j] >> 16);
+		digest [j * 4 + 2] = (unsigned char) (state [j] >> 8);
+		digest [j * 4 + 3] = (unsigned char) state [j];
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha256DigestWith - SHA-256 of a Message with a Given Method
+ *
+ *	SYNOPSIS
+ *		void
+ *		sha256DigestWith(
+ *			int				method,				- DIGEST_PORTABLE, ...
+ *			const void		*data,				- Message
+ *			size_t			length,				- Length of Message
+ *			unsigned char	*digest)			- SHA256_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		The method must be supported by this processor (DIGEST_PORTABLE, or
+ *		digestMethod ()). A method for another architecture is portable.
+ *-----------------------------------------------------------------------------
+ */
+
+void sha256DigestWith (int method, const void *data, size_t length, unsigned char *digest)
+{
+	block_function				blocks = sha256Blocks;
+	uint32_t					state [8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+#ifdef DIGEST_X86
+	if (method == DIGEST_SHA_NI)
+		blocks = sha256BlocksShaNi;
+#endif
+#ifdef DIGEST_ARM
+	if (method == DIGEST_ARMV8)
+		blocks = sha256BlocksArmv8;
+#endif
+
+	hashBlocks (blocks, state, 8, (const unsigned char *) data, length, digest);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha1DigestWith - SHA-1 of a Message with a Given Method
+ *
+ *	SYNOPSIS
+ *		void
+ *		sha1DigestWith(
+ *			int				method,				- DIGEST_PORTABLE, ...
+ *			const void		*data,				- Message
+ *			size_t			length,				- Length of Message
+ *			unsigned char	*digest)			- SHA1_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void sha1DigestWith (int method, const void *data, size_t length, unsigned char *digest)
+{
+	block_function				blocks = sha1Blocks;
+	uint32_t					state [5] =
+	{
+		0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+	};
+
+#ifdef DIGEST_X86
+	if (method == DIGEST_SHA_NI)
+		blocks = sha1BlocksShaNi;
+#endif
+#ifdef DIGEST_ARM
+	if (method == DIGEST_ARMV8)
+		blocks = sha1BlocksArmv8;
+#endif
+
+	hashBlocks (blocks, state, 5, (const unsigned char *) data, length, digest);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		digestMethod - Best Digest Method for this Processor
+ *
+ *	SYNOPSIS
+ *		int
+ *		digestMethod(void)
+ *
+ *	RETURN VALUE
+ *		DIGEST_SHA_NI, DIGEST_ARMV8, or DIGEST_PORTABLE.
+ *
+ *	DESCRIPTION
+ *		The processor is examined once. Both hashes are accelerated together,
+ *		so a method is chosen only if the processor has both (as every
+ *		processor with either does in practice).
+ *-----------------------------------------------------------------------------
+ */
+
+static int detectMethod (void)
+{
+#ifdef DIGEST_X86
+	unsigned int				eax, ebx, ecx, edx;
+
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("sse4.1") && __get_cpuid_count (7, 0, &eax, &ebx, &ecx, &edx)
+	  && ((ebx & (1U << 29)) != 0))
+		return DIGEST_SHA_NI;
+#endif
+#ifdef DIGEST_ARM
+#if defined (__APPLE__)
+	return DIGEST_ARMV8;
+#elif defined (__linux__)
+	unsigned long				hwcap = getauxval (AT_HWCAP);
+
+	if (((hwcap & HWCAP_SHA1) != 0) && ((hwcap & HWCAP_SHA2) != 0))
+		return DIGEST_ARMV8;
+#endif
+#endif
+	return DIGEST_PORTABLE;
+}
+
+int digestMethod (void)
+{
+	static const int			method = detectMethod ();
+
+	return method;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		digestMethodName - Name of a Digest Method
+ *
+ *	SYNOPSIS
+ *		const char *
+ *		digestMethodName(
+ *			int				method)				- DIGEST_PORTABLE, ...
+ *
+ *	RETURN VALUE
+ *		"portable", "sha-ni", or "armv8" ("unknown" if out of range).
+ *-----------------------------------------------------------------------------
+ */
+
+const char *digestMethodName (int method)
+{
+	if ((method < 0) || (method >= (int) (sizeof (method_names) / sizeof (method_names [0]))))
+		return "unknown";
+
+	return method_names [method];
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha256Digest - SHA-256 of a Message
+ *
+ *	SYNOPSIS
+ *		void
+ *		sha256Digest(
+ *			const void		*data,				- Message
+ *			size_t			length,				- Length of Message
+ *			unsigned char	*digest)			- SHA256_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void sha256Digest (const void *data, size_t length, unsigned char *digest)
+{
+	sha256DigestWith (digestMethod (), data, length, digest);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sha1Digest - SHA-1 of a Message
+ *
+ *	SYNOPSIS
+ *		void
+ *		sha1Digest(
+ *			const void		*data,				- Message
+ *			size_t			length,				- Length of Message
+ *			unsigned char	*digest)			- SHA1_LENGTH Bytes
+ *
+ *	RETURN VALUE
+ *		None
+ *-----------------------------------------------------------------------------
+ */
+
+void sha1Digest (const void *data, size_t length, unsigned char *digest)
+{
+	sha1DigestWith (digestMethod (), data, length, digest);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		formatDigest - Format a Digest as a Fingerprint
+ *
+ *	SYNOPSIS
+ *		void
+ *		formatDigest(
+ *			const unsigned char	*digest,		- Digest
+ *			size_t			length,				- Length of Digest
+ *			char			*buffer,			- Output Buffer (length * 3)
+ *			size_t			size)				- Size of Output Buffer
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		As openssl x509 -fingerprint does: upper case hex bytes separated
+ *		by colons.
+ *-----------------------------------------------------------------------------
+ */
+
+void formatDigest (const unsigned char *digest, size_t length, char *buffer, size_t size)
+{
+	static const char			hex [] = "0123456789ABCDEF";
+	size_t						i;
+
+	for (i = 0; (i < length) && (i * 3 + 3 <= size); i++)
+	{
+		buffer [i * 3] = hex [digest [i] >> 4];
+		buffer [i * 3 + 1] = hex [digest [i] & 0x0f];
+		buffer [i * 3 + 2] = ':';
+	}
+
+	if (i > 0)
+		buffer [i * 3 - 1] = '\0';
+	else if (size > 0)
+		*buffer = '\0';
+}
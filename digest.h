@@ -0,0 +1,27 @@
+/*-----------------------------------------------------------------------------
+ *	digest, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <stddef.h>
+
+#define SHA256_LENGTH			32
+#define SHA1_LENGTH				20
+
+#define DIGEST_PORTABLE			0
+#define DIGEST_SHA_NI			1
+#define DIGEST_ARMV8			2
+
+void sha256Digest (const void *data, size_t length, unsigned char *digest);
+void sha1Digest (const void *data, size_t length, unsigned char *digest);
+void sha256DigestWith (int method, const void *data, size_t length, unsigned char *digest);
+void sha1DigestWith (int method, const void *data, size_t length, unsigned char *digest);
+int digestMethod (void);
+const char *digestMethodName (int method);
+void formatDigest (const unsigned char *digest, size_t length, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,647 @@
+/*-----------------------------------------------------------------------------
+ *	dirWalk, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "dirWalk.h"
+
+/*-----------------------------------------------------------------------------
+ *	Directories are read concurrently, but their files are taken by nextWalk
+ *	in a fixed order (depth first, each directory's files before its
+ *	subdirectories, both in name order), so the output is the same whatever
+ *	the number of walkers. Each directory is a node of the part of the tree
+ *	not yet taken; once read, it holds its files and its subdirectories.
+ *
+ *	When PENDING_FILES files have been read but not taken, the walkers wait
+ *	(unless nextWalk is waiting for a directory not yet read), so a huge tree
+ *	never has to be held in memory.
+ *-----------------------------------------------------------------------------
+ */
+
+#define PENDING_FILES			4096
+
+typedef struct walk_node
+{
+	struct walk_node		*next;				/* Next sibling */
+	struct walk_node		*parent;
+	struct walk_node		*children;			/* First subdirectory */
+	struct walk_node		*unread;			/* Next directory to read */
+	char					*path;
+	char					**files;
+	size_t					fileCount;
+	size_t					fileNext;			/* Next file to take */
+	bool					read;
+}
+walk_node;
+
+typedef struct
+{
+	char					**paths;
+	size_t					count;
+	size_t					size;
+}
+path_list;
+
+struct dir_walk
+{
+	pthread_mutex_t			mutex;
+	pthread_cond_t			cond;
+	walk_node				*unread;			/* Directories not yet read */
+	int						busy;				/* Walkers reading a directory */
+	walk_node				*cursor;			/* Directory files are taken from */
+	size_t					pending;			/* Files read but not taken */
+	bool					waiting;			/* nextWalk waiting for cursor */
+	char					**rootFiles;		/* Non-directory roots */
+	int						rootCount;
+	int						rootNext;
+	char					*patternBuffer;
+	const char				**patterns;
+	int						patternCount;
+	pthread_t				*tids;
+	int						threads;
+};
+
+#if defined(__linux__)
+struct linux_dirent64
+{
+	uint64_t				d_ino;
+	int64_t					d_off;
+	unsigned short			d_reclen;
+	unsigned char			d_type;
+	char					d_name [1];
+};
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addPath - Add a Path to a List
+ *
+ *	SYNOPSIS
+ *		static void
+ *		addPath(
+ *			path_list		*list,				- List to Extend
+ *			const char		*dir,				- Directory
+ *			const char		*name)				- Name within Directory
+ *
+ *	RETURN VALUE
+ *		None (exits if memory is exhausted).
+ *-----------------------------------------------------------------------------
+ */
+
+static void addPath (path_list *list, const char *dir, const char *name)
+{
+	size_t						dirLength = strlen (dir);
+	size_t						nameLength = strlen (name);
+	char						**paths;
+	char						*path;
+
+	if (list->count == list->size)
+	{
+		list->size = (list->size == 0) ? 64 : list->size * 2;
+		paths = (char **) realloc (list->paths, list->size * sizeof (char *));
+		if (paths == (char **) NULL)
+		{
+			fprintf (stderr, "realloc failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+		list->paths = paths;
+	}
+
+	path = (char *) malloc (dirLength + nameLength + 2);
+	if (path == (char *) NULL)
+	{
+		fprintf (stderr, "malloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	memcpy (path, dir, dirLength);
+	if ((dirLength > 0) && (dir [dirLength - 1] != '/'))
+		path [dirLength++] = '/';
+	memcpy (path + dirLength, name, nameLength + 1);
+
+	list->paths [list->count++] = path;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		comparePaths - Order Paths by Name
+ *-----------------------------------------------------------------------------
+ */
+
+static int comparePaths (const void *a, const void *b)
+{
+	return strcmp (*(const char * const *) a, *(const char * const *) b);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addEntry - Classify one Directory Entry
+ *
+ *	SYNOPSIS
+ *		static void
+ *		addEntry(
+ *			const dir_walk	*walk,				- Walk in Progress
+ *			int				fd,					- Directory
+ *			const char		*path,				- Path of Directory
+ *			const char		*name,				- Name of Entry
+ *			unsigned char	type,				- DT_DIR, DT_REG, ...
+ *			path_list		*dirs,				- Subdirectories Found
+ *			path_list		*files)				- Matching Files Found
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Subdirectories are always descended. Regular files and symbolic
+ *		links (Let's Encrypt's live/ directory holds only links) are kept
+ *		if their name matches any pattern. Symbolic links to directories are
+ *		not followed, so the walk cannot loop.
+ *-----------------------------------------------------------------------------
+ */
+
+static void addEntry (const dir_walk *walk, int fd, const char *path, const char *name, unsigned char type, path_list *dirs, path_list *files)
+{
+	struct stat					st;
+	int							i;
+
+	if ((strcmp (name, ".") == 0) || (strcmp (name, "..") == 0))
+		return;
+
+	if (type == DT_UNKNOWN)
+	{
+		if (fstatat (fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+			return;
+
+		if (S_ISDIR (st.st_mode))
+			type = DT_DIR;
+		else if (S_ISREG (st.st_mode))
+			type = DT_REG;
+		else if (S_ISLNK (st.st_mode))
+			type = DT_LNK;
+	}
+
+	if (type == DT_DIR)
+	{
+		addPath (dirs, path, name);
+		return;
+	}
+
+	if ((type != DT_REG) && (type != DT_LNK))
+		return;
+
+	for (i = 0; i < walk->patternCount; i++)
+	{
+		if (fnmatch (walk->patterns [i], name, 0) == 0)
+		{
+			addPath (files, path, name);
+			return;
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readDirectory - Read one Directory
+ *
+ *	SYNOPSIS
+ *		static void
+ *		readDirectory(
+ *			const dir_walk	*walk,				- Walk in Progress
+ *			const char		*path,				- Directory to Read
+ *			path_list		*dirs,				- Subdirectories Found
+ *			path_list		*files)				- Matching Files Found
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		On Linux, entries are read with getdents64 directly into a large
+ *		buffer, which takes far fewer system calls than readdir, and the
+ *		entry type usually avoids a stat per entry.
+ *-----------------------------------------------------------------------------
+ */
+
+static void readDirectory (const dir_walk *walk, const char *path, path_list *dirs, path_list *files)
+{
+	int							fd;
+
+	fd = openat (AT_FDCWD, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		fprintf (stderr, "open (%s) failed <%s>\n", path, strerror (errno));
+		return;
+	}
+
+#if defined(__linux__)
+	char						buffer [32768];
+	struct linux_dirent64		*entry;
+	long						n;
+	long						offset;
+
+	while ((n = syscall (SYS_getdents64, fd, buffer, sizeof (buffer))) > 0)
+	{
+		for (offset = 0; offset < n; offset += entry->d_reclen)
+		{
+			entry = (struct linux_dirent64 *) (buffer + offset);
+			addEntry (walk, fd, path, entry->d_name, entry->d_type, dirs, files);
+		}
+	}
+
+	if (n == -1)
+		fprintf (stderr, "getdents64 (%s) failed <%s>\n", path, strerror (errno));
+
+	close (fd);
+#else
+	DIR							*dir;
+	struct dirent				*entry;
+
+	dir = fdopendir (fd);
+	if (dir == (DIR *) NULL)
+	{
+		fprintf (stderr, "fdopendir (%s) failed <%s>\n", path, strerror (errno));
+		close (fd);
+		return;
+	}
+
+	while ((entry = readdir (dir)) != (struct dirent *) NULL)
+		addEntry (walk, dirfd (dir), path, entry->d_name, entry->d_type, dirs, files);
+
+	closedir (dir);
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		newNode - Allocate a Directory Node
+ *
+ *	SYNOPSIS
+ *		static walk_node *
+ *		newNode(
+ *			char			*path,				- Path of Directory (taken)
+ *			walk_node		*parent)			- Parent, NULL for a root
+ *
+ *	RETURN VALUE
+ *		The node (exits if memory is exhausted).
+ *-----------------------------------------------------------------------------
+ */
+
+static walk_node *newNode (char *path, walk_node *parent)
+{
+	walk_node					*node;
+
+	node = (walk_node *) calloc (1, sizeof (walk_node));
+	if ((node == (walk_node *) NULL) || (path == (char *) NULL))
+	{
+		fprintf (stderr, "malloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	node->path = path;
+	node->parent = parent;
+	return node;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		walker - Walker Thread
+ *
+ *	SYNOPSIS
+ *		static void *
+ *		walker(
+ *			void			*arg)				- Walk in Progress
+ *
+ *	RETURN VALUE
+ *		NULL
+ *
+ *	DESCRIPTION
+ *		Each walker repeatedly takes a directory from the stack, reads it
+ *		without holding the lock, then records its matching files and
+ *		subdirectories (in name order) in its node, and pushes the
+ *		subdirectories. The walk is finished when the stack is empty and no
+ *		walker is reading a directory.
+ *
+ *		Directories are read in whatever order the walkers take them, but
+ *		nextWalk takes the files in a fixed depth first order.
+ *-----------------------------------------------------------------------------
+ */
+
+static void *walker (void *arg)
+{
+	dir_walk					*walk = (dir_walk *) arg;
+	walk_node					*dir;
+	walk_node					*subdir;
+	walk_node					*first;
+	walk_node					**last;
+	path_list					dirs;
+	path_list					files;
+	size_t						i;
+
+	memset (&dirs, 0, sizeof (dirs));
+	memset (&files, 0, sizeof (files));
+
+	pthread_mutex_lock (&walk->mutex);
+
+	for (;;)
+	{
+		while (((walk->unread == (walk_node *) NULL) && (walk->busy > 0))
+		  || ((walk->unread != (walk_node *) NULL) && (walk->pending >= PENDING_FILES) && ! walk->waiting))
+			pthread_cond_wait (&walk->cond, &walk->mutex);
+
+		if (walk->unread == (walk_node *) NULL)
+			break;
+
+		dir = walk->unread;
+		walk->unread = dir->unread;
+		walk->busy++;
+		pthread_mutex_unlock (&walk->mutex);
+
+		dirs.count = 0;
+		files.count = 0;
+		readDirectory (walk, dir->path, &dirs, &files);
+		if (dirs.count > 1)
+			qsort (dirs.paths, dirs.count, sizeof (char *), comparePaths);
+		if (files.count > 1)
+			qsort (files.paths, files.count, sizeof (char *), comparePaths);
+
+		first = (walk_node *) NULL;
+		last = &first;
+		for (i = 0; i < dirs.count; i++)
+		{
+			subdir = newNode (dirs.paths [i], dir);
+			*last = subdir;
+			last = &subdir->next;
+		}
+
+		if (files.count > 0)
+		{
+			dir->files = (char **) malloc (files.count * sizeof (char *));
+			if (dir->files == (char **) NULL)
+			{
+				fprintf (stderr, "malloc failed <%s>\n", strerror (errno));
+				exit (1);
+			}
+			memcpy (dir->files, files.paths, files.count * sizeof (char *));
+		}
+
+		pthread_mutex_lock (&walk->mutex);
+
+		dir->children = first;
+		dir->fileCount = files.count;
+		dir->read = true;
+		walk->pending += files.count;
+
+		for (subdir = first; subdir != (walk_node *) NULL; subdir = subdir->next)
+			subdir->unread = (subdir->next == (walk_node *) NULL) ? walk->unread : subdir->next;
+		if (first != (walk_node *) NULL)
+			walk->unread = first;
+
+		walk->busy--;
+		pthread_cond_broadcast (&walk->cond);
+	}
+
+	pthread_cond_broadcast (&walk->cond);
+	pthread_mutex_unlock (&walk->mutex);
+
+	free (dirs.paths);
+	free (files.paths);
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		startWalk - Start Walking Directory Trees
+ *
+ *	SYNOPSIS
+ *		dir_walk *
+ *		startWalk(
+ *			int				count,				- Number of Roots
+ *			const char		**roots,			- Directories (or Files)
+ *			const char		*patterns,			- Comma Separated Patterns
+ *			int				threads)			- Number of Walker Threads
+ *
+ *	RETURN VALUE
+ *		Walk in progress, to be passed to nextWalk and endWalk.
+ *
+ *	DESCRIPTION
+ *		Each root that is a directory is walked recursively, finding files
+ *		whose names match any of the patterns (as in the shell, so "*.pem"
+ *		or "fullchain.pem"). Any other root is returned as is, whatever its
+ *		name, so that files and directories may be mixed.
+ *-----------------------------------------------------------------------------
+ */
+
+dir_walk *startWalk (int count, const char **roots, const char *patterns, int threads)
+{
+	dir_walk					*walk;
+	walk_node					*dir;
+	walk_node					**last;
+	struct stat					st;
+	char						*p;
+	int							i;
+
+	walk = (dir_walk *) calloc (1, sizeof (dir_walk));
+	if (walk != (dir_walk *) NULL)
+	{
+		walk->patternBuffer = strdup (patterns);
+		walk->patterns = (const char **) calloc (strlen (patterns) + 1, sizeof (const char *));
+		walk->rootFiles = (char **) calloc (count + 1, sizeof (char *));
+		walk->tids = (pthread_t *) calloc ((threads < 1) ? 1 : threads, sizeof (pthread_t));
+	}
+
+	if ((walk == (dir_walk *) NULL) || (walk->patternBuffer == (char *) NULL) || (walk->patterns == (const char **) NULL)
+	  || (walk->rootFiles == (char **) NULL) || (walk->tids == (pthread_t *) NULL))
+	{
+		fprintf (stderr, "calloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	for (p = strtok (walk->patternBuffer, ","); p != (char *) NULL; p = strtok ((char *) NULL, ","))
+		walk->patterns [walk->patternCount++] = p;
+
+	last = &walk->cursor;
+	for (i = 0; i < count; i++)
+	{
+		if ((stat (roots [i], &st) == 0) && S_ISDIR (st.st_mode))
+		{
+			dir = newNode (strdup (roots [i]), (walk_node *) NULL);
+			*last = dir;
+			last = &dir->next;
+		}
+	}
+
+	for (dir = walk->cursor; dir != (walk_node *) NULL; dir = dir->next)
+		dir->unread = dir->next;
+	walk->unread = walk->cursor;
+
+	for (i = 0; i < count; i++)
+	{
+		if ((stat (roots [i], &st) == -1) || ! S_ISDIR (st.st_mode))
+		{
+			if ((walk->rootFiles [walk->rootCount++] = strdup (roots [i])) == (char *) NULL)
+			{
+				fprintf (stderr, "strdup failed <%s>\n", strerror (errno));
+				exit (1);
+			}
+		}
+	}
+
+	pthread_mutex_init (&walk->mutex, NULL);
+	pthread_cond_init (&walk->cond, NULL);
+
+	walk->threads = (threads < 1) ? 1 : threads;
+	for (i = 0; i < walk->threads; i++)
+	{
+		if (pthread_create (&walk->tids [i], NULL, walker, walk) != 0)
+		{
+			fprintf (stderr, "pthread_create failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+	}
+
+	return walk;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		advance - Move Past a Directory whose Files have all been Taken
+ *
+ *	SYNOPSIS
+ *		static walk_node *
+ *		advance(
+ *			walk_node		*node)				- Directory (read)
+ *
+ *	RETURN VALUE
+ *		The next directory in depth first order, or NULL at the end.
+ *
+ *	DESCRIPTION
+ *		A directory is released once it has no subdirectories left to take,
+ *		so only the path from the root to the cursor (and the siblings along
+ *		it) is kept.
+ *-----------------------------------------------------------------------------
+ */
+
+static walk_node *advance (walk_node *node)
+{
+	walk_node					*next;
+	walk_node					*parent;
+
+	free (node->files);
+	node->files = (char **) NULL;
+	if (node->children != (walk_node *) NULL)
+		return node->children;
+
+	for (;;)
+	{
+		next = node->next;
+		parent = node->parent;
+		free (node->path);
+		free (node);
+
+		if (next != (walk_node *) NULL)
+			return next;
+		if (parent == (walk_node *) NULL)
+			return (walk_node *) NULL;
+		node = parent;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextWalk - Next File Found
+ *
+ *	SYNOPSIS
+ *		char *
+ *		nextWalk(
+ *			void			*walk)				- Walk in Progress
+ *
+ *	RETURN VALUE
+ *		Path of the next file (to be freed by the caller), or NULL when the
+ *		walk is finished. Suitable as a work_source for processSource.
+ *-----------------------------------------------------------------------------
+ */
+
+char *nextWalk (void *arg)
+{
+	dir_walk					*walk = (dir_walk *) arg;
+	char						*path;
+
+	if (walk->rootNext < walk->rootCount)
+		return walk->rootFiles [walk->rootNext++];
+
+	pthread_mutex_lock (&walk->mutex);
+
+	path = (char *) NULL;
+	while (walk->cursor != (walk_node *) NULL)
+	{
+		if (! walk->cursor->read)
+		{
+			walk->waiting = true;
+			pthread_cond_broadcast (&walk->cond);
+			while (! walk->cursor->read)
+				pthread_cond_wait (&walk->cond, &walk->mutex);
+			walk->waiting = false;
+		}
+
+		if (walk->cursor->fileNext < walk->cursor->fileCount)
+		{
+			path = walk->cursor->files [walk->cursor->fileNext++];
+			if (walk->pending-- == PENDING_FILES)
+				pthread_cond_broadcast (&walk->cond);
+			break;
+		}
+
+		walk->cursor = advance (walk->cursor);
+	}
+
+	pthread_mutex_unlock (&walk->mutex);
+	return path;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		endWalk - Finish a Walk
+ *
+ *	SYNOPSIS
+ *		void
+ *		endWalk(
+ *			dir_walk		*walk)				- Walk in Progress
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Must be called only after nextWalk has returned NULL.
+ *-----------------------------------------------------------------------------
+ */
+
+void endWalk (dir_walk *walk)
+{
+	int							i;
+
+	for (i = 0; i < walk->threads; i++)
+		pthread_join (walk->tids [i], NULL);
+
+	pthread_cond_destroy (&walk->cond);
+	pthread_mutex_destroy (&walk->mutex);
+	free (walk->patternBuffer);
+	free (walk->patterns);
+	free (walk->rootFiles);
+	free (walk->tids);
+	free (walk);
+}
@@ -0,0 +1,18 @@
+/*-----------------------------------------------------------------------------
+ *	dirWalk, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef DIRWALK_H
+#define DIRWALK_H
+
+#define WALK_DEFAULT_PATTERNS	"*.pem"
+
+typedef struct dir_walk dir_walk;
+
+dir_walk *startWalk (int count, const char **roots, const char *patterns, int threads);
+char *nextWalk (void *walk);
+void endWalk (dir_walk *walk);
+
+#endif
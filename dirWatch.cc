@@ -0,0 +1,529 @@
+/*-----------------------------------------------------------------------------
+ *	dirWatch, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+#include "dirWatch.h"
+
+/*-----------------------------------------------------------------------------
+ *	Every directory under the roots is watched with inotify. A file whose
+ *	name matches a pattern is reported when it is closed after writing,
+ *	renamed into place (as certbot replaces the links in live/), created
+ *	as a symbolic link, or removed. Directories created later are watched
+ *	as they appear, and the files already in them are reported.
+ *
+ *	nextWatch blocks in read, so a watch costs no CPU between events.
+ *-----------------------------------------------------------------------------
+ */
+
+#define WATCH_FILE_EVENTS		(IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+#define WATCH_EVENTS			(WATCH_FILE_EVENTS | IN_ONLYDIR)
+#define SUMMARY_BUCKETS			1024
+
+typedef struct
+{
+	char					**paths;
+	size_t					count;
+	size_t					size;
+}
+path_list;
+
+struct dir_watch
+{
+	int						fd;					/* inotify */
+	char					**dirs;				/* Indexed by watch descriptor */
+	int						dirCount;
+	path_list				pending;			/* Found, not yet returned */
+	size_t					pendingNext;
+	char					buffer [65536];		/* Events read */
+	ssize_t					length;
+	ssize_t					offset;
+	char					*patternBuffer;
+	const char				**patterns;
+	int						patternCount;
+};
+
+/*-----------------------------------------------------------------------------
+ *	The summary of each file last processed, so that a file rewritten with
+ *	the same contents (or reported twice for one change) is not reported
+ *	again.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct summary_entry
+{
+	struct summary_entry	*next;
+	char					*filename;
+	uint64_t				summary;
+}
+summary_entry;
+
+static pthread_mutex_t		summary_mutex = PTHREAD_MUTEX_INITIALIZER;
+static summary_entry		*summaries [SUMMARY_BUCKETS];
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		hashBytes - FNV-1a Hash
+ *-----------------------------------------------------------------------------
+ */
+
+static uint64_t hashBytes (const char *data, size_t length)
+{
+	const unsigned char			*p = (const unsigned char *) data;
+	uint64_t					h = 0xcbf29ce484222325ULL;
+
+	while (length-- > 0)
+	{
+		h ^= *p++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		addPath - Add a Path to a List
+ *-----------------------------------------------------------------------------
+ */
+
+static void addPath (path_list *list, const char *dir, const char *name)
+{
+	char						**paths;
+	char						*path;
+
+	if (list->count == list->size)
+	{
+		list->size = (list->size == 0) ? 64 : list->size * 2;
+		paths = (char **) realloc (list->paths, list->size * sizeof (char *));
+		if (paths == (char **) NULL)
+		{
+			fprintf (stderr, "realloc failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+		list->paths = paths;
+	}
+
+	path = (char *) malloc (strlen (dir) + strlen (name) + 2);
+	if (path == (char *) NULL)
+	{
+		fprintf (stderr, "malloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+	sprintf (path, "%s/%s", dir, name);
+	list->paths [list->count++] = path;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		matchName - Does a Filename Match any Pattern?
+ *-----------------------------------------------------------------------------
+ */
+
+static bool matchName (const dir_watch *watch, const char *name)
+{
+	int							i;
+
+	for (i = 0; i < watch->patternCount; i++)
+	{
+		if (fnmatch (watch->patterns [i], name, 0) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+#if defined(__linux__)
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		watchTree - Watch a Directory and all Directories Below it
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		watchTree(
+ *			dir_watch		*watch,				- Watch
+ *			const char		*path,				- Directory
+ *			bool			report)				- Report Files Found
+ *
+ *	RETURN VALUE
+ *		true if the directory is watched.
+ *
+ *	DESCRIPTION
+ *		With report, the matching files already in a new directory are
+ *		added to the pending list, since they were created (or moved in)
+ *		before it was watched. Symbolic links to directories are not
+ *		followed, so the watch cannot loop.
+ *-----------------------------------------------------------------------------
+ */
+
+static bool watchTree (dir_watch *watch, const char *path, bool report)
+{
+	DIR							*dir;
+	struct dirent				*entry;
+	struct stat					st;
+	path_list					subdirs;
+	char						**dirs;
+	int							wd;
+	int							size;
+	size_t						i;
+
+	wd = inotify_add_watch (watch->fd, path, WATCH_EVENTS);
+	if (wd == -1)
+	{
+		fprintf (stderr, "inotify_add_watch (%s) failed <%s>\n", path, strerror (errno));
+		return false;
+	}
+
+	if (wd >= watch->dirCount)
+	{
+		for (size = (watch->dirCount == 0) ? 64 : watch->dirCount; size <= wd; size *= 2)
+			;
+		dirs = (char **) realloc (watch->dirs, size * sizeof (char *));
+		if (dirs == (char **) NULL)
+		{
+			fprintf (stderr, "realloc failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+		memset (dirs + watch->dirCount, 0, (size - watch->dirCount) * sizeof (char *));
+		watch->dirs = dirs;
+		watch->dirCount = size;
+	}
+	free (watch->dirs [wd]);
+	watch->dirs [wd] = strdup (path);
+
+	dir = opendir (path);
+	if (dir == (DIR *) NULL)
+		return true;
+
+	memset (&subdirs, 0, sizeof (subdirs));
+	while ((entry = readdir (dir)) != (struct dirent *) NULL)
+	{
+		if ((strcmp (entry->d_name, ".") == 0) || (strcmp (entry->d_name, "..") == 0))
+			continue;
+
+		if (fstatat (dirfd (dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == -1)
+			continue;
+
+		if (S_ISDIR (st.st_mode))
+			addPath (&subdirs, path, entry->d_name);
+		else if (report && (S_ISREG (st.st_mode) || S_ISLNK (st.st_mode)) && matchName (watch, entry->d_name))
+			addPath (&watch->pending, path, entry->d_name);
+	}
+	closedir (dir);
+
+	for (i = 0; i < subdirs.count; i++)
+	{
+		watchTree (watch, subdirs.paths [i], report);
+		free (subdirs.paths [i]);
+	}
+	free (subdirs.paths);
+
+	return true;
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		startWatch - Start Watching Directory Trees
+ *
+ *	SYNOPSIS
+ *		dir_watch *
+ *		startWatch(
+ *			int				count,				- Number of Roots
+ *			const char		**roots,			- Directories to Watch
+ *			const char		*patterns)			- Comma Separated Patterns
+ *
+ *	RETURN VALUE
+ *		Watch, to be passed to nextWatch and endWatch, or NULL (with errno
+ *		set) if a root is not a directory or cannot be watched. Watching
+ *		requires inotify, so elsewhere than Linux errno is ENOSYS.
+ *
+ *	DESCRIPTION
+ *		Files already present are not reported; the caller scans them
+ *		first (after starting the watch, so that no change is missed).
+ *-----------------------------------------------------------------------------
+ */
+
+dir_watch *startWatch (int count, const char **roots, const char *patterns)
+{
+#if defined(__linux__)
+	dir_watch					*watch;
+	struct stat					st;
+	char						*p;
+	int							i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (stat (roots [i], &st) == -1)
+			return (dir_watch *) NULL;
+
+		if (! S_ISDIR (st.st_mode))
+		{
+			errno = ENOTDIR;
+			return (dir_watch *) NULL;
+		}
+	}
+
+	watch = (dir_watch *) calloc (1, sizeof (dir_watch));
+	if (watch == (dir_watch *) NULL)
+		return watch;
+
+	watch->patternBuffer = strdup (patterns);
+	watch->patterns = (const char **) calloc (strlen (patterns) + 1, sizeof (const char *));
+	watch->fd = inotify_init1 (IN_CLOEXEC);
+	if ((watch->patternBuffer == (char *) NULL) || (watch->patterns == (const char **) NULL) || (watch->fd == -1))
+	{
+		endWatch (watch);
+		return (dir_watch *) NULL;
+	}
+
+	for (p = strtok (watch->patternBuffer, ","); p != (char *) NULL; p = strtok ((char *) NULL, ","))
+		watch->patterns [watch->patternCount++] = p;
+
+	for (i = 0; i < count; i++)
+	{
+		if (! watchTree (watch, roots [i], false))
+		{
+			endWatch (watch);
+			return (dir_watch *) NULL;
+		}
+	}
+
+	return watch;
+#else
+	errno = ENOSYS;
+	return (dir_watch *) NULL;
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextWatch - Wait for the Next File to Change
+ *
+ *	SYNOPSIS
+ *		char *
+ *		nextWatch(
+ *			void			*watch)				- Watch
+ *
+ *	RETURN VALUE
+ *		Path of a file that was written, replaced, or removed (to be freed
+ *		by the caller), or NULL if the watch failed. Suitable as a
+ *		work_source for processSource, for which it never ends.
+ *-----------------------------------------------------------------------------
+ */
+
+char *nextWatch (void *arg)
+{
+#if defined(__linux__)
+	dir_watch					*watch = (dir_watch *) arg;
+	struct inotify_event		*event;
+	struct stat					st;
+	char						path [4096];
+
+	for (;;)
+	{
+		if (watch->pendingNext < watch->pending.count)
+			return watch->pending.paths [watch->pendingNext++];
+
+		watch->pending.count = 0;
+		watch->pendingNext = 0;
+
+		if (watch->offset >= watch->length)
+		{
+			watch->length = read (watch->fd, watch->buffer, sizeof (watch->buffer));
+			watch->offset = 0;
+			if ((watch->length == -1) && (errno == EINTR))
+				continue;
+			if (watch->length <= 0)
+			{
+				fprintf (stderr, "read (inotify) failed <%s>\n", strerror (errno));
+				return (char *) NULL;
+			}
+		}
+
+		event = (struct inotify_event *) (watch->buffer + watch->offset);
+		watch->offset += sizeof (struct inotify_event) + event->len;
+
+		if (event->mask & IN_Q_OVERFLOW)
+			fprintf (stderr, "inotify: events lost (queue overflow)\n");
+
+		if ((event->wd < 0) || (event->wd >= watch->dirCount) || (watch->dirs [event->wd] == (char *) NULL))
+			continue;
+
+		if (event->mask & IN_IGNORED)
+		{
+			free (watch->dirs [event->wd]);
+			watch->dirs [event->wd] = (char *) NULL;
+			continue;
+		}
+
+		if (event->len == 0)
+			continue;
+
+		snprintf (path, sizeof (path), "%s/%s", watch->dirs [event->wd], event->name);
+
+		if (event->mask & IN_ISDIR)
+		{
+			if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				watchTree (watch, path, true);
+			continue;
+		}
+
+		if (! matchName (watch, event->name))
+			continue;
+
+		/*---------------------------------------------------------------------
+		 *	A regular file being created is reported once it is closed.
+		 *---------------------------------------------------------------------
+		 */
+
+		if ((event->mask & IN_CREATE) && ((lstat (path, &st) == -1) || ! S_ISLNK (st.st_mode)))
+			continue;
+
+		return strdup (path);
+	}
+#else
+	return (char *) NULL;
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		endWatch - Stop Watching
+ *-----------------------------------------------------------------------------
+ */
+
+void endWatch (dir_watch *watch)
+{
+	int							i;
+	size_t						j;
+
+	if (watch->fd > 0)
+		close (watch->fd);
+
+	for (i = 0; i < watch->dirCount; i++)
+		free (watch->dirs [i]);
+
+	for (j = watch->pendingNext; j < watch->pending.count; j++)
+		free (watch->pending.paths [j]);
+
+	free (watch->dirs);
+	free (watch->pending.paths);
+	free (watch->patternBuffer);
+	free (watch->patterns);
+	free (watch);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		fileSummary - Summarize the Contents of a File
+ *-----------------------------------------------------------------------------
+ */
+
+uint64_t fileSummary (const char *data, size_t length)
+{
+	return hashBytes (data, length);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		changedSummary - Record the Summary of a File, if it Changed
+ *
+ *	SYNOPSIS
+ *		bool
+ *		changedSummary(
+ *			const char		*filename,			- File
+ *			uint64_t		summary)			- From fileSummary
+ *
+ *	RETURN VALUE
+ *		true if the file is new, or its summary differs from the last one
+ *		recorded. May be called by several threads at once.
+ *-----------------------------------------------------------------------------
+ */
+
+bool changedSummary (const char *filename, uint64_t summary)
+{
+	summary_entry				**bucket;
+	summary_entry				*entry;
+	bool						changed = true;
+
+	bucket = &summaries [hashBytes (filename, strlen (filename)) % SUMMARY_BUCKETS];
+
+	pthread_mutex_lock (&summary_mutex);
+	for (entry = *bucket; entry != (summary_entry *) NULL; entry = entry->next)
+	{
+		if (strcmp (entry->filename, filename) == 0)
+			break;
+	}
+
+	if (entry != (summary_entry *) NULL)
+	{
+		changed = (entry->summary != summary);
+		entry->summary = summary;
+	}
+	else
+	{
+		entry = (summary_entry *) malloc (sizeof (summary_entry));
+		if ((entry != (summary_entry *) NULL) && ((entry->filename = strdup (filename)) != (char *) NULL))
+		{
+			entry->summary = summary;
+			entry->next = *bucket;
+			*bucket = entry;
+		}
+		else
+			free (entry);
+	}
+	pthread_mutex_unlock (&summary_mutex);
+
+	return changed;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		forgetSummary - Forget a File that has been Removed
+ *
+ *	RETURN VALUE
+ *		true if the file had a summary (so its removal is news).
+ *-----------------------------------------------------------------------------
+ */
+
+bool forgetSummary (const char *filename)
+{
+	summary_entry				**link;
+	summary_entry				*entry;
+
+	link = &summaries [hashBytes (filename, strlen (filename)) % SUMMARY_BUCKETS];
+
+	pthread_mutex_lock (&summary_mutex);
+	for (entry = *link; entry != (summary_entry *) NULL; link = &entry->next, entry = entry->next)
+	{
+		if (strcmp (entry->filename, filename) == 0)
+		{
+			*link = entry->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock (&summary_mutex);
+
+	if (entry == (summary_entry *) NULL)
+		return false;
+
+	free (entry->filename);
+	free (entry);
+	return true;
+}
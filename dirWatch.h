@@ -0,0 +1,22 @@
+/*-----------------------------------------------------------------------------
+ *	dirWatch, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef DIRWATCH_H
+#define DIRWATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct dir_watch dir_watch;
+
+dir_watch *startWatch (int count, const char **roots, const char *patterns);
+char *nextWatch (void *watch);
+void endWatch (dir_watch *watch);
+uint64_t fileSummary (const char *data, size_t length);
+bool changedSummary (const char *filename, uint64_t summary);
+bool forgetSummary (const char *filename);
+
+#endif
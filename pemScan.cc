@@ -0,0 +1,336 @@
+/*-----------------------------------------------------------------------------
+ *	pemScan, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "base64.h"
+#include "pemScan.h"
+#include "readAhead.h"
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		openPemFile - Open a PEM File and Load its Contents
+ *
+ *	SYNOPSIS
+ *		bool
+ *		openPemFile(
+ *			const char		*filename,			- File to Open
+ *			pem_file		*file)				- Contents of File
+ *
+ *	RETURN VALUE
+ *		true if the file was loaded, false (with errno set) otherwise.
+ *
+ *	DESCRIPTION
+ *		The file descriptor is kept open (so that callers may fstat or fchmod
+ *		it) until closePemFile is called. If the file has already been read
+ *		ahead (see readAhead), that is used instead.
+ *-----------------------------------------------------------------------------
+ */
+
+bool openPemFile (const char *filename, pem_file *file)
+{
+	struct stat					st;
+	char						*buffer;
+	void						*map;
+	size_t						total = 0;
+	ssize_t						n;
+	int							saved;
+
+	if (takeReadAhead (filename, file))
+	{
+		if ((file->fd == -1) || (file->length > 0))
+			return (file->fd != -1);
+	}
+	else
+	{
+		file->data = (const char *) NULL;
+		file->length = 0;
+		file->mapped = false;
+
+		file->fd = open (filename, O_RDONLY);
+		if (file->fd == -1)
+			return false;
+	}
+
+	if (fstat (file->fd, &st) == -1)
+	{
+		saved = errno;
+		close (file->fd);
+		errno = saved;
+		return false;
+	}
+
+	if (st.st_size == 0)
+		return true;
+
+	if (st.st_size >= PEM_MAP_THRESHOLD)
+	{
+		map = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+		if (map != MAP_FAILED)
+		{
+			file->data = (const char *) map;
+			file->length = (size_t) st.st_size;
+			file->mapped = true;
+			return true;
+		}
+	}
+
+	buffer = (char *) malloc ((size_t) st.st_size);
+	if (buffer == (char *) NULL)
+	{
+		close (file->fd);
+		errno = ENOMEM;
+		return false;
+	}
+
+	while (total < (size_t) st.st_size)
+	{
+		n = read (file->fd, buffer + total, (size_t) st.st_size - total);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+				continue;
+
+			saved = errno;
+			free (buffer);
+			close (file->fd);
+			errno = saved;
+			return false;
+		}
+		if (n == 0)
+			break;
+		total += (size_t) n;
+	}
+
+	file->data = buffer;
+	file->length = total;
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		closePemFile - Release a PEM File
+ *
+ *	SYNOPSIS
+ *		void
+ *		closePemFile(
+ *			pem_file		*file)				- File to Release
+ *
+ *	RETURN VALUE
+ *		None.
+ *-----------------------------------------------------------------------------
+ */
+
+void closePemFile (pem_file *file)
+{
+	if (file->mapped)
+		munmap ((void *) file->data, file->length);
+	else
+		free ((void *) file->data);
+
+	close (file->fd);
+
+	file->data = (const char *) NULL;
+	file->length = 0;
+	file->fd = -1;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		findMarker - Find a Marker Line
+ *
+ *	SYNOPSIS
+ *		static const char *
+ *		findMarker(
+ *			const char		*start,				- Start of File
+ *			const char		*p,					- Start of Search
+ *			const char		*end,				- End of File
+ *			const char		*marker,			- Marker to Find
+ *			size_t			length)				- Length of Marker
+ *
+ *	RETURN VALUE
+ *		Pointer to the marker, or NULL if not found.
+ *
+ *	DESCRIPTION
+ *		A marker must start a line, and may be followed only by trailing
+ *		whitespace. Candidates are located with memchr, which the C library
+ *		vectorizes, so the Base64 body (which never contains '-') is skipped
+ *		a vector at a time; a rejected candidate skips to the next line.
+ *-----------------------------------------------------------------------------
+ */
+
+static const char *findMarker (const char *start, const char *p, const char *end, const char *marker, size_t length)
+{
+	const char					*q;
+	const char					*r;
+
+	while ((p < end) && ((q = (const char *) memchr (p, '-', end - p)) != (const char *) NULL))
+	{
+		if (((q == start) || (q [-1] == '\n'))
+		  && ((size_t) (end - q) >= length) && (memcmp (q, marker, length) == 0))
+		{
+			for (r = q + length; (r < end) && ((*r == ' ') || (*r == '\t') || (*r == '\r') || (*r == '\f')); r++)
+				;
+
+			if ((r == end) || (*r == '\n'))
+				return q;
+		}
+
+		p = (const char *) memchr (q, '\n', end - q);
+		if (p == (const char *) NULL)
+			break;
+		p++;
+	}
+
+	return (const char *) NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		findPemBlock - Find the Next Certificate in a File
+ *
+ *	SYNOPSIS
+ *		const char *
+ *		findPemBlock(
+ *			const pem_file	*file,				- Contents of File
+ *			const char		*p,					- Start of Search
+ *			pem_block		*block)				- Certificate Found
+ *
+ *	RETURN VALUE
+ *		Where to continue searching, or NULL if there are no more
+ *		certificates.
+ *-----------------------------------------------------------------------------
+ */
+
+const char *findPemBlock (const pem_file *file, const char *p, pem_block *block)
+{
+	const char					*start = file->data;
+	const char					*end = file->data + file->length;
+	const char					*q;
+
+	block->begin = findMarker (start, p, end, PEM_BEGIN_CERTIFICATE, sizeof (PEM_BEGIN_CERTIFICATE) - 1);
+	if (block->begin == (const char *) NULL)
+		return (const char *) NULL;
+
+	q = (const char *) memchr (block->begin, '\n', end - block->begin);
+	block->body = (q == (const char *) NULL) ? end : q + 1;
+
+	block->bodyEnd = findMarker (start, block->body, end, PEM_END_CERTIFICATE, sizeof (PEM_END_CERTIFICATE) - 1);
+	if (block->bodyEnd == (const char *) NULL)
+	{
+		block->bodyEnd = end;
+		block->end = end;
+	}
+	else
+	{
+		q = (const char *) memchr (block->bodyEnd, '\n', end - block->bodyEnd);
+		block->end = (q == (const char *) NULL) ? end : q + 1;
+	}
+
+	return block->end;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		countPemBlocks - Count the Certificates in a File
+ *
+ *	SYNOPSIS
+ *		int
+ *		countPemBlocks(
+ *			const pem_file	*file)				- Contents of File
+ *
+ *	RETURN VALUE
+ *		Number of certificates that readPemFile will find in the file.
+ *
+ *	DESCRIPTION
+ *		Only the BEGIN and END lines are located; nothing is decoded. This
+ *		lets a caller size its storage before calling readPemFile.
+ *-----------------------------------------------------------------------------
+ */
+
+int countPemBlocks (const pem_file *file)
+{
+	pem_block					block;
+	const char					*p = file->data;
+	int							count = 0;
+
+	while ((p != (const char *) NULL) && ((p = findPemBlock (file, p, &block)) != (const char *) NULL))
+		count++;
+
+	return count;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		readPemFile - Decode all Certificates in a PEM File
+ *
+ *	SYNOPSIS
+ *		int
+ *		readPemFile(
+ *			const pem_file	*file,				- Contents of File
+ *			pem_callback	callback,			- Called for each Certificate
+ *			void			*context)			- Passed to callback
+ *
+ *	RETURN VALUE
+ *		Number of certificates in the file, or -1 if memory is exhausted.
+ *
+ *	DESCRIPTION
+ *		This function decodes the Base64 body of each certificate to DER and
+ *		passes it, with the byte ranges of the certificate, to the callback.
+ *		Anything outside of the BEGIN and END lines is ignored.
+ *-----------------------------------------------------------------------------
+ */
+
+int readPemFile (const pem_file *file, pem_callback callback, void *context)
+{
+	pem_block					block;
+	const char					*p = file->data;
+	unsigned char				*der = (unsigned char *) NULL;
+	unsigned char				*newDer;
+	size_t						derSize = 0;
+	size_t						derLength;
+	size_t						bodyLength;
+	int							count = 0;
+
+	while ((p != (const char *) NULL) && ((p = findPemBlock (file, p, &block)) != (const char *) NULL))
+	{
+		count++;
+
+		if (block.end == block.bodyEnd)
+		{
+			(*callback) (context, count, &block, (const unsigned char *) NULL, 0);
+			continue;
+		}
+
+		bodyLength = block.bodyEnd - block.body;
+		if ((bodyLength * 3) / 4 + 3 > derSize)
+		{
+			derSize = (bodyLength * 3) / 4 + 3;
+			newDer = (unsigned char *) realloc (der, derSize);
+			if (newDer == (unsigned char *) NULL)
+			{
+				count = -1;
+				break;
+			}
+			der = newDer;
+		}
+
+		if (decodeBase64 (block.body, bodyLength, der, &derLength))
+			(*callback) (context, count, &block, der, derLength);
+		else
+			(*callback) (context, count, &block, (const unsigned char *) NULL, 0);
+	}
+
+	free (der);
+	return count;
+}
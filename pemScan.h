@@ -0,0 +1,67 @@
+/*-----------------------------------------------------------------------------
+ *	pemScan, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef PEMSCAN_H
+#define PEMSCAN_H
+
+#include <stddef.h>
+
+#define PEM_BEGIN_CERTIFICATE	"-----BEGIN CERTIFICATE-----"
+#define PEM_END_CERTIFICATE		"-----END CERTIFICATE-----"
+
+/*-----------------------------------------------------------------------------
+ *	Files smaller than this are read in one shot; larger files are mapped.
+ *	(For a typical 3-6 KB fullchain.pem, read is cheaper than mmap/munmap.)
+ *-----------------------------------------------------------------------------
+ */
+
+#define PEM_MAP_THRESHOLD		(64 * 1024)
+
+/*-----------------------------------------------------------------------------
+ *	Contents of one file, either mapped or read in one shot.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	int						fd;
+	const char				*data;
+	size_t					length;
+	bool					mapped;
+}
+pem_file;
+
+/*-----------------------------------------------------------------------------
+ *	Byte ranges of one certificate within a file, including the line
+ *	terminator of the END line. If there is no END line, bodyEnd and end
+ *	are both the end of the file.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				*begin;				/* BEGIN line */
+	const char				*body;				/* Base64 body */
+	const char				*bodyEnd;			/* END line */
+	const char				*end;				/* Just past END line */
+}
+pem_block;
+
+/*-----------------------------------------------------------------------------
+ *	Called for each certificate in a PEM file. der is NULL if the certificate
+ *	could not be decoded (invalid Base64, or no END line).
+ *-----------------------------------------------------------------------------
+ */
+
+typedef void (*pem_callback) (void *context, int count, const pem_block *block, const unsigned char *der, size_t length);
+
+bool openPemFile (const char *filename, pem_file *file);
+void closePemFile (pem_file *file);
+const char *findPemBlock (const pem_file *file, const char *p, pem_block *block);
+int countPemBlocks (const pem_file *file);
+int readPemFile (const pem_file *file, pem_callback callback, void *context);
+
+#endif
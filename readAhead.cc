@@ -0,0 +1,1077 @@
+/*-----------------------------------------------------------------------------
+ *	readAhead, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#include "readAhead.h"
+
+/*-----------------------------------------------------------------------------
+ *	A fleet is mostly small files, so scanning one is mostly waiting for
+ *	open, stat, and read, one file at a time. Instead, a feeder thread takes
+ *	names from the source as fast as it supplies them, and up to depth files
+ *	are opened and read at once, ahead of the workers. Each worker is then
+ *	handed the next name (in source order) once its file has been read, and
+ *	openPemFile takes the contents instead of reading the file again.
+ *
+ *	With io_uring (Linux 5.6 and later), one reaper thread submits openat
+ *	and read for every file in batches, and keeps all of them in flight.
+ *	Otherwise (or if io_uring is not permitted), a pool of reader threads
+ *	opens and reads them with blocking calls.
+ *
+ *	A file may be named more than once (a symbolic link in live/ and its
+ *	target in archive/), and deleteCert may rewrite it under one name after
+ *	it was read ahead under another. So the device and inode of each file
+ *	are kept as it is finished, and a file read ahead before another file
+ *	with the same device and inode was finished is read again, just as it
+ *	would be without read ahead.
+ *
+ *	Each file read ahead is open until it is processed, so depth is kept
+ *	below the limit on open files (ulimit -n). If opening a file still
+ *	fails for want of descriptors, fewer files are read ahead from then on,
+ *	and the worker opens that one itself.
+ *-----------------------------------------------------------------------------
+ */
+
+#if defined(IORING_FEAT_RW_CUR_POS)
+#define USE_IO_URING
+#endif
+
+#define READ_AHEAD_MAX			4096
+#define READER_THREADS			32				/* Without io_uring */
+#define SPARE_FILES				64				/* Left for everything else */
+
+#define SLOT_FREE				0
+#define SLOT_QUEUED				1				/* Named, not yet started */
+#define SLOT_BUSY				2				/* Being opened and read */
+#define SLOT_DONE				3				/* Ready to be handed out */
+#define SLOT_HANDED				4				/* Being processed */
+
+typedef struct
+{
+	bool					any;				/* Matches every file */
+	bool					known;				/* dev and ino are set */
+	dev_t					dev;
+	ino_t					ino;
+}
+file_identity;
+
+typedef struct
+{
+	read_ahead				*owner;
+	char					*filename;			/* NULL if free */
+	int						state;
+	bool					taken;				/* by takeReadAhead */
+	bool					stale;				/* Opened again by the worker */
+	pem_file				file;				/* fd is -1 if it failed */
+	int						error;				/* errno if it failed */
+	file_identity			identity;
+	size_t					opened;				/* Files finished before open */
+#if defined(USE_IO_URING)
+	int						step;				/* Request in flight */
+#endif
+}
+ahead_slot;
+
+#if defined(USE_IO_URING)
+#define STEP_OPEN				0
+#define STEP_READ				1
+
+#define READ_SIZE				(16 * 1024)		/* Read by the ring */
+
+#define WAKE_DATA				(~(uint64_t) 0)	/* user_data of eventfd read */
+
+typedef struct
+{
+	int						fd;
+	int						event;				/* eventfd that wakes the reaper */
+	uint64_t				eventCount;			/* Read from event */
+	void					*sqRing;
+	size_t					sqRingSize;
+	void					*cqRing;
+	size_t					cqRingSize;
+	struct io_uring_sqe		*sqes;
+	size_t					sqesSize;
+	unsigned				*sqTail;
+	unsigned				*sqMask;
+	unsigned				*sqArray;
+	unsigned				*cqHead;
+	unsigned				*cqTail;
+	unsigned				*cqMask;
+	struct io_uring_cqe		*cqes;
+	unsigned				toSubmit;			/* Queued, not yet submitted */
+	int						inFlight;			/* Requests for files */
+	bool					waiting;			/* Reaper waits for completions */
+}
+uring;
+#endif
+
+struct read_ahead
+{
+	work_source				source;
+	void					*context;
+	pthread_mutex_t			mutex;
+	pthread_cond_t			ready;				/* Next file read, or no more */
+	pthread_cond_t			space;				/* Fewer than depth waiting */
+	pthread_cond_t			queued;				/* A file named, or no more */
+	ahead_slot				*slots;				/* depth + threads */
+	size_t					slotCount;
+	file_identity			*finished;			/* Last slotCount finished */
+	size_t					finishCount;
+	size_t					*order;				/* Slot of each file % depth */
+	size_t					depth;
+	size_t					limit;				/* Files read ahead, <= depth */
+	size_t					tail;				/* Next file to be named */
+	size_t					started;			/* Next file to be read */
+	size_t					head;				/* Next file to be handed out */
+	bool					exhausted;			/* source returned NULL */
+	pthread_t				feeder;
+	pthread_t				*engines;			/* Reaper, or readers */
+	int						engineCount;
+#if defined(USE_IO_URING)
+	bool					useRing;
+	uring					ring;
+#endif
+};
+
+/*-----------------------------------------------------------------------------
+ *	The slot handed to each worker thread by nextReadAhead.
+ *-----------------------------------------------------------------------------
+ */
+
+static pthread_key_t		current_key;
+static pthread_once_t		current_once = PTHREAD_ONCE_INIT;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		createCurrentKey - Create the Key of the Current Slot
+ *-----------------------------------------------------------------------------
+ */
+
+static void createCurrentKey (void)
+{
+	pthread_key_create (&current_key, NULL);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		releaseSlot - Free a Slot for the Next File (Mutex Held)
+ *-----------------------------------------------------------------------------
+ */
+
+static void releaseSlot (read_ahead *ahead, ahead_slot *slot)
+{
+	file_identity				*finished;
+
+	if (slot->state == SLOT_HANDED)
+	{
+		finished = &ahead->finished [ahead->finishCount++ % ahead->slotCount];
+		*finished = slot->identity;
+		finished->any = slot->stale;
+	}
+
+	if ((! slot->taken) && (slot->file.fd != -1))
+		closePemFile (&slot->file);
+
+	free (slot->filename);
+	slot->filename = (char *) NULL;
+	slot->state = SLOT_FREE;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		finishSlot - Mark a File as Read (Mutex Held)
+ *
+ *	DESCRIPTION
+ *		Workers only wait for the next file to be handed out, so they are
+ *		woken only when that one is read.
+ *-----------------------------------------------------------------------------
+ */
+
+static void finishSlot (read_ahead *ahead, ahead_slot *slot)
+{
+	slot->state = SLOT_DONE;
+	if (&ahead->slots [ahead->order [ahead->head % ahead->depth]] == slot)
+		pthread_cond_broadcast (&ahead->ready);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		shrinkLimit - Read Fewer Files Ahead after EMFILE (Mutex Held)
+ *
+ *	DESCRIPTION
+ *		Something else (another thread, or a library) is holding more
+ *		descriptors than SPARE_FILES allowed for, so only half of the files
+ *		now waiting are kept open from then on.
+ *-----------------------------------------------------------------------------
+ */
+
+static void shrinkLimit (read_ahead *ahead, int error)
+{
+	size_t						keep = (ahead->tail - ahead->head) / 2;
+
+	if ((error != EMFILE) && (error != ENFILE))
+		return;
+
+	if (keep < 1)
+		keep = 1;
+	if (ahead->limit > keep)
+		ahead->limit = keep;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		sameFile - Are two Identities the Same File?
+ *-----------------------------------------------------------------------------
+ */
+
+static bool sameFile (const file_identity *a, const file_identity *b)
+{
+	return a->any || b->any || (a->known && b->known && (a->dev == b->dev) && (a->ino == b->ino));
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		staleSlot - Might a File have Changed since it was Read? (Mutex Held)
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		staleSlot(
+ *			const read_ahead	*ahead,			- Read Ahead
+ *			const ahead_slot	*slot)			- File Read Ahead
+ *
+ *	RETURN VALUE
+ *		true if the same file was finished after this one was opened, or
+ *		is being processed now (under another name).
+ *-----------------------------------------------------------------------------
+ */
+
+static bool staleSlot (const read_ahead *ahead, const ahead_slot *slot)
+{
+	size_t						i;
+
+	if (ahead->finishCount - slot->opened > ahead->slotCount)
+		return true;
+
+	for (i = slot->opened; i < ahead->finishCount; i++)
+	{
+		if (sameFile (&ahead->finished [i % ahead->slotCount], &slot->identity))
+			return true;
+	}
+
+	for (i = 0; i < ahead->slotCount; i++)
+	{
+		if ((&ahead->slots [i] != slot) && (ahead->slots [i].state == SLOT_HANDED)
+				&& (ahead->slots [i].stale || sameFile (&ahead->slots [i].identity, &slot->identity)))
+			return true;
+	}
+
+	return false;
+}
+
+#if defined(USE_IO_URING)
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		closeRing - Release an io_uring
+ *-----------------------------------------------------------------------------
+ */
+
+static void closeRing (uring *ring)
+{
+	if (ring->sqes != (struct io_uring_sqe *) NULL)
+		munmap (ring->sqes, ring->sqesSize);
+	if ((ring->cqRing != (void *) NULL) && (ring->cqRing != ring->sqRing))
+		munmap (ring->cqRing, ring->cqRingSize);
+	if (ring->sqRing != (void *) NULL)
+		munmap (ring->sqRing, ring->sqRingSize);
+	if (ring->event != -1)
+		close (ring->event);
+	if (ring->fd != -1)
+		close (ring->fd);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		mapRing - Map Part of an io_uring
+ *-----------------------------------------------------------------------------
+ */
+
+static void *mapRing (int fd, size_t size, off_t offset)
+{
+	void						*map;
+
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+	return (map == MAP_FAILED) ? (void *) NULL : map;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		setupRing - Create an io_uring
+ *
+ *	SYNOPSIS
+ *		static bool
+ *		setupRing(
+ *			uring			*ring,				- Ring to Create
+ *			unsigned		entries)			- Requests in Flight
+ *
+ *	RETURN VALUE
+ *		true if the ring is ready, false (with errno set) if io_uring is not
+ *		available: not built into the kernel, older than Linux 5.6 (no
+ *		openat or read), or not permitted (kernel.io_uring_disabled, or a
+ *		seccomp filter in a container).
+ *-----------------------------------------------------------------------------
+ */
+
+static bool setupRing (uring *ring, unsigned entries)
+{
+	struct io_uring_params		params;
+	unsigned char				*sq;
+	unsigned char				*cq;
+	int							saved;
+
+	memset (ring, 0, sizeof (uring));
+	ring->event = -1;
+
+	memset (&params, 0, sizeof (params));
+	ring->fd = (int) syscall (__NR_io_uring_setup, entries, &params);
+	if (ring->fd == -1)
+		return false;
+
+	if ((params.features & IORING_FEAT_RW_CUR_POS) == 0)
+	{
+		closeRing (ring);
+		errno = ENOSYS;
+		return false;
+	}
+
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) && (ring->cqRingSize > ring->sqRingSize))
+		ring->sqRingSize = ring->cqRingSize;
+	ring->sqesSize = params.sq_entries * sizeof (struct io_uring_sqe);
+
+	ring->sqRing = mapRing (ring->fd, ring->sqRingSize, IORING_OFF_SQ_RING);
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cqRing = ring->sqRing;
+	else
+		ring->cqRing = mapRing (ring->fd, ring->cqRingSize, IORING_OFF_CQ_RING);
+	ring->sqes = (struct io_uring_sqe *) mapRing (ring->fd, ring->sqesSize, IORING_OFF_SQES);
+	ring->event = eventfd (0, EFD_CLOEXEC);
+
+	if ((ring->sqRing == (void *) NULL) || (ring->cqRing == (void *) NULL)
+			|| (ring->sqes == (struct io_uring_sqe *) NULL) || (ring->event == -1))
+	{
+		saved = errno;
+		closeRing (ring);
+		errno = saved;
+		return false;
+	}
+
+	sq = (unsigned char *) ring->sqRing;
+	cq = (unsigned char *) ring->cqRing;
+	ring->sqTail = (unsigned *) (sq + params.sq_off.tail);
+	ring->sqMask = (unsigned *) (sq + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+	ring->cqHead = (unsigned *) (cq + params.cq_off.head);
+	ring->cqTail = (unsigned *) (cq + params.cq_off.tail);
+	ring->cqMask = (unsigned *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		queueRequest - Queue a Request for the Next Submission
+ *
+ *	SYNOPSIS
+ *		static struct io_uring_sqe *
+ *		queueRequest(
+ *			uring			*ring,				- Ring
+ *			int				opcode,				- IORING_OP_...
+ *			int				fd,					- File Descriptor
+ *			uint64_t		data)				- Slot Number (or WAKE_DATA)
+ *
+ *	RETURN VALUE
+ *		The request, to be completed by the caller.
+ *
+ *	DESCRIPTION
+ *		The ring has more entries than there are slots, and each slot has
+ *		at most one request in flight, so there is always room.
+ *-----------------------------------------------------------------------------
+ */
+
+static struct io_uring_sqe *queueRequest (uring *ring, int opcode, int fd, uint64_t data)
+{
+	struct io_uring_sqe			*sqe;
+	unsigned					tail = *ring->sqTail;
+	unsigned					index = tail & *ring->sqMask;
+
+	sqe = &ring->sqes [index];
+	memset (sqe, 0, sizeof (struct io_uring_sqe));
+	sqe->opcode = (uint8_t) opcode;
+	sqe->fd = fd;
+	sqe->user_data = data;
+
+	ring->sqArray [index] = index;
+	__atomic_store_n (ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+	ring->toSubmit++;
+	if (data != WAKE_DATA)
+		ring->inFlight++;
+
+	return sqe;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		queueRead - Queue a Read of the Beginning of a File
+ *-----------------------------------------------------------------------------
+ */
+
+static void queueRead (uring *ring, ahead_slot *slot, size_t index)
+{
+	struct io_uring_sqe			*sqe;
+
+	slot->step = STEP_READ;
+	sqe = queueRequest (ring, IORING_OP_READ, slot->file.fd, index);
+	sqe->addr = (uint64_t) (uintptr_t) slot->file.data;
+	sqe->len = READ_SIZE;
+	sqe->off = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		stepSlot - Handle the Completion of a Request (Mutex Held)
+ *
+ *	SYNOPSIS
+ *		static void
+ *		stepSlot(
+ *			read_ahead		*ahead,				- Read Ahead
+ *			size_t			index,				- Slot Number
+ *			int				result)				- Result, or -errno
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Each file is opened, then up to READ_SIZE bytes are read from its
+ *		beginning. There is no statx: io_uring always hands it to a kernel
+ *		worker thread, which costs more than it saves for a small file.
+ *		Instead, takeReadAhead checks the size with fstat.
+ *-----------------------------------------------------------------------------
+ */
+
+static void stepSlot (read_ahead *ahead, size_t index, int result)
+{
+	ahead_slot					*slot = &ahead->slots [index];
+	uring						*ring = &ahead->ring;
+	char						*buffer;
+
+	ring->inFlight--;
+
+	if ((slot->step == STEP_READ) && ((result == -EINTR) || (result == -EAGAIN)))
+	{
+		queueRead (ring, slot, index);
+		return;
+	}
+
+	if (result < 0)
+	{
+		if (slot->file.fd != -1)
+			closePemFile (&slot->file);
+		slot->error = -result;
+		shrinkLimit (ahead, slot->error);
+	}
+	else if (slot->step == STEP_OPEN)
+	{
+		slot->file.fd = result;
+		buffer = (char *) malloc (READ_SIZE);
+		if (buffer != (char *) NULL)
+		{
+			slot->file.data = buffer;
+			queueRead (ring, slot, index);
+			return;
+		}
+	}
+	else
+		slot->file.length = (size_t) result;
+
+	if ((slot->file.length == 0) && (slot->file.data != (const char *) NULL))
+	{
+		free ((void *) slot->file.data);
+		slot->file.data = (const char *) NULL;
+	}
+
+	finishSlot (ahead, slot);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		reaper - io_uring Thread
+ *
+ *	SYNOPSIS
+ *		static void *
+ *		reaper(
+ *			void			*arg)				- Read Ahead
+ *
+ *	RETURN VALUE
+ *		NULL
+ *
+ *	DESCRIPTION
+ *		The reaper is the only thread that uses the ring. Each time around,
+ *		it queues openat for every file named since, and one io_uring_enter
+ *		submits those together with the reads that followed the last
+ *		completions, and waits for the next completion. The feeder wakes it
+ *		through an eventfd, which it keeps a read on.
+ *-----------------------------------------------------------------------------
+ */
+
+static void *reaper (void *arg)
+{
+	read_ahead					*ahead = (read_ahead *) arg;
+	uring						*ring = &ahead->ring;
+	ahead_slot					*slot;
+	struct io_uring_sqe			*sqe;
+	struct io_uring_cqe			*cqe;
+	size_t						index;
+	unsigned					head;
+	int							n;
+
+	pthread_mutex_lock (&ahead->mutex);
+	sqe = queueRequest (ring, IORING_OP_READ, ring->event, WAKE_DATA);
+	sqe->addr = (uint64_t) (uintptr_t) &ring->eventCount;
+	sqe->len = sizeof (ring->eventCount);
+	sqe->off = (uint64_t) -1;
+
+	for (;;)
+	{
+		for (; ahead->started < ahead->tail; ahead->started++)
+		{
+			index = ahead->order [ahead->started % ahead->depth];
+			slot = &ahead->slots [index];
+			slot->state = SLOT_BUSY;
+			slot->opened = ahead->finishCount;
+			slot->step = STEP_OPEN;
+			sqe = queueRequest (ring, IORING_OP_OPENAT, AT_FDCWD, index);
+			sqe->addr = (uint64_t) (uintptr_t) slot->filename;
+			sqe->open_flags = O_RDONLY;
+		}
+
+		if (ahead->exhausted && (ring->inFlight == 0))
+			break;
+
+		ring->waiting = true;
+		pthread_mutex_unlock (&ahead->mutex);
+
+		n = (int) syscall (__NR_io_uring_enter, ring->fd, ring->toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if ((n == -1) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+		{
+			fprintf (stderr, "io_uring_enter failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+
+		pthread_mutex_lock (&ahead->mutex);
+		ring->waiting = false;
+		if (n > 0)
+			ring->toSubmit -= (unsigned) n;
+
+		for (head = *ring->cqHead; head != __atomic_load_n (ring->cqTail, __ATOMIC_ACQUIRE); head++)
+		{
+			cqe = &ring->cqes [head & *ring->cqMask];
+			if (cqe->user_data != WAKE_DATA)
+				stepSlot (ahead, (size_t) cqe->user_data, cqe->res);
+			else
+			{
+				sqe = queueRequest (ring, IORING_OP_READ, ring->event, WAKE_DATA);
+				sqe->addr = (uint64_t) (uintptr_t) &ring->eventCount;
+				sqe->len = sizeof (ring->eventCount);
+				sqe->off = (uint64_t) -1;
+			}
+		}
+		__atomic_store_n (ring->cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock (&ahead->mutex);
+	return NULL;
+}
+#endif
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		reader - Reader Thread (without io_uring)
+ *
+ *	SYNOPSIS
+ *		static void *
+ *		reader(
+ *			void			*arg)				- Read Ahead
+ *
+ *	RETURN VALUE
+ *		NULL
+ *-----------------------------------------------------------------------------
+ */
+
+static void *reader (void *arg)
+{
+	read_ahead					*ahead = (read_ahead *) arg;
+	ahead_slot					*slot;
+
+	pthread_mutex_lock (&ahead->mutex);
+	for (;;)
+	{
+		while ((ahead->started == ahead->tail) && (! ahead->exhausted))
+			pthread_cond_wait (&ahead->queued, &ahead->mutex);
+
+		if (ahead->started == ahead->tail)
+			break;
+
+		slot = &ahead->slots [ahead->order [ahead->started++ % ahead->depth]];
+		slot->state = SLOT_BUSY;
+		slot->opened = ahead->finishCount;
+		pthread_mutex_unlock (&ahead->mutex);
+
+		if (! openPemFile (slot->filename, &slot->file))
+		{
+			slot->error = errno;
+			slot->file.fd = -1;
+		}
+
+		pthread_mutex_lock (&ahead->mutex);
+		shrinkLimit (ahead, slot->error);
+		finishSlot (ahead, slot);
+	}
+
+	pthread_mutex_unlock (&ahead->mutex);
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		wakeEngine - Tell the Reaper or Readers about a Change (Mutex Held)
+ *
+ *	DESCRIPTION
+ *		While the reaper has requests in flight, it starts the files named
+ *		meanwhile when the next one completes, so it is only woken when it
+ *		has nothing else to wait for.
+ *-----------------------------------------------------------------------------
+ */
+
+static void wakeEngine (read_ahead *ahead)
+{
+	if (ahead->exhausted)
+	{
+		pthread_cond_broadcast (&ahead->queued);
+		pthread_cond_broadcast (&ahead->ready);
+	}
+	else
+		pthread_cond_signal (&ahead->queued);
+
+#if defined(USE_IO_URING)
+	if (ahead->useRing && ahead->ring.waiting && (ahead->ring.inFlight == 0))
+	{
+		ahead->ring.waiting = false;
+		eventfd_write (ahead->ring.event, 1);
+	}
+#endif
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		feeder - Feeder Thread
+ *
+ *	SYNOPSIS
+ *		static void *
+ *		feeder(
+ *			void			*arg)				- Read Ahead
+ *
+ *	RETURN VALUE
+ *		NULL
+ *
+ *	DESCRIPTION
+ *		Names are taken from the source whenever fewer than limit files
+ *		are waiting to be handed out. The source may block (a pipe, or a
+ *		directory walk), so it has a thread of its own, and files already
+ *		named are read meanwhile.
+ *-----------------------------------------------------------------------------
+ */
+
+static void *feeder (void *arg)
+{
+	read_ahead					*ahead = (read_ahead *) arg;
+	ahead_slot					*slot;
+	char						*filename;
+	size_t						index;
+
+	pthread_mutex_lock (&ahead->mutex);
+	for (;;)
+	{
+		while (ahead->tail - ahead->head >= ahead->limit)
+			pthread_cond_wait (&ahead->space, &ahead->mutex);
+
+		for (index = 0; ahead->slots [index].state != SLOT_FREE; index++)
+			;
+		slot = &ahead->slots [index];
+		slot->state = SLOT_QUEUED;
+		pthread_mutex_unlock (&ahead->mutex);
+
+		filename = (*ahead->source) (ahead->context);
+
+		pthread_mutex_lock (&ahead->mutex);
+		if (filename == (char *) NULL)
+		{
+			slot->state = SLOT_FREE;
+			ahead->exhausted = true;
+			wakeEngine (ahead);
+			break;
+		}
+
+		slot->filename = filename;
+		slot->taken = false;
+		slot->stale = false;
+		slot->file.fd = -1;
+		slot->file.data = (const char *) NULL;
+		slot->file.length = 0;
+		slot->file.mapped = false;
+		slot->error = 0;
+		memset (&slot->identity, 0, sizeof (file_identity));
+		ahead->order [ahead->tail++ % ahead->depth] = index;
+		wakeEngine (ahead);
+	}
+
+	pthread_mutex_unlock (&ahead->mutex);
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		startReadAhead - Start Reading Files Ahead of the Workers
+ *
+ *	SYNOPSIS
+ *		read_ahead *
+ *		startReadAhead(
+ *			work_source		source,				- Supplies each File
+ *			void			*context,			- Passed to source
+ *			int				depth,				- Files Read Ahead
+ *			int				threads)			- Number of Worker Threads
+ *
+ *	RETURN VALUE
+ *		Read ahead, whose files are taken by nextReadAhead.
+ *
+ *	DESCRIPTION
+ *		Each worker holds on to the slot of the file it is processing, so
+ *		there is a slot for each worker besides the depth files read ahead.
+ *		depth is reduced to leave SPARE_FILES descriptors, and a few for each
+ *		worker (its own file, and deleteCert's new file and backup), below
+ *		the limit on open files.
+ *		If memory or threads are exhausted, the error is reported and the
+ *		program exits, as processSource does.
+ *-----------------------------------------------------------------------------
+ */
+
+read_ahead *startReadAhead (work_source source, void *context, int depth, int threads)
+{
+	read_ahead					*ahead;
+	void						*(*engine) (void *) = reader;
+	struct rlimit				files;
+	rlim_t						spare;
+	size_t						i;
+	int							j;
+
+	if (depth > READ_AHEAD_MAX)
+		depth = READ_AHEAD_MAX;
+	if ((getrlimit (RLIMIT_NOFILE, &files) == 0) && (files.rlim_cur != RLIM_INFINITY))
+	{
+		spare = SPARE_FILES + 4 * (rlim_t) threads;
+		if (files.rlim_cur < spare + (rlim_t) depth)
+			depth = (files.rlim_cur > spare) ? (int) (files.rlim_cur - spare) : 1;
+	}
+	if (depth < 1)
+		depth = 1;
+
+	pthread_once (&current_once, createCurrentKey);
+
+	ahead = (read_ahead *) calloc (1, sizeof (read_ahead));
+	if (ahead != (read_ahead *) NULL)
+	{
+		ahead->slotCount = (size_t) depth + (size_t) threads;
+		ahead->slots = (ahead_slot *) calloc (ahead->slotCount, sizeof (ahead_slot));
+		ahead->finished = (file_identity *) calloc (ahead->slotCount, sizeof (file_identity));
+		ahead->order = (size_t *) calloc ((size_t) depth, sizeof (size_t));
+	}
+	if ((ahead == (read_ahead *) NULL) || (ahead->slots == (ahead_slot *) NULL)
+			|| (ahead->finished == (file_identity *) NULL) || (ahead->order == (size_t *) NULL))
+	{
+		fprintf (stderr, "calloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	ahead->source = source;
+	ahead->context = context;
+	ahead->depth = (size_t) depth;
+	ahead->limit = (size_t) depth;
+	for (i = 0; i < ahead->slotCount; i++)
+	{
+		ahead->slots [i].owner = ahead;
+		ahead->slots [i].file.fd = -1;
+	}
+
+	pthread_mutex_init (&ahead->mutex, NULL);
+	pthread_cond_init (&ahead->ready, NULL);
+	pthread_cond_init (&ahead->space, NULL);
+	pthread_cond_init (&ahead->queued, NULL);
+
+	ahead->engineCount = (depth < READER_THREADS) ? depth : READER_THREADS;
+#if defined(USE_IO_URING)
+	ahead->useRing = setupRing (&ahead->ring, (unsigned) depth + 1);
+	if (ahead->useRing)
+	{
+		engine = reaper;
+		ahead->engineCount = 1;
+	}
+#endif
+
+	ahead->engines = (pthread_t *) calloc ((size_t) ahead->engineCount, sizeof (pthread_t));
+	if (ahead->engines == (pthread_t *) NULL)
+	{
+		fprintf (stderr, "calloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	for (j = 0; j < ahead->engineCount; j++)
+	{
+		if (pthread_create (&ahead->engines [j], NULL, engine, ahead) != 0)
+		{
+			fprintf (stderr, "pthread_create failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+	}
+
+	if (pthread_create (&ahead->feeder, NULL, feeder, ahead) != 0)
+	{
+		fprintf (stderr, "pthread_create failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	return ahead;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextReadAhead - Next File that has been Read
+ *
+ *	SYNOPSIS
+ *		char *
+ *		nextReadAhead(
+ *			void			*readAhead)			- Read Ahead
+ *
+ *	RETURN VALUE
+ *		Next filename from the source (to be freed by the caller), once the
+ *		file has been read, or NULL when there are no more. Suitable as a
+ *		work_source for processSource.
+ *
+ *	DESCRIPTION
+ *		The file is kept for takeReadAhead on the calling thread until that
+ *		thread asks for the next one. If it was not taken by then (it was
+ *		skipped, or reported from an index), it is released unread.
+ *-----------------------------------------------------------------------------
+ */
+
+char *nextReadAhead (void *readAhead)
+{
+	read_ahead					*ahead = (read_ahead *) readAhead;
+	ahead_slot					*slot;
+	char						*filename;
+
+	slot = (ahead_slot *) pthread_getspecific (current_key);
+	pthread_setspecific (current_key, NULL);
+
+	pthread_mutex_lock (&ahead->mutex);
+	if (slot != (ahead_slot *) NULL)
+		releaseSlot (ahead, slot);
+
+	for (;;)
+	{
+		slot = &ahead->slots [ahead->order [ahead->head % ahead->depth]];
+		if ((ahead->head < ahead->tail) && (slot->state == SLOT_DONE))
+			break;
+		if ((ahead->head == ahead->tail) && ahead->exhausted)
+		{
+			pthread_mutex_unlock (&ahead->mutex);
+			return (char *) NULL;
+		}
+		pthread_cond_wait (&ahead->ready, &ahead->mutex);
+	}
+
+	ahead->head++;
+	slot->state = SLOT_HANDED;
+	pthread_cond_signal (&ahead->space);
+	filename = strdup (slot->filename);
+	pthread_mutex_unlock (&ahead->mutex);
+
+	if (filename == (char *) NULL)
+	{
+		fprintf (stderr, "strdup failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	pthread_setspecific (current_key, slot);
+	return filename;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		takeReadAhead - Take the Contents of a File that has been Read
+ *
+ *	SYNOPSIS
+ *		bool
+ *		takeReadAhead(
+ *			const char		*filename,			- File to Open
+ *			pem_file		*file)				- Contents of File
+ *
+ *	RETURN VALUE
+ *		true if filename is the file last handed to this thread, and it was
+ *		not rewritten (under another name) since it was read ahead. Then
+ *		*file is what was read (to be released with closePemFile), or its fd
+ *		is -1 (with errno set) if the file could not be opened.
+ *
+ *	DESCRIPTION
+ *		Unless all of the file was read (its size is what fstat reports),
+ *		only the open file is taken, and data is NULL; openPemFile then
+ *		reads or maps it as usual. If it could not be opened for want of
+ *		descriptors, false is returned, so openPemFile tries again.
+ *-----------------------------------------------------------------------------
+ */
+
+bool takeReadAhead (const char *filename, pem_file *file)
+{
+	ahead_slot					*slot;
+	struct stat					st;
+	file_identity				identity;
+	bool						stale = false;
+
+	pthread_once (&current_once, createCurrentKey);
+
+	slot = (ahead_slot *) pthread_getspecific (current_key);
+	if ((slot == (ahead_slot *) NULL) || slot->taken || (strcmp (slot->filename, filename) != 0))
+		return false;
+
+	slot->taken = true;
+	memset (&identity, 0, sizeof (identity));
+	if ((slot->file.fd == -1) && ((slot->error == EMFILE) || (slot->error == ENFILE)))
+		stale = true;
+	else if (slot->file.fd != -1)
+	{
+		if (fstat (slot->file.fd, &st) == -1)
+			stale = true;
+		else
+		{
+			identity.dev = st.st_dev;
+			identity.ino = st.st_ino;
+			identity.known = true;
+
+			if ((slot->file.length != (size_t) st.st_size) && (slot->file.data != (const char *) NULL))
+			{
+				if (slot->file.mapped)
+					munmap ((void *) slot->file.data, slot->file.length);
+				else
+					free ((void *) slot->file.data);
+				slot->file.data = (const char *) NULL;
+				slot->file.length = 0;
+				slot->file.mapped = false;
+			}
+		}
+	}
+
+	/* Other threads compare identities under the mutex */
+	pthread_mutex_lock (&slot->owner->mutex);
+	slot->identity = identity;
+	stale = stale || staleSlot (slot->owner, slot);
+	slot->stale = stale;
+	pthread_mutex_unlock (&slot->owner->mutex);
+
+	if (stale)
+	{
+		if (slot->file.fd != -1)
+			closePemFile (&slot->file);
+		return false;
+	}
+
+	*file = slot->file;
+	slot->file.fd = -1;
+	slot->file.data = (const char *) NULL;
+	slot->file.length = 0;
+
+	if (file->fd == -1)
+		errno = slot->error;
+
+	return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		endReadAhead - Release a Read Ahead
+ *
+ *	SYNOPSIS
+ *		void
+ *		endReadAhead(
+ *			read_ahead		*readAhead)			- Read Ahead
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Called once nextReadAhead has returned NULL, and every worker has
+ *		finished.
+ *-----------------------------------------------------------------------------
+ */
+
+void endReadAhead (read_ahead *readAhead)
+{
+	size_t						i;
+	int							j;
+
+	pthread_join (readAhead->feeder, NULL);
+	for (j = 0; j < readAhead->engineCount; j++)
+		pthread_join (readAhead->engines [j], NULL);
+
+	pthread_setspecific (current_key, NULL);
+	for (i = 0; i < readAhead->slotCount; i++)
+	{
+		if (readAhead->slots [i].filename != (char *) NULL)
+			releaseSlot (readAhead, &readAhead->slots [i]);
+	}
+
+#if defined(USE_IO_URING)
+	if (readAhead->useRing)
+		closeRing (&readAhead->ring);
+#endif
+
+	pthread_mutex_destroy (&readAhead->mutex);
+	pthread_cond_destroy (&readAhead->ready);
+	pthread_cond_destroy (&readAhead->space);
+	pthread_cond_destroy (&readAhead->queued);
+	free (readAhead->engines);
+	free (readAhead->slots);
+	free (readAhead->order);
+	free (readAhead->finished);
+	free (readAhead);
+}
@@ -0,0 +1,22 @@
+/*-----------------------------------------------------------------------------
+ *	readAhead, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include "pemScan.h"
+#include "workPool.h"
+
+#define READ_AHEAD_DEFAULT		256				/* Files read ahead */
+
+typedef struct read_ahead read_ahead;
+
+read_ahead *startReadAhead (work_source source, void *context, int depth, int threads);
+char *nextReadAhead (void *readAhead);
+void endReadAhead (read_ahead *readAhead);
+bool takeReadAhead (const char *filename, pem_file *file);
+
+#endif
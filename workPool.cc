@@ -0,0 +1,525 @@
+/*-----------------------------------------------------------------------------
+ *	workPool, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "readAhead.h"
+#include "workPool.h"
+
+/*-----------------------------------------------------------------------------
+ *	Output of one file, waiting to be emitted in order.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	char					*buffer;
+	size_t					length;
+	bool					done;
+}
+work_result;
+
+typedef struct
+{
+	work_source				source;
+	void					*context;
+	bool					exhausted;			/* source returned NULL */
+	int						next;				/* Next file to be started */
+	int						emitted;			/* Next file to be emitted */
+	int						window;				/* Maximum files in flight */
+	work_function			function;
+	work_result				*results;			/* Indexed by file % window */
+	pthread_mutex_t			mutex;
+	pthread_cond_t			cond;
+	pthread_mutex_t			sourceMutex;		/* Held while calling source */
+}
+work_pool;
+
+/*-----------------------------------------------------------------------------
+ *	Files named on the command line.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	const char				**filenames;
+	int						count;
+	int						next;
+}
+argument_list;
+
+static const char			*output_separator = (const char *) NULL;
+static bool					output_started = false;
+static int					read_ahead_depth = 0;
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		defaultThreads - Default Number of Worker Threads
+ *
+ *	SYNOPSIS
+ *		int
+ *		defaultThreads(void)
+ *
+ *	RETURN VALUE
+ *		Number of online processors (at least 1).
+ *-----------------------------------------------------------------------------
+ */
+
+int defaultThreads (void)
+{
+	long						n = sysconf (_SC_NPROCESSORS_ONLN);
+
+	return (n < 1) ? 1 : (int) n;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		setSeparator - Set Separator between the Output of two Files
+ *
+ *	SYNOPSIS
+ *		void
+ *		setSeparator(
+ *			const char		*separator)			- Separator, or NULL
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		The separator is written between the output of any two files that
+ *		both produced output (for example, the comma between the records
+ *		of a JSON array).
+ *-----------------------------------------------------------------------------
+ */
+
+void setSeparator (const char *separator)
+{
+	output_separator = separator;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		setReadAhead - Set Number of Files Read Ahead of the Workers
+ *
+ *	SYNOPSIS
+ *		void
+ *		setReadAhead(
+ *			int				depth)				- Files, or 0 for None
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		With read ahead, processSource opens and reads up to depth files
+ *		at once (see readAhead) before handing them to the workers, whose
+ *		work_function must open each file with openPemFile.
+ *-----------------------------------------------------------------------------
+ */
+
+void setReadAhead (int depth)
+{
+	read_ahead_depth = depth;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		emitOutput - Write the Output of one File to stdout
+ *
+ *	SYNOPSIS
+ *		static void
+ *		emitOutput(
+ *			const char		*buffer,			- Output of File
+ *			size_t			length)				- Length of Output
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Called from one thread only, in file order. stdout is not flushed
+ *		here; it is written whenever its buffer fills.
+ *-----------------------------------------------------------------------------
+ */
+
+static void emitOutput (const char *buffer, size_t length)
+{
+	if (length == 0)
+		return;
+
+	if (output_started && (output_separator != (const char *) NULL))
+		fputs (output_separator, stdout);
+
+	fwrite (buffer, 1, length, stdout);
+	output_started = true;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		worker - Worker Thread
+ *
+ *	SYNOPSIS
+ *		static void *
+ *		worker(
+ *			void			*arg)				- Work Pool
+ *
+ *	RETURN VALUE
+ *		NULL
+ *
+ *	DESCRIPTION
+ *		Each worker repeatedly claims the next file, processes it into a
+ *		memory stream, and posts the result. A worker does not start a file
+ *		more than window files ahead of the output, which bounds memory.
+ *
+ *		Files are claimed under sourceMutex, so that file numbers follow
+ *		the order of the source even though the source may block; the pool
+ *		mutex is not held meanwhile, so finished files are still emitted.
+ *-----------------------------------------------------------------------------
+ */
+
+static void *worker (void *arg)
+{
+	work_pool					*pool = (work_pool *) arg;
+	work_result					*result;
+	char						*filename;
+	char						*buffer;
+	size_t						length;
+	FILE						*out;
+	int							i;
+
+	for (;;)
+	{
+		pthread_mutex_lock (&pool->sourceMutex);
+
+		pthread_mutex_lock (&pool->mutex);
+		while ((! pool->exhausted) && (pool->next >= pool->emitted + pool->window))
+			pthread_cond_wait (&pool->cond, &pool->mutex);
+		pthread_mutex_unlock (&pool->mutex);
+
+		filename = pool->exhausted ? (char *) NULL : (*pool->source) (pool->context);
+
+		pthread_mutex_lock (&pool->mutex);
+		if (filename == (char *) NULL)
+		{
+			pool->exhausted = true;
+			pthread_cond_broadcast (&pool->cond);
+			pthread_mutex_unlock (&pool->mutex);
+			pthread_mutex_unlock (&pool->sourceMutex);
+			break;
+		}
+		i = pool->next++;
+		pthread_mutex_unlock (&pool->mutex);
+
+		pthread_mutex_unlock (&pool->sourceMutex);
+
+		buffer = (char *) NULL;
+		length = 0;
+		out = open_memstream (&buffer, &length);
+		if (out == (FILE *) NULL)
+			fprintf (stderr, "open_memstream (%s) failed <%s>\n", filename, strerror (errno));
+		else
+		{
+			(*pool->function) (filename, out);
+			fclose (out);
+		}
+		free (filename);
+
+		pthread_mutex_lock (&pool->mutex);
+		result = &pool->results [i % pool->window];
+		result->buffer = buffer;
+		result->length = length;
+		result->done = true;
+		pthread_cond_broadcast (&pool->cond);
+		pthread_mutex_unlock (&pool->mutex);
+	}
+
+	return NULL;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextArgument - Next File Named on the Command Line
+ *
+ *	SYNOPSIS
+ *		static char *
+ *		nextArgument(
+ *			void			*context)			- Argument List
+ *
+ *	RETURN VALUE
+ *		Copy of the next filename, or NULL when there are no more.
+ *-----------------------------------------------------------------------------
+ */
+
+static char *nextArgument (void *context)
+{
+	argument_list				*list = (argument_list *) context;
+	char						*filename;
+
+	if (list->next >= list->count)
+		return (char *) NULL;
+
+	filename = strdup (list->filenames [list->next++]);
+	if (filename == (char *) NULL)
+	{
+		fprintf (stderr, "strdup failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	return filename;
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		nextName - Next Filename from a Stream
+ *
+ *	SYNOPSIS
+ *		char *
+ *		nextName(
+ *			void			*list)				- Name List
+ *
+ *	RETURN VALUE
+ *		Next filename (to be freed by the caller), or NULL at end of file.
+ *		Suitable as a work_source for processSource.
+ *
+ *	DESCRIPTION
+ *		Names are read one at a time as the pool needs them, so a list of
+ *		any length (for example from "find ... -print0") is processed in
+ *		bounded memory while it is still being produced. Empty names are
+ *		skipped, and a CR before a newline is removed.
+ *-----------------------------------------------------------------------------
+ */
+
+char *nextName (void *list)
+{
+	name_list					*names = (name_list *) list;
+	char						*name;
+	size_t						size;
+	ssize_t						length;
+
+	for (;;)
+	{
+		name = (char *) NULL;
+		size = 0;
+		length = getdelim (&name, &size, names->delimiter, names->in);
+		if (length == -1)
+		{
+			free (name);
+			return (char *) NULL;
+		}
+
+		if ((length > 0) && (name [length - 1] == names->delimiter))
+			name [--length] = '\0';
+		if ((names->delimiter == '\n') && (length > 0) && (name [length - 1] == '\r'))
+			name [--length] = '\0';
+
+		if (length > 0)
+			return name;
+
+		free (name);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		processFiles - Process Files in Parallel with Ordered Output
+ *
+ *	SYNOPSIS
+ *		void
+ *		processFiles(
+ *			int				count,				- Number of Files
+ *			const char		**filenames,		- Files to Process
+ *			int				threads,			- Number of Worker Threads
+ *			work_function	function)			- Called for each File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		Process the files named on the command line; see processSource.
+ *-----------------------------------------------------------------------------
+ */
+
+void processFiles (int count, const char **filenames, int threads, work_function function)
+{
+	argument_list				list;
+
+	list.filenames = filenames;
+	list.count = count;
+	list.next = 0;
+
+	if (threads > count)
+		threads = count;
+
+	processSource (nextArgument, &list, threads, function);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		runPool - Process Files in Parallel with Ordered Output
+ *
+ *	SYNOPSIS
+ *		static void
+ *		runPool(
+ *			work_source		source,				- Supplies each File
+ *			void			*context,			- Passed to source
+ *			int				threads,			- Number of Worker Threads
+ *			work_function	function)			- Called for each File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		With one thread, each file is processed directly to stdout (or, if
+ *		there is a separator, to memory). With more, files are processed
+ *		concurrently and the main thread writes each file's output to stdout
+ *		as soon as all earlier files are done, so the output is identical to
+ *		serial processing.
+ *
+ *		Files are taken from the source only as workers are ready for them,
+ *		so the complete list of files is never held in memory.
+ *-----------------------------------------------------------------------------
+ */
+
+static void runPool (work_source source, void *context, int threads, work_function function)
+{
+	work_pool					pool;
+	work_result					*result;
+	pthread_t					*tids;
+	char						*filename;
+	char						*buffer;
+	size_t						length;
+	FILE						*out;
+	int							i;
+
+	if (threads <= 1)
+	{
+		while ((filename = (*source) (context)) != (char *) NULL)
+		{
+			if (output_separator == (const char *) NULL)
+				(*function) (filename, stdout);
+			else
+			{
+				buffer = (char *) NULL;
+				length = 0;
+				out = open_memstream (&buffer, &length);
+				if (out == (FILE *) NULL)
+					fprintf (stderr, "open_memstream (%s) failed <%s>\n", filename, strerror (errno));
+				else
+				{
+					(*function) (filename, out);
+					fclose (out);
+					emitOutput (buffer, length);
+				}
+				free (buffer);
+			}
+			free (filename);
+		}
+		return;
+	}
+
+	pool.source = source;
+	pool.context = context;
+	pool.exhausted = false;
+	pool.next = 0;
+	pool.emitted = 0;
+	pool.window = threads * 4;
+	pool.function = function;
+	pool.results = (work_result *) calloc (pool.window, sizeof (work_result));
+	tids = (pthread_t *) calloc (threads, sizeof (pthread_t));
+	if ((pool.results == (work_result *) NULL) || (tids == (pthread_t *) NULL))
+	{
+		fprintf (stderr, "calloc failed <%s>\n", strerror (errno));
+		exit (1);
+	}
+
+	pthread_mutex_init (&pool.mutex, NULL);
+	pthread_cond_init (&pool.cond, NULL);
+	pthread_mutex_init (&pool.sourceMutex, NULL);
+
+	for (i = 0; i < threads; i++)
+	{
+		if (pthread_create (&tids [i], NULL, worker, &pool) != 0)
+		{
+			fprintf (stderr, "pthread_create failed <%s>\n", strerror (errno));
+			exit (1);
+		}
+	}
+
+	/*-------------------------------------------------------------------------
+	 *	Emit the output of each file in order, until the source is exhausted
+	 *	and every file it supplied has been emitted.
+	 *-------------------------------------------------------------------------
+	 */
+
+	pthread_mutex_lock (&pool.mutex);
+	for (;;)
+	{
+		result = &pool.results [pool.emitted % pool.window];
+		while ((! result->done) && ! (pool.exhausted && (pool.emitted == pool.next)))
+			pthread_cond_wait (&pool.cond, &pool.mutex);
+
+		if (! result->done)
+			break;
+		pthread_mutex_unlock (&pool.mutex);
+
+		emitOutput (result->buffer, result->length);
+		free (result->buffer);
+
+		pthread_mutex_lock (&pool.mutex);
+		result->buffer = (char *) NULL;
+		result->done = false;
+		pool.emitted++;
+		pthread_cond_broadcast (&pool.cond);
+	}
+	pthread_mutex_unlock (&pool.mutex);
+
+	for (i = 0; i < threads; i++)
+		pthread_join (tids [i], NULL);
+
+	pthread_mutex_destroy (&pool.sourceMutex);
+	pthread_cond_destroy (&pool.cond);
+	pthread_mutex_destroy (&pool.mutex);
+	free (pool.results);
+	free (tids);
+}
+
+/*-----------------------------------------------------------------------------
+ *	NAME
+ *		processSource - Process Files in Parallel with Ordered Output
+ *
+ *	SYNOPSIS
+ *		void
+ *		processSource(
+ *			work_source		source,				- Supplies each File
+ *			void			*context,			- Passed to source
+ *			int				threads,			- Number of Worker Threads
+ *			work_function	function)			- Called for each File
+ *
+ *	RETURN VALUE
+ *		None
+ *
+ *	DESCRIPTION
+ *		See runPool. If read ahead is set, the files are read ahead of the
+ *		workers, in the order of the source.
+ *-----------------------------------------------------------------------------
+ */
+
+void processSource (work_source source, void *context, int threads, work_function function)
+{
+	read_ahead					*ahead;
+
+	if (read_ahead_depth <= 0)
+	{
+		runPool (source, context, threads, function);
+		return;
+	}
+
+	ahead = startReadAhead (source, context, read_ahead_depth, threads);
+	runPool (nextReadAhead, ahead, threads, function);
+	endReadAhead (ahead);
+}
@@ -0,0 +1,48 @@
+/*-----------------------------------------------------------------------------
+ *	workPool, Copyright (C) 2021 Herb Weiner. All rights reserved.
+ *	CC BY-SA 4.0: https://creativecommons.org/licenses/by-sa/4.0
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stdio.h>
+
+/*-----------------------------------------------------------------------------
+ *	Called (possibly concurrently) for each file. All report output must be
+ *	written to out, which is emitted to stdout in the original file order.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef void (*work_function) (const char *filename, FILE *out);
+
+/*-----------------------------------------------------------------------------
+ *	Returns the next file to process (allocated with malloc, and freed by
+ *	the pool), or NULL when there are no more. Called by one thread at a
+ *	time, and may block until a file is available.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef char *(*work_source) (void *context);
+
+/*-----------------------------------------------------------------------------
+ *	Filenames read from a stream, one per line or NUL terminated.
+ *-----------------------------------------------------------------------------
+ */
+
+typedef struct
+{
+	FILE					*in;
+	int						delimiter;			/* '\n' or '\0' */
+}
+name_list;
+
+int defaultThreads (void);
+void processFiles (int count, const char **filenames, int threads, work_function function);
+void processSource (work_source source, void *context, int threads, work_function function);
+void setSeparator (const char *separator);
+void setReadAhead (int depth);
+char *nextName (void *list);
+
+#endif